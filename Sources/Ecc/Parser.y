@@ -336,11 +336,19 @@ event_declaration
       _strCurrentEvent);
     fprintf(_fDeclaration, "%s();\n", _strCurrentEvent );
     fprintf(_fDeclaration, "CEntityEvent *MakeCopy(void);\n");
+    fprintf(_fDeclaration, "CEntityEvent *MakeCopyAt(void *pvMemory);\n");
+    fprintf(_fDeclaration, "SLONG GetSizeOf(void) { return sizeof(*this); };\n");
+    fprintf(_fDeclaration, "const char *GetName(void) { return \"%s\"; };\n", _strCurrentEvent);
     fprintf(_fImplementation, 
       "CEntityEvent *%s::MakeCopy(void) { "
       "CEntityEvent *peeCopy = new %s(*this); "
       "return peeCopy;}\n",
       _strCurrentEvent, _strCurrentEvent);
+    fprintf(_fImplementation, 
+      "CEntityEvent *%s::MakeCopyAt(void *pvMemory) { "
+      "CEntityEvent *peeCopy = new(pvMemory) %s(*this); "
+      "return peeCopy;}\n",
+      _strCurrentEvent, _strCurrentEvent);
     fprintf(_fImplementation, "%s::%s() : CEntityEvent(EVENTCODE_%s) {;\n",
       _strCurrentEvent, _strCurrentEvent, _strCurrentEvent);
   } '{' event_members_list opt_comma '}' ';' {
@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/Unzip.h>
 #include <Engine/Base/CRC.h>
 #include <Engine/Base/Shell.h>
+#include <Engine/Base/Synchronization.h>
 #include <Engine/Templates/NameTable_CTFileName.h>
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Templates/DynamicStackArray.cpp>
@@ -44,6 +45,8 @@ ULONG _ulPageSize = 0;
 // maximum lenght of file that can be saved (default: 128Mb)
 ULONG _ulMaxLenghtOfSavingFile = (1UL<<20)*128;
 extern INDEX fil_bPreferZips = FALSE;
+extern INDEX fil_bMapFiles = TRUE;
+extern INDEX fil_iLoaderThreads = 2;  // threads that read files ahead when stocks prefetch them (0=none)
 
 // set if current thread has currently enabled stream handling
 static _declspec(thread) BOOL _bThreadCanHandleStreams = FALSE;
@@ -245,6 +248,8 @@ void InitStreams(void)
 
 void EndStreams(void)
 {
+  extern void EndFilePreloading(void);
+  EndFilePreloading();
 }
 
 
@@ -821,6 +826,16 @@ void CTStream::DictionaryReadEnd_t(void)
 void CTStream::DictionaryPreload_t(void)
 {
   INDEX ctFileNames = strm_afnmDictionary.Count();
+  // let loader threads read all files ahead, while they are loaded one by one below
+  {for(INDEX iFileName=0; iFileName<ctFileNames; iFileName++) {
+    CTFileName &fnm = strm_afnmDictionary[iFileName];
+    CTString strExt = fnm.FileExt();
+    if (strExt==".tex") {
+      _pTextureStock->Prefetch(fnm);
+    } else if (strExt==".mdl") {
+      _pModelStock->Prefetch(fnm);
+    }
+  }}
   // for each filename
   for(INDEX iFileName=0; iFileName<ctFileNames; iFileName++) {
     // preload it
@@ -837,6 +852,15 @@ void CTStream::DictionaryPreload_t(void)
       CPrintF( TRANS("Cannot preload %s: %s\n"), (CTString&)fnm, strError);
     }
   }
+  // files that failed to load before being opened are not needed anymore
+  // (only this dictionary's ones, others may still be read ahead for someone else)
+  {for(INDEX iFileName=0; iFileName<ctFileNames; iFileName++) {
+    CTFileName &fnm = strm_afnmDictionary[iFileName];
+    CTString strExt = fnm.FileExt();
+    if (strExt==".tex" || strExt==".mdl") {
+      DiscardPreloadedFile(fnm);
+    }
+  }}
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -862,6 +886,401 @@ CTStream::~CTStream(void)
 /////////////////////////////////////////////////////////////////////////////
 // File stream opening/closing methods
 
+// map a read-only view of a part of a file (slSize<0 for rest of the file)
+// returns pointer to data (NULL if mapping is not possible) and base of the view to unmap
+static UBYTE *MapFileView(const CTFileName &fnmFile, SLONG slOffset, SLONG &slSize, void *&pvView)
+{
+  pvView = NULL;
+  HANDLE hFile = CreateFileA(fnmFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile==INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  if (slSize<0) {
+    slSize = GetFileSize(hFile, NULL)-slOffset;
+  }
+  // empty files cannot be mapped
+  if (slSize<=0) {
+    CloseHandle(hFile);
+    return NULL;
+  }
+  HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(hFile);
+  if (hMapping==NULL) {
+    return NULL;
+  }
+  // view must start at allocation granularity
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  SLONG slViewOffset = slOffset-slOffset%si.dwAllocationGranularity;
+  // view keeps the mapping open by itself
+  pvView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, slViewOffset, slOffset-slViewOffset+slSize);
+  CloseHandle(hMapping);
+  if (pvView==NULL) {
+    return NULL;
+  }
+  return (UBYTE*)pvView+(slOffset-slViewOffset);
+}
+
+// open a file for reading: map it, unpack it from zip or open it on disk
+// (loader threads use this too, so it must not touch any stream state)
+static void OpenForReading_t(INDEX iFile, const CTFileName &fnmFullFileName, FILE *&pFile,
+  INDEX &iZipHandle, UBYTE *&pubBuffer, SLONG &slBufferSize, void *&pvMappedView)
+{
+  // if zip file
+  if( iFile==EFP_MODZIP || iFile==EFP_BASEZIP) {
+    // open from zip
+    iZipHandle = UNZIPOpen_t(fnmFullFileName);
+    slBufferSize = UNZIPGetSize(iZipHandle);
+    // if the entry is stored uncompressed
+    CTFileName fnmZip;
+    SLONG slOffset, slSizeCompressed, slSizeUncompressed;
+    BOOL bCompressed;
+    UNZIPGetFileInfo(iZipHandle, fnmZip, slOffset, slSizeCompressed, slSizeUncompressed, bCompressed);
+    if (fil_bMapFiles && !bCompressed && slBufferSize>0) {
+      // use its data directly from the archive
+      pubBuffer = MapFileView(fnmZip, slOffset, slBufferSize, pvMappedView);
+    }
+    // if not mapped
+    if (pubBuffer==NULL) {
+      // load the file from the zip in the buffer
+      pubBuffer = (UBYTE*)VirtualAlloc(NULL, slBufferSize, MEM_COMMIT, PAGE_READWRITE);
+      UNZIPReadBlock_t(iZipHandle, (UBYTE*)pubBuffer, 0, slBufferSize);
+    }
+  // if it is a physical file
+  } else if (iFile==EFP_FILE) {
+    // try to map it in memory
+    if (fil_bMapFiles) {
+      slBufferSize = -1;
+      pubBuffer = MapFileView(fnmFullFileName, 0, slBufferSize, pvMappedView);
+    }
+    // if not mapped
+    if (pubBuffer==NULL) {
+      // open file in read only mode
+      slBufferSize = 0;
+      pFile = fopen(fnmFullFileName, "rb");
+    }
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// File preloading
+
+// Stocks can ask for files they will load soon. Loader threads then read them from disk and
+// unpack them from zips ahead of time, and CTFileStream::Open_t() just takes the ready buffer.
+// Parsing the files still happens on the thread that opens them.
+
+#define MAX_LOADERTHREADS 8
+#define MAX_PRELOADEDBYTES (64*1024*1024) // loader threads wait when this much is ready, but not opened
+#define PRELOAD_HASHSIZE 256
+
+#define PFS_QUEUED    0   // waiting for loader thread
+#define PFS_LOADING   1   // loader thread is reading it
+#define PFS_READY     2   // buffer is ready to be taken
+#define PFS_NOTLOADED 3   // cannot be preloaded (stream will open it as usual)
+
+// a file that is read ahead
+class CPreloadedFile {
+public:
+  CListNode pf_lnInHash;      // node in list of files with same hash
+  CListNode pf_lnInQueue;     // node in queue for loader threads (if queued)
+  CTFileName pf_fnmFile;      // filename as requested
+  CTFileName pf_fnmFullFile;  // expanded filename
+  INDEX pf_iState;
+  BOOL  pf_bDiscarded;        // nobody wants it anymore, loader thread should free it
+  INDEX pf_iZipHandle;
+  UBYTE *pf_pubBuffer;
+  SLONG pf_slBufferSize;
+  void *pf_pvMappedView;
+
+  CPreloadedFile(void) {
+    pf_iState = PFS_QUEUED;
+    pf_bDiscarded = FALSE;
+    pf_iZipHandle = -1;
+    pf_pubBuffer = NULL;
+    pf_slBufferSize = 0;
+    pf_pvMappedView = NULL;
+  }
+  ~CPreloadedFile(void) {
+    if (pf_iZipHandle>=0) {
+      UNZIPClose(pf_iZipHandle);
+    }
+    if (pf_pvMappedView!=NULL) {
+      UnmapViewOfFile(pf_pvMappedView);
+    } else if (pf_pubBuffer!=NULL) {
+      VirtualFree(pf_pubBuffer, 0, MEM_RELEASE);
+    }
+  }
+};
+
+static CTCriticalSection _csPreload;   // guards all preloaded files and the queue
+static CListHead _alhPreloaded[PRELOAD_HASHSIZE];
+static CListHead _lhPreloadQueue;
+static SLONG _slPreloadedBytes = 0;    // bytes that are ready, but not yet taken
+static HANDLE _ahLoaderThreads[MAX_LOADERTHREADS];
+static INDEX _ctLoaderThreads = 0;
+static HANDLE _hPreloadEvent = NULL;   // signaled when a file is queued or taken
+static volatile BOOL _bStopLoaders = FALSE;
+
+
+// find preloaded file by name (must be called inside _csPreload)
+static CPreloadedFile *FindPreloadedFile(const CTFileName &fnm)
+{
+  CListHead &lh = _alhPreloaded[fnm.GetHash()%PRELOAD_HASHSIZE];
+  FOREACHINLIST(CPreloadedFile, pf_lnInHash, lh, itpf) {
+    if (itpf->pf_fnmFile==fnm) {
+      return &*itpf;
+    }
+  }
+  return NULL;
+}
+
+
+// forget a preloaded file (must be called inside _csPreload)
+static void RemovePreloadedFile(CPreloadedFile *ppf)
+{
+  if (ppf->pf_iState==PFS_READY) {
+    _slPreloadedBytes -= ppf->pf_slBufferSize;
+  }
+  if (ppf->pf_lnInQueue.IsLinked()) {
+    ppf->pf_lnInQueue.Remove();
+  }
+  ppf->pf_lnInHash.Remove();
+}
+
+
+// read the file in loader thread
+static void LoadPreloadedFile(CPreloadedFile &pf)
+{
+  FILE *pFile = NULL;
+  try {
+    INDEX iFile = ExpandFilePath(EFP_READ, pf.pf_fnmFile, pf.pf_fnmFullFile);
+    OpenForReading_t(iFile, pf.pf_fnmFullFile, pFile, pf.pf_iZipHandle,
+      pf.pf_pubBuffer, pf.pf_slBufferSize, pf.pf_pvMappedView);
+  } catch (char *) {
+    // stream will report the error when opening it
+  }
+  // files that are not in memory are better opened by stream itself
+  if (pFile!=NULL) {
+    fclose(pFile);
+  }
+  if (pf.pf_pubBuffer==NULL) {
+    pf.pf_iState = PFS_NOTLOADED;
+    return;
+  }
+  // if mapped, touch each page so that it is read from disk now
+  if (pf.pf_pvMappedView!=NULL) {
+    volatile UBYTE ubTouch = 0;
+    for (SLONG slOffset=0; slOffset<pf.pf_slBufferSize; slOffset+=4096) {
+      ubTouch += pf.pf_pubBuffer[slOffset];
+    }
+  }
+  pf.pf_iState = PFS_READY;
+}
+
+
+static DWORD WINAPI LoaderThread(LPVOID lpParam)
+{
+  while (!_bStopLoaders) {
+    // take first queued file, if there is room for it
+    CPreloadedFile *ppf = NULL;
+    {
+      CTSingleLock slPreload(&_csPreload, TRUE);
+      if (!_lhPreloadQueue.IsEmpty() && _slPreloadedBytes<MAX_PRELOADEDBYTES) {
+        ppf = LIST_HEAD(_lhPreloadQueue, CPreloadedFile, pf_lnInQueue);
+        ppf->pf_lnInQueue.Remove();
+        ppf->pf_iState = PFS_LOADING;
+      }
+    }
+    // if nothing to read, wait until something is queued or taken
+    if (ppf==NULL) {
+      WaitForSingleObject(_hPreloadEvent, 10);
+      continue;
+    }
+
+    CPreloadedFile pfLoaded;
+    pfLoaded.pf_fnmFile = ppf->pf_fnmFile;
+    LoadPreloadedFile(pfLoaded);
+
+    CTSingleLock slPreload(&_csPreload, TRUE);
+    // if it was discarded meanwhile, just free it
+    if (ppf->pf_bDiscarded) {
+      delete ppf;
+      continue;  // loaded data is freed with pfLoaded
+    }
+    // publish what was loaded
+    ppf->pf_fnmFullFile = pfLoaded.pf_fnmFullFile;
+    ppf->pf_iState      = pfLoaded.pf_iState;
+    ppf->pf_iZipHandle  = pfLoaded.pf_iZipHandle;
+    ppf->pf_pubBuffer   = pfLoaded.pf_pubBuffer;
+    ppf->pf_slBufferSize= pfLoaded.pf_slBufferSize;
+    ppf->pf_pvMappedView= pfLoaded.pf_pvMappedView;
+    pfLoaded.pf_iZipHandle = -1;
+    pfLoaded.pf_pubBuffer = NULL;
+    pfLoaded.pf_pvMappedView = NULL;
+    if (ppf->pf_iState==PFS_READY) {
+      _slPreloadedBytes += ppf->pf_slBufferSize;
+    }
+  }
+  return 0;
+}
+
+
+static BOOL StartLoaderThreads(void)
+{
+  if (_ctLoaderThreads>0) return TRUE;
+  _csPreload.cs_iIndex = -1;
+  _bStopLoaders = FALSE;
+  _hPreloadEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (_hPreloadEvent==NULL) return FALSE;
+
+  fil_iLoaderThreads = Clamp(fil_iLoaderThreads, 0L, (INDEX)MAX_LOADERTHREADS);
+  for (INDEX iThread=0; iThread<fil_iLoaderThreads; iThread++) {
+    DWORD dwThreadId;
+    HANDLE hThread = CreateThread(NULL, 0, LoaderThread, NULL, 0, &dwThreadId);
+    if (hThread==NULL) break;
+    _ahLoaderThreads[_ctLoaderThreads++] = hThread;
+  }
+  // if no thread could be started, files are read only when opened
+  if (_ctLoaderThreads==0) {
+    CloseHandle(_hPreloadEvent);
+    _hPreloadEvent = NULL;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+// let loader threads read a file that will be opened soon
+void PreloadFile(const CTFileName &fnmFile)
+{
+  if (fil_iLoaderThreads<=0 || fnmFile=="") {
+    return;
+  }
+  if (!StartLoaderThreads()) {
+    return;
+  }
+  CTSingleLock slPreload(&_csPreload, TRUE);
+  // if already requested, don't read it twice
+  if (FindPreloadedFile(fnmFile)!=NULL) {
+    return;
+  }
+  CPreloadedFile *ppf = new CPreloadedFile;
+  ppf->pf_fnmFile = fnmFile;
+  _alhPreloaded[fnmFile.GetHash()%PRELOAD_HASHSIZE].AddTail(ppf->pf_lnInHash);
+  _lhPreloadQueue.AddTail(ppf->pf_lnInQueue);
+  SetEvent(_hPreloadEvent);
+}
+
+
+// take over a file that loader threads have read (returns FALSE if it was not preloaded)
+static BOOL TakePreloadedFile(const CTFileName &fnmFile, INDEX &iZipHandle,
+  UBYTE *&pubBuffer, SLONG &slBufferSize, void *&pvMappedView)
+{
+  if (_ctLoaderThreads==0) {
+    return FALSE;
+  }
+  FOREVER {
+    {
+      CTSingleLock slPreload(&_csPreload, TRUE);
+      CPreloadedFile *ppf = FindPreloadedFile(fnmFile);
+      if (ppf==NULL) {
+        return FALSE;
+      }
+      // if loader thread is still reading it, wait for it
+      if (ppf->pf_iState!=PFS_LOADING) {
+        RemovePreloadedFile(ppf);
+        BOOL bReady = ppf->pf_iState==PFS_READY;
+        if (bReady) {
+          iZipHandle   = ppf->pf_iZipHandle;
+          pubBuffer    = ppf->pf_pubBuffer;
+          slBufferSize = ppf->pf_slBufferSize;
+          pvMappedView = ppf->pf_pvMappedView;
+          ppf->pf_iZipHandle = -1;
+          ppf->pf_pubBuffer = NULL;
+          ppf->pf_pvMappedView = NULL;
+          // there is room for more now
+          SetEvent(_hPreloadEvent);
+        }
+        delete ppf;
+        return bReady;
+      }
+    }
+    Sleep(1);
+  }
+}
+
+
+// free a file that was preloaded, but will not be opened (or is about to be written)
+void DiscardPreloadedFile(const CTFileName &fnmFile)
+{
+  if (_ctLoaderThreads==0) {
+    return;
+  }
+  FOREVER {
+    {
+      CTSingleLock slPreload(&_csPreload, TRUE);
+      CPreloadedFile *ppf = FindPreloadedFile(fnmFile);
+      if (ppf==NULL) {
+        return;
+      }
+      // if loader thread is still reading it, wait for it to release the file
+      if (ppf->pf_iState!=PFS_LOADING) {
+        RemovePreloadedFile(ppf);
+        if (ppf->pf_iState==PFS_READY) {
+          // there is room for more now
+          SetEvent(_hPreloadEvent);
+        }
+        delete ppf;
+        return;
+      }
+    }
+    Sleep(1);
+  }
+}
+
+
+// free all files that were preloaded, but never opened
+void DiscardPreloadedFiles(void)
+{
+  if (_ctLoaderThreads==0) {
+    return;
+  }
+  CTSingleLock slPreload(&_csPreload, TRUE);
+  for (INDEX iHash=0; iHash<PRELOAD_HASHSIZE; iHash++) {
+    FORDELETELIST(CPreloadedFile, pf_lnInHash, _alhPreloaded[iHash], itpf) {
+      CPreloadedFile *ppf = &*itpf;
+      RemovePreloadedFile(ppf);
+      // if loader thread is reading it, let it free it when done
+      if (ppf->pf_iState==PFS_LOADING) {
+        ppf->pf_bDiscarded = TRUE;
+      } else {
+        delete ppf;
+      }
+    }
+  }
+}
+
+
+// stop loader threads and free all preloaded files
+void EndFilePreloading(void)
+{
+  if (_ctLoaderThreads==0) {
+    return;
+  }
+  DiscardPreloadedFiles();
+  _bStopLoaders = TRUE;
+  WaitForMultipleObjects(_ctLoaderThreads, _ahLoaderThreads, TRUE, INFINITE);
+  for (INDEX iThread=0; iThread<_ctLoaderThreads; iThread++) {
+    CloseHandle(_ahLoaderThreads[iThread]);
+  }
+  _ctLoaderThreads = 0;
+  CloseHandle(_hPreloadEvent);
+  _hPreloadEvent = NULL;
+}
+
+
 /*
  * Default constructor.
  */
@@ -871,8 +1290,10 @@ CTFileStream::CTFileStream(void)
   // mark that file is created for writing
   fstrm_bReadOnly = TRUE;
   fstrm_iZipHandle = -1;
-  fstrm_iZipLocation = 0;
-  fstrm_pubZipBuffer = NULL;
+  fstrm_iBufferLocation = 0;
+  fstrm_pubBuffer = NULL;
+  fstrm_slBufferSize = 0;
+  fstrm_pvMappedView = NULL;
 }
 
 /*
@@ -881,7 +1302,7 @@ CTFileStream::CTFileStream(void)
 CTFileStream::~CTFileStream(void)
 {
   // close stream
-  if (fstrm_pFile != NULL || fstrm_iZipHandle!=-1) {
+  if (fstrm_pFile != NULL || fstrm_pubBuffer!=NULL) {
     Close();
   }
 }
@@ -902,7 +1323,7 @@ void CTFileStream::Open_t(const CTFileName &fnFileName, CTStream::OpenMode om/*=
   // check parameters
   ASSERT(strlen(fnFileName)>0);
   // check that the file is not open
-  ASSERT(fstrm_pFile==NULL && fstrm_iZipHandle==-1);
+  ASSERT(fstrm_pFile==NULL && fstrm_pubBuffer==NULL);
 
   // expand the filename to full path
   CTFileName fnmFullFileName;
@@ -912,23 +1333,19 @@ void CTFileStream::Open_t(const CTFileName &fnFileName, CTStream::OpenMode om/*=
   if( om == OM_READ) {
     // initially, no physical file
     fstrm_pFile = NULL;
-    // if zip file
-    if( iFile==EFP_MODZIP || iFile==EFP_BASEZIP) {
-      // open from zip
-      fstrm_iZipHandle = UNZIPOpen_t(fnmFullFileName);
-      fstrm_slZipSize = UNZIPGetSize(fstrm_iZipHandle);
-      // load the file from the zip in the buffer
-      fstrm_pubZipBuffer = (UBYTE*)VirtualAlloc(NULL, fstrm_slZipSize, MEM_COMMIT, PAGE_READWRITE);
-      UNZIPReadBlock_t(fstrm_iZipHandle, (UBYTE*)fstrm_pubZipBuffer, 0, fstrm_slZipSize);
-    // if it is a physical file
-    } else if (iFile==EFP_FILE) {
-      // open file in read only mode
-      fstrm_pFile = fopen(fnmFullFileName, "rb");
+    // if loader threads have already read the file, just take it
+    if (!TakePreloadedFile(fnFileName, fstrm_iZipHandle, fstrm_pubBuffer,
+                           fstrm_slBufferSize, fstrm_pvMappedView)) {
+      // otherwise open it now
+      OpenForReading_t(iFile, fnmFullFileName, fstrm_pFile, fstrm_iZipHandle,
+        fstrm_pubBuffer, fstrm_slBufferSize, fstrm_pvMappedView);
     }
     fstrm_bReadOnly = TRUE;
   
   // if write mode requested
   } else if( om == OM_WRITE) {
+    // contents read ahead would be stale
+    DiscardPreloadedFile(fnFileName);
     // open file for reading and writing
     fstrm_pFile = fopen(fnmFullFileName, "rb+");
     fstrm_bReadOnly = FALSE;
@@ -938,7 +1355,7 @@ void CTFileStream::Open_t(const CTFileName &fnFileName, CTStream::OpenMode om/*=
   }
 
   // if openning operation was not successfull
-  if(fstrm_pFile == NULL && fstrm_iZipHandle==-1) {
+  if(fstrm_pFile == NULL && fstrm_pubBuffer==NULL) {
     // throw exception
     Throw_t(TRANS("Cannot open file `%s' (%s)"), (CTString&)fnmFullFileName,
       strerror(errno));
@@ -976,6 +1393,10 @@ void CTFileStream::Create_t(const CTFileName &fnFileName,
   // check that the file is not open
   ASSERT(fstrm_pFile == NULL);
 
+  // contents read ahead would be stale
+  DiscardPreloadedFile(fnFileName);
+  DiscardPreloadedFile(fnFileNameAbsolute);
+
   // create the directory for the new file if it doesn't exist yet
   MakeSureDirectoryPathExists(fnmFullFileName);
 
@@ -1002,7 +1423,7 @@ void CTFileStream::Create_t(const CTFileName &fnFileName,
 void CTFileStream::Close(void)
 {
   // if file is not open
-  if (fstrm_pFile==NULL && fstrm_iZipHandle==-1) {
+  if (fstrm_pFile==NULL && fstrm_pubBuffer==NULL) {
     ASSERT(FALSE);
     return;
   }
@@ -1022,12 +1443,23 @@ void CTFileStream::Close(void)
     // close zip entry
     UNZIPClose(fstrm_iZipHandle);
     fstrm_iZipHandle = -1;
+  }
 
-    VirtualFree(fstrm_pubZipBuffer, 0, MEM_RELEASE);
-
-    _ulVirtuallyAllocatedSpace -= fstrm_slZipSize;
-    //CPrintF("Freed virtual memory with size ^c00ff00%d KB^C (now %d KB)\n", (fstrm_slZipSize / 1000), (_ulVirtuallyAllocatedSpace / 1000));
+  // if file is mapped
+  if (fstrm_pvMappedView!=NULL) {
+    // just unmap it
+    UnmapViewOfFile(fstrm_pvMappedView);
+    fstrm_pvMappedView = NULL;
+  // if file was loaded from zip
+  } else if (fstrm_pubBuffer!=NULL) {
+    VirtualFree(fstrm_pubBuffer, 0, MEM_RELEASE);
+
+    _ulVirtuallyAllocatedSpace -= fstrm_slBufferSize;
+    //CPrintF("Freed virtual memory with size ^c00ff00%d KB^C (now %d KB)\n", (fstrm_slBufferSize / 1000), (_ulVirtuallyAllocatedSpace / 1000));
   }
+  fstrm_pubBuffer = NULL;
+  fstrm_slBufferSize = 0;
+  fstrm_iBufferLocation = 0;
 
   // clear dictionary vars
   strm_dmDictionaryMode = DM_NONE;
@@ -1046,6 +1478,14 @@ ULONG CTFileStream::GetStreamCRC32_t(void)
   // if file in zip
   } else if (fstrm_iZipHandle >=0) {
     return UNZIPGetCRC(fstrm_iZipHandle);
+  // if mapped file
+  } else if (fstrm_pubBuffer!=NULL) {
+    // checksum the mapping directly
+    ULONG ulCRC;
+    CRC_Start(ulCRC);
+    CRC_AddBlock(ulCRC, fstrm_pubBuffer, fstrm_slBufferSize);
+    CRC_Finish(ulCRC);
+    return ulCRC;
   } else {
     ASSERT(FALSE);
     return 0;
@@ -1055,9 +1495,16 @@ ULONG CTFileStream::GetStreamCRC32_t(void)
 /* Read a block of data from stream. */
 void CTFileStream::Read_t(void *pvBuffer, SLONG slSize)
 {
-  if(fstrm_iZipHandle != -1) {
-    memcpy(pvBuffer, fstrm_pubZipBuffer + fstrm_iZipLocation, slSize);
-    fstrm_iZipLocation += slSize;
+  if(fstrm_pubBuffer != NULL) {
+    // never read past the end of buffer (file may be truncated or shorter than expected)
+    const SLONG slLeft = (fstrm_iBufferLocation>=0) ? ClampDn(fstrm_slBufferSize-fstrm_iBufferLocation, 0L) : 0;
+    if (slSize>slLeft) {
+      memcpy(pvBuffer, fstrm_pubBuffer + fstrm_iBufferLocation, slLeft);
+      fstrm_iBufferLocation += slLeft;
+      ThrowF_t(TRANS("EOF reached, file %s"), strm_strStreamDescription);
+    }
+    memcpy(pvBuffer, fstrm_pubBuffer + fstrm_iBufferLocation, slSize);
+    fstrm_iBufferLocation += slSize;
     return;
   }
 
@@ -1067,7 +1514,7 @@ void CTFileStream::Read_t(void *pvBuffer, SLONG slSize)
 /* Write a block of data to stream. */
 void CTFileStream::Write_t(const void *pvBuffer, SLONG slSize)
 {
-  if(fstrm_bReadOnly || fstrm_iZipHandle != -1) {
+  if(fstrm_bReadOnly || fstrm_pubBuffer != NULL) {
     throw "Stream is read-only!";
   }
 
@@ -1077,11 +1524,11 @@ void CTFileStream::Write_t(const void *pvBuffer, SLONG slSize)
 /* Seek in stream. */
 void CTFileStream::Seek_t(SLONG slOffset, enum SeekDir sd)
 {
-  if(fstrm_iZipHandle != -1) {
+  if(fstrm_pubBuffer != NULL) {
     switch(sd) {
-    case SD_BEG: fstrm_iZipLocation = slOffset; break;
-    case SD_CUR: fstrm_iZipLocation += slOffset; break;
-    case SD_END: fstrm_iZipLocation = GetSize_t() + slOffset; break;
+    case SD_BEG: fstrm_iBufferLocation = slOffset; break;
+    case SD_CUR: fstrm_iBufferLocation += slOffset; break;
+    case SD_END: fstrm_iBufferLocation = GetSize_t() + slOffset; break;
     }
   } else {
     fseek(fstrm_pFile, slOffset, sd);
@@ -1097,8 +1544,8 @@ void CTFileStream::SetPos_t(SLONG slPosition)
 /* Get absolute position in stream. */
 SLONG CTFileStream::GetPos_t(void)
 {
-  if(fstrm_iZipHandle != -1) {
-    return fstrm_iZipLocation;
+  if(fstrm_pubBuffer != NULL) {
+    return fstrm_iBufferLocation;
   } else {
     return ftell(fstrm_pFile);
   }
@@ -1107,8 +1554,8 @@ SLONG CTFileStream::GetPos_t(void)
 /* Get size of stream */
 SLONG CTFileStream::GetStreamSize(void)
 {
-  if(fstrm_iZipHandle != -1) {
-    return UNZIPGetSize(fstrm_iZipHandle);
+  if(fstrm_pubBuffer != NULL) {
+    return fstrm_slBufferSize;
   } else {
     long lCurrentPos = ftell(fstrm_pFile);
     fseek(fstrm_pFile, 0, SD_END);
@@ -1121,8 +1568,8 @@ SLONG CTFileStream::GetStreamSize(void)
 /* Check if file position points to the EOF */
 BOOL CTFileStream::AtEOF(void)
 {
-  if(fstrm_iZipHandle != -1) {
-    return fstrm_iZipLocation >= fstrm_slZipSize;
+  if(fstrm_pubBuffer != NULL) {
+    return fstrm_iBufferLocation >= fstrm_slBufferSize;
   } else {
     int eof = feof(fstrm_pFile);
     return eof != 0;
@@ -1432,6 +1879,7 @@ BOOL RemoveFile(const CTFileName &fnmFile)
   CTFileName fnmExpanded;
   INDEX iFile = ExpandFilePath(EFP_WRITE, fnmFile, fnmExpanded);
   if (iFile==EFP_FILE) {
+    DiscardPreloadedFile(fnmFile);
     int ires = remove(fnmExpanded);
     return ires==0;
   } else {
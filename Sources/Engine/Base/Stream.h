@@ -236,9 +236,10 @@ private:
   FILE *fstrm_pFile;    // ptr to opened file
 
   INDEX fstrm_iZipHandle; // handle of zip-file entry
-  INDEX fstrm_iZipLocation; // location in zip-file entry
-  UBYTE* fstrm_pubZipBuffer; // buffer for zip-file entry
-  SLONG fstrm_slZipSize; // size of the zip-file entry
+  INDEX fstrm_iBufferLocation; // location in buffer
+  UBYTE* fstrm_pubBuffer; // buffer with zip-file entry or mapped file contents (NULL if reading from file)
+  SLONG fstrm_slBufferSize; // size of the buffer
+  void *fstrm_pvMappedView; // mapped view of the file the buffer points into (NULL if not mapped)
 
   BOOL fstrm_bReadOnly;  // set if file is opened in read-only mode
 public:
@@ -349,6 +350,12 @@ ENGINE_API ULONG GetFileCRC32_t(const CTFileName &fnmFile); // throw char *
 ENGINE_API BOOL IsFileReadOnly(const CTFileName &fnmFile);
 // Delete a file (called 'remove' to avid name clashes with win32)
 ENGINE_API BOOL RemoveFile(const CTFileName &fnmFile);
+// Let loader threads read a file ahead, so that opening it later doesn't wait for disk or unzipping
+ENGINE_API void PreloadFile(const CTFileName &fnmFile);
+// Free a file that was preloaded, but will not be opened (waits if it is being read)
+ENGINE_API void DiscardPreloadedFile(const CTFileName &fnmFile);
+// Free all files that were preloaded, but never opened
+ENGINE_API void DiscardPreloadedFiles(void);
 
 // Expand a file's filename to full path
 
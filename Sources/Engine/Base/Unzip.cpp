@@ -23,6 +23,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/ErrorReporting.h>
 #include <Engine/Base/Console.h>
 #include <Engine/Base/Synchronization.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Math/Functions.h>
 
 #include <Engine/Templates/StaticArray.cpp>
@@ -30,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/zlib/zlib.h>
 extern CTCriticalSection zip_csLock; // critical section for access to zlib functions
+extern CTCriticalSection zip_csHandles; // critical section for access to the table of zip handles
 
 #pragma pack(1)
 
@@ -131,6 +134,7 @@ public:
   FILE *zh_fFile;         // open handle of the archive
 #define BUF_SIZE  1024
   UBYTE *zh_pubBufIn;     // input buffer
+  UBYTE *zh_pubBufOut;    // entire uncompressed entry, once reading stops being sequential
 
   CZipHandle(void);
   void Clear(void);
@@ -167,28 +171,37 @@ CZipHandle::CZipHandle(void)
   zh_bOpen = FALSE;
   zh_fFile = NULL;
   zh_pubBufIn = NULL;
+  zh_pubBufOut = NULL;
   memset(&zh_zstream, 0, sizeof(zh_zstream));
 }
 void CZipHandle::Clear(void) 
 {
-  zh_bOpen = FALSE;
   zh_zeEntry.Clear();
 
   // clear the zlib stream
-  CTSingleLock slZip(&zip_csLock, TRUE);
+  {CTSingleLock slZip(&zip_csLock, TRUE);
   inflateEnd(&zh_zstream);
   memset(&zh_zstream, 0, sizeof(zh_zstream));
+  }
 
   // free buffers
   if (zh_pubBufIn!=NULL) {
     FreeMemory(zh_pubBufIn);
     zh_pubBufIn = NULL;
   }
+  if (zh_pubBufOut!=NULL) {
+    FreeMemory(zh_pubBufOut);
+    zh_pubBufOut = NULL;
+  }
   // close the zip archive file
   if (zh_fFile!=NULL) {
     fclose(zh_fFile);
     zh_fFile = NULL;
   }
+
+  // release the handle only when everything is freed, so other threads can reuse it
+  CTSingleLock slHandles(&zip_csHandles, TRUE);
+  zh_bOpen = FALSE;
 }
 void CZipHandle::ThrowZLIBError_t(int ierr, const CTString &strDescription)
 {
@@ -200,11 +213,79 @@ void CZipHandle::ThrowZLIBError_t(int ierr, const CTString &strDescription)
 
 // all files in all active zip archives
 static CStaticStackArray<CZipEntry>  _azeFiles;
-// handles for currently open files
-static CStaticStackArray<CZipHandle> _azhHandles;
+// handles for currently open files (allocated separately, so they don't move when table grows)
+static CStaticStackArray<CZipHandle *> _apzhHandles;
 // filenames of all archives
 static CStaticStackArray<CTFileName> _afnmArchives;
 
+// one slot in hash index of zip entries
+struct ZipIndexSlot {
+  ULONG zis_ulKey;    // hash of the entry filename
+  INDEX zis_iFile;    // index of the entry in file array (-1 if slot is empty)
+};
+// hash index of all files in all active zip archives
+static CStaticArray<ZipIndexSlot> _azisIndex;
+
+// build hash index for given array of zip entries
+static void MakeZipIndex(CStaticArray<ZipIndexSlot> &azis, CStaticStackArray<CZipEntry> &aze)
+{
+  // use at most half of the slots, so probe sequences stay short
+  INDEX ctSlots = 16;
+  while (ctSlots<aze.Count()*2) {
+    ctSlots*=2;
+  }
+  azis.Clear();
+  azis.New(ctSlots);
+  for(INDEX iSlot=0; iSlot<ctSlots; iSlot++) {
+    azis[iSlot].zis_iFile = -1;
+  }
+
+  // for each file, in priority order
+  for(INDEX iFile=0; iFile<aze.Count(); iFile++) {
+    const CTFileName &fnm = aze[iFile].ze_fnm;
+    ULONG ulKey = fnm.GetHash();
+    INDEX iSlot = ulKey&(ctSlots-1);
+    for(;;) {
+      ZipIndexSlot &zis = azis[iSlot];
+      // if free slot
+      if (zis.zis_iFile<0) {
+        // put it here
+        zis.zis_ulKey = ulKey;
+        zis.zis_iFile = iFile;
+        break;
+      }
+      // if same file is already in index
+      if (zis.zis_ulKey==ulKey && aze[zis.zis_iFile].ze_fnm==fnm) {
+        // keep the first one, it is from an archive with higher priority
+        break;
+      }
+      iSlot = (iSlot+1)&(ctSlots-1);
+    }
+  }
+}
+
+// find index of a file in given zip entries using the hash index (-1 for no file)
+static INDEX FindInZipIndex(CStaticArray<ZipIndexSlot> &azis, CStaticStackArray<CZipEntry> &aze,
+  const CTFileName &fnm)
+{
+  INDEX ctSlots = azis.Count();
+  if (ctSlots==0) {
+    return -1;
+  }
+  ULONG ulKey = fnm.GetHash();
+  INDEX iSlot = ulKey&(ctSlots-1);
+  for(;;) {
+    const ZipIndexSlot &zis = azis[iSlot];
+    if (zis.zis_iFile<0) {
+      return -1;
+    }
+    if (zis.zis_ulKey==ulKey && aze[zis.zis_iFile].ze_fnm==fnm) {
+      return zis.zis_iFile;
+    }
+    iSlot = (iSlot+1)&(ctSlots-1);
+  }
+}
+
 // convert slashes to backslashes in a file path
 void ConvertSlashes(char *p)
 {
@@ -459,6 +540,9 @@ void UNZIPReadDirectoriesReverse_t(void)
     }
   }
 
+  // index all files that were read
+  MakeZipIndex(_azisIndex, _azeFiles);
+
   // if there were errors
   if (strAllErrors!="") {
     // report them
@@ -469,14 +553,7 @@ void UNZIPReadDirectoriesReverse_t(void)
 // check if a zip file entry exists
 BOOL UNZIPFileExists(const CTFileName &fnm)
 {
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      return TRUE;
-    }
-  }
-  return FALSE;
+  return FindInZipIndex(_azisIndex, _azeFiles, fnm)>=0;
 }
 
 // enumeration for all files in all zips
@@ -497,33 +574,39 @@ BOOL UNZIPIsFileAtIndexMod(INDEX i)
 // get index of a file (-1 for no file)
 INDEX UNZIPGetFileIndex(const CTFileName &fnm)
 {
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      return iFile;
-    }
-  }
-  return -1;
+  return FindInZipIndex(_azisIndex, _azeFiles, fnm);
 }
 
-// get info on a zip file entry
-void UNZIPGetFileInfo(INDEX iHandle, CTFileName &fnmZip, 
-  SLONG &slOffset, SLONG &slSizeCompressed, SLONG &slSizeUncompressed, 
-  BOOL &bCompressed)
+// get an open zip handle (NULL if invalid)
+static CZipHandle *GetOpenHandle(INDEX iHandle)
 {
+  CTSingleLock slHandles(&zip_csHandles, TRUE);
   // check handle number
-  if(iHandle<0 || iHandle>=_azhHandles.Count()) {
+  if(iHandle<0 || iHandle>=_apzhHandles.Count()) {
     ASSERT(FALSE);
-    return;
+    return NULL;
   }
   // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
+  CZipHandle *pzh = _apzhHandles[iHandle];
   // check the handle
-  if (!zh.zh_bOpen) {
+  if (!pzh->zh_bOpen) {
     ASSERT(FALSE);
+    return NULL;
+  }
+  return pzh;
+}
+
+// get info on a zip file entry
+void UNZIPGetFileInfo(INDEX iHandle, CTFileName &fnmZip, 
+  SLONG &slOffset, SLONG &slSizeCompressed, SLONG &slSizeUncompressed, 
+  BOOL &bCompressed)
+{
+  // get the handle
+  CZipHandle *pzh = GetOpenHandle(iHandle);
+  if (pzh==NULL) {
     return;
   }
+  CZipHandle &zh = *pzh;
 
   // get parameters
   fnmZip = *zh.zh_zeEntry.ze_pfnmArchive;
@@ -537,14 +620,10 @@ void UNZIPGetFileInfo(INDEX iHandle, CTFileName &fnmZip,
 INDEX UNZIPOpen_t(const CTFileName &fnm)
 {
   CZipEntry *pze = NULL;
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      // stop searching
-      pze = &_azeFiles[iFile];
-      break;
-    }
+  // find the file
+  INDEX iFile = FindInZipIndex(_azisIndex, _azeFiles, fnm);
+  if (iFile>=0) {
+    pze = &_azeFiles[iFile];
   }
 
   // if not found
@@ -553,38 +632,45 @@ INDEX UNZIPOpen_t(const CTFileName &fnm)
     ThrowF_t(TRANS("File not found: %s"), (const CTString&)fnm);
   }
 
-  // for each existing handle
-  BOOL bHandleFound = FALSE;
+  // reserve a handle, other threads may be opening files at the same time
+  CZipHandle *pzh = NULL;
   INDEX iHandle=1;
-  for (; iHandle<_azhHandles.Count(); iHandle++) {
+  {CTSingleLock slHandles(&zip_csHandles, TRUE);
+  // for each existing handle
+  for (; iHandle<_apzhHandles.Count(); iHandle++) {
     // if unused
-    if (!_azhHandles[iHandle].zh_bOpen) {
+    if (!_apzhHandles[iHandle]->zh_bOpen) {
       // use that one
-      bHandleFound = TRUE;
+      pzh = _apzhHandles[iHandle];
       break;
     }
   }
   // if no free handle found
-  if (!bHandleFound) {
+  if (pzh==NULL) {
     // create a new one
-    iHandle = _azhHandles.Count();
-    _azhHandles.Push(1);
+    iHandle = _apzhHandles.Count();
+    pzh = new CZipHandle;
+    _apzhHandles.Push() = pzh;
+  }
+  ASSERT(!pzh->zh_bOpen);
+  pzh->zh_bOpen = TRUE;
   }
   
   // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
-  ASSERT(!zh.zh_bOpen);
+  CZipHandle &zh = *pzh;
   zh.zh_zeEntry = *pze;
 
   // open zip archive for reading
   zh.zh_fFile = fopen(*pze->ze_pfnmArchive, "rb");
   // if failed to open it
   if (zh.zh_fFile==NULL) {
+    CTString strError;
+    strError.PrintF(TRANS("Cannot open '%s': %s"), (const CTString&)*pze->ze_pfnmArchive,
+      strerror(errno));
     // clear the handle
     zh.Clear();
     // fail
-    ThrowF_t(TRANS("Cannot open '%s': %s"), (const CTString&)*pze->ze_pfnmArchive,
-      strerror(errno));
+    ThrowF_t("%s", strError);
   }
   // seek to the local header of the entry
   fseek(zh.zh_fFile, zh.zh_zeEntry.ze_slDataOffset, SEEK_SET);
@@ -594,8 +680,11 @@ INDEX UNZIPOpen_t(const CTFileName &fnm)
   // if this is not the expected sig
   if (slSig!=SIGNATURE_LFH) {
     // fail
-    ThrowF_t(TRANS("%s/%s: Wrong signature for 'local file header'"), 
+    CTString strError;
+    strError.PrintF(TRANS("%s/%s: Wrong signature for 'local file header'"), 
       (CTString&)*zh.zh_zeEntry.ze_pfnmArchive, zh.zh_zeEntry.ze_fnm);
+    zh.Clear();
+    ThrowF_t("%s", strError);
   }
   // read the header
   LocalFileHeader lfh;
@@ -610,7 +699,7 @@ INDEX UNZIPOpen_t(const CTFileName &fnm)
   zh.zh_pubBufIn  = (UBYTE*)AllocMemory(BUF_SIZE);
 
   // initialize zlib stream
-  CTSingleLock slZip(&zip_csLock, TRUE);
+  {CTSingleLock slZip(&zip_csLock, TRUE);
   zh.zh_zstream.next_out  = NULL;
   zh.zh_zstream.avail_out = 0;
   zh.zh_zstream.next_in   = NULL;
@@ -618,37 +707,33 @@ INDEX UNZIPOpen_t(const CTFileName &fnm)
   zh.zh_zstream.zalloc = (alloc_func)Z_NULL;
   zh.zh_zstream.zfree = (free_func)Z_NULL;
   int err = inflateInit2(&zh.zh_zstream, -15);  // 32k windows
+  slZip.Unlock();
   // if failed
   if (err!=Z_OK) {
-    // clean up what is possible
-    FreeMemory(zh.zh_pubBufIn );
-    zh.zh_pubBufIn  = NULL;
-    fclose(zh.zh_fFile);
-    zh.zh_fFile = NULL;
+    CTString strError;
+    strError.PrintF(TRANS("(%s/%s) %s - ZLIB error: %s"), 
+      (const CTString&)*zh.zh_zeEntry.ze_pfnmArchive, (const CTString&)zh.zh_zeEntry.ze_fnm,
+      TRANS("Cannot init inflation"), GetZlibError(err));
+    // clean up and release the handle
+    zh.Clear();
     // throw error
-    zh.ThrowZLIBError_t(err, TRANS("Cannot init inflation"));
+    ThrowF_t("%s", strError);
+  }
   }
 
   // return the handle successfully
-  zh.zh_bOpen = TRUE;
   return iHandle;
 }
 
 // get uncompressed size of a file
 SLONG UNZIPGetSize(INDEX iHandle)
 {
-  // check handle number
-  if(iHandle<0 || iHandle>=_azhHandles.Count()) {
-    ASSERT(FALSE);
-    return 0;
-  }
   // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
-  // check the handle
-  if (!zh.zh_bOpen) {
-    ASSERT(FALSE);
+  CZipHandle *pzh = GetOpenHandle(iHandle);
+  if (pzh==NULL) {
     return 0;
   }
+  CZipHandle &zh = *pzh;
 
   return zh.zh_zeEntry.ze_slUncompressedSize;
 }
@@ -656,37 +741,56 @@ SLONG UNZIPGetSize(INDEX iHandle)
 // get CRC of a file
 ULONG UNZIPGetCRC(INDEX iHandle)
 {
-  // check handle number
-  if(iHandle<0 || iHandle>=_azhHandles.Count()) {
-    ASSERT(FALSE);
-    return 0;
-  }
   // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
-  // check the handle
-  if (!zh.zh_bOpen) {
-    ASSERT(FALSE);
+  CZipHandle *pzh = GetOpenHandle(iHandle);
+  if (pzh==NULL) {
     return 0;
   }
+  CZipHandle &zh = *pzh;
 
   return zh.zh_zeEntry.ze_ulCRC;
 }
 
+// largest entry that is unpacked entirely when read non-sequentially
+static const SLONG zip_slMaxRandomAccessSize = 16*1024*1024;
+
+// decode next block of data from current position of a zip handle
+static void InflateBlock_t(CZipHandle &zh, UBYTE *pub, SLONG slLen)
+{
+  // set zlib for writing to the block
+  zh.zh_zstream.avail_out = slLen;
+  zh.zh_zstream.next_out = pub;
+
+  // while there is something to write to given block
+  while (zh.zh_zstream.avail_out>0) {
+    // if zlib has no more input
+    while(zh.zh_zstream.avail_in==0) {
+      // read more to it
+      SLONG slRead = fread(zh.zh_pubBufIn, 1, BUF_SIZE, zh.zh_fFile);
+      if (slRead<=0) {
+        return; // !!!!
+      }
+      // tell zlib that there is more to read
+      zh.zh_zstream.next_in = zh.zh_pubBufIn;
+      zh.zh_zstream.avail_in  = slRead;
+    }
+    // decode to output
+    int ierr = inflate(&zh.zh_zstream, Z_SYNC_FLUSH);
+    if (ierr!=Z_OK && ierr!=Z_STREAM_END) {
+      zh.ThrowZLIBError_t(ierr, TRANS("Error reading from zip"));
+    }
+  }
+}
+
 // read a block from zip file
 void UNZIPReadBlock_t(INDEX iHandle, UBYTE *pub, SLONG slStart, SLONG slLen)
 {
-  // check handle number
-  if(iHandle<0 || iHandle>=_azhHandles.Count()) {
-    ASSERT(FALSE);
-    return;
-  }
   // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
-  // check the handle
-  if (!zh.zh_bOpen) {
-    ASSERT(FALSE);
+  CZipHandle *pzh = GetOpenHandle(iHandle);
+  if (pzh==NULL) {
     return;
   }
+  CZipHandle &zh = *pzh;
 
   // if behind the end of file
   if (slStart>=zh.zh_zeEntry.ze_slUncompressedSize) {
@@ -705,7 +809,14 @@ void UNZIPReadBlock_t(INDEX iHandle, UBYTE *pub, SLONG slStart, SLONG slLen)
     return;
   }
 
-  CTSingleLock slZip(&zip_csLock, TRUE);
+  // NOTE: each handle has its own file and zlib stream, so no locking is needed here
+
+  // if whole entry was already unpacked
+  if (zh.zh_pubBufOut!=NULL) {
+    // just copy from there
+    memcpy(pub, zh.zh_pubBufOut+slStart, slLen);
+    return;
+  }
 
   // if behind the current pointer
   if (slStart<zh.zh_zstream.total_out) {
@@ -715,6 +826,21 @@ void UNZIPReadBlock_t(INDEX iHandle, UBYTE *pub, SLONG slStart, SLONG slLen)
     zh.zh_zstream.next_in = NULL;
     // seek to start of zip entry data inside archive
     fseek(zh.zh_fFile, zh.zh_zeEntry.ze_slDataOffset, SEEK_SET);
+
+    // if not too large
+    if (zh.zh_zeEntry.ze_slUncompressedSize<=zip_slMaxRandomAccessSize) {
+      // unpack entire entry once, so this and all further seeks are free
+      UBYTE *pubOut = (UBYTE*)AllocMemory(zh.zh_zeEntry.ze_slUncompressedSize);
+      try {
+        InflateBlock_t(zh, pubOut, zh.zh_zeEntry.ze_slUncompressedSize);
+      } catch (char *) {
+        FreeMemory(pubOut);
+        throw;
+      }
+      zh.zh_pubBufOut = pubOut;
+      memcpy(pub, zh.zh_pubBufOut+slStart, slLen);
+      return;
+    }
   }
 
   // while ahead of the current pointer
@@ -751,46 +877,159 @@ void UNZIPReadBlock_t(INDEX iHandle, UBYTE *pub, SLONG slStart, SLONG slLen)
     return;
   }
 
-  // set zlib for writing to the block
-  zh.zh_zstream.avail_out = slLen;
-  zh.zh_zstream.next_out = pub;
+  // decode the block
+  InflateBlock_t(zh, pub, slLen);
+}
 
-  // while there is something to write to given block
-  while (zh.zh_zstream.avail_out>0) {
-    // if zlib has no more input
-    while(zh.zh_zstream.avail_in==0) {
-      // read more to it
-      SLONG slRead = fread(zh.zh_pubBufIn, 1, BUF_SIZE, zh.zh_fFile);
-      if (slRead<=0) {
-        return; // !!!!
+// close a zip file entry
+void UNZIPClose(INDEX iHandle)
+{
+  // get the handle
+  CZipHandle *pzh = GetOpenHandle(iHandle);
+  if (pzh==NULL) {
+    return;
+  }
+  CZipHandle &zh = *pzh;
+  // clear it
+  zh.Clear();
+}
+
+// measure file lookup speed on a synthetic set of archives
+void UNZIPBenchmark(void)
+{
+  const INDEX ctFiles = 100000;
+  const INDEX ctArchives = 4;
+  CStaticStackArray<CZipEntry> aze;
+  CStaticArray<ZipIndexSlot> azis;
+  CTFileName afnmArchives[ctArchives];
+  aze.SetAllocationStep(4096);
+
+  // make entries, every archive overrides some files of the ones after it
+  for(INDEX iArchive=0; iArchive<ctArchives; iArchive++) {
+    afnmArchives[iArchive].PrintF("Mods\\Test\\Test%d.gro", iArchive);
+  }
+  for(INDEX iFile=0; iFile<ctFiles; iFile++) {
+    CZipEntry &ze = aze.Push();
+    INDEX iName = (iFile%8==0) ? iFile%(ctFiles/ctArchives) : iFile;
+    ze.ze_fnm.PrintF("Models\\Dir%03d\\File%06d.mdl", iName/256, iName);
+    ze.ze_pfnmArchive = &afnmArchives[iFile*ctArchives/ctFiles];
+    ze.ze_bMod = TRUE;
+  }
+
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  MakeZipIndex(azis, aze);
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+
+  // look up every file and the same number of missing ones
+  INDEX ctWrong = 0;
+  for(INDEX iLookup=0; iLookup<ctFiles; iLookup++) {
+    INDEX iFound = FindInZipIndex(azis, aze, aze[iLookup].ze_fnm);
+    if (iFound<0 || iFound>iLookup || !(aze[iFound].ze_fnm==aze[iLookup].ze_fnm)) {
+      ctWrong++;
+    }
+  }
+  CTFileName fnmMissing;
+  for(INDEX iMissing=0; iMissing<ctFiles; iMissing++) {
+    fnmMissing.PrintF("Models\\Missing\\File%06d.mdl", iMissing);
+    if (FindInZipIndex(azis, aze, fnmMissing)>=0) {
+      ctWrong++;
+    }
+  }
+  CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+
+  // compare with linear search over a part of the files
+  const INDEX ctLinear = 1000;
+  INDEX ctLinearFound = 0;
+  for(INDEX iLinear=0; iLinear<ctLinear; iLinear++) {
+    const CTFileName &fnm = aze[(iLinear*97)%ctFiles].ze_fnm;
+    for(INDEX iFile=0; iFile<aze.Count(); iFile++) {
+      if (aze[iFile].ze_fnm==fnm) {
+        ctLinearFound++;
+        break;
       }
-      // tell zlib that there is more to read
-      zh.zh_zstream.next_in = zh.zh_pubBufIn;
-      zh.zh_zstream.avail_in  = slRead;
     }
-    // decode to output
-    int ierr = inflate(&zh.zh_zstream, Z_SYNC_FLUSH);
-    if (ierr!=Z_OK && ierr!=Z_STREAM_END) {
-      zh.ThrowZLIBError_t(ierr, TRANS("Error reading from zip"));
+  }
+  CTimerValue tv3 = _pTimer->GetHighPrecisionTimer();
+
+  CPrintF("%d files in %d archives: index built in %.2fms\n", ctFiles, ctArchives, (tv1-tv0).GetSeconds()*1000);
+  CPrintF("  hashed lookup: %.3fus per file\n", (tv2-tv1).GetSeconds()*1E6/(ctFiles*2));
+  CPrintF("  linear lookup: %.3fus per file\n", (tv3-tv2).GetSeconds()*1E6/ctLinear);
+  if (ctWrong>0 || ctLinearFound!=ctLinear) {
+    CPrintF("  %d lookups were WRONG!\n", ctWrong);
+  }
+}
+
+// files and results for archive read benchmark
+static CStaticStackArray<INDEX> _aiBenchmarkFiles;
+static INDEX _ctBenchmarkThreads = 0;
+static SLONG _aslBenchmarkRead[64];
+
+// read every n-th benchmark file in random order of blocks
+static DWORD WINAPI UNZIPBenchmarkThread(LPVOID lpParam)
+{
+  INDEX iThread = (INDEX)lpParam;
+  _aslBenchmarkRead[iThread] = 0;
+  const SLONG slBlock = 16*1024;
+  UBYTE *pubBlock = (UBYTE*)AllocMemory(slBlock);
+  for(INDEX i=iThread; i<_aiBenchmarkFiles.Count(); i+=_ctBenchmarkThreads) {
+    const CZipEntry &ze = _azeFiles[_aiBenchmarkFiles[i]];
+    try {
+      INDEX iHandle = UNZIPOpen_t(ze.ze_fnm);
+      // read blocks backwards, to force seeking
+      INDEX ctBlocks = (ze.ze_slUncompressedSize+slBlock-1)/slBlock;
+      for(INDEX iBlock=ctBlocks-1; iBlock>=0; iBlock--) {
+        UNZIPReadBlock_t(iHandle, pubBlock, iBlock*slBlock, slBlock);
+      }
+      _aslBenchmarkRead[iThread] += ze.ze_slUncompressedSize;
+      UNZIPClose(iHandle);
+    } catch (char *) {
     }
   }
+  FreeMemory(pubBlock);
+  return 0;
 }
 
-// close a zip file entry
-void UNZIPClose(INDEX iHandle)
+// measure read speed from archives with given number of threads
+void UNZIPReadBenchmark(INDEX ctThreads)
 {
-  // check handle number
-  if(iHandle<0 || iHandle>=_azhHandles.Count()) {
-    ASSERT(FALSE);
-    return;
+  ctThreads = Clamp(ctThreads, 1L, 64L);
+  // use compressed files big enough to need seeking
+  _aiBenchmarkFiles.PopAll();
+  for(INDEX iFile=0; iFile<_azeFiles.Count() && _aiBenchmarkFiles.Count()<256; iFile++) {
+    const CZipEntry &ze = _azeFiles[iFile];
+    if (!ze.ze_bStored && ze.ze_slUncompressedSize>=64*1024
+      && FindInZipIndex(_azisIndex, _azeFiles, ze.ze_fnm)==iFile) {
+      _aiBenchmarkFiles.Push() = iFile;
+    }
   }
-  // get the handle
-  CZipHandle &zh = _azhHandles[iHandle];
-  // check the handle
-  if (!zh.zh_bOpen) {
-    ASSERT(FALSE);
+  if (_aiBenchmarkFiles.Count()==0) {
+    CPrintF(TRANS("No suitable files in archives.\n"));
     return;
   }
-  // clear it
-  zh.Clear();
+
+  // for one thread and then for all threads
+  for(INDEX iPass=0; iPass<2; iPass++) {
+    _ctBenchmarkThreads = (iPass==0) ? 1 : ctThreads;
+    HANDLE ahThreads[64];
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    for(INDEX iThread=0; iThread<_ctBenchmarkThreads; iThread++) {
+      DWORD dwThreadId;
+      ahThreads[iThread] = CreateThread(NULL, 0, UNZIPBenchmarkThread, (LPVOID)iThread, 0, &dwThreadId);
+    }
+    WaitForMultipleObjects(_ctBenchmarkThreads, ahThreads, TRUE, INFINITE);
+    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+    SLONG slRead = 0;
+    for(INDEX iThread=0; iThread<_ctBenchmarkThreads; iThread++) {
+      CloseHandle(ahThreads[iThread]);
+      slRead += _aslBenchmarkRead[iThread];
+    }
+    DOUBLE dSeconds = (tv1-tv0).GetSeconds();
+    CPrintF("%2d thread(s): %d files, %.1f MB in %.2fs (%.1f MB/s)\n", _ctBenchmarkThreads,
+      _aiBenchmarkFiles.Count(), slRead/1048576.0, dSeconds, slRead/1048576.0/dSeconds);
+  }
+}
+void UNZIPReadBenchmarkCfunc(void *pArgs)
+{
+  INDEX ctThreads = NEXTARGUMENT(INDEX);
+  UNZIPReadBenchmark(ctThreads);
 }
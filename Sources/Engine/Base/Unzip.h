@@ -47,6 +47,10 @@ const CTFileName &UNZIPGetFileAtIndex(INDEX i);
 INDEX UNZIPGetFileIndex(const CTFileName &fnm);
 // check if a file is from a mod's zip
 BOOL UNZIPIsFileAtIndexMod(INDEX i);
+// measure file lookup speed on a synthetic set of archives
+void UNZIPBenchmark(void);
+// measure read speed from archives with given number of threads
+void UNZIPReadBenchmark(INDEX ctThreads);
 
 
 #endif  /* include-once check. */
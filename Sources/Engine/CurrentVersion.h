@@ -15,6 +15,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define _SE_DEMO            0   // set for demo versions
 #define _SE_BUILD_MAJOR 10000   // use new number for each released version
-#define _SE_BUILD_MINOR    10   // minor versions that are data-compatibile, but are not netgame-compatibile
+#define _SE_BUILD_MINOR    11   // minor versions that are data-compatibile, but are not netgame-compatibile
 #define _SE_BUILD_EXTRA    ""   // extra version with minor code changes
-#define _SE_VER_STRING  "1.10"  // usually shown in server browser, etc
+#define _SE_VER_STRING  "1.11"  // usually shown in server browser, etc
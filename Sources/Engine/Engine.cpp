@@ -59,6 +59,8 @@ extern BOOL _bFullScreen = FALSE;
 
 // critical section for access to zlib functions
 CTCriticalSection zip_csLock; 
+// critical section for access to the table of zip handles
+CTCriticalSection zip_csHandles;
 
 // to keep system gamma table
 static UWORD auwSystemGamma[256*3];
@@ -79,6 +81,8 @@ static INDEX sys_iCPUModel = 0;
 static INDEX sys_iCPUStepping = 0;
 static BOOL  sys_bCPUHasMMX = 0;
 static BOOL  sys_bCPUHasCMOV = 0;
+       BOOL  sys_bCPUHasSSE = 0;
+       BOOL  sys_bCPUHasSSE2 = 0;
 static INDEX sys_iCPUMHz = 0;
        INDEX sys_iCPUMisc = 0;
 
@@ -146,12 +150,16 @@ static void DetectCPU(void)
 
   BOOL bMMX  = ulFeatures & (1<<23);
   BOOL bCMOV = ulFeatures & (1<<15);
+  BOOL bSSE  = ulFeatures & (1<<25);
+  BOOL bSSE2 = ulFeatures & (1<<26);
 
   CTString strYes = TRANS("Yes");
   CTString strNo = TRANS("No");
 
   CPrintF(TRANS("  MMX : %s\n"), bMMX ?strYes:strNo);
   CPrintF(TRANS("  CMOV: %s\n"), bCMOV?strYes:strNo);
+  CPrintF(TRANS("  SSE : %s\n"), bSSE ?strYes:strNo);
+  CPrintF(TRANS("  SSE2: %s\n"), bSSE2?strYes:strNo);
   CPrintF(TRANS("  Clock: %.0fMHz\n"), _pTimer->tm_llCPUSpeedHZ/1E6);
 
   sys_strCPUVendor = strVendor;
@@ -161,6 +169,8 @@ static void DetectCPU(void)
   sys_iCPUStepping = iStepping;
   sys_bCPUHasMMX = bMMX!=0;
   sys_bCPUHasCMOV = bCMOV!=0;
+  sys_bCPUHasSSE  = bSSE!=0;
+  sys_bCPUHasSSE2 = bSSE2!=0;
   sys_iCPUMHz = INDEX(_pTimer->tm_llCPUSpeedHZ/1E6);
 
   if( !bMMX) FatalError( TRANS("MMX support required but not present!"));
@@ -329,6 +339,7 @@ ENGINE_API void SE_InitEngine(CTString strGameID)
 
   // initialize zip semaphore
   zip_csLock.cs_iIndex = -1;  // not checked for locking order
+  zip_csHandles.cs_iIndex = -1;
 
 
   // get info on the first disk in system
@@ -351,11 +362,15 @@ ENGINE_API void SE_InitEngine(CTString strGameID)
   extern INDEX con_bNoWarnings;
   extern INDEX wld_bFastObjectOptimization;
   extern INDEX fil_bPreferZips;
+  extern INDEX fil_bMapFiles;
+  extern INDEX fil_iLoaderThreads;
   extern FLOAT mth_fCSGEpsilon;
   _pShell->DeclareSymbol("user INDEX con_bNoWarnings;", &con_bNoWarnings);
   _pShell->DeclareSymbol("user INDEX wld_bFastObjectOptimization;", &wld_bFastObjectOptimization);
   _pShell->DeclareSymbol("user FLOAT mth_fCSGEpsilon;", &mth_fCSGEpsilon);
   _pShell->DeclareSymbol("persistent user INDEX fil_bPreferZips;", &fil_bPreferZips);
+  _pShell->DeclareSymbol("persistent user INDEX fil_bMapFiles;", &fil_bMapFiles);
+  _pShell->DeclareSymbol("persistent user INDEX fil_iLoaderThreads;", &fil_iLoaderThreads);
   // OS info
   _pShell->DeclareSymbol("user const CTString sys_strOS    ;", &sys_strOS);
   _pShell->DeclareSymbol("user const INDEX sys_iOSMajor    ;", &sys_iOSMajor);
@@ -370,6 +385,8 @@ ENGINE_API void SE_InitEngine(CTString strGameID)
   _pShell->DeclareSymbol("user const INDEX sys_iCPUStepping   ;", &sys_iCPUStepping);
   _pShell->DeclareSymbol("user const INDEX sys_bCPUHasMMX     ;", &sys_bCPUHasMMX  );
   _pShell->DeclareSymbol("user const INDEX sys_bCPUHasCMOV    ;", &sys_bCPUHasCMOV );
+  _pShell->DeclareSymbol("user const INDEX sys_bCPUHasSSE     ;", &sys_bCPUHasSSE  );
+  _pShell->DeclareSymbol("user const INDEX sys_bCPUHasSSE2    ;", &sys_bCPUHasSSE2 );
   _pShell->DeclareSymbol("user const INDEX sys_iCPUMHz        ;", &sys_iCPUMHz     );
   _pShell->DeclareSymbol("     const INDEX sys_iCPUMisc       ;", &sys_iCPUMisc    );
   // RAM info
@@ -385,6 +402,16 @@ ENGINE_API void SE_InitEngine(CTString strGameID)
   // Stock clearing
   extern void FreeUnusedStock(void);
   _pShell->DeclareSymbol("user void FreeUnusedStock(void);", &FreeUnusedStock);
+  // Archive lookup benchmark
+  extern void UNZIPBenchmark(void);
+  extern void UNZIPReadBenchmarkCfunc(void *pArgs);
+  _pShell->DeclareSymbol("user void ZipBenchmark(void);", &UNZIPBenchmark);
+  _pShell->DeclareSymbol("user void ZipReadBenchmark(INDEX);", &UNZIPReadBenchmarkCfunc);
+  // Range query benchmark
+  extern void FindEntitiesInRangeBenchmarkCfunc(void *pArgs);
+  _pShell->DeclareSymbol("user void FindEntitiesInRangeBenchmark(INDEX, INDEX);", &FindEntitiesInRangeBenchmarkCfunc);
+  extern void EntitySpawnBenchmarkCfunc(void *pArgs);
+  _pShell->DeclareSymbol("user void EntitySpawnBenchmark(INDEX);", &EntitySpawnBenchmarkCfunc);
   
   // Timer tick quantum
   _pShell->DeclareSymbol("user const FLOAT fTickQuantum;", (FLOAT*)&_pTimer->TickQuantum);
@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Base/CRC.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Base/Statistics_Internal.h>
 #include <Engine/Network/Network.h>
 #include <Engine/Network/PlayerTarget.h>
@@ -2029,10 +2030,122 @@ class CSentEvent {
 public:
   CEntityPointer se_penEntity;
   CEntityEvent *se_peeEvent;
+  BOOL se_bPooled;      // set if the event copy is in the event pool, not on heap
   inline void Clear(void) { se_penEntity = NULL; }
 };
 
 static CStaticStackArray<CSentEvent> _aseSentEvents;  // delayed events
+
+// pool for copies of sent events, all freed at once when sent events are handled
+#define EVENTPOOL_CHUNKSIZE (16*1024)
+static CStaticStackArray<UBYTE *> _apubEventPoolChunks;  // all allocated chunks (never freed)
+static INDEX _iEventPoolChunk = -1;   // chunk currently used (-1 if none)
+static SLONG _slEventPoolUsed = 0;    // bytes used in current chunk
+
+// get memory for an event copy from the pool (NULL if too large)
+static void *AllocEventMemory(SLONG slSize)
+{
+  slSize = (slSize+7)&~7;
+  if (slSize>EVENTPOOL_CHUNKSIZE) {
+    return NULL;
+  }
+  // if current chunk is full, go to next one
+  if (_iEventPoolChunk<0 || _slEventPoolUsed+slSize>EVENTPOOL_CHUNKSIZE) {
+    _iEventPoolChunk++;
+    _slEventPoolUsed = 0;
+    if (_iEventPoolChunk>=_apubEventPoolChunks.Count()) {
+      _apubEventPoolChunks.Push() = (UBYTE*)AllocMemory(EVENTPOOL_CHUNKSIZE);
+    }
+  }
+  void *pvMemory = _apubEventPoolChunks[_iEventPoolChunk]+_slEventPoolUsed;
+  _slEventPoolUsed += slSize;
+  return pvMemory;
+}
+
+// statistics of handled events
+extern INDEX ent_bReportEvents;
+class CEventStats {
+public:
+  SLONG es_slEvent;       // event code
+  CTString es_strName;    // event class name (empty if event is not generated by Ecc)
+  INDEX es_ctEvents;      // number of events handled
+};
+static CStaticStackArray<CEventStats> _aesEventStats;
+static BOOL  _bEventStatsInTick = FALSE;  // set while a game tick is processed
+static INDEX _ctEventStatsTicks = 0;      // number of game ticks processed
+static INDEX _ctEventStatsEvents = 0;     // number of events handled in game ticks
+static INDEX _ctEventStatsTickEvents = 0; // number of events handled in current tick
+static INDEX _ctEventStatsMaxEvents = 0;  // max events handled in one tick
+
+// count an event for statistics
+static void CountEventForStats(CEntityEvent &ee)
+{
+  for (INDEX ies=0; ies<_aesEventStats.Count(); ies++) {
+    if (_aesEventStats[ies].es_slEvent==ee.ee_slEvent) {
+      _aesEventStats[ies].es_ctEvents++;
+      return;
+    }
+  }
+  CEventStats &es = _aesEventStats.Push();
+  es.es_slEvent = ee.ee_slEvent;
+  es.es_strName = ee.GetName();  // copied, since entity class DLL can be unloaded before report
+  es.es_ctEvents = 1;
+}
+
+// mark start of a game tick for event statistics (prediction is not counted)
+void BeginEventStatsTick(void)
+{
+  _bEventStatsInTick = ent_bReportEvents;
+  _ctEventStatsTickEvents = 0;
+}
+
+// mark end of a game tick for event statistics
+void EndEventStatsTick(void)
+{
+  if (!_bEventStatsInTick) {
+    return;
+  }
+  _bEventStatsInTick = FALSE;
+  _ctEventStatsTicks++;
+  _ctEventStatsEvents += _ctEventStatsTickEvents;
+  _ctEventStatsMaxEvents = Max(_ctEventStatsMaxEvents, _ctEventStatsTickEvents);
+}
+
+static int qsort_CompareEventStats(const void *ppv0, const void *ppv1)
+{
+  const CEventStats &es0 = *(const CEventStats *)ppv0;
+  const CEventStats &es1 = *(const CEventStats *)ppv1;
+  return es1.es_ctEvents-es0.es_ctEvents;
+}
+
+// print and reset statistics of handled events
+void ReportEventStats(void)
+{
+  if (!ent_bReportEvents) {
+    CPrintF(TRANS("Set ent_bReportEvents=1 to gather event statistics.\n"));
+    return;
+  }
+  const FLOAT fTicks = FLOAT(Max(_ctEventStatsTicks, 1L));
+  CPrintF("Events handled: %d in %d ticks (%.1f per tick, max %d)\n", _ctEventStatsEvents,
+    _ctEventStatsTicks, _ctEventStatsEvents/fTicks, _ctEventStatsMaxEvents);
+  if (_aesEventStats.Count()>0) {
+    qsort(&_aesEventStats[0], _aesEventStats.Count(), sizeof(CEventStats), qsort_CompareEventStats);
+    CPrintF("Events by class:\n");
+  }
+  for (INDEX ies=0; ies<_aesEventStats.Count(); ies++) {
+    CEventStats &es = _aesEventStats[ies];
+    CTString strName = es.es_strName;
+    if (strName=="") {
+      strName.PrintF("0x%08X", es.es_slEvent);
+    }
+    CPrintF("  %-32s %8d (%.2f per tick)\n", (const char*)strName, es.es_ctEvents, es.es_ctEvents/fTicks);
+  }
+  _aesEventStats.PopAll();
+  _ctEventStatsTicks = 0;
+  _ctEventStatsEvents = 0;
+  _ctEventStatsMaxEvents = 0;
+}
+
 /* Send an event to this entity. */
 void CEntity::SendEvent(const CEntityEvent &ee)
 {
@@ -2040,9 +2153,79 @@ void CEntity::SendEvent(const CEntityEvent &ee)
     ASSERT(FALSE);
     return;
   }
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_SENTEVENTS);
   CSentEvent &se = _aseSentEvents.Push();
   se.se_penEntity = this;
-  se.se_peeEvent = ((CEntityEvent&)ee).MakeCopy();  // discard const qualifier
+  CEntityEvent &eeSent = (CEntityEvent&)ee;  // discard const qualifier
+  // try to copy the event into the pool
+  se.se_peeEvent = NULL;
+  SLONG slSize = eeSent.GetSizeOf();
+  if (slSize>0) {
+    void *pvMemory = AllocEventMemory(slSize);
+    if (pvMemory!=NULL) {
+      se.se_peeEvent = eeSent.MakeCopyAt(pvMemory);
+    }
+  }
+  se.se_bPooled = se.se_peeEvent!=NULL;
+  // if not possible, copy it on heap
+  if (!se.se_bPooled) {
+    _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_SENTEVENTS_HEAP);
+    se.se_peeEvent = eeSent.MakeCopy();
+  }
+}
+
+// add an entity found in range, unless it was already found
+static inline void AddEntityInRange(CDynamicContainer<CEntity> &cen, CEntity *pen)
+{
+  if (!(pen->en_ulFlags&ENF_FOUNDINGRIDSEARCH)) {
+    pen->en_ulFlags |= ENF_FOUNDINGRIDSEARCH;
+    cen.Add(pen);
+  }
+}
+
+// test if a model entity touches the box and add it
+static void FindModelInRange(CEntity *pen, const FLOATaabbox3D &boxRange,
+  CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly)
+{
+  // if the entity's bounding sphere doesn't touch the box
+  if (!boxRange.HasContactWith(
+    FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
+    // skip it
+    return;
+  }
+  // if it has collision box
+  if (pen->en_pciCollisionInfo!=NULL) {
+    // for each sphere
+    FOREACHINSTATICARRAY(pen->en_pciCollisionInfo->ci_absSpheres, CMovingSphere, itms) {
+      // project it
+      itms->ms_vRelativeCenter0 = itms->ms_vCenter*pen->en_mRotation+pen->en_plPlacement.pl_PositionVector;
+      // if the sphere touches the range
+      if (boxRange.HasContactWith(FLOATaabbox3D(itms->ms_vRelativeCenter0, itms->ms_fR))) {
+        // add it to container
+        AddEntityInRange(cen, pen);
+        return;
+      }
+    }
+  // if no collision box, but non-colliding are allowed
+  } else if (!bCollidingOnly) {
+    // add it to container
+    AddEntityInRange(cen, pen);
+  }
+}
+
+// test if a non-zoning brush entity touches the box and add it
+static void FindBrushInRange(CEntity *pen, const FLOATaabbox3D &boxRange,
+  CDynamicContainer<CEntity> &cen)
+{
+  // if the brush entity touches the box
+  if (boxRange.HasContactWith(
+    FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
+    // if the brush touches the box
+    if (boxRange.HasContactWith(pen->en_pbrBrush->GetFirstMip()->bm_boxBoundingBox)) {
+      // add it to container
+      AddEntityInRange(cen, pen);
+    }
+  }
 }
 
 // find entities in a box (box must be around this entity)
@@ -2050,9 +2233,95 @@ void CEntity::FindEntitiesInRange(
   const FLOATaabbox3D &boxRange, CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly)
 {
   ASSERT(GetFPUPrecision()==FPT_24BIT);
+  _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_FINDENTITIESINRANGE);
+
+  // if only colliding entities are needed
+  if (bCollidingOnly) {
+    // all colliding models are in collision grid, so just test the ones near the box
+    static CStaticStackArray<CEntity*> apenNearEntities;
+    en_pwoWorld->FindEntitiesNearBox(boxRange, apenNearEntities);
+
+    // mark entities that are already in container
+    {FOREACHINDYNAMICCONTAINER(cen, CEntity, iten) {
+      iten->en_ulFlags |= ENF_FOUNDINGRIDSEARCH;
+    }}
+
+    {for(INDEX ienNear=0; ienNear<apenNearEntities.Count(); ienNear++) {
+      CEntity *pen = apenNearEntities[ienNear];
+      // if it is a model that is inside the world
+      if ((pen->en_RenderType==RT_MODEL || pen->en_RenderType==RT_EDITORMODEL
+        || pen->en_RenderType==RT_SKAMODEL || pen->en_RenderType==RT_SKAEDITORMODEL)
+        && !pen->en_rdSectors.IsEmpty()) {
+        FindModelInRange(pen, boxRange, cen, bCollidingOnly);
+      }
+    }}
+
+    // brushes are not in the grid, test each non-zoning brush in the world
+    {FOREACHINDYNAMICARRAY(en_pwoWorld->wo_baBrushes.ba_abrBrushes, CBrush3D, itbr) {
+      CEntity *pen = itbr->br_penEntity;
+      if (pen!=NULL && pen->en_RenderType==RT_BRUSH && !(pen->en_ulFlags&(ENF_ZONING|ENF_DELETED))
+        && !pen->en_rdSectors.IsEmpty()) {
+        FindBrushInRange(pen, boxRange, cen);
+      }
+    }}
+
+  // if non-colliding entities are needed too
+  } else {
+    // mark entities that are already in container
+    {FOREACHINDYNAMICCONTAINER(cen, CEntity, iten) {
+      iten->en_ulFlags |= ENF_FOUNDINGRIDSEARCH;
+    }}
 
+    // for each zoning brush in the world
+    {FOREACHINDYNAMICARRAY(en_pwoWorld->wo_baBrushes.ba_abrBrushes, CBrush3D, itbr) {
+      CEntity *penZoning = itbr->br_penEntity;
+      if (penZoning==NULL || penZoning->en_RenderType!=RT_BRUSH || !(penZoning->en_ulFlags&ENF_ZONING)
+        || (penZoning->en_ulFlags&ENF_DELETED)) {
+        continue;
+      }
+      // get first mip in its brush
+      CBrushMip *pbm = itbr->GetFirstMip();
+      // if the mip doesn't touch the box
+      if (!pbm->bm_boxBoundingBox.HasContactWith(boxRange)) {
+        // skip it
+        continue;
+      }
+
+      // for all sectors in this mip
+      FOREACHINDYNAMICARRAY(pbm->bm_abscSectors, CBrushSector, itbsc) {
+        // if the sector doesn't touch the box
+        if (!itbsc->bsc_boxBoundingBox.HasContactWith(boxRange)) {
+          // skip it
+          continue;
+        }
+
+        // for all entities in the sector
+        {FOREACHDSTOFSRC(itbsc->bsc_rsEntities, CEntity, en_rdSectors, pen)
+          if (pen->en_RenderType==RT_MODEL || pen->en_RenderType==RT_EDITORMODEL
+            ||pen->en_RenderType==RT_SKAMODEL || pen->en_RenderType==RT_SKAEDITORMODEL) {
+            FindModelInRange(pen, boxRange, cen, bCollidingOnly);
+          } else if (pen->en_RenderType==RT_BRUSH) {
+            FindBrushInRange(pen, boxRange, cen);
+          }
+        ENDFOR}
+      }
+    }}
+  }
+
+  // clear found flags
+  {FOREACHINDYNAMICCONTAINER(cen, CEntity, iten) {
+    iten->en_ulFlags &= ~ENF_FOUNDINGRIDSEARCH;
+  }}
+  _pfPhysicsProfile.StopTimer(CPhysicsProfile::PTI_FINDENTITIESINRANGE);
+}
+
+
+// original implementation that scans all entities, kept as reference for the benchmark
+static void FindEntitiesInRange_Reference(CWorld *pwo,
+  const FLOATaabbox3D &boxRange, CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly)
+{
   // for each entity in the world of this entity
-  FOREACHINDYNAMICCONTAINER(en_pwoWorld->wo_cenEntities, CEntity, iten) {
+  FOREACHINDYNAMICCONTAINER(pwo->wo_cenEntities, CEntity, iten) {
     // if it is zoning brush entity
     if (iten->en_RenderType == CEntity::RT_BRUSH && (iten->en_ulFlags&ENF_ZONING)) {
       // get first mip in its brush
@@ -2074,7 +2343,7 @@ void CEntity::FindEntitiesInRange(
         // for all entities in the sector
         {FOREACHDSTOFSRC(itbsc->bsc_rsEntities, CEntity, en_rdSectors, pen)
           // if the model entity touches the box
-          if ((pen->en_RenderType==RT_MODEL || pen->en_RenderType==RT_EDITORMODEL)
+          if ((pen->en_RenderType==CEntity::RT_MODEL || pen->en_RenderType==CEntity::RT_EDITORMODEL)
             && boxRange.HasContactWith(
             FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
 
@@ -2101,7 +2370,7 @@ void CEntity::FindEntitiesInRange(
               }
             }
           // if the brush entity touches the box
-          } else if (pen->en_RenderType==RT_BRUSH && 
+          } else if (pen->en_RenderType==CEntity::RT_BRUSH && 
             boxRange.HasContactWith(
             FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
             // if the brush touches the box
@@ -2111,7 +2380,7 @@ void CEntity::FindEntitiesInRange(
                 cen.Add(pen);
               }
             }
-          } else if ((pen->en_RenderType==RT_SKAMODEL  || pen->en_RenderType==RT_SKAEDITORMODEL)
+          } else if ((pen->en_RenderType==CEntity::RT_SKAMODEL  || pen->en_RenderType==CEntity::RT_SKAEDITORMODEL)
             && boxRange.HasContactWith(
             FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
             // if it has collision box
@@ -2144,6 +2413,94 @@ void CEntity::FindEntitiesInRange(
   }
 }
 
+// spawn copies of a model entity around the world and compare range queries against the reference
+void FindEntitiesInRangeBenchmark(INDEX ctEntities, INDEX ctQueries)
+{
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+  ctEntities = Clamp(ctEntities, 0L, 20000L);
+  ctQueries  = Clamp(ctQueries, 1L, 100000L);
+  // spawning changes entity IDs and world state, which would desync a running game or demo
+  if (_pNetwork->IsGameActive()) {
+    CPrintF(TRANS("Cannot run benchmark while a game is running.\n"));
+    return;
+  }
+  CWorld &wo = _pNetwork->ga_World;
+
+  // find a non-living model with collision to copy and the extent of the world
+  CEntity *penTemplate = NULL;
+  FLOATaabbox3D boxWorld;
+  {FOREACHINDYNAMICCONTAINER(wo.wo_cenEntities, CEntity, iten) {
+    if (penTemplate==NULL && iten->en_pciCollisionInfo!=NULL && !(iten->en_ulFlags&ENF_ALIVE)
+      && (iten->en_RenderType==CEntity::RT_MODEL || iten->en_RenderType==CEntity::RT_SKAMODEL)) {
+      penTemplate = iten;
+    }
+    if (iten->en_RenderType==CEntity::RT_BRUSH && (iten->en_ulFlags&ENF_ZONING)) {
+      boxWorld |= iten->en_pbrBrush->GetFirstMip()->bm_boxBoundingBox;
+    }
+  }}
+  if (penTemplate==NULL || boxWorld.IsEmpty()) {
+    CPrintF(TRANS("Load a world with zoning brushes and a colliding model first.\n"));
+    return;
+  }
+
+  ULONG ulSeed = 0x3A1B7C9;
+  #define NEXTRANDOM() (ulSeed = ulSeed*1103515245+12345, FLOAT((ulSeed>>8)&0xFFFF)/65535.0f)
+  #define RANDOMPOINT() FLOAT3D( \
+    Lerp(boxWorld.Min()(1), boxWorld.Max()(1), NEXTRANDOM()), \
+    Lerp(boxWorld.Min()(2), boxWorld.Max()(2), NEXTRANDOM()), \
+    Lerp(boxWorld.Min()(3), boxWorld.Max()(3), NEXTRANDOM()))
+
+  // populate the world
+  CDynamicContainer<CEntity> cenSpawned;
+  {for(INDEX ien=0; ien<ctEntities; ien++) {
+    CPlacement3D pl(RANDOMPOINT(), ANGLE3D(NEXTRANDOM()*360.0f, 0, 0));
+    cenSpawned.Add(wo.CopyEntityInWorld(*penTemplate, pl, FALSE));
+  }}
+
+  // run same queries through both implementations
+  CTimerValue tvNew(0.0), tvOld(0.0);
+  INDEX ctFound = 0;
+  INDEX ctMismatches = 0;
+  {for(INDEX iQuery=0; iQuery<ctQueries; iQuery++) {
+    FLOATaabbox3D boxRange(RANDOMPOINT(), 2.0f+NEXTRANDOM()*14.0f);
+    BOOL bCollidingOnly = (iQuery%4)!=0;
+    CDynamicContainer<CEntity> cenNew, cenOld;
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    penTemplate->FindEntitiesInRange(boxRange, cenNew, bCollidingOnly);
+    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+    FindEntitiesInRange_Reference(&wo, boxRange, cenOld, bCollidingOnly);
+    CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+    tvNew += tv1-tv0;
+    tvOld += tv2-tv1;
+    ctFound += cenNew.Count();
+    // both must find the same entities, in any order
+    BOOL bSame = cenNew.Count()==cenOld.Count();
+    {FOREACHINDYNAMICCONTAINER(cenNew, CEntity, iten) {
+      bSame = bSame && cenOld.IsMember(iten);
+    }}
+    if (!bSame) {
+      ctMismatches++;
+    }
+  }}
+  #undef RANDOMPOINT
+  #undef NEXTRANDOM
+
+  // remove the copies
+  {FOREACHINDYNAMICCONTAINER(cenSpawned, CEntity, iten) {
+    iten->Destroy();
+  }}
+
+  CPrintF("FindEntitiesInRange(): %d entities in world, %d queries, %d found, %d mismatches\n",
+    wo.wo_cenEntities.Count()+ctEntities, ctQueries, ctFound, ctMismatches);
+  CPrintF("  reference: %.2f ms, new: %.2f ms\n", tvOld.GetSeconds()*1000, tvNew.GetSeconds()*1000);
+}
+void FindEntitiesInRangeBenchmarkCfunc(void *pArgs)
+{
+  INDEX ctEntities = NEXTARGUMENT(INDEX);
+  INDEX ctQueries  = NEXTARGUMENT(INDEX);
+  FindEntitiesInRangeBenchmark(ctEntities, ctQueries);
+}
+
 /* Send an event to all entities in a box (box must be around this entity). */
 void CEntity::SendEventInRange(const CEntityEvent &ee, const FLOATaabbox3D &boxRange)
 {
@@ -2182,17 +2539,31 @@ void CEntity::HandleSentEvents(void)
     iFirstEvent++;
   }
 
+  // gather statistics if needed
+  if (_bEventStatsInTick) {
+    _ctEventStatsTickEvents += _aseSentEvents.Count();
+    for(INDEX iee=0; iee<_aseSentEvents.Count(); iee++) {
+      CountEventForStats(*_aseSentEvents[iee].se_peeEvent);
+    }
+  }
+
   // for each event
   for(INDEX iee=0; iee<_aseSentEvents.Count(); iee++) {
     CSentEvent &se = _aseSentEvents[iee];
     // release the entity and destroy the event
     se.se_penEntity = NULL;
-    delete se.se_peeEvent;
+    if (se.se_bPooled) {
+      se.se_peeEvent->~CEntityEvent();
+    } else {
+      delete se.se_peeEvent;
+    }
     se.se_peeEvent = NULL;
   }
 
-  // flush all events
+  // flush all events and their pool
   _aseSentEvents.PopAll();
+  _iEventPoolChunk = -1;
+  _slEventPoolUsed = 0;
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -3702,6 +4073,19 @@ void CLiveEntity::ReceiveDamage(CEntity *penInflictor, enum DamageType dmtType,
  */
 CRationalEntity::CRationalEntity(void)
 {
+  en_iInTimers = -1;
+  en_ulTimerOrder = 0;
+}
+
+/*
+ * Destructor.
+ */
+CRationalEntity::~CRationalEntity(void)
+{
+  // remove from list of timers if still waiting
+  if (en_iInTimers>=0) {
+    en_pwoWorld->RemoveTimer(this);
+  }
 }
 
 /* Calculate physics for moving. */
@@ -3749,7 +4133,7 @@ void CRationalEntity::Copy(CEntity &enOther, ULONG ulFlags)
     CRationalEntity *prenOther = (CRationalEntity *)(&enOther);
     en_timeTimer = prenOther->en_timeTimer;
     en_stslStateStack = prenOther->en_stslStateStack;
-    if (prenOther->en_lnInTimers.IsLinked()) {
+    if (prenOther->IsTimerSet()) {
       en_pwoWorld->AddTimer(this);
     }
   }
@@ -3779,7 +4163,7 @@ void CRationalEntity::Write_t( CTStream *ostr) // throw char *
 {
   CLiveEntity::Write_t(ostr);
   // if not currently waiting for thinking
-  if (!en_lnInTimers.IsLinked()) {
+  if (!IsTimerSet()) {
     // set dummy thinking time as a flag for later loading
     en_timeTimer = THINKTIME_NEVER;
   }
@@ -3806,8 +4190,8 @@ void CRationalEntity::SetTimerAt(TIME timeAbsolute)
   if (en_timeTimer != THINKTIME_NEVER) {
     en_pwoWorld->AddTimer(this);
   } else {
-    if (en_lnInTimers.IsLinked()) {
-      en_lnInTimers.Remove();
+    if (IsTimerSet()) {
+      en_pwoWorld->RemoveTimer(this);
     }
   }
 }
@@ -3825,8 +4209,8 @@ void CRationalEntity::SetTimerAfter(TIME timeDelta)
 void CRationalEntity::UnsetTimer(void)
 {
   en_timeTimer = THINKTIME_NEVER;
-  if (en_lnInTimers.IsLinked()) {
-    en_lnInTimers.Remove();
+  if (IsTimerSet()) {
+    en_pwoWorld->RemoveTimer(this);
   }
 }
 
@@ -3942,8 +4326,8 @@ void CRationalEntity::OnInitialize(const CEntityEvent &eeInput)
 
   // do not think
   en_timeTimer = THINKTIME_NEVER;
-  if (en_lnInTimers.IsLinked()) {
-    en_lnInTimers.Remove();
+  if (IsTimerSet()) {
+    en_pwoWorld->RemoveTimer(this);
   }
 
   // initialize state stack
@@ -750,7 +750,8 @@ public:
  */
 class ENGINE_API CRationalEntity : public CLiveEntity {
 public:
-  CListNode en_lnInTimers;    // node in list of waiting timers - sorted by wait time
+  INDEX en_iInTimers;         // index in world's heap of waiting timers (-1 if not waiting)
+  ULONG en_ulTimerOrder;      // order among timers waiting for same moment (later set is due first)
 public:
   TIME en_timeTimer;          // moment in time this entity waits for timer
 
@@ -793,6 +794,8 @@ public:
   void SetTimerAfter(TIME timeDelta);
   /* Cancel eventual pending timer. */
   void UnsetTimer(void);
+  /* Check if entity is waiting for a timer. */
+  inline BOOL IsTimerSet(void) const { return en_iInTimers>=0; };
 
   /* Called after creating and setting its properties. */
   virtual void OnInitialize(const CEntityEvent &eeInput);
@@ -801,6 +804,8 @@ public:
 public:
   /* Constructor. */
   CRationalEntity(void);
+  /* Destructor. */
+  ~CRationalEntity(void);
 
   /* Handle an event - return false if event was not handled. */
   virtual BOOL HandleEvent(const CEntityEvent &ee);
@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Templates/Stock_CEntityClass.h>
 
 #include <Engine/Templates/Stock_CEntityClass.h>
+#include <Engine/Templates/StaticArray.cpp>
 
 /////////////////////////////////////////////////////////////////////
 // CEntityClass
@@ -97,6 +98,9 @@ void CEntityClass::Clear(void)
   ec_pdecDLLClass = NULL;
   ec_hiClassDLL = NULL;
   ec_fnmClassDLL.Clear();
+  ec_apeheHandlers.Clear();
+  ec_apepPropertiesByID.Clear();
+  ec_apepPropertiesByName.Clear();
 }
 
 /* Check that all properties have been properly declared. */
@@ -152,6 +156,110 @@ void CEntityClass::CheckClassProperties(void)
 #endif
 }
 
+// hash functions for lookup tables
+static inline ULONG HashForState(SLONG slState)
+{
+  ULONG ulHash = ULONG(slState)*0x9E3779B1UL;
+  return ulHash^(ulHash>>16);
+}
+static inline ULONG HashForID(ULONG ulID)
+{
+  ULONG ulHash = ulID*0x9E3779B1UL;
+  return ulHash^(ulHash>>16);
+}
+static inline ULONG HashForName(const char *strName)
+{
+  // names are compared without case
+  ULONG ulHash = 2166136261UL;
+  for (; *strName!=0; strName++) {
+    ulHash = (ulHash^(UBYTE)tolower(*strName))*16777619UL;
+  }
+  return ulHash;
+}
+
+// get size of hash table for given number of entries
+static INDEX HashTableSize(INDEX ctEntries)
+{
+  // keep at most half of the slots used
+  INDEX ctSlots = 16;
+  while (ctSlots<ctEntries*2) {
+    ctSlots *= 2;
+  }
+  return ctSlots;
+}
+
+/*
+ * Build lookup tables for handlers and properties of the class and all its bases.
+ */
+void CEntityClass::BuildLookupTables(void)
+{
+  ec_apeheHandlers.Clear();
+  ec_apepPropertiesByID.Clear();
+  ec_apepPropertiesByName.Clear();
+  if (ec_pdecDLLClass==NULL) {
+    return;
+  }
+
+  // count entries in all classes in hierarchy
+  INDEX ctHandlers = 0;
+  INDEX ctProperties = 0;
+  CDLLEntityClass *pdec;
+  for (pdec=ec_pdecDLLClass; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    ctHandlers += pdec->dec_ctHandlers;
+    ctProperties += pdec->dec_ctProperties;
+  }
+  ec_apeheHandlers.New(HashTableSize(ctHandlers));
+  ec_apepPropertiesByID.New(HashTableSize(ctProperties));
+  ec_apepPropertiesByName.New(HashTableSize(ctProperties));
+  const INDEX iHandlerMask = ec_apeheHandlers.Count()-1;
+  const INDEX iPropertyMask = ec_apepPropertiesByID.Count()-1;
+  INDEX iSlot;
+  for (iSlot=0; iSlot<ec_apeheHandlers.Count(); iSlot++) {
+    ec_apeheHandlers[iSlot] = NULL;
+  }
+  for (iSlot=0; iSlot<ec_apepPropertiesByID.Count(); iSlot++) {
+    ec_apepPropertiesByID[iSlot] = NULL;
+    ec_apepPropertiesByName[iSlot] = NULL;
+  }
+
+  // for all classes from this one down to the base, first entry with given key wins,
+  // same as when searching each class in turn
+  for (pdec=ec_pdecDLLClass; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    // add handlers by state
+    {for (INDEX iHandler=0; iHandler<pdec->dec_ctHandlers; iHandler++) {
+      CEventHandlerEntry *pehe = &pdec->dec_aeheHandlers[iHandler];
+      iSlot = HashForState(pehe->ehe_slState)&iHandlerMask;
+      while (ec_apeheHandlers[iSlot]!=NULL && ec_apeheHandlers[iSlot]->ehe_slState!=pehe->ehe_slState) {
+        iSlot = (iSlot+1)&iHandlerMask;
+      }
+      if (ec_apeheHandlers[iSlot]==NULL) {
+        ec_apeheHandlers[iSlot] = pehe;
+      }
+    }}
+    // add properties by id and by name
+    {for (INDEX iProperty=0; iProperty<pdec->dec_ctProperties; iProperty++) {
+      CEntityProperty *pep = &pdec->dec_aepProperties[iProperty];
+      iSlot = HashForID(pep->ep_ulID)&iPropertyMask;
+      while (ec_apepPropertiesByID[iSlot]!=NULL && ec_apepPropertiesByID[iSlot]->ep_ulID!=pep->ep_ulID) {
+        iSlot = (iSlot+1)&iPropertyMask;
+      }
+      if (ec_apepPropertiesByID[iSlot]==NULL) {
+        ec_apepPropertiesByID[iSlot] = pep;
+      }
+      if (pep->ep_strName==NULL) {
+        continue;
+      }
+      iSlot = HashForName(pep->ep_strName)&iPropertyMask;
+      while (ec_apepPropertiesByName[iSlot]!=NULL && stricmp(ec_apepPropertiesByName[iSlot]->ep_strName, pep->ep_strName)!=0) {
+        iSlot = (iSlot+1)&iPropertyMask;
+      }
+      if (ec_apepPropertiesByName[iSlot]==NULL) {
+        ec_apepPropertiesByName[iSlot] = pep;
+      }
+    }}
+  }
+}
+
 /*
  * Construct a new member of the class.
  */
@@ -176,6 +284,14 @@ CEntity *CEntityClass::New(void)
  */
 void CEntityClass::ObtainComponents_t(void)
 {
+  // let loader threads read ahead all components that will be obtained
+  {for (INDEX iComponent=0; iComponent<ec_pdecDLLClass->dec_ctComponents; iComponent++) {
+    CEntityComponent &ec = ec_pdecDLLClass->dec_aecComponents[iComponent];
+    if( gam_iPrecachePolicy>=PRECACHE_ALL || ec.ec_ectType==ECT_CLASS) {
+      ec.Prefetch();
+    }
+  }}
+
   // for each component
   for (INDEX iComponent=0; iComponent<ec_pdecDLLClass->dec_ctComponents; iComponent++) {
     // if not precaching all
@@ -197,6 +313,7 @@ void CEntityClass::ObtainComponents_t(void)
       // if in paranoia mode
       if( gam_iPrecachePolicy==PRECACHE_PARANOIA) {
         // fail
+        DiscardComponentPrefetches();
         throw;
       // if not in paranoia mode
       } else {
@@ -205,6 +322,21 @@ void CEntityClass::ObtainComponents_t(void)
       }
     }
   }
+  // files of components that were not opened (e.g. failed to load) are not needed anymore
+  DiscardComponentPrefetches();
+}
+
+/*
+ * Free files read ahead for components that were not obtained.
+ */
+void CEntityClass::DiscardComponentPrefetches(void)
+{
+  for (INDEX iComponent=0; iComponent<ec_pdecDLLClass->dec_ctComponents; iComponent++) {
+    CEntityComponent &ec = ec_pdecDLLClass->dec_aecComponents[iComponent];
+    if( gam_iPrecachePolicy>=PRECACHE_ALL || ec.ec_ectType==ECT_CLASS) {
+      DiscardPreloadedFile(ec.ec_fnmComponent);
+    }
+  }
 }
 
 /*
@@ -316,6 +448,8 @@ void CEntityClass::Read_t( CTStream *istr) // throw char *
 
   // check that the class properties have been properly declared
   CheckClassProperties();
+  // flatten handlers and properties of the whole hierarchy for fast lookup
+  BuildLookupTables();
 }
 
 /*
@@ -354,17 +488,51 @@ void CEntityClass::AddToCRCTable(void)
 
 /* Get pointer to entity property from its name. */
 class CEntityProperty *CEntityClass::PropertyForName(const CTString &strPropertyName) {
-  return ec_pdecDLLClass->PropertyForName(strPropertyName);
+  // if no lookup table, search the classes
+  const INDEX ctSlots = ec_apepPropertiesByName.Count();
+  if (ctSlots==0) {
+    return ec_pdecDLLClass->PropertyForName(strPropertyName);
+  }
+  INDEX iSlot = HashForName(strPropertyName)&(ctSlots-1);
+  for (CEntityProperty *pep; (pep=ec_apepPropertiesByName[iSlot])!=NULL; iSlot=(iSlot+1)&(ctSlots-1)) {
+    if (pep->ep_strName==strPropertyName) {
+      return pep;
+    }
+  }
+  return NULL;
 };
 /* Get pointer to entity property from its packed identifier. */
 class CEntityProperty *CEntityClass::PropertyForTypeAndID(
   ULONG ulType, ULONG ulID) {
-  return ec_pdecDLLClass->PropertyForTypeAndID((CEntityProperty::PropertyType)ulType, ulID);
+  // if no lookup table, search the classes
+  const INDEX ctSlots = ec_apepPropertiesByID.Count();
+  if (ctSlots==0) {
+    return ec_pdecDLLClass->PropertyForTypeAndID((CEntityProperty::PropertyType)ulType, ulID);
+  }
+  INDEX iSlot = HashForID(ulID)&(ctSlots-1);
+  for (CEntityProperty *pep; (pep=ec_apepPropertiesByID[iSlot])!=NULL; iSlot=(iSlot+1)&(ctSlots-1)) {
+    if (pep->ep_ulID==ulID) {
+      // if it has different type, return that it was not found, this makes the whole thing much safer
+      return pep->ep_eptType==(CEntityProperty::PropertyType)ulType ? pep : NULL;
+    }
+  }
+  return NULL;
 };
 
 /* Get event handler for given state and event code. */
 CEntity::pEventHandler CEntityClass::HandlerForStateAndEvent(SLONG slState, SLONG slEvent) {
-  return ec_pdecDLLClass->HandlerForStateAndEvent(slState, slEvent);
+  // if no lookup table, search the classes
+  const INDEX ctSlots = ec_apeheHandlers.Count();
+  if (ctSlots==0) {
+    return ec_pdecDLLClass->HandlerForStateAndEvent(slState, slEvent);
+  }
+  INDEX iSlot = HashForState(slState)&(ctSlots-1);
+  for (CEventHandlerEntry *pehe; (pehe=ec_apeheHandlers[iSlot])!=NULL; iSlot=(iSlot+1)&(ctSlots-1)) {
+    if (pehe->ehe_slState==slState) {
+      return pehe->ehe_pEventHandler;
+    }
+  }
+  return NULL;
 }
 
 /* Get pointer to component from its identifier. */
@@ -30,6 +30,8 @@ class ENGINE_API CEntityClass : public CSerial {
 public:
   /* Obtain all components from component table. */
   void ObtainComponents_t(void);  // throw char *
+  /* Free files read ahead for components that were not obtained. */
+  void DiscardComponentPrefetches(void);
   /* Release all components from component table. */
   void ReleaseComponents(void);
 public:
@@ -37,6 +39,11 @@ public:
   HINSTANCE ec_hiClassDLL;                // handle to the DLL with the class
   class CDLLEntityClass *ec_pdecDLLClass; // pointer to DLL class in the DLL
 
+  // lookup tables for whole class hierarchy (open hashing, empty slots are NULL)
+  CStaticArray<class CEventHandlerEntry *> ec_apeheHandlers; // handlers by state
+  CStaticArray<class CEntityProperty *> ec_apepPropertiesByID;   // properties by id
+  CStaticArray<class CEntityProperty *> ec_apepPropertiesByName; // properties by name
+
   /* Default constructor. */
   CEntityClass(void);
   /* Constructor for a fixed class. */
@@ -52,6 +59,8 @@ public:
 
   /* Check that all properties have been properly declared. */
   void CheckClassProperties(void);
+  /* Build lookup tables for handlers and properties of the class and all its bases. */
+  void BuildLookupTables(void);
 
   /* Construct a new member of the class. */
   class CEntity *New(void);
@@ -19,6 +19,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
   #pragma once
 #endif
 
+#include <new.h>  // for placement new in MakeCopyAt()
+
 // a BOOL that is constructed with value of FALSE (used in some entity initializations)
 class ENGINE_API CBoolDefaultFalse {
 public:
@@ -41,6 +43,15 @@ public:
     CEntityEvent *peeCopy = new CEntityEvent(*this);
     return peeCopy;
   };
+  // copy into given memory of GetSizeOf() bytes (derived classes must override both,
+  // as event classes generated by Ecc do)
+  virtual CEntityEvent *MakeCopyAt(void *pvMemory) {
+    CEntityEvent *peeCopy = new(pvMemory) CEntityEvent(*this);
+    return peeCopy;
+  };
+  virtual SLONG GetSizeOf(void) { return sizeof(CEntityEvent); };
+  // name of the event class (event classes generated by Ecc override this)
+  virtual const char *GetName(void) { return ""; };
 };
 // a reference to a void event for use as default parameter
 ENGINE_API extern const CEntityEvent &_eeVoid;
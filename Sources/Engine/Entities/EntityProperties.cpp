@@ -611,6 +611,28 @@ void CEntityComponent::Obtain_t(void)  // throw char *
   // add to CRC
   AddToCRCTable();
 }
+/*
+ * Start reading the component's file ahead, so that obtaining it is faster.
+ */
+void CEntityComponent::Prefetch(void)
+{
+  // if obtained, there is nothing to read
+  if (ec_pvPointer!=NULL) {
+    return;
+  }
+  switch(ec_ectType) {
+    case ECT_TEXTURE: _pTextureStock->Prefetch(ec_fnmComponent); break;
+    case ECT_MODEL:   _pModelStock->Prefetch(ec_fnmComponent); break;
+    case ECT_SOUND:
+      // encoded sounds are streamed later, their files are not read when obtained
+      if (ec_fnmComponent.FileExt()!=".ogg" && ec_fnmComponent.FileExt()!=".mp3") {
+        _pSoundStock->Prefetch(ec_fnmComponent);
+      }
+      break;
+    case ECT_CLASS:   _pEntityClassStock->Prefetch(ec_fnmComponent); break;
+  }
+}
+
 void CEntityComponent::ObtainWithCheck(void)
 {
   try {
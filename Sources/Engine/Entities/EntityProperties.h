@@ -150,6 +150,8 @@ public:
   /* Obtain the component. */
   void Obtain_t(void);  // throw char *
   void ObtainWithCheck(void);
+  /* Start reading the component's file ahead, so that obtaining it is faster. */
+  void Prefetch(void);
   // add component to crc table
   void AddToCRCTable(void);
   /* Release the component. */
@@ -144,6 +144,8 @@ extern INDEX shd_bAllowFlats = TRUE;   // allow optimization of single-color sha
 extern INDEX shd_iForceFlats = 0;      // force all shadowmaps to be flat (internal!) - 0=don't, 1=w/o overbrighting, 2=w/ overbrighting
 extern INDEX shd_bShowFlats  = FALSE;  // colorize flat shadows
 extern INDEX shd_bColorize   = FALSE;  // colorize shadows by size (gradieng from red=big to green=little)
+extern INDEX shd_bUseSSE2    = TRUE;   // mix shadow layers with SSE2 kernels when CPU supports them
+extern INDEX shd_iBakeThreads = 0;     // threads that finish static shadow layers while next ones are rendered (0=none)
 
 
 // OpenGL control
@@ -202,11 +204,13 @@ extern INDEX mdl_iShadowQuality    = 1;
 extern FLOAT mdl_fLODMul           = 1.0f;
 extern FLOAT mdl_fLODAdd           = 0.0f;
 extern INDEX mdl_iLODDisappear     = 1; // 0=never, 1=ignore bias, 2=with bias
+extern INDEX mdl_bUseSSE2          = TRUE;  // unpack model frames with SSE2 kernels when CPU supports it
 // ska controls
 extern INDEX ska_bShowSkeleton     = FALSE;
 extern INDEX ska_bShowColision     = FALSE;
 extern FLOAT ska_fLODMul           = 1.0f;
 extern FLOAT ska_fLODAdd           = 0.0f;
+extern INDEX ska_bUseSSE           = TRUE;  // skin meshes with SSE when CPU supports it
 // terrain controls
 extern INDEX ter_bShowQuadTree     = FALSE;
 extern INDEX ter_bShowWireframe    = FALSE;
@@ -792,6 +796,9 @@ extern void UncacheShadows(void)
 
 // refresh (uncache and eventually cache) all cached shadow maps
 extern void CacheShadows(void);
+extern void ShadowMixerBenchmark(void);
+extern void RM_SkinningBenchmarkCfunc(void *pArgs);
+extern void ModelUnpackBenchmarkCfunc(void *pArgs);
 static void RecacheShadows(void)
 {
   // mute all sounds
@@ -1064,6 +1071,7 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("user void TexturesInfo(void);", &TexturesInfo);
   _pShell->DeclareSymbol("user void UncacheShadows(void);",  &UncacheShadows);
   _pShell->DeclareSymbol("user void RecacheShadows(void);",  &RecacheShadows);
+  _pShell->DeclareSymbol("user void ShadowMixerBenchmark(void);", &ShadowMixerBenchmark);
   _pShell->DeclareSymbol("user void RefreshTextures(void);", &RefreshTextures);
   _pShell->DeclareSymbol("user void ReloadModels(void);",    &ReloadModels);
 
@@ -1123,11 +1131,15 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("persistent user INDEX mdl_bFineQuality post:MdlPostFunc;", &mdl_bFineQuality);
   _pShell->DeclareSymbol("persistent user INDEX mdl_iShadowQuality;",  &mdl_iShadowQuality);
   _pShell->DeclareSymbol("                INDEX mdl_bTruformWeapons;", &mdl_bTruformWeapons);
+  _pShell->DeclareSymbol("persistent user INDEX mdl_bUseSSE2;",        &mdl_bUseSSE2);
+  _pShell->DeclareSymbol("user void ModelUnpackBenchmark(CTString);", &ModelUnpackBenchmarkCfunc);
   
   _pShell->DeclareSymbol("           user INDEX ska_bShowSkeleton;",   &ska_bShowSkeleton);
   _pShell->DeclareSymbol("           user INDEX ska_bShowColision;",   &ska_bShowColision);
   _pShell->DeclareSymbol("persistent user FLOAT ska_fLODMul;",         &ska_fLODMul);
   _pShell->DeclareSymbol("persistent user FLOAT ska_fLODAdd;",         &ska_fLODAdd);
+  _pShell->DeclareSymbol("persistent user INDEX ska_bUseSSE;",         &ska_bUseSSE);
+  _pShell->DeclareSymbol("user void SkinningBenchmark(INDEX, INDEX);", &RM_SkinningBenchmarkCfunc);
   
   _pShell->DeclareSymbol("           user INDEX ter_bShowQuadTree;",   &ter_bShowQuadTree);
   _pShell->DeclareSymbol("           user INDEX ter_bShowWireframe;",  &ter_bShowWireframe);
@@ -1180,6 +1192,8 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("persistent      INDEX shd_iForceFlats;", &shd_iForceFlats);
   _pShell->DeclareSymbol("           user INDEX shd_bShowFlats;",  &shd_bShowFlats);
   _pShell->DeclareSymbol("           user INDEX shd_bColorize;",   &shd_bColorize);
+  _pShell->DeclareSymbol("persistent user INDEX shd_bUseSSE2;",    &shd_bUseSSE2);
+  _pShell->DeclareSymbol("persistent user INDEX shd_iBakeThreads;", &shd_iBakeThreads);
   
   _pShell->DeclareSymbol("           user INDEX gfx_bRenderParticles;", &gfx_bRenderParticles);
   _pShell->DeclareSymbol("           user INDEX gfx_bRenderFog;",       &gfx_bRenderFog);
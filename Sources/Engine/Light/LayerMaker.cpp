@@ -25,11 +25,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/World/World.h>
 #include <Engine/Entities/Entity.h>
 #include <Engine/Templates/StaticArray.cpp>
+#include <Engine/Templates/StaticStackArray.cpp>
+#include <Engine/Templates/DynamicArray.cpp>
+#include <Engine/Templates/DynamicContainer.cpp>
 #include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Math/Clipping.inl>
 
 #include <Engine/Light/Shadows_internal.h>
 #include <Engine/World/WorldEditingProfile.h>
+#include <Engine/Base/Synchronization.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/CRC.h>
+#include <Engine/Base/Translation.h>
 
 //#include <Engine/Graphics/ImageInfo.h>
 //#include <Engine/Base/ErrorReporting.h>
@@ -85,6 +94,9 @@ public:
 
   CLightSource *lm_plsLight;    // current light
 
+  ULONG lm_ulPolygonFlags;      // polygon flags when the layer was rendered
+  class CPolygonMaskRef *lm_ppmrPolygonMask; // polygon mask shared with bake threads (NULL if none)
+
   // remember general data
   void CalculateData(void);
 
@@ -94,6 +106,8 @@ public:
   // make shadow mask for the light
   ULONG MakeShadowMask(CBrushShadowLayer *pbsl);
   ULONG MakeOneShadowMaskMip(INDEX iMip);
+  // make other mips, spread and pack the rendered shadow mask (doesn't touch the world)
+  void FinishShadowMask(void);
   // flip shadow mask around V axis (for parallel lights)
   void FlipShadowMask(INDEX iMip);
 
@@ -110,6 +124,153 @@ public:
   BOOL CreateLayers(CBrushPolygon &bpo, CWorld &woWorld, BOOL bDoDirectionalLights);
 };
 
+
+// ------------------------------------ bake threads
+
+// Shadows are rendered with the one global renderer, so layers are still rendered one by one.
+// Everything that comes after rendering only works on the layer's own masks, so that part is
+// left to bake threads while the next layer is being rendered.
+
+extern INDEX shd_iBakeThreads;
+
+#define MAX_BAKETHREADS 16
+#define MAX_PENDINGLAYERS 256   // main thread finishes layers itself when bake threads fall behind
+
+// byte-packed polygon mask shared by all layers of one polygon
+class CPolygonMaskRef {
+public:
+  UBYTE *pmr_pubMask;
+  INDEX pmr_ctRefs;   // layers that still need the mask (guarded by _csBake)
+};
+
+static CTCriticalSection _csBake;              // guards pending layers and polygon mask references
+static CStaticStackArray<CLayerMaker> _almPending; // rendered layers that are waiting to be finished
+static INDEX _iFirstPending = 0;               // first layer that is not yet taken
+static INDEX _ctBusyLayers = 0;                // layers that bake threads are finishing right now
+static HANDLE _ahBakeThreads[MAX_BAKETHREADS];
+static INDEX _ctBakeThreads = 0;
+static HANDLE _hBakeEvent = NULL;              // signaled when a layer is queued
+static volatile BOOL _bStopBake = FALSE;
+
+
+// release one reference to a polygon mask (frees it with the last one)
+static void ReleasePolygonMask(CPolygonMaskRef *ppmr)
+{
+  {
+    CTSingleLock slBake(&_csBake, TRUE);
+    ppmr->pmr_ctRefs--;
+    if( ppmr->pmr_ctRefs>0) return;
+  }
+  FreeMemory(ppmr->pmr_pubMask);
+  delete ppmr;
+}
+
+
+// finish first pending layer (returns FALSE if there is none)
+static BOOL FinishPendingLayer(void)
+{
+  CLayerMaker lm;
+  {
+    CTSingleLock slBake(&_csBake, TRUE);
+    if( _iFirstPending>=_almPending.Count()) return FALSE;
+    lm = _almPending[_iFirstPending];
+    _iFirstPending++;
+    _ctBusyLayers++;
+  }
+  lm.FinishShadowMask();
+  lm.lm_pbslLayer->bsl_pubLayer = lm.lm_pubLayer;
+  ReleasePolygonMask(lm.lm_ppmrPolygonMask);
+  CTSingleLock slBake(&_csBake, TRUE);
+  _ctBusyLayers--;
+  return TRUE;
+}
+
+
+// queue a rendered layer to be finished by bake threads
+static void QueuePendingLayer(const CLayerMaker &lm)
+{
+  INDEX ctPending;
+  {
+    CTSingleLock slBake(&_csBake, TRUE);
+    lm.lm_ppmrPolygonMask->pmr_ctRefs++;
+    // reuse the array when all layers were taken
+    if( _iFirstPending==_almPending.Count()) {
+      _almPending.PopAll();
+      _iFirstPending = 0;
+    }
+    _almPending.Push() = lm;
+    ctPending = _almPending.Count()-_iFirstPending;
+  }
+  SetEvent(_hBakeEvent);
+  // if bake threads cannot keep up, help them (keeps byte-packed masks from piling up)
+  if( ctPending>MAX_PENDINGLAYERS) FinishPendingLayer();
+}
+
+
+static DWORD WINAPI BakeThread(LPVOID lpParam)
+{
+  while( !_bStopBake) {
+    // if nothing to finish, wait until some layer is rendered
+    if( !FinishPendingLayer()) {
+      WaitForSingleObject( _hBakeEvent, 10);
+    }
+  }
+  return 0;
+}
+
+
+// start bake threads for making shadow maps (if enabled)
+extern void BeginShadowBake(void)
+{
+  shd_iBakeThreads = Clamp( shd_iBakeThreads, 0L, (INDEX)MAX_BAKETHREADS);
+  if( _ctBakeThreads>0 || shd_iBakeThreads==0) return;
+  _csBake.cs_iIndex = -1;
+  _bStopBake = FALSE;
+  _hBakeEvent = CreateEvent( NULL, FALSE, FALSE, NULL);
+  if( _hBakeEvent==NULL) return;
+
+  for( INDEX iThread=0; iThread<shd_iBakeThreads; iThread++) {
+    DWORD dwThreadId;
+    HANDLE hThread = CreateThread( NULL, 0, BakeThread, NULL, 0, &dwThreadId);
+    if( hThread==NULL) break;
+    _ahBakeThreads[_ctBakeThreads++] = hThread;
+  }
+  // if no thread could be started, layers will be finished right after rendering
+  if( _ctBakeThreads==0) {
+    CloseHandle( _hBakeEvent);
+    _hBakeEvent = NULL;
+  }
+}
+
+
+// wait until all layers are finished and stop bake threads
+extern void EndShadowBake(void)
+{
+  if( _ctBakeThreads==0) return;
+  // help with layers that are still pending
+  while( FinishPendingLayer()) NOTHING;
+  // wait for those that bake threads have already taken
+  FOREVER {
+    {
+      CTSingleLock slBake(&_csBake, TRUE);
+      if( _ctBusyLayers==0) break;
+    }
+    Sleep(0);
+  }
+
+  _bStopBake = TRUE;
+  WaitForMultipleObjects( _ctBakeThreads, _ahBakeThreads, TRUE, INFINITE);
+  for( INDEX iThread=0; iThread<_ctBakeThreads; iThread++) {
+    CloseHandle( _ahBakeThreads[iThread]);
+  }
+  _ctBakeThreads = 0;
+  CloseHandle( _hBakeEvent);
+  _hBakeEvent = NULL;
+  _almPending.PopAll();
+  _iFirstPending = 0;
+}
+
+
 /* Make mip-maps of the shadow mask. */
 static void MakeMipmapsForMask(UBYTE *pubMask, PIX pixSizeU, PIX pixSizeV, SLONG slTotalSize)
 {
@@ -642,15 +803,46 @@ ULONG CLayerMaker::MakeShadowMask(CBrushShadowLayer *pbsl)
       ulLighted&=MakeOneShadowMaskMip(iMip);
     }
   } else {
-    // make first mip-map of mask
+    // make first mip-map of mask (others are made from it when finishing)
     ulLighted&=MakeOneShadowMaskMip(0);
+  }
+
+  // update statistics
+  _ctShadowLayers++;
+  _ctShadowClusters+=lm_mmtLayer.mmt_slTotalSize;
+
+  // if the layer is all light or all dark, its mask would be discarded anyway
+  if( ulLighted&(BSLF_ALLLIGHT|BSLF_ALLDARK)) {
+    FreeMemory(lm_pubLayer);
+    pbsl->bsl_pubLayer = NULL;
+    return ulLighted;
+  }
+
+  lm_ulPolygonFlags = lm_pbpoPolygon->bpo_ulFlags;
+  // if there are bake threads, let them finish the mask
+  if( lm_ppmrPolygonMask!=NULL) {
+    pbsl->bsl_pubLayer = NULL;
+    QueuePendingLayer(*this);
+  // otherwise finish it now
+  } else {
+    FinishShadowMask();
+    pbsl->bsl_pubLayer = lm_pubLayer;
+  }
+  return ulLighted;
+}
+
+// make other mips, spread and pack the rendered shadow mask (doesn't touch the world)
+void CLayerMaker::FinishShadowMask(void)
+{
+  // if polygon doesn't require exact shadows
+  if( !(lm_ulPolygonFlags&BPOF_ACCURATESHADOWS)) {
     // make other shadow mask mips from the first one
     MakeMipmapsForMask( lm_pubLayer, lm_mmtLayer.mmt_pixU, lm_mmtLayer.mmt_pixV,
                         lm_mmtLayer.mmt_slTotalSize);
   }
 
   // spread the shadow mask towards pixels outside of polygon
-  if( !(lm_pbpoPolygon->bpo_ulFlags&BPOF_DARKCORNERS)) {
+  if( !(lm_ulPolygonFlags&BPOF_DARKCORNERS)) {
     SpreadShadowMaskOutwards();
   } else {
     SpreadShadowMaskInwards();
@@ -660,13 +852,6 @@ ULONG CLayerMaker::MakeShadowMask(CBrushShadowLayer *pbsl)
   // convert the shadow mask from byte-packed into bit-packed mask
   ConvertBytesToBits(lm_pubLayer, lm_pubLayer, lm_mmtLayer.mmt_slTotalSize);
   ShrinkMemory((void **)&lm_pubLayer, (lm_mmtLayer.mmt_slTotalSize+7)/8);
-  pbsl->bsl_pubLayer = lm_pubLayer;
-
-  // update statistics
-  _ctShadowLayers++;
-  _ctShadowClusters+=lm_mmtLayer.mmt_slTotalSize;
-
-  return ulLighted;
 }
 
 ULONG CLayerMaker::MakeOneShadowMaskMip(INDEX iMip)
@@ -815,6 +1000,7 @@ BOOL CLayerMaker::CreateLayers(CBrushPolygon &bpo, CWorld &woWorld, BOOL bDoDire
   lm_pwoWorld = &woWorld;
   lm_pbsmShadowMap = &bpo.bpo_smShadowMap;
   lm_pbpoPolygon = &bpo;
+  lm_ppmrPolygonMask = NULL;
 
   // for each layer that should be calculated, but isn't
   FORDELETELIST(CBrushShadowLayer, bsl_lnInShadowMap, lm_pbsmShadowMap->bsm_lhLayers, itbsl) {
@@ -838,6 +1024,12 @@ BOOL CLayerMaker::CreateLayers(CBrushPolygon &bpo, CWorld &woWorld, BOOL bDoDire
       CalculateData();
       // make bit-packed mask of where the polygon is in the shadow map
       MakePolygonMask();
+      // if there are bake threads, share the polygon mask with them
+      if( _ctBakeThreads>0) {
+        lm_ppmrPolygonMask = new CPolygonMaskRef;
+        lm_ppmrPolygonMask->pmr_pubMask = lm_pubPolygonMask;
+        lm_ppmrPolygonMask->pmr_ctRefs = 1;
+      }
       bInitialized = TRUE;
     }
 
@@ -861,8 +1053,12 @@ BOOL CLayerMaker::CreateLayers(CBrushPolygon &bpo, CWorld &woWorld, BOOL bDoDire
 
   // if was intialized
   if( bInitialized) {
-    // free bit-packed polygon mask
-    FreeMemory( lm_pubPolygonMask);
+    // free byte-packed polygon mask (when bake threads don't need it anymore)
+    if( lm_ppmrPolygonMask!=NULL) {
+      ReleasePolygonMask( lm_ppmrPolygonMask);
+    } else {
+      FreeMemory( lm_pubPolygonMask);
+    }
   }
 
   // if some new layers have been calculated
@@ -889,3 +1085,89 @@ void CBrushPolygon::MakeShadowMap(CWorld *pwoWorld, BOOL bDoDirectionalLights)
   }
   _pfWorldEditingProfile.StopTimer(CWorldEditingProfile::PTI_MAKESHADOWMAP);
 }
+
+
+// checksum of all shadow layers in a world (flags, rectangles and masks)
+static ULONG ShadowLayersChecksum(CWorld &wo)
+{
+  ULONG ulCRC;
+  CRC_Start(ulCRC);
+  // for each brush entity in the world
+  FOREACHINDYNAMICCONTAINER(wo.wo_cenEntities, CEntity, iten) {
+    if (iten->en_RenderType != CEntity::RT_BRUSH) {
+      continue;
+    }
+    // for each polygon in each sector of each mip in its brush
+    FOREACHINLIST(CBrushMip, bm_lnInBrush, iten->en_pbrBrush->br_lhBrushMips, itbm) {
+      FOREACHINDYNAMICARRAY(itbm->bm_abscSectors, CBrushSector, itbsc) {
+        FOREACHINSTATICARRAY(itbsc->bsc_abpoPolygons, CBrushPolygon, itbpo) {
+          // add each of its shadow layers
+          FOREACHINLIST(CBrushShadowLayer, bsl_lnInShadowMap, itbpo->bpo_smShadowMap.bsm_lhLayers, itbsl) {
+            CBrushShadowLayer &bsl = *itbsl;
+            CRC_AddLONG(ulCRC, bsl.bsl_ulFlags);
+            CRC_AddLONG(ulCRC, bsl.bsl_pixMinU);
+            CRC_AddLONG(ulCRC, bsl.bsl_pixMinV);
+            CRC_AddLONG(ulCRC, bsl.bsl_pixSizeU);
+            CRC_AddLONG(ulCRC, bsl.bsl_pixSizeV);
+            if (bsl.bsl_pubLayer==NULL) {
+              continue;
+            }
+            // bits after the last pixel are not defined, so leave them out
+            const SLONG slFullBytes = bsl.bsl_slSizeInPixels/8;
+            CRC_AddBlock(ulCRC, bsl.bsl_pubLayer, slFullBytes);
+            if (bsl.bsl_slSizeInPixels%8) {
+              const UBYTE ubMask = (1<<(bsl.bsl_slSizeInPixels%8))-1;
+              CRC_AddBYTE(ulCRC, bsl.bsl_pubLayer[slFullBytes]&ubMask);
+            }
+          }
+        }
+      }
+    }
+  }
+  CRC_Finish(ulCRC);
+  return ulCRC;
+}
+
+
+// recalculate all shadows of a world without and with bake threads and compare results
+static void ShadowBakeBenchmark(const CTFileName &fnmWorld)
+{
+  CWorld woWorld;
+  try {
+    woWorld.Load_t(fnmWorld);
+  } catch (char *strError) {
+    CPrintF(TRANS("Cannot load world '%s': %s\n"), (const char*)fnmWorld, strError);
+    return;
+  }
+
+  // remember user's setting, passes below override it (bake serially by default, so compare with 2 threads then)
+  const INDEX iBakeThreadsOld = shd_iBakeThreads;
+  const INDEX iBakeThreads = (shd_iBakeThreads>0) ? Clamp( shd_iBakeThreads, 1L, (INDEX)MAX_BAKETHREADS) : 2;
+  FLOAT atmBake[2];
+  ULONG aulCRC[2];
+  for (INDEX iPass=0; iPass<2; iPass++) {
+    // first pass without bake threads, second with them
+    shd_iBakeThreads = (iPass==0) ? 0 : iBakeThreads;
+    woWorld.DiscardAllShadows();
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    woWorld.CalculateDirectionalShadows();
+    CTimerValue tvStop = _pTimer->GetHighPrecisionTimer();
+    atmBake[iPass] = (tvStop-tvStart).GetSeconds();
+    aulCRC[iPass] = ShadowLayersChecksum(woWorld);
+  }
+  shd_iBakeThreads = iBakeThreadsOld;
+
+  CPrintF(TRANS("Shadow bake of '%s':\n"), (const char*)fnmWorld);
+  CPrintF(TRANS("  serial:         %7.3fs (checksum 0x%08X)\n"), atmBake[0], aulCRC[0]);
+  CPrintF(TRANS("  %2d bake threads: %7.3fs (checksum 0x%08X)\n"), iBakeThreads, atmBake[1], aulCRC[1]);
+  CPrintF(TRANS("  speedup: %.2fx\n"), atmBake[0]/ClampDn(atmBake[1], 0.001f));
+  if (aulCRC[0]!=aulCRC[1]) {
+    CPrintF(TRANS("  WARNING: shadow layers differ!\n"));
+  }
+}
+
+void ShadowBakeBenchmarkCfunc(void *pArgs)
+{
+  CTString strWorld = *NEXTARGUMENT(CTString*);
+  ShadowBakeBenchmark(CTFileName(strWorld));
+}
@@ -15,6 +15,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "stdh.h"
 
+#include <emmintrin.h>
+
 #include <Engine/Brushes/Brush.h>
 #include <Engine/Brushes/BrushTransformed.h>
 #include <Engine/Light/LightSource.h>
@@ -26,6 +28,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Entities/Entity.h>
 #include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Math/Clipping.inl>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Timer.h>
 
 #include <Engine/Light/Shadows_internal.h>
 #include <Engine/World/WorldEditingProfile.h>
@@ -33,19 +38,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Templates/DynamicArray.cpp>
 
-// asm shortcuts
-#define O offset
-#define Q qword ptr
-#define D dword ptr
-#define W  word ptr
-#define B  byte ptr
-
-#define ASMOPT 1
-
-
 extern INDEX shd_bFineQuality;
 extern INDEX shd_iFiltering;
 extern INDEX shd_iDithering;
+extern INDEX shd_bUseSSE2;
+extern BOOL  sys_bCPUHasSSE2;
 
 extern const UBYTE *pubClipByte;
 extern UBYTE aubSqrt[  SQRTTABLESIZE];
@@ -98,16 +95,10 @@ public:
   void FindLayerMipmap( CBrushShadowLayer *pbsl, UBYTE *&pub, UBYTE &ubMask);
 
   // add one point layer to the shadow map
-  void AddAmbientPoint(void);
-  void AddAmbientMaskPoint( UBYTE *pubMask, UBYTE ubMask);
-  void AddDiffusionPoint(void);
-  void AddDiffusionMaskPoint( UBYTE *pubMask, UBYTE ubMask);
   BOOL PrepareOneLayerPoint( CBrushShadowLayer *pbsl, BOOL bNoMask);
   void AddOneLayerPoint( CBrushShadowLayer *pbsl, UBYTE *pub, UBYTE ubMask=0);
 
   // add one directional layer to the shadow map
-  void AddDirectional(void);
-  void AddMaskDirectional( UBYTE *pubMask, UBYTE ubMask);
   void AddOneLayerDirectional( CBrushShadowLayer *pbsl, UBYTE *pub, UBYTE ubMask=0);
 
   // add one gradient layer to the shadow map
@@ -254,443 +245,432 @@ static INDEX _iPixCt, _iRowCt;
 static SLONG _slModulo;
 static ULONG _ulLightFlags, _ulPolyFlags;
 static SLONG _slL2Row, _slDDL2oDU, _slDDL2oDV, _slDDL2oDUoDV, _slDL2oDURow, _slDL2oDV;
-static SLONG _slLightMax, _slHotSpot, _slLightStep;
+static SLONG _slLightMax, _slHotSpot, _slLightStep, _slMax1oL;
 static ULONG *_pulLayer;
+static ULONG _ulLightRGB;   // light color in R,G,B,A memory order
+static UBYTE *_pubMask;     // layer mask (NULL if not masked)
+static UBYTE _ubMask;       // mask bit of the first pixel
+static BOOL  _bDiffusion;   // set if point light uses diffusion
+// gradient colors (8:6) and their advancers, per color channel in R,G,B,A memory order
+static SWORD _aswGrStart[4], _aswGr0[4], _aswGr1[4], _aswGrDI[4], _aswGrDJ[4];
+static SLONG _fixGrRow, _fixGrDI, _fixGrDJ;
 
 
-// add one layer point light without diffusion and mask
-void CLayerMixer::AddAmbientPoint(void)
+// check which kernels should be used for mixing
+static BOOL UseSSE2(void)
 {
-  // prepare some local variables
-  __int64 mmDDL2oDU = _slDDL2oDU;
-  __int64 mmDDL2oDV = _slDDL2oDV;
-  ULONG ulLightRGB = ByteSwap(lm_colLight);
-  _slLightMax<<=7;
-  _slLightStep>>=1;
+  return shd_bUseSSE2 && sys_bCPUHasSSE2;
+}
 
-  __asm {
-    // prepare interpolants
-    movd    mm0,D [_slL2Row]
-    movd    mm1,D [_slDL2oDURow]
-    psllq   mm1,32
-    por     mm1,mm0         // MM1 = slDL2oDURow | slL2Row
-    movd    mm0,D [_slDL2oDV]
-    movd    mm2,D [_slDDL2oDUoDV]
-    psllq   mm2,32
-    por     mm2,mm0         // MM2 = slDDL2oDUoDV | slDL2oDV
-    // prepare color
-    pxor    mm0,mm0
-    movd    mm7,D [ulLightRGB]
-    punpcklbw mm7,mm0
-    psllw   mm7,1
-    // loop thru rows
-    mov     edi,D [_pulLayer]
-    mov     ebx,D [_iRowCt]
-rowLoop:
-    push    ebx
-    movd    ebx,mm1         // EBX = slL2Point
-    movq    mm3,mm1
-    psrlq   mm3,32          // MM3 = 0 | slDL2oDU
-    // loop thru pixels in current row
-    mov     ecx,D [_iPixCt]
-pixLoop:
-    // check if pixel need to be drawn
-    cmp     ebx,FTOX
-    jge     skipPixel
-    // calculate intensities and do actual drawing of shadow pixel ARGB
-    movd    mm4,ecx
-    mov     eax,ebx
-    sar     eax,SHIFTX
-    and     eax,(SQRTTABLESIZE-1)
-    movzx   eax,B aubSqrt[eax]
-    mov     ecx,D [_slLightMax]
-    cmp     eax,D [_slHotSpot]
-    jle     skipInterpolation
-    mov     ecx,255
-    sub     ecx,eax
-    imul    ecx,D [_slLightStep]
-skipInterpolation:
-    // calculate rgb pixel to add
-    movd    mm6,ecx    
-    punpcklwd mm6,mm6
-    punpckldq mm6,mm6
-    pmulhw  mm6,mm7
-    // add dynamic light pixel to underlying pixel
-    movd    mm5,D [edi]
-    punpcklbw mm5,mm0
-    paddw   mm5,mm6
-    packuswb mm5,mm0
-    movd    D [edi],mm5
-    movd    ecx,mm4
-skipPixel:
-    // advance to next pixel
-    add     edi,4
-    movd    eax,mm3
-    add     ebx,eax
-    paddd   mm3,Q [mmDDL2oDU]
-    dec     ecx
-    jnz     pixLoop
-    // advance to the next row
-    pop     ebx
-    add     edi,D [_slModulo]
-    paddd   mm1,mm2
-    paddd   mm2,Q [mmDDL2oDV]
-    dec     ebx
-    jnz     rowLoop
-    emms
+
+// light intensity of a point light at pixel with given squared distance (low word is used)
+static inline SLONG PointIntensity( SLONG slL2Point)
+{
+  const INDEX iL = (slL2Point>>SHIFTX)&(SQRTTABLESIZE-1);  // and is just for degenerate cases
+  if( _bDiffusion) {
+    const SLONG sl1oL = auw1oSqrt[iL];
+    return (sl1oL<_slMax1oL) ? (sl1oL-256)*_slLightStep : _slLightMax;
+  } else {
+    const SLONG slL = aubSqrt[iL];
+    return (slL>_slHotSpot) ? (255-slL)*_slLightStep : _slLightMax;
   }
 }
 
-// add one layer point light without diffusion and with mask
-void CLayerMixer::AddAmbientMaskPoint( UBYTE *pubMask, UBYTE ubMask)
+// add light of given intensity to one pixel
+static inline void AddPointLight( UBYTE *pub, SLONG slIntensity)
 {
+  const SLONG slI = (SWORD)slIntensity;
+  const UBYTE *pubLight = (const UBYTE*)&_ulLightRGB;
+  pub[0] = pubClipByte[ pub[0] + ((slI*(pubLight[0]<<1))>>16)];
+  pub[1] = pubClipByte[ pub[1] + ((slI*(pubLight[1]<<1))>>16)];
+  pub[2] = pubClipByte[ pub[2] + ((slI*(pubLight[2]<<1))>>16)];
+  pub[3] = pubClipByte[ pub[3] + ((slI*(pubLight[3]<<1))>>16)];
+}
 
-#if ASMOPT == 1
+// add constant color to one pixel
+static inline void AddColor( UBYTE *pub, ULONG ulColor)
+{
+  const UBYTE *pubColor = (const UBYTE*)&ulColor;
+  pub[0] = pubClipByte[ pub[0] + pubColor[0]];
+  pub[1] = pubClipByte[ pub[1] + pubColor[1]];
+  pub[2] = pubClipByte[ pub[2] + pubColor[2]];
+  pub[3] = pubClipByte[ pub[3] + pubColor[3]];
+}
 
-  // prepare some local variables
-  __int64 mmDDL2oDU = _slDDL2oDU;
-  __int64 mmDDL2oDV = _slDDL2oDV;
-  ULONG ulLightRGB = ByteSwap(lm_colLight);
-  _slLightMax<<=7;
-  _slLightStep>>=1;
+// add gradient color to one pixel
+static inline void AddGradient( UBYTE *pub, const SWORD *psw)
+{
+  pub[0] = pubClipByte[ pub[0] + (psw[0]>>6)];
+  pub[1] = pubClipByte[ pub[1] + (psw[1]>>6)];
+  pub[2] = pubClipByte[ pub[2] + (psw[2]>>6)];
+  pub[3] = pubClipByte[ pub[3] + (psw[3]>>6)];
+}
 
-  __asm {
-    // prepare interpolants
-    movd    mm0,D [_slL2Row]
-    movd    mm1,D [_slDL2oDURow]
-    psllq   mm1,32
-    por     mm1,mm0         // MM1 = slDL2oDURow | slL2Row
-    movd    mm0,D [_slDL2oDV]
-    movd    mm2,D [_slDDL2oDUoDV]
-    psllq   mm2,32
-    por     mm2,mm0         // MM2 = slDDL2oDUoDV | slDL2oDV
-    // prepare color
-    pxor    mm0,mm0         // MM0 = 0 | 0 (for unpacking purposes)
-    movd    mm7,D [ulLightRGB]
-    punpcklbw mm7,mm0
-    psllw   mm7,1
-    // loop thru rows
-    mov     esi,D [pubMask]
-    mov     edi,D [_pulLayer]
-    movzx   edx,B [ubMask]
-    mov     ebx,D [_iRowCt]
-rowLoop:
-    push    ebx
-    movd    ebx,mm1         // EBX = slL2Point
-    movq    mm3,mm1
-    psrlq   mm3,32          // MM3 = 0 | slDL2oDU
-    // loop thru pixels in current row
-    mov     ecx,D [_iPixCt]
-pixLoop:
-    // check if pixel need to be drawn; i.e. draw if( [esi] & ubMask && (slL2Point<FTOX))
-    cmp     ebx,FTOX
-    jge     skipPixel
-    test    dl,B [esi]
-    je      skipPixel
-    // calculate intensities and do actual drawing of shadow pixel ARGB
-    movd    mm4,ecx
-    mov     eax,ebx
-    sar     eax,SHIFTX
-    and     eax,(SQRTTABLESIZE-1)
-    movzx   eax,B aubSqrt[eax]
-    mov     ecx,D [_slLightMax]
-    cmp     eax,D [_slHotSpot]
-    jle     skipInterpolation
-    mov     ecx,255
-    sub     ecx,eax
-    imul    ecx,D [_slLightStep]
-skipInterpolation:
-    // mix underlaying pixels with the calculated one
-    movd    mm6,ecx 
-    punpcklwd mm6,mm6
-    punpckldq mm6,mm6
-    pmulhw  mm6,mm7
-    // add light pixel to underlying pixel
-    movd    mm5,D [edi]
-    punpcklbw mm5,mm0
-    paddw   mm5,mm6
-    packuswb mm5,mm0
-    movd    D [edi],mm5
-    movd    ecx,mm4
-skipPixel:
-    // advance to next pixel
-    add     edi,4
-    movd    eax,mm3
-    add     ebx,eax
-    paddd   mm3,Q [mmDDL2oDU]
-    rol     dl,1
-    adc     esi,0
-    dec     ecx
-    jnz     pixLoop
-    // advance to the next row
-    pop     ebx
-    add     edi,D [_slModulo]
-    paddd   mm1,mm2
-    paddd   mm2,Q [mmDDL2oDV]
-    dec     ebx
-    jnz     rowLoop
-    emms
+// check mask bit of the current pixel and advance to the next one
+static inline BOOL NextMaskBit( UBYTE *&pubMask, UBYTE &ubMask)
+{
+  const BOOL bSet = (*pubMask) & ubMask;
+  ubMask = (ubMask<<1) | (ubMask>>7);
+  if( ubMask==1) pubMask++;
+  return bSet;
+}
+
+// advance gradient color to the next pixel or row
+static inline void AdvanceGradient( SLONG &fixGr, SLONG fixDGr, SWORD *psw, const SWORD *pswAdv)
+{
+  fixGr += fixDGr;
+  // if out of gradient, clamp to the nearer end color
+  if( (ULONG)fixGr > 0x8000) {
+    const SWORD *pswEnd = (fixGr>0x8000) ? _aswGr1 : _aswGr0;
+    psw[0] = pswEnd[0];  psw[1] = pswEnd[1];  psw[2] = pswEnd[2];  psw[3] = pswEnd[3];
+  } else {
+    psw[0] += pswAdv[0]; psw[1] += pswAdv[1]; psw[2] += pswAdv[2]; psw[3] += pswAdv[3];
   }
+}
+
 
-#else
+// reference kernels, one pixel at a time
 
-  for( PIX pixV=0; pixV<_iRowCt; pixV++)
+// add one point light layer
+static void MixPoint_C(void)
+{
+  ULONG *pul = _pulLayer;
+  UBYTE *pubMask = _pubMask;
+  UBYTE  ubMask  = _ubMask;
+  SLONG slL2Row = _slL2Row;
+  SLONG slDL2oDURow = _slDL2oDURow;
+  SLONG slDL2oDV = _slDL2oDV;
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++)
   {
-    SLONG slL2Point = _slL2Row;
-    SLONG slDL2oDU  = _slDL2oDURow;
-    for( PIX pixU=0; pixU<_iPixCt; pixU++)
+    SLONG slL2Point = slL2Row;
+    SLONG slDL2oDU  = slDL2oDURow;
+    for( INDEX iPix=0; iPix<_iPixCt; iPix++)
     {
-      // if the point is not masked
-      if( *pubPoint&ubMask && (slL2Point<FTOX)) {
-        SLONG slL = (slL2Point>>SHIFTX)&(SQRTTABLESIZE-1);  // and is just for degenerate cases
-        SLONG slIntensity = _slLightMax;
-        slL = aubSqrt[slL];
-        if( slL>_slHotSpot) slIntensity = ((255-slL)*_slLightStep)>>8;
-        // add the intensity to the pixel
-        AddToCluster( (UBYTE*)_pulLayer, slIntensity/255.0f);
-      } 
+      // draw if the point is not masked and light reaches it
+      const BOOL bLit = (pubMask==NULL) || NextMaskBit( pubMask, ubMask);
+      if( bLit && slL2Point<FTOX) AddPointLight( (UBYTE*)pul, PointIntensity(slL2Point));
       // go to the next pixel
-      _pulLayer++;
-      slL2Point += _slDL2oDU;
+      pul++;
+      slL2Point += slDL2oDU;
       slDL2oDU  += _slDDL2oDU;
-      ubMask<<=1;
-      if( ubMask==0) {
-        pubPoint++;
-        ubMask = 1;
-      }
     }
     // go to the next row
-    _pulLayer    += _slModulo/BYTES_PER_TEXEL;
-    _slL2Row     += _slDL2oDV;
-    _slDL2oDV    += _slDDL2oDV;
-    _slDL2oDURow += _slDDL2oDUoDV;
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
+    slL2Row     += slDL2oDV;
+    slDL2oDV    += _slDDL2oDV;
+    slDL2oDURow += _slDDL2oDUoDV;
   }
+}
 
-#endif
+// add one directional light layer
+static void MixDirectional_C(void)
+{
+  ULONG *pul = _pulLayer;
+  UBYTE *pubMask = _pubMask;
+  UBYTE  ubMask  = _ubMask;
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++) {
+    for( INDEX iPix=0; iPix<_iPixCt; iPix++) {
+      const BOOL bLit = (pubMask==NULL) || NextMaskBit( pubMask, ubMask);
+      if( bLit) AddColor( (UBYTE*)pul, _ulLightRGB);
+      pul++;
+    }
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
+  }
+}
 
+// add one gradient layer
+static void MixGradient_C(void)
+{
+  ULONG *pul = _pulLayer;
+  SLONG fixGrRow = _fixGrRow;
+  SWORD aswRow[4] = { _aswGrStart[0], _aswGrStart[1], _aswGrStart[2], _aswGrStart[3] };
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++)
+  {
+    SLONG fixGrCol = fixGrRow;
+    SWORD aswCol[4] = { aswRow[0], aswRow[1], aswRow[2], aswRow[3] };
+    for( INDEX iPix=0; iPix<_iPixCt; iPix++) {
+      AddGradient( (UBYTE*)pul, aswCol);
+      AdvanceGradient( fixGrCol, _fixGrDI, aswCol, _aswGrDI);
+      pul++;
+    }
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
+    AdvanceGradient( fixGrRow, _fixGrDJ, aswRow, _aswGrDJ);
+  }
 }
 
-// add one layer point light with diffusion and without mask
-void CLayerMixer::AddDiffusionPoint(void)
+
+// SSE2 kernels, four pixels at a time where possible (must give same results as reference ones)
+
+// add one point light layer
+static void MixPoint_SSE2(void)
 {
-  // adjust params for diffusion lighting
-  SLONG slMax1oL = MAX_SLONG;
-  _slLightStep = FloatToInt(_slLightStep * _fMinLightDistance * _f1oFallOff);
-  if( _slLightStep!=0) slMax1oL = (256<<8) / _slLightStep +256;
-
-  // prepare some local variables
-  __int64 mmDDL2oDU = _slDDL2oDU;
-  __int64 mmDDL2oDV = _slDDL2oDV;
-  ULONG ulLightRGB = ByteSwap(lm_colLight);
-  _slLightMax<<=7;
-  _slLightStep>>=1;
+  const __m128i mZero  = _mm_setzero_si128();
+  const __m128i mLight = _mm_slli_epi16( _mm_unpacklo_epi8( _mm_set1_epi32(_ulLightRGB), mZero), 1);
+  const __m128i mFTOX  = _mm_set1_epi32( FTOX);
+  const __m128i mIndex = _mm_set1_epi32( SQRTTABLESIZE-1);
+  const __m128i mMax   = _mm_set1_epi32( _slLightMax);
+  const __m128i mStep  = _mm_set1_epi32( _slLightStep);
+  const __m128i mLimit = _mm_set1_epi32( _bDiffusion ? _slMax1oL : _slHotSpot);
+  const __m128i mBase  = _mm_set1_epi32( _bDiffusion ? 256 : 255);
+  const __m128i mDD    = _mm_set1_epi32( _slDDL2oDU);
+  const __m128i mDD4   = _mm_slli_epi32( mDD, 2);
+  const __m128i mDD6   = _mm_set1_epi32( _slDDL2oDU*6);
+  // second order part of point interpolants for lanes 0..3 pixels ahead
+  const __m128i mLaneDD = _mm_set_epi32( _slDDL2oDU*3, _slDDL2oDU, 0, 0);
+
+  ULONG *pul = _pulLayer;
+  UBYTE *pubMask = _pubMask;
+  UBYTE  ubMask  = _ubMask;
+  SLONG slL2Row = _slL2Row;
+  SLONG slDL2oDURow = _slDL2oDURow;
+  SLONG slDL2oDV = _slDL2oDV;
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++)
+  {
+    SLONG slL2Point = slL2Row;
+    SLONG slDL2oDU  = slDL2oDURow;
+    INDEX ctPix = _iPixCt;
+    if( ctPix>=4) {
+      // squared distances and their steps for four consecutive pixels
+      const __m128i mD = _mm_set1_epi32( slDL2oDU);
+      __m128i mL2 = _mm_add_epi32( _mm_set1_epi32( slL2Point), mLaneDD);
+      mL2 = _mm_add_epi32( mL2, _mm_set_epi32( slDL2oDU*3, slDL2oDU*2, slDL2oDU, 0));
+      __m128i mDL2 = _mm_add_epi32( mD, _mm_set_epi32( _slDDL2oDU*3, _slDDL2oDU*2, _slDDL2oDU, 0));
+      for( ; ctPix>=4; ctPix-=4)
+      {
+        // find pixels that light reaches
+        __m128i mLit = _mm_cmplt_epi32( mL2, mFTOX);
+        if( pubMask!=NULL) {
+          const SLONG sl0 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+          const SLONG sl1 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+          const SLONG sl2 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+          const SLONG sl3 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+          mLit = _mm_and_si128( mLit, _mm_set_epi32( sl3, sl2, sl1, sl0));
+        }
+        if( _mm_movemask_epi8(mLit)!=0)
+        {
+          // fetch distances from table
+          SLONG aslIndex[4];
+          _mm_storeu_si128( (__m128i*)aslIndex, _mm_and_si128( _mm_srai_epi32( mL2, SHIFTX), mIndex));
+          __m128i mL;
+          if( _bDiffusion) {
+            mL = _mm_set_epi32( auw1oSqrt[aslIndex[3]], auw1oSqrt[aslIndex[2]], auw1oSqrt[aslIndex[1]], auw1oSqrt[aslIndex[0]]);
+          } else {
+            mL = _mm_set_epi32( aubSqrt[aslIndex[3]], aubSqrt[aslIndex[2]], aubSqrt[aslIndex[1]], aubSqrt[aslIndex[0]]);
+          }
+          // interpolate intensity outside of hotspot (only low words of results are used)
+          __m128i mInterpolate, mI;
+          if( _bDiffusion) {
+            mInterpolate = _mm_cmplt_epi32( mL, mLimit);
+            mI = _mm_mullo_epi16( _mm_sub_epi32( mL, mBase), mStep);
+          } else {
+            mInterpolate = _mm_cmpgt_epi32( mL, mLimit);
+            mI = _mm_mullo_epi16( _mm_sub_epi32( mBase, mL), mStep);
+          }
+          mI = _mm_or_si128( _mm_and_si128( mInterpolate, mI), _mm_andnot_si128( mInterpolate, mMax));
+          mI = _mm_and_si128( mI, mLit);
+          // spread intensity of each pixel over its color channels
+          __m128i mI01 = _mm_unpacklo_epi32( mI, mI);
+          __m128i mI23 = _mm_unpackhi_epi32( mI, mI);
+          mI01 = _mm_shufflehi_epi16( _mm_shufflelo_epi16( mI01, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,2,0,0));
+          mI23 = _mm_shufflehi_epi16( _mm_shufflelo_epi16( mI23, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,2,0,0));
+          // add light to underlying pixels
+          const __m128i mPix = _mm_loadu_si128( (__m128i*)pul);
+          const __m128i mPix01 = _mm_add_epi16( _mm_unpacklo_epi8( mPix, mZero), _mm_mulhi_epi16( mI01, mLight));
+          const __m128i mPix23 = _mm_add_epi16( _mm_unpackhi_epi8( mPix, mZero), _mm_mulhi_epi16( mI23, mLight));
+          _mm_storeu_si128( (__m128i*)pul, _mm_packus_epi16( mPix01, mPix23));
+        }
+        // advance four pixels
+        pul += 4;
+        mL2  = _mm_add_epi32( mL2, _mm_add_epi32( _mm_slli_epi32( mDL2, 2), mDD6));
+        mDL2 = _mm_add_epi32( mDL2, mDD4);
+      }
+      // continue from the first lane
+      slL2Point = _mm_cvtsi128_si32( mL2);
+      slDL2oDU  = _mm_cvtsi128_si32( mDL2);
+    }
+    // do the rest of the row one pixel at a time
+    for( ; ctPix>0; ctPix--) {
+      const BOOL bLit = (pubMask==NULL) || NextMaskBit( pubMask, ubMask);
+      if( bLit && slL2Point<FTOX) AddPointLight( (UBYTE*)pul, PointIntensity(slL2Point));
+      pul++;
+      slL2Point += slDL2oDU;
+      slDL2oDU  += _slDDL2oDU;
+    }
+    // go to the next row
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
+    slL2Row     += slDL2oDV;
+    slDL2oDV    += _slDDL2oDV;
+    slDL2oDURow += _slDDL2oDUoDV;
+  }
+}
 
-  __asm {
-    // prepare interpolants
-    movd    mm0,D [_slL2Row]
-    movd    mm1,D [_slDL2oDURow]
-    psllq   mm1,32
-    por     mm1,mm0         // MM1 = slDL2oDURow | slL2Row
-    movd    mm0,D [_slDL2oDV]
-    movd    mm2,D [_slDDL2oDUoDV]
-    psllq   mm2,32
-    por     mm2,mm0         // MM2 = slDDL2oDUoDV | slDL2oDV
-    // prepare color
-    pxor    mm0,mm0
-    movd    mm7,D [ulLightRGB]
-    punpcklbw mm7,mm0
-    psllw   mm7,1
-    // loop thru rows
-    mov     edi,D [_pulLayer]
-    mov     ebx,D [_iRowCt]
-rowLoop:
-    push    ebx
-    movd    ebx,mm1         // EBX = slL2Point
-    movq    mm3,mm1
-    psrlq   mm3,32          // MM3 = 0 | slDL2oDU
-    // loop thru pixels in current row
-    mov     ecx,D [_iPixCt]
-pixLoop:
-    // check if pixel need to be drawn
-    cmp     ebx,FTOX
-    jge     skipPixel
-    // calculate intensities and do actual drawing of shadow pixel ARGB
-    movd    mm4,ecx
-    mov     eax,ebx
-    sar     eax,SHIFTX
-    and     eax,(SQRTTABLESIZE-1)
-    movzx   eax,W auw1oSqrt[eax*2]
-    mov     ecx,D [_slLightMax]
-    cmp     eax,D [slMax1oL]
-    jge     skipInterpolation
-    lea     ecx,[eax-256]
-    imul    ecx,D [_slLightStep]
-skipInterpolation:
-    // calculate rgb pixel to add
-    movd    mm6,ecx    
-    punpcklwd mm6,mm6
-    punpckldq mm6,mm6
-    pmulhw  mm6,mm7
-    // add dynamic light pixel to underlying pixel
-    movd    mm5,D [edi]
-    punpcklbw mm5,mm0
-    paddw   mm5,mm6
-    packuswb mm5,mm0
-    movd    D [edi],mm5
-    movd    ecx,mm4
-skipPixel:
-    // advance to next pixel
-    add     edi,4
-    movd    eax,mm3
-    add     ebx,eax
-    paddd   mm3,Q [mmDDL2oDU]
-    dec     ecx
-    jnz     pixLoop
-    // advance to the next row
-    pop     ebx
-    add     edi,D [_slModulo]
-    paddd   mm1,mm2
-    paddd   mm2,Q [mmDDL2oDV]
-    dec     ebx
-    jnz     rowLoop
-    emms
+// add one directional light layer
+static void MixDirectional_SSE2(void)
+{
+  const __m128i mLight = _mm_set1_epi32( _ulLightRGB);
+  ULONG *pul = _pulLayer;
+  UBYTE *pubMask = _pubMask;
+  UBYTE  ubMask  = _ubMask;
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++)
+  {
+    INDEX ctPix = _iPixCt;
+    for( ; ctPix>=4; ctPix-=4) {
+      __m128i mAdd = mLight;
+      if( pubMask!=NULL) {
+        const SLONG sl0 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+        const SLONG sl1 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+        const SLONG sl2 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+        const SLONG sl3 = NextMaskBit( pubMask, ubMask) ? -1 : 0;
+        mAdd = _mm_and_si128( mAdd, _mm_set_epi32( sl3, sl2, sl1, sl0));
+      }
+      _mm_storeu_si128( (__m128i*)pul, _mm_adds_epu8( _mm_loadu_si128( (__m128i*)pul), mAdd));
+      pul += 4;
+    }
+    for( ; ctPix>0; ctPix--) {
+      const BOOL bLit = (pubMask==NULL) || NextMaskBit( pubMask, ubMask);
+      if( bLit) AddColor( (UBYTE*)pul, _ulLightRGB);
+      pul++;
+    }
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
   }
 }
 
-// add one layer point light with diffusion and mask
-void CLayerMixer::AddDiffusionMaskPoint( UBYTE *pubMask, UBYTE ubMask)
+// add one gradient layer (gradient must be clamped per pixel, so only one pixel at a time)
+static void MixGradient_SSE2(void)
 {
-  // adjust params for diffusion lighting
-  SLONG slMax1oL = MAX_SLONG;
-  _slLightStep = FloatToInt(_slLightStep * _fMinLightDistance * _f1oFallOff);
-  if( _slLightStep!=0) slMax1oL = (256<<8) / _slLightStep +256;
+  const __m128i mZero = _mm_setzero_si128();
+  const __m128i mGr0  = _mm_loadl_epi64( (__m128i*)_aswGr0);
+  const __m128i mGr1  = _mm_loadl_epi64( (__m128i*)_aswGr1);
+  const __m128i mDI   = _mm_loadl_epi64( (__m128i*)_aswGrDI);
+  const __m128i mDJ   = _mm_loadl_epi64( (__m128i*)_aswGrDJ);
+  __m128i mRow = _mm_loadl_epi64( (__m128i*)_aswGrStart);
+  ULONG *pul = _pulLayer;
+  SLONG fixGrRow = _fixGrRow;
+  for( INDEX iRow=0; iRow<_iRowCt; iRow++)
+  {
+    SLONG fixGrCol = fixGrRow;
+    __m128i mCol = mRow;
+    for( INDEX iPix=0; iPix<_iPixCt; iPix++) {
+      // add or substract light pixel to underlying pixel
+      __m128i mPix = _mm_unpacklo_epi8( _mm_cvtsi32_si128(*pul), mZero);
+      mPix = _mm_add_epi16( mPix, _mm_srai_epi16( mCol, 6));
+      *pul = _mm_cvtsi128_si32( _mm_packus_epi16( mPix, mZero));
+      // advance to next pixel
+      fixGrCol += _fixGrDI;
+      if( (ULONG)fixGrCol > 0x8000) mCol = (fixGrCol>0x8000) ? mGr1 : mGr0;
+      else mCol = _mm_add_epi16( mCol, mDI);
+      pul++;
+    }
+    // advance to next row
+    pul = (ULONG*)((UBYTE*)pul + _slModulo);
+    fixGrRow += _fixGrDJ;
+    if( (ULONG)fixGrRow > 0x8000) mRow = (fixGrRow>0x8000) ? mGr1 : mGr0;
+    else mRow = _mm_add_epi16( mRow, mDJ);
+  }
+}
 
-#if ASMOPT == 1
 
-  // prepare some local variables
-  __int64 mmDDL2oDU = _slDDL2oDU;
-  __int64 mmDDL2oDV = _slDDL2oDV;
-  ULONG ulLightRGB = ByteSwap(lm_colLight);
+// prepare kernel variables for point light layer
+static void PreparePointKernel( ULONG ulLightRGB, UBYTE *pubMask, UBYTE ubMask, BOOL bDiffusion)
+{
+  _ulLightRGB = ulLightRGB;
+  _pubMask = pubMask;
+  _ubMask  = ubMask;
+  _bDiffusion = bDiffusion;
+  // adjust params for diffusion lighting
+  _slMax1oL = MAX_SLONG;
+  if( bDiffusion) {
+    _slLightStep = FloatToInt(_slLightStep * _fMinLightDistance * _f1oFallOff);
+    if( _slLightStep!=0) _slMax1oL = (256<<8) / _slLightStep +256;
+  }
+  // scale for multiplying with doubled light color
   _slLightMax<<=7;
   _slLightStep>>=1;
+}
 
-  __asm {
-    // prepare interpolants
-    movd    mm0,D [_slL2Row]
-    movd    mm1,D [_slDL2oDURow]
-    psllq   mm1,32
-    por     mm1,mm0         // MM1 = slDL2oDURow | slL2Row
-    movd    mm0,D [_slDL2oDV]
-    movd    mm2,D [_slDDL2oDUoDV]
-    psllq   mm2,32
-    por     mm2,mm0         // MM2 = slDDL2oDUoDV | slDL2oDV
-    // prepare color
-    pxor    mm0,mm0         // MM0 = 0 | 0 (for unpacking purposes)
-    movd    mm7,D [ulLightRGB]
-    punpcklbw mm7,mm0
-    psllw   mm7,1
-    // loop thru rows
-    mov     esi,D [pubMask]
-    mov     edi,D [_pulLayer]
-    movzx   edx,B [ubMask]
-    mov     ebx,D [_iRowCt]
-rowLoop:
-    push    ebx
-    movd    ebx,mm1         // EBX = slL2Point
-    movq    mm3,mm1
-    psrlq   mm3,32          // MM3 = 0 | slDL2oDU
-    // loop thru pixels in current row
-    mov     ecx,D [_iPixCt]
-pixLoop:
-    // check if pixel need to be drawn; i.e. draw if( [esi] & ubMask && (slL2Point<FTOX))
-    cmp     ebx,FTOX
-    jge     skipPixel
-    test    dl,B [esi]
-    je      skipPixel
-    // calculate intensities and do actual drawing of shadow pixel ARGB
-    movd    mm4,ecx
-    mov     eax,ebx
-    sar     eax,SHIFTX
-    and     eax,(SQRTTABLESIZE-1)
-    movzx   eax,W auw1oSqrt[eax*2]
-    mov     ecx,D [_slLightMax]
-    cmp     eax,D [slMax1oL]
-    jge     skipInterpolation
-    lea     ecx,[eax-256]
-    imul    ecx,D [_slLightStep]
-skipInterpolation:
-    // mix underlaying pixels with the calculated one
-    movd    mm6,ecx 
-    punpcklwd mm6,mm6
-    punpckldq mm6,mm6
-    pmulhw  mm6,mm7
-    // add light pixel to underlying pixel
-    movd    mm5,D [edi]
-    punpcklbw mm5,mm0
-    paddw   mm5,mm6
-    packuswb mm5,mm0
-    movd    D [edi],mm5
-    movd    ecx,mm4
-skipPixel:
-    // advance to next pixel
-    add     edi,4
-    movd    eax,mm3
-    add     ebx,eax
-    paddd   mm3,Q [mmDDL2oDU]
-    rol     dl,1
-    adc     esi,0
-    dec     ecx
-    jnz     pixLoop
-    // advance to the next row
-    pop     ebx
-    add     edi,D [_slModulo]
-    paddd   mm1,mm2
-    paddd   mm2,Q [mmDDL2oDV]
-    dec     ebx
-    jnz     rowLoop
-    emms
+// prepare kernel variables for gradient layer
+static void PrepareGradientKernel( COLOR colStart, COLOR col0, COLOR col1, BOOL bDark,
+                                   SLONG fixGrRow, SLONG fixDGroDI, SLONG fixDGroDJ)
+{
+  const ULONG ulStart = ByteSwap(colStart);
+  const ULONG ul0 = ByteSwap(col0);
+  const ULONG ul1 = ByteSwap(col1);
+  for( INDEX i=0; i<4; i++) {
+    // expand color bytes to 8:6 (start) and 8:7 (ends)
+    SWORD swStart = (SWORD)((((const UBYTE*)&ulStart)[i]*257)>>2);
+    SWORD sw0 = (SWORD)((((const UBYTE*)&ul0)[i]*257)>>1);
+    SWORD sw1 = (SWORD)((((const UBYTE*)&ul1)[i]*257)>>1);
+    // eventually adjust for dark light
+    if( bDark) {
+      swStart = -swStart;
+      sw0 = -sw0;
+      sw1 = -sw1;
+    }
+    // find column and row color advancers (8:6)
+    const SWORD swDelta = (SWORD)(sw1-sw0);
+    _aswGrDI[i] = (SWORD)((swDelta*(SLONG)(SWORD)fixDGroDI)>>16);
+    _aswGrDJ[i] = (SWORD)((swDelta*(SLONG)(SWORD)fixDGroDJ)>>16);
+    _aswGrStart[i] = swStart;
+    _aswGr0[i] = sw0>>1;
+    _aswGr1[i] = sw1>>1;
   }
+  _fixGrRow = fixGrRow;
+  _fixGrDI  = fixDGroDI;
+  _fixGrDJ  = fixDGroDJ;
+}
 
-#else
-
+// prepare light interpolants for point light layer
+static void PreparePointInterpolants( const FLOAT3D &v00, const FLOAT3D &vStepU, const FLOAT3D &vStepV,
+                                      FLOAT fHotSpot, BOOL bDarkLight)
+{
+  FLOAT fFactor = FTOX * _f1oFallOff*_f1oFallOff;
+  FLOAT fL2Row  = v00%v00;
+  FLOAT fDDL2oDU    = vStepU%vStepU;
+  FLOAT fDDL2oDV    = vStepV%vStepV;
+  FLOAT fDDL2oDUoDV = vStepU%vStepV;
+  FLOAT fDL2oDURow  = fDDL2oDU + 2*(vStepU%v00);
+  FLOAT fDL2oDV     = fDDL2oDV + 2*(vStepV%v00);
+  fDDL2oDU     *= 2;
+  fDDL2oDV     *= 2;
+  fDDL2oDUoDV  *= 2;
+  _slL2Row      = FloatToInt( fL2Row      * fFactor);
+  _slDDL2oDU    = FloatToInt( fDDL2oDU    * fFactor);
+  _slDDL2oDV    = FloatToInt( fDDL2oDV    * fFactor);
+  _slDDL2oDUoDV = FloatToInt( fDDL2oDUoDV * fFactor);
+  _slDL2oDURow  = FloatToInt( fDL2oDURow  * fFactor);
+  _slDL2oDV     = FloatToInt( fDL2oDV     * fFactor);
 
-  // for each pixel in the shadow map
-  for( PIX pixV=0; pixV<_iRowCt; pixV++)
-  {
-    SLONG slL2Point = _slL2Row;
-    SLONG slDL2oDU  = _slDL2oDURow;
-    for( PIX pixU=0; pixU<_iPixCt; pixU++)
-    {
-      // if the point is not masked
-      if( *pubMask&ubMask && (slL2Point<FTOX)) {
-        SLONG sl1oL = (slL2Point>>SHIFTX)&(SQRTTABLESIZE-1);  // and is just for degenerate cases
-        sl1oL = auw1oSqrt[sl1oL];
-        SLONG slIntensity = _slLightMax;
-        if( sl1oL<slMax1oL) slIntensity = ((sl1oL-256)*_slLightStep)>>16;
-        // add the intensity to the pixel
-        AddToCluster( (UBYTE*)_pulLayer, slIntensity/255.0f);
-      } 
-      // advance to next pixel
-      _pulLayer++;
-      slL2Point +=  slDL2oDU;
-      slDL2oDU  += _slDDL2oDU;
-      ubMask<<=1;
-      if( ubMask==0) {
-        pubMask++;
-        ubMask = 1;
-      }
-    }
-    // advance to next row
-    _pulLayer    += _slModulo/BYTES_PER_TEXEL;
-    _slL2Row     += _slDL2oDV;
-    _slDL2oDV    += _slDDL2oDV;
-    _slDL2oDURow += _slDDL2oDUoDV;
+  // prepare final light interpolants
+  _slLightMax  = 255;
+  _slHotSpot   = FloatToInt( 255.0f * fHotSpot * _f1oFallOff);
+  _slLightStep = FloatToInt( 65535.0f / (255.0f - _slHotSpot));
+  // dark light inverts parameters
+  if( bDarkLight) {
+    _slLightMax  = -_slLightMax;
+    _slLightStep = -_slLightStep;
   }
+}
 
-#endif
 
+// add one point light layer to the shadow map (pubMask=NULL for no mask)
+static void MixPoint( ULONG ulLightRGB, UBYTE *pubMask, UBYTE ubMask, BOOL bDiffusion)
+{
+  PreparePointKernel( ulLightRGB, pubMask, ubMask, bDiffusion);
+  if( UseSSE2()) MixPoint_SSE2();
+  else MixPoint_C();
 }
 
+// add one directional light layer to the shadow map (pubMask=NULL for no mask)
+static void MixDirectional( ULONG ulLightRGB, UBYTE *pubMask, UBYTE ubMask)
+{
+  _ulLightRGB = ulLightRGB;
+  _pubMask = pubMask;
+  _ubMask  = ubMask;
+  if( UseSSE2()) MixDirectional_SSE2();
+  else MixDirectional_C();
+}
+
+
 // prepares point light that creates layer (returns TRUE if there is infulence)
 BOOL CLayerMixer::PrepareOneLayerPoint( CBrushShadowLayer *pbsl, BOOL bNoMask)
 {
@@ -744,66 +724,9 @@ BOOL CLayerMixer::PrepareOneLayerPoint( CBrushShadowLayer *pbsl, BOOL bNoMask)
     }
   }
 
-  // prepare intermediate light interpolants
+  // prepare light interpolants
   FLOAT3D v00 = (lm_vO+lm_vStepU*pixMinU + lm_vStepV*pixMinV) - *_vLight;
-  FLOAT fFactor = FTOX * _f1oFallOff*_f1oFallOff;
-  FLOAT fL2Row  = v00%v00;
-  FLOAT fDDL2oDU    = lm_vStepU%lm_vStepU;
-  FLOAT fDDL2oDV    = lm_vStepV%lm_vStepV;
-  FLOAT fDDL2oDUoDV = lm_vStepU%lm_vStepV;
-  FLOAT fDL2oDURow  = fDDL2oDU + 2*(lm_vStepU%v00);
-  FLOAT fDL2oDV     = fDDL2oDV + 2*(lm_vStepV%v00);
-  //_v00 = v00;
-
-#if ASMOPT == 1
-  __asm {
-    fld     D [fDDL2oDU]
-    fadd    D [fDDL2oDU]
-    fld     D [fDDL2oDV]
-    fadd    D [fDDL2oDV]
-    fld     D [fDDL2oDUoDV]
-    fadd    D [fDDL2oDUoDV]
-    // st0=2*fDDL2oDUoDV, st1=2*fDDL2oDV, st2=2*fDDL2oDU
-    fld     D [fL2Row]
-    fmul    D [fFactor]
-    fld     D [fDL2oDURow]
-    fmul    D [fFactor]
-    fld     D [fDL2oDV]
-    fmul    D [fFactor]
-    // st0=fDL2oDV*fFactor, st1=fDL2oDURow*fFactor, st2=fL2Row*fFactor,
-    // st3=2*fDDL2oDUoDV, st4=2*fDDL2oDV, st5=2*fDDL2oDU
-    fld     D [fFactor]
-    fmul    st(4),st(0)
-    fmul    st(5),st(0)
-    fmulp   st(6),st(0)
-    fistp   D [_slDL2oDV]
-    fistp   D [_slDL2oDURow]
-    fistp   D [_slL2Row]
-    fistp   D [_slDDL2oDUoDV]
-    fistp   D [_slDDL2oDV]
-    fistp   D [_slDDL2oDU]
-  }
-#else
-  fDDL2oDU     *= 2;
-  fDDL2oDV     *= 2;
-  fDDL2oDUoDV  *= 2;
-  _slL2Row      = FloatToInt( fL2Row      * fFactor);
-  _slDDL2oDU    = FloatToInt( fDDL2oDU    * fFactor);
-  _slDDL2oDV    = FloatToInt( fDDL2oDV    * fFactor);
-  _slDDL2oDUoDV = FloatToInt( fDDL2oDUoDV * fFactor);
-  _slDL2oDURow  = FloatToInt( fDL2oDURow  * fFactor);
-  _slDL2oDV     = FloatToInt( fDL2oDV     * fFactor);
-#endif
-
-  // prepare final light interpolants
-  _slLightMax  = 255;
-  _slHotSpot   = FloatToInt( 255.0f * lm_plsLight->ls_rHotSpot * _f1oFallOff);
-  _slLightStep = FloatToInt( 65535.0f / (255.0f - _slHotSpot));
-  // dark light inverts parameters
-  if( _ulLightFlags & LSF_DARKLIGHT) {
-    _slLightMax  = -_slLightMax;
-    _slLightStep = -_slLightStep;
-  }
+  PreparePointInterpolants( v00, lm_vStepU, lm_vStepV, lm_plsLight->ls_rHotSpot, _ulLightFlags&LSF_DARKLIGHT);
 
   // saturate light color
   lm_colLight = AdjustColor( lm_colLight, _slShdHueShift, _slShdSaturation);
@@ -824,25 +747,9 @@ void CLayerMixer::AddOneLayerPoint( CBrushShadowLayer *pbsl, UBYTE *pubMask, UBY
 
   // determine diffusion presence and corresponding routine
   BOOL bDiffusion = (_ulLightFlags&LSF_DIFFUSION) && !(_ulPolyFlags&BPOF_NOPLANEDIFFUSION);
-  // masked or non-masked?
-  if( pubMask==NULL) {
-    // non-masked
-    if( !lm_bDynamic && bDiffusion) {
-      // non-masked diffusion
-      AddDiffusionPoint();
-    } else {
-      // non-masked ambient
-      AddAmbientPoint();
-    }
-  } else {
-    // masked
-    if( bDiffusion) {
-      // masked diffusion
-      AddDiffusionMaskPoint( pubMask, ubMask);
-    } else {
-      AddAmbientMaskPoint( pubMask, ubMask);
-    }
-  }
+  // dynamic lights without mask are always mixed as ambient
+  if( pubMask==NULL && lm_bDynamic) bDiffusion = FALSE;
+  MixPoint( ByteSwap(lm_colLight), pubMask, ubMask, bDiffusion);
 
   // all done
   _pfWorldEditingProfile.StopTimer(CWorldEditingProfile::PTI_ADDONELAYERPOINT);
@@ -868,322 +775,15 @@ void CLayerMixer::AddOneLayerGradient( CGradientParameters &gp)
   _pulLayer  = lm_pulShadowMap;
   FLOAT fStart = Clamp( fGr00-(fDGroDJ+fDGroDI)*0.5f, 0.0f, 1.0f);
 
-#if ASMOPT == 1
-
-  __int64 mmRowAdv;
-  SLONG fixGRow  = (fGr00-(fDGroDJ+fDGroDI)*0.5f)*32767.0f; // 16:15
-  SLONG slModulo = (lm_pixCanvasSizeU-lm_pixPolygonSizeU) *BYTES_PER_TEXEL;
-  COLOR colStart = LerpColor( col0, col1, fStart);
-  INDEX ctCols = lm_pixPolygonSizeU;
-  INDEX ctRows = lm_pixPolygonSizeV;
-  BOOL  bDarkLight = gp.gp_bDark;
-  
-  __asm {
-    mov     eax,D [colStart]
-    mov     ebx,D [col0]
-    mov     edx,D [col1]
-    bswap   eax
-    bswap   ebx
-    bswap   edx
-    movd    mm1,eax
-    movd    mm2,ebx
-    movd    mm3,edx
-    punpcklbw mm1,mm1
-    punpcklbw mm2,mm2
-    punpcklbw mm3,mm3
-    psrlw   mm1,2
-    psrlw   mm2,1
-    psrlw   mm3,1
-    // eventually adjust for dark light
-    cmp     D [bDarkLight],0
-    je      skipDark
-    pcmpeqd mm0,mm0
-    pxor    mm1,mm0
-    pxor    mm2,mm0
-    pxor    mm3,mm0
-    psubw   mm1,mm0
-    psubw   mm2,mm0
-    psubw   mm3,mm0
-skipDark:
-    // keep colors
-    movq    mm0,mm2
-    movq    mm7,mm3
-    // find row and column advancers
-    psubw   mm3,mm2
-    movq    mm2,mm3
-    movd    mm5,D [fixDGroDI]
-    movd    mm6,D [fixDGroDJ]
-    punpcklwd mm5,mm5
-    punpcklwd mm6,mm6
-    punpckldq mm5,mm5
-    punpckldq mm6,mm6
-    pmulhw  mm2,mm5           // column color advancer (8:6)
-    pmulhw  mm3,mm6           // row color advancer    (8:6)
-    movq    Q [mmRowAdv],mm3 
-
-    // prepare starting variables
-    movq    mm5,mm0
-    movq    mm6,mm7
-    psraw   mm5,1   // starting color
-    psraw   mm6,1   // ending color
-    pxor    mm0,mm0
-    mov     esi,D [fixGRow]
-    mov     edi,D [_pulLayer]
-    mov     edx,D [ctRows]
-rowLoop:
-    mov     ebx,esi
-    movq    mm4,mm1
-    mov     ecx,D [ctCols]
-pixLoop:
-    // add or substract light pixel to underlying pixel
-    movq    mm7,mm4
-    psraw   mm7,6
-    movd    mm3,D [edi]
-    punpcklbw mm3,mm0
-    paddw   mm3,mm7
-    packuswb mm3,mm0
-    movd    D [edi],mm3
-
-    // advance to next pixel
-    add     ebx,D [fixDGroDI]
-    cmp     ebx,0x8000
-    ja      pixClamp
-    paddw   mm4,mm2
-    add     edi,4
-    dec     ecx
-    jnz     pixLoop
-    jmp     pixDone
-pixClamp:
-    movq    mm4,mm6
-    jg      pixNext
-    movq    mm4,mm5
-pixNext:
-    add     edi,4
-    dec     ecx
-    jnz     pixLoop
-pixDone:
-
-    // advance to next row
-    add     esi,D [fixDGroDJ]
-    cmp     esi,0x8000
-    ja      rowClamp
-    paddw   mm1,Q [mmRowAdv]
-    add     edi,D [slModulo]
-    dec     edx
-    jnz     rowLoop
-    jmp     rowDone
-rowClamp:
-    movq    mm1,mm6
-    jg      rowNext
-    movq    mm1,mm5
-rowNext:
-    add     edi,D [slModulo]
-    dec     edx
-    jnz     rowLoop
-rowDone:
-    emms
-  }
-
-#else
-
-  // well, make gradient ...
-  SLONG slR0=0,slG0=0,slB0=0;
-  SLONG slR1=0,slG1=0,slB1=0;
-  ColorToRGB( col0, (UBYTE&)slR0,(UBYTE&)slG0,(UBYTE&)slB0);
-  ColorToRGB( col1, (UBYTE&)slR1,(UBYTE&)slG1,(UBYTE&)slB1);
-  if( gp.gp_bDark) {
-    slR0 = -slR0;  slG0 = -slG0;  slB0 = -slB0;
-    slR1 = -slR1;  slG1 = -slG1;  slB1 = -slB1;
-  }
-  fixDGroDI >>= 1; // 16:14
-  fixDGroDJ >>= 1; // 16:14
-  SWORD fixRrow = Lerp( slR0,slR1,fStart) <<6; // 8:6
-  SWORD fixGrow = Lerp( slG0,slG1,fStart) <<6; // 8:6
-  SWORD fixBrow = Lerp( slB0,slB1,fStart) <<6; // 8:6
-  SWORD fixDRoDI = ((slR1-slR0)*fixDGroDI)>>8;
-  SWORD fixDGoDI = ((slG1-slG0)*fixDGroDI)>>8;
-  SWORD fixDBoDI = ((slB1-slB0)*fixDGroDI)>>8;
-  SWORD fixDRoDJ = ((slR1-slR0)*fixDGroDJ)>>8;
-  SWORD fixDGoDJ = ((slG1-slG0)*fixDGroDJ)>>8;
-  SWORD fixDBoDJ = ((slB1-slB0)*fixDGroDJ)>>8;
-
-  // loop it, baby
-  FLOAT fGrRow = fGr00 - (fDGroDJ+fDGroDI)*0.5f;
-  PIX   pixOffset = 0;
-  PIX   pixModulo = lm_pixCanvasSizeU-lm_pixPolygonSizeU;
-  for( INDEX j=0; j<lm_pixPolygonSizeV; j++)
-  { // prepare row
-    FLOAT fGrCol  = fGrRow;
-    SWORD fixRcol = fixRrow;
-    SWORD fixGcol = fixGrow;
-    SWORD fixBcol = fixBrow;
-    for( INDEX i=0; i<lm_pixPolygonSizeU; i++)
-    { // loop pixels
-      SLONG slR = Clamp( fixRcol>>6, -255, +255);
-      SLONG slG = Clamp( fixGcol>>6, -255, +255);
-      SLONG slB = Clamp( fixBcol>>6, -255, +255);
-      IncrementByteWithClip( ((UBYTE*)&_pulLayer[pixOffset])[0], slR);
-      IncrementByteWithClip( ((UBYTE*)&_pulLayer[pixOffset])[1], slG);
-      IncrementByteWithClip( ((UBYTE*)&_pulLayer[pixOffset])[2], slB);
-      // advance to next pixel
-      fGrCol += fDGroDI;
-      pixOffset++;
-      if( fGrCol<0) {
-        fixRcol = slR0<<6;
-        fixGcol = slG0<<6;
-        fixBcol = slB0<<6;
-      } else if( fGrCol>1) {
-        fixRcol = slR1<<6;
-        fixGcol = slG1<<6;
-        fixBcol = slB1<<6;
-      } else {
-        fixRcol += fixDRoDI;
-        fixGcol += fixDGoDI;
-        fixBcol += fixDBoDI;
-      }
-    }
-    // advance to next row
-    fGrRow += fDGroDJ;
-    pixOffset += pixModulo;
-    if( fGrRow<0) {
-      fixRrow = slR0<<6;
-      fixGrow = slG0<<6;
-      fixBrow = slB0<<6;
-    } else if( fGrRow>1) {
-      fixRrow = slR1<<6;
-      fixGrow = slG1<<6;
-      fixBrow = slB1<<6;
-    } else {
-      fixRrow += fixDRoDJ;
-      fixGrow += fixDGoDJ;
-      fixBrow += fixDBoDJ;
-    }
-  }
-
-#endif
-
-}
-
-
-
-// apply directional light or ambient to layer
-void CLayerMixer::AddDirectional(void)
-{
-
-#if ASMOPT == 1
-
-  ULONG ulLight = ByteSwap( lm_colLight);
-  __asm {
-    // prepare pointers and variables
-    mov     edi,D [_pulLayer]
-    mov     ebx,D [_iRowCt]
-    movd    mm6,D [ulLight]
-    punpckldq mm6,mm6
-rowLoop: 
-    mov     ecx,D [_iPixCt]
-    shr     ecx,1
-    jz      pixRest
-pixLoop:
-    // mix underlaying pixels with the constant color pixel
-    movq    mm5,Q [edi]
-    paddusb mm5,mm6
-    movq    Q [edi],mm5
-    // advance to next pixel
-    add     edi,8
-    dec     ecx
-    jnz     pixLoop
-pixRest:
-    test    D [_iPixCt],1
-    jz      rowNext
-    movd    mm5,D [edi]
-    paddusb mm5,mm6
-    movd    D [edi],mm5
-    add     edi,4
-rowNext:
-    // advance to the next row
-    add     edi,D [_slModulo]
-    dec     ebx
-    jnz     rowLoop
-    emms
-  }
-
-#else
-
-  // for each pixel in the shadow map
-  for( PIX pixV=0; pixV<_iRowCt; pixV++) {
-    for( PIX pixU=0; pixU<_iPixCt; pixU++) {
-      // add the intensity to the pixel
-      AddToCluster( (UBYTE*)_pulLayer);
-      _pulLayer++; // go to the next pixel
-    } // go to the next row
-    _pulLayer += slModulo;
-  }
-
-#endif
-
+  _iPixCt = lm_pixPolygonSizeU;
+  _iRowCt = lm_pixPolygonSizeV;
+  _slModulo = (lm_pixCanvasSizeU-lm_pixPolygonSizeU) *BYTES_PER_TEXEL;
+  SLONG fixGRow = (fGr00-(fDGroDJ+fDGroDI)*0.5f)*32767.0f; // 16:15
+  PrepareGradientKernel( LerpColor( col0, col1, fStart), col0, col1, gp.gp_bDark, fixGRow, fixDGroDI, fixDGroDJ);
+  if( UseSSE2()) MixGradient_SSE2();
+  else MixGradient_C();
 }
 
-// apply directional light thru mask to layer
-void CLayerMixer::AddMaskDirectional( UBYTE *pubMask, UBYTE ubMask)
-{
-
-#if ASMOPT == 1
-
-  // prepare some local variables
-  ULONG ulLight = ByteSwap( lm_colLight);
-  __asm {
-    // prepare pointers and variables
-    movzx   edx,B [ubMask]
-    mov     esi,D [pubMask]
-    mov     edi,D [_pulLayer]
-    mov     ebx,D [_iRowCt]
-    movd    mm6,D [ulLight]
-rowLoop:
-    mov     ecx,D [_iPixCt]
-pixLoop:
-    // mix underlaying pixels with the constant light color if not shaded
-    test    dl,B [esi]
-    jz      skipLight
-    movd    mm5,D [edi]
-    paddusb mm5,mm6
-    movd    D [edi],mm5
-skipLight:
-    // advance to next pixel
-    add     edi,4
-    rol     dl,1
-    adc     esi,0
-    dec     ecx
-    jnz     pixLoop
-    // advance to the next row
-    add     edi,D [_slModulo]
-    dec     ebx
-    jnz     rowLoop
-    emms
-  }
-
-#else
-
-  // for each pixel in the shadow map
-  for( PIX pixV=0; pixV<_iRowCt; pixV++) {
-    for( PIX pixU=0; pixU<_iPixCt; pixU++) {
-      // if the point is not masked
-      if( *pubMask&ubMask) {
-        // add the intensity to the pixel
-        AddToCluster( (UBYTE*)_pulLayer);
-      } // go to the next pixel
-      _pulLayer++;
-      ubMask<<=1;
-      if( ubMask==0) {
-        pubMask ++;
-        ubMask = 1;
-      }
-    } // go to the next row
-    _pulLayer += slModulo;
-  }
-
-#endif
-
-}
 
 
 // apply directional light to layer
@@ -1232,14 +832,7 @@ void CLayerMixer::AddOneLayerDirectional( CBrushShadowLayer *pbsl, UBYTE *pubMas
   lm_colLight = MulColors(   lm_colLight, ulIntensity);
   lm_colLight = AdjustColor( lm_colLight, _slShdHueShift, _slShdSaturation);
 
-  // masked or non-masked?
-  if( pubMask==NULL) {
-    // non-masked
-    AddDirectional();
-  } else {
-    // masked
-    AddMaskDirectional( pubMask, ubMask);
-  }
+  MixDirectional( ByteSwap(lm_colLight), pubMask, ubMask);
 
   // all done
   _pfWorldEditingProfile.StopTimer(CWorldEditingProfile::PTI_ADDONELAYERDIRECTIONAL);
@@ -1247,6 +840,22 @@ void CLayerMixer::AddOneLayerDirectional( CBrushShadowLayer *pbsl, UBYTE *pubMas
 
 
 
+// copy from static shadow map to dynamic layer
+__forceinline void CLayerMixer::CopyShadowLayer(void)
+{
+  memcpy( lm_pulShadowMap, lm_pulStaticShadowMap, lm_pixCanvasSizeU*lm_pixCanvasSizeV*BYTES_PER_TEXEL);
+}
+
+
+// fill dynamic layer with one color
+__forceinline void CLayerMixer::FillShadowLayer( COLOR col)
+{
+  const ULONG ulCol = ByteSwap(col);  // convert to R,G,B,A memory format!
+  const PIX pixCt = lm_pixCanvasSizeU*lm_pixCanvasSizeV;
+  for( PIX pix=0; pix<pixCt; pix++) lm_pulShadowMap[pix] = ulCol;
+}
+
+
 // clamper helper
 static INDEX GetDither(void)
 {
@@ -1282,16 +891,7 @@ void CLayerMixer::MixOneMipmap(CBrushShadowMap *pbsm, INDEX iMipmap)
       }}
     }
   } // set initial color
-  __asm {
-    cld
-    mov     ebx,D [this]
-    mov     ecx,D [ebx].lm_pixCanvasSizeU
-    imul    ecx,D [ebx].lm_pixCanvasSizeV
-    mov     edi,D [ebx].lm_pulShadowMap
-    mov     eax,D [colAmbient]
-    bswap   eax
-    rep     stosd
-  }
+  FillShadowLayer( colAmbient);
   _pfWorldEditingProfile.StopTimer(CWorldEditingProfile::PTI_AMBIENTFILL);
 
   // find gradient layer
@@ -1364,37 +964,6 @@ void CLayerMixer::MixOneMipmap(CBrushShadowMap *pbsm, INDEX iMipmap)
 
 
 
-// copy from static shadow map to dynamic layer
-__forceinline void CLayerMixer::CopyShadowLayer(void)
-{
-  __asm {
-    cld
-    mov     ebx,D [this]
-    mov     ecx,D [ebx].lm_pixCanvasSizeU
-    imul    ecx,D [ebx].lm_pixCanvasSizeV
-    mov     esi,D [ebx].lm_pulStaticShadowMap
-    mov     edi,D [ebx].lm_pulShadowMap
-    rep     movsd
-  }
-}
-
-
-// copy from static shadow map to dynamic layer
-__forceinline void CLayerMixer::FillShadowLayer( COLOR col)
-{
-  __asm {
-    cld
-    mov     ebx,D [this]
-    mov     ecx,D [ebx].lm_pixCanvasSizeU
-    imul    ecx,D [ebx].lm_pixCanvasSizeV
-    mov     edi,D [ebx].lm_pulShadowMap
-    mov     eax,D [col]
-    bswap   eax   // convert to R,G,B,A memory format!
-    rep     stosd
-  }
-}
-
-
 // mix dynamic lights
 void CLayerMixer::MixOneMipmapDynamic( CBrushShadowMap *pbsm, INDEX iMipmap)
 {
@@ -1467,3 +1036,83 @@ void CBrushShadowMap::MixLayers( INDEX iFirstMip, INDEX iLastMip, BOOL bDynamic/
   _pfWorldEditingProfile.StopTimer( CWorldEditingProfile::PTI_MIXLAYERS);
   _sfStats.StopTimer( CStatForm::STI_SHADOWUPDATE);
 }
+
+
+
+// compare reference and SSE2 mixing kernels on synthetic layers and measure their speed
+void ShadowMixerBenchmark(void)
+{
+  if( !sys_bCPUHasSSE2) {
+    CPrintF( TRANS("SSE2 is not supported on this CPU.\n"));
+    return;
+  }
+  // synthetic shadow map and layer mask
+  const PIX pixSize = 256;
+  const INDEX ctPixels = pixSize*pixSize;
+  const INDEX ctIterations = 50;
+  ULONG *pulSource = (ULONG*)AllocMemory( ctPixels*BYTES_PER_TEXEL);
+  ULONG *pulC      = (ULONG*)AllocMemory( ctPixels*BYTES_PER_TEXEL);
+  ULONG *pulSSE2   = (ULONG*)AllocMemory( ctPixels*BYTES_PER_TEXEL);
+  UBYTE *pubMask   = (UBYTE*)AllocMemory( ctPixels/8+1);
+  ULONG ulSeed = 0x1234567;
+  for( INDEX iPix=0; iPix<ctPixels; iPix++) {
+    ulSeed = ulSeed*1103515245 + 12345;
+    pulSource[iPix] = ulSeed;
+  }
+  for( INDEX iMask=0; iMask<ctPixels/8+1; iMask++) {
+    ulSeed = ulSeed*1103515245 + 12345;
+    pubMask[iMask] = (UBYTE)(ulSeed>>16);
+  }
+  // layer covers most of the map, with odd width to exercise row ends
+  _iPixCt = pixSize-3;
+  _iRowCt = pixSize-5;
+  _slModulo = (pixSize-_iPixCt) *BYTES_PER_TEXEL;
+
+  static const char *astrTests[] = {
+    "ambient point", "ambient mask point", "diffusion point", "diffusion mask point",
+    "dark point", "directional", "mask directional", "gradient", "dark gradient" };
+  CPrintF( "%-22s %10s %10s %8s\n", "layer", "C (ms)", "SSE2 (ms)", "speedup");
+  for( INDEX iTest=0; iTest<ARRAYCOUNT(astrTests); iTest++)
+  {
+    // point light above the middle of the layer, pixels are 0.25m apart
+    _f1oFallOff = 1.0f / 40.0f;
+    _fMinLightDistance = 2.0f;
+    PreparePointInterpolants( FLOAT3D( -32.0f, -2.0f, -32.0f), FLOAT3D( 0.25f, 0, 0), FLOAT3D( 0, 0, 0.25f),
+                              10.0f, iTest==4);
+    UBYTE *pubTestMask = (iTest==1 || iTest==3 || iTest==6) ? pubMask+1 : NULL;
+    if( iTest<5) {
+      PreparePointKernel( 0xFFC08000, pubTestMask, 4, iTest==2 || iTest==3);
+    } else if( iTest<7) {
+      _ulLightRGB = 0x40206000;
+      _pubMask = pubTestMask;
+      _ubMask  = 4;
+    } else {
+      PrepareGradientKernel( 0x20406000, 0x10204000, 0xC0A08000, iTest==8, -4000, 150, 140);
+    }
+
+    // run both kernels on same data and time them
+    void (*apMix[2])(void);
+    apMix[0] = (iTest<5) ? MixPoint_C    : (iTest<7) ? MixDirectional_C    : MixGradient_C;
+    apMix[1] = (iTest<5) ? MixPoint_SSE2 : (iTest<7) ? MixDirectional_SSE2 : MixGradient_SSE2;
+    ULONG *apulResult[2] = { pulC, pulSSE2 };
+    DOUBLE adMs[2];
+    for( INDEX iKernel=0; iKernel<2; iKernel++) {
+      _pulLayer = apulResult[iKernel];
+      memcpy( _pulLayer, pulSource, ctPixels*BYTES_PER_TEXEL);
+      apMix[iKernel]();
+      CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+      for( INDEX iIteration=0; iIteration<ctIterations; iIteration++) apMix[iKernel]();
+      CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+      adMs[iKernel] = (tv1-tv0).GetSeconds()*1000 / ctIterations;
+    }
+    // both kernels did same passes over same data, so results must be byte-exact
+    const BOOL bSame = memcmp( pulC, pulSSE2, ctPixels*BYTES_PER_TEXEL)==0;
+    CPrintF( "%-22s %10.3f %10.3f %7.2fx %s\n", astrTests[iTest], adMs[0], adMs[1],
+             adMs[1]>0 ? adMs[0]/adMs[1] : 0.0, bSame ? "" : "MISMATCH!");
+  }
+
+  FreeMemory( pulSource);
+  FreeMemory( pulC);
+  FreeMemory( pulSSE2);
+  FreeMemory( pubMask);
+}
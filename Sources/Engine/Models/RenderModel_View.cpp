@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Base/Statistics_internal.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Models/ModelObject.h>
 #include <Engine/Models/ModelData.h>
 #include <Engine/Models/ModelProfile.h>
@@ -27,12 +28,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Fog_internal.h>
 #include <Engine/Base/Lists.inl>
 #include <Engine/World/WorldEditingProfile.h>
+#include <Engine/Base/Timer.h>
 
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Templates/StaticStackArray.cpp>
+#include <Engine/Templates/Stock_CModelData.h>
 
 #include <Engine/Models/RenderModel_internal.h>
 
+#include <emmintrin.h>
+
 // asm shortcuts
 #define O offset
 #define Q qword ptr
@@ -43,6 +48,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define ASMOPT 1
 
 extern INDEX mdl_bRenderBump;
+extern INDEX mdl_bUseSSE2;
+extern BOOL  sys_bCPUHasSSE2;
 
 extern BOOL CVA_bModels;
 extern BOOL GFX_bTruform;
@@ -1077,562 +1084,387 @@ static void AttenuateColor( const UBYTE *pshdMip, const INDEX ctVertices)
 }
 
 
-// unpack vertices (and eventually normals) of one frame
-static void UnpackFrame( CRenderModel &rm, BOOL bKeepNormals)
+// unpacking parameters (cached by UnpackVertices for unpacking kernels)
+static const void  *_pvFrame0, *_pvFrame1;  // last and next frame (same if not lerping)
+static const UWORD *_puwMipToMdl;
+static SWORD *_pswMipCol;
+static BOOL  _bKeepNormals;
+static FLOAT _fLerpRatio;
+static FLOAT _fStretchX, _fStretchY, _fStretchZ;
+static FLOAT _fOffsetX,  _fOffsetY,  _fOffsetZ;
+static FLOAT _fLightObjX, _fLightObjY, _fLightObjZ;
+
+
+// check which kernels should be used for unpacking
+static BOOL UseSSE2(void)
 {
-  _pfModelProfile.StartTimer( CModelProfile::PTI_VIEW_INIT_UNPACK);
-  _pfModelProfile.IncrementTimerAveragingCounter( CModelProfile::PTI_VIEW_INIT_UNPACK, _ctAllMipVx);
+  return mdl_bUseSSE2 && sys_bCPUHasSSE2;
+}
 
-  // cache lerp ratio, compression, stretch and light factors
-  FLOAT fStretchX = rm.rm_vStretch(1);
-  FLOAT fStretchY = rm.rm_vStretch(2);
-  FLOAT fStretchZ = rm.rm_vStretch(3);
-  FLOAT fOffsetX  = rm.rm_vOffset(1);
-  FLOAT fOffsetY  = rm.rm_vOffset(2);
-  FLOAT fOffsetZ  = rm.rm_vOffset(3);
-  const FLOAT fLerpRatio = rm.rm_fRatio;
-  const FLOAT fLightObjX = rm.rm_vLightObj(1) * -255.0f;  // multiplier is made here, so it doesn't need to be done per-vertex
-  const FLOAT fLightObjY = rm.rm_vLightObj(2) * -255.0f;
-  const FLOAT fLightObjZ = rm.rm_vLightObj(3) * -255.0f;
-  const UWORD *puwMipToMdl = (const UWORD*)&rm.rm_pmmiMip->mmpi_auwMipToMdl[0];
-        SWORD *pswMipCol   = (SWORD*)&pcolMipBase[_ctAllMipVx>>1];
-
-  // if 16 bit compression
-  if( rm.rm_pmdModelData->md_Flags & MF_COMPRESSED_16BIT)
+
+// unpack range of mip vertices from 16-bit compressed frame(s)
+static void UnpackFrame16_C( INDEX iFirstVx, INDEX iLastVx)
+{
+  const ModelFrameVertex16 *pFrame0 = (const ModelFrameVertex16*)_pvFrame0;
+  const ModelFrameVertex16 *pFrame1 = (const ModelFrameVertex16*)_pvFrame1;
+  // if no lerping
+  if( pFrame0==pFrame1)
   {
-    // if no lerping
-    const ModelFrameVertex16 *pFrame0 = rm.rm_pFrame16_0;
-    const ModelFrameVertex16 *pFrame1 = rm.rm_pFrame16_1;
-    if( pFrame0==pFrame1)
-    {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop16:
-        push    ecx
-        mov     esi,D [puwMipToMdl]
-        movzx   eax,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        lea     esi,[esi+eax*8]
-        // store vertex
-        movsx   eax,W [esi]ModelFrameVertex16.mfv_SWPoint[0]
-        movsx   ecx,W [esi]ModelFrameVertex16.mfv_SWPoint[2]
-        movsx   edx,W [esi]ModelFrameVertex16.mfv_SWPoint[4]
-        mov     D [slTmp1],eax
-        mov     D [slTmp2],ecx
-        mov     D [slTmp3],edx
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // determine normal
-        movzx   eax,B [esi]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [esi]ModelFrameVertex16.mfv_ubNormP
-        mov     esi,D [pfSinTable]
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]
-        fxch    st(1)
-        fstp    D [slTmp1]
-        fstp    D [slTmp3]
-        mov     eax,D [slTmp1]
-        mov     ecx,D [slTmp3]
-        xor     eax,0x80000000     
-        xor     ecx,0x80000000     
-        mov     D [slTmp1],eax
-        mov     D [slTmp3],ecx
-        // determine vertex shade
-        fld     D [slTmp1]
-        fmul    D [fLightObjX]
-        fld     D [esi+edx*4 +0]
-        fmul    D [fLightObjY]
-        fld     D [slTmp3]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext16
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [slTmp1]
-        mov     edx,D [esi+edx*4 +0]
-        mov     esi,D [slTmp3]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext16:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop16
-      }
-#else
-      // for each vertex in mip
-      for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
-        // get destination for unpacking
-        const INDEX iMdlVx = puwMipToMdl[iMipVx];
-        const ModelFrameVertex16 &mfv0 = pFrame0[iMdlVx];
-        // store vertex
-        GFXVertex3 &vtx = pvtxMipBase[iMipVx];
-        vtx.x = (mfv0.mfv_SWPoint(1) -fOffsetX) *fStretchX;
-        vtx.y = (mfv0.mfv_SWPoint(2) -fOffsetY) *fStretchY;
-        vtx.z = (mfv0.mfv_SWPoint(3) -fOffsetZ) *fStretchZ;
-        // determine normal
-        const FLOAT fSinH0 = pfSinTable[mfv0.mfv_ubNormH];
-        const FLOAT fSinP0 = pfSinTable[mfv0.mfv_ubNormP];
-        const FLOAT fCosH0 = pfCosTable[mfv0.mfv_ubNormH];
-        const FLOAT fCosP0 = pfCosTable[mfv0.mfv_ubNormP];
-        const FLOAT fNX = -fSinH0*fCosP0;
-        const FLOAT fNY = +fSinP0;
-        const FLOAT fNZ = -fCosH0*fCosP0;
-        // store vertex shade
-        pswMipCol[iMipVx] = FloatToInt(fNX*fLightObjX + fNY*fLightObjY + fNZ*fLightObjZ);
-        // store normal (if needed)
-        if( bKeepNormals) {
-          pnorMipBase[iMipVx].nx = fNX;
-          pnorMipBase[iMipVx].ny = fNY;
-          pnorMipBase[iMipVx].nz = fNZ;
-        }
+    // for each vertex in mip
+    for( INDEX iMipVx=iFirstVx; iMipVx<iLastVx; iMipVx++) {
+      // get destination for unpacking
+      const INDEX iMdlVx = _puwMipToMdl[iMipVx];
+      const ModelFrameVertex16 &mfv0 = pFrame0[iMdlVx];
+      // store vertex
+      GFXVertex3 &vtx = pvtxMipBase[iMipVx];
+      vtx.x = (mfv0.mfv_SWPoint(1) -_fOffsetX) *_fStretchX;
+      vtx.y = (mfv0.mfv_SWPoint(2) -_fOffsetY) *_fStretchY;
+      vtx.z = (mfv0.mfv_SWPoint(3) -_fOffsetZ) *_fStretchZ;
+      // determine normal
+      const FLOAT fSinH0 = pfSinTable[mfv0.mfv_ubNormH];
+      const FLOAT fSinP0 = pfSinTable[mfv0.mfv_ubNormP];
+      const FLOAT fCosH0 = pfCosTable[mfv0.mfv_ubNormH];
+      const FLOAT fCosP0 = pfCosTable[mfv0.mfv_ubNormP];
+      const FLOAT fNX = -fSinH0*fCosP0;
+      const FLOAT fNY = +fSinP0;
+      const FLOAT fNZ = -fCosH0*fCosP0;
+      // store vertex shade
+      _pswMipCol[iMipVx] = FloatToInt(fNX*_fLightObjX + fNY*_fLightObjY + fNZ*_fLightObjZ);
+      // store normal (if needed)
+      if( _bKeepNormals) {
+        pnorMipBase[iMipVx].nx = fNX;
+        pnorMipBase[iMipVx].ny = fNY;
+        pnorMipBase[iMipVx].nz = fNZ;
       }
-#endif
     }
-    // if lerping
-    else
-    {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop16L:
-        push    ecx
-        push    ebx
-        mov     esi,D [puwMipToMdl]
-        movzx   ebx,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        mov     ecx,D [pFrame1]
-        // lerp vertex
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[0]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[0]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp1],eax
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[2]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[2]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp2],eax
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[4]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[4]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp3],eax
-        // store vertex
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // load normals
-        movzx   eax,B [esi+ebx*8]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [esi+ebx*8]ModelFrameVertex16.mfv_ubNormP
-        mov     esi,D [pfSinTable]
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+edx*4 +0]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]  // fCosH0*fCosP0, fSinP0, fSinH0*fCosP0  
-        movzx   eax,B [ecx+ebx*8]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [ecx+ebx*8]ModelFrameVertex16.mfv_ubNormP
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+edx*4 +0]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]  // fCosH1*fCosP1, fSinP1, fSinH1*fCosP1,  fCosH0*fCosP0, fSinP0, fSinH0*fCosP0
-        // lerp normals
-        fxch    st(5)        // SH0CP0,        SP1,     SH1CP1,        CH0CP0, SP0,    CH1CP1
-        fsub    st(2),st(0)
-        fxch    st(4)        // SP0,           SP1,     SH1CP1-SH0CP0, CH0CP0, SH0CP0, CH1CP1
-        fsub    st(1),st(0)  // SP0,           SP1-SP0, SH1CP1-SH0CP0, CH0CP0, SH0CP0, CH1CP1
-        fxch    st(3)        // CH0CP0,        SP1-SP0, SH1CP1-SH0CP0, SP0,    SH0CP0, CH1CP1
-        fsub    st(5),st(0)  // CH0CP0,        SP1-SP0, SH1CP1-SH0CP0, SP0,    SH0CP0, CH1CP1-CH0CP0
-        fxch    st(2)        // SH1CP1-SH0CP0, SP1-SP0, CH0CP0,        SP0,    SH0CP0, CH1CP1-CH0CP0
-        fmul    D [fLerpRatio]
-        fxch    st(1)        // SP1-SP0,       lSH1CP1, CH0CP0,        SP0,    SH0CP0, CH1CP1-CH0CP0
-        fmul    D [fLerpRatio]
-        fxch    st(5)        // CH1CP1-CH0CP0, lSH1CP1, CH0CP0,        SP0,    SH0CP0, lSP1SP0
-        fmul    D [fLerpRatio]
-        fxch    st(1)        // lSH1CP1, lCH1CP1, CH0CP0,  SP0, SH0CP0, lSP1SP0
-        faddp   st(4),st(0)  // lCH1CP1, CH0CP0,  SP0,     fNX, lSP1SP0
-        fxch    st(2)        // SP0,     CH0CP0,  lCH1CP1, fNX, lSP1SP0
-        faddp   st(4),st(0)  // CH0CP0,  lCH1CP1, fNX,     fNY
-        faddp   st(1),st(0)  // -fNZ, -fNX,  fNY
-        fxch    st(2)        //  fNY, -fNX, -fNZ
-        fstp    D [slTmp2]
-        fstp    D [slTmp1]
-        fstp    D [slTmp3]
-        pop     ebx
-        mov     eax,D [slTmp1]
-        mov     ecx,D [slTmp3]
-        xor     eax,0x80000000     
-        xor     ecx,0x80000000     
-        mov     D [slTmp1],eax
-        mov     D [slTmp3],ecx
-        // determine vertex shade
-        fld     D [slTmp1]
-        fmul    D [fLightObjX]
-        fld     D [slTmp2]
-        fmul    D [fLightObjY]
-        fld     D [slTmp3]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext16L
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [slTmp1]
-        mov     edx,D [slTmp2]
-        mov     esi,D [slTmp3]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext16L:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop16L
-      }
-#else
-      // for each vertex in mip
-      for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
-        // get destination for unpacking
-        const INDEX iMdlVx = puwMipToMdl[iMipVx];
-        const ModelFrameVertex16 &mfv0 = pFrame0[iMdlVx];
-        const ModelFrameVertex16 &mfv1 = pFrame1[iMdlVx];
-        // store lerped vertex
-        GFXVertex3 &vtx = pvtxMipBase[iMipVx];
-        vtx.x = (Lerp( (FLOAT)mfv0.mfv_SWPoint(1), (FLOAT)mfv1.mfv_SWPoint(1), fLerpRatio) -fOffsetX) * fStretchX;
-        vtx.y = (Lerp( (FLOAT)mfv0.mfv_SWPoint(2), (FLOAT)mfv1.mfv_SWPoint(2), fLerpRatio) -fOffsetY) * fStretchY;
-        vtx.z = (Lerp( (FLOAT)mfv0.mfv_SWPoint(3), (FLOAT)mfv1.mfv_SWPoint(3), fLerpRatio) -fOffsetZ) * fStretchZ;
-        // determine lerped normal
-        const FLOAT fSinH0 = pfSinTable[mfv0.mfv_ubNormH];  const FLOAT fSinH1 = pfSinTable[mfv1.mfv_ubNormH];
-        const FLOAT fSinP0 = pfSinTable[mfv0.mfv_ubNormP];  const FLOAT fSinP1 = pfSinTable[mfv1.mfv_ubNormP];
-        const FLOAT fCosH0 = pfCosTable[mfv0.mfv_ubNormH];  const FLOAT fCosH1 = pfCosTable[mfv1.mfv_ubNormH];
-        const FLOAT fCosP0 = pfCosTable[mfv0.mfv_ubNormP];  const FLOAT fCosP1 = pfCosTable[mfv1.mfv_ubNormP];
-        const FLOAT fNX = Lerp( -fSinH0*fCosP0, -fSinH1*fCosP1, fLerpRatio);
-        const FLOAT fNY = Lerp( +fSinP0,        +fSinP1,        fLerpRatio);
-        const FLOAT fNZ = Lerp( -fCosH0*fCosP0, -fCosH1*fCosP1, fLerpRatio);
-        // store vertex shade
-        pswMipCol[iMipVx] = FloatToInt(fNX*fLightObjX + fNY*fLightObjY + fNZ*fLightObjZ);
-        // store lerped normal (if needed)
-        if( bKeepNormals) {
-          pnorMipBase[iMipVx].nx = fNX;
-          pnorMipBase[iMipVx].ny = fNY;
-          pnorMipBase[iMipVx].nz = fNZ;
-        }
+  }
+  // if lerping
+  else
+  {
+    // for each vertex in mip
+    for( INDEX iMipVx=iFirstVx; iMipVx<iLastVx; iMipVx++) {
+      // get destination for unpacking
+      const INDEX iMdlVx = _puwMipToMdl[iMipVx];
+      const ModelFrameVertex16 &mfv0 = pFrame0[iMdlVx];
+      const ModelFrameVertex16 &mfv1 = pFrame1[iMdlVx];
+      // store lerped vertex
+      GFXVertex3 &vtx = pvtxMipBase[iMipVx];
+      vtx.x = (Lerp( (FLOAT)mfv0.mfv_SWPoint(1), (FLOAT)mfv1.mfv_SWPoint(1), _fLerpRatio) -_fOffsetX) * _fStretchX;
+      vtx.y = (Lerp( (FLOAT)mfv0.mfv_SWPoint(2), (FLOAT)mfv1.mfv_SWPoint(2), _fLerpRatio) -_fOffsetY) * _fStretchY;
+      vtx.z = (Lerp( (FLOAT)mfv0.mfv_SWPoint(3), (FLOAT)mfv1.mfv_SWPoint(3), _fLerpRatio) -_fOffsetZ) * _fStretchZ;
+      // determine lerped normal
+      const FLOAT fSinH0 = pfSinTable[mfv0.mfv_ubNormH];  const FLOAT fSinH1 = pfSinTable[mfv1.mfv_ubNormH];
+      const FLOAT fSinP0 = pfSinTable[mfv0.mfv_ubNormP];  const FLOAT fSinP1 = pfSinTable[mfv1.mfv_ubNormP];
+      const FLOAT fCosH0 = pfCosTable[mfv0.mfv_ubNormH];  const FLOAT fCosH1 = pfCosTable[mfv1.mfv_ubNormH];
+      const FLOAT fCosP0 = pfCosTable[mfv0.mfv_ubNormP];  const FLOAT fCosP1 = pfCosTable[mfv1.mfv_ubNormP];
+      const FLOAT fNX = Lerp( -fSinH0*fCosP0, -fSinH1*fCosP1, _fLerpRatio);
+      const FLOAT fNY = Lerp( +fSinP0,        +fSinP1,        _fLerpRatio);
+      const FLOAT fNZ = Lerp( -fCosH0*fCosP0, -fCosH1*fCosP1, _fLerpRatio);
+      // store vertex shade
+      _pswMipCol[iMipVx] = FloatToInt(fNX*_fLightObjX + fNY*_fLightObjY + fNZ*_fLightObjZ);
+      // store lerped normal (if needed)
+      if( _bKeepNormals) {
+        pnorMipBase[iMipVx].nx = fNX;
+        pnorMipBase[iMipVx].ny = fNY;
+        pnorMipBase[iMipVx].nz = fNZ;
       }
-#endif
-
     }
   }
-  // if 8 bit compression
-  else 
+}
+
+
+// unpack range of mip vertices from 8-bit compressed frame(s)
+static void UnpackFrame8_C( INDEX iFirstVx, INDEX iLastVx)
+{
+  const ModelFrameVertex8 *pFrame0 = (const ModelFrameVertex8*)_pvFrame0;
+  const ModelFrameVertex8 *pFrame1 = (const ModelFrameVertex8*)_pvFrame1;
+  // if no lerping
+  if( pFrame0==pFrame1)
   {
-    const ModelFrameVertex8 *pFrame0 = rm.rm_pFrame8_0;
-    const ModelFrameVertex8 *pFrame1 = rm.rm_pFrame8_1;
-    // if no lerping
-    if( pFrame0==pFrame1)
-    {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop8:
-        push    ecx
-        mov     esi,D [puwMipToMdl]
-        movzx   eax,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        lea     esi,[esi+eax*4]
-        // store vertex
-        movsx   eax,B [esi]ModelFrameVertex8.mfv_SBPoint[0]
-        movsx   ecx,B [esi]ModelFrameVertex8.mfv_SBPoint[1]
-        movsx   edx,B [esi]ModelFrameVertex8.mfv_SBPoint[2]
-        mov     D [slTmp1],eax
-        mov     D [slTmp2],ecx
-        mov     D [slTmp3],edx
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // determine normal
-        movzx   eax,B [esi]ModelFrameVertex8.mfv_NormIndex
-        lea     esi,[eax*2+eax]
-        // determine vertex shade
-        fld     D [avGouraudNormals+ esi*4 +0]
-        fmul    D [fLightObjX]
-        fld     D [avGouraudNormals+ esi*4 +4]
-        fmul    D [fLightObjY]
-        fld     D [avGouraudNormals+ esi*4 +8]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext8
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [avGouraudNormals+ esi*4 +0]
-        mov     edx,D [avGouraudNormals+ esi*4 +4]
-        mov     esi,D [avGouraudNormals+ esi*4 +8]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext8:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop8
-      }
-#else
-      // for each vertex in mip
-      for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
-        // get destination for unpacking
-        const INDEX iMdlVx = puwMipToMdl[iMipVx];
-        const ModelFrameVertex8 &mfv0 = pFrame0[iMdlVx];
-        // store vertex
-        GFXVertex3 &vtx = pvtxMipBase[iMipVx];
-        vtx.x = (mfv0.mfv_SBPoint(1) -fOffsetX) * fStretchX;
-        vtx.y = (mfv0.mfv_SBPoint(2) -fOffsetY) * fStretchY;
-        vtx.z = (mfv0.mfv_SBPoint(3) -fOffsetZ) * fStretchZ;
-        // determine normal
-        const FLOAT3D &vNormal0 = avGouraudNormals[mfv0.mfv_NormIndex];
-        const FLOAT fNX = vNormal0(1);
-        const FLOAT fNY = vNormal0(2);
-        const FLOAT fNZ = vNormal0(3);
-        // store vertex shade
-        pswMipCol[iMipVx] = FloatToInt(fNX*fLightObjX + fNY*fLightObjY + fNZ*fLightObjZ);
-        // store lerped normal (if needed)
-        if( bKeepNormals) {
-          pnorMipBase[iMipVx].nx = fNX;
-          pnorMipBase[iMipVx].ny = fNY;
-          pnorMipBase[iMipVx].nz = fNZ;
-        }
+    // for each vertex in mip
+    for( INDEX iMipVx=iFirstVx; iMipVx<iLastVx; iMipVx++) {
+      // get destination for unpacking
+      const INDEX iMdlVx = _puwMipToMdl[iMipVx];
+      const ModelFrameVertex8 &mfv0 = pFrame0[iMdlVx];
+      // store vertex
+      GFXVertex3 &vtx = pvtxMipBase[iMipVx];
+      vtx.x = (mfv0.mfv_SBPoint(1) -_fOffsetX) * _fStretchX;
+      vtx.y = (mfv0.mfv_SBPoint(2) -_fOffsetY) * _fStretchY;
+      vtx.z = (mfv0.mfv_SBPoint(3) -_fOffsetZ) * _fStretchZ;
+      // determine normal
+      const FLOAT3D &vNormal0 = avGouraudNormals[mfv0.mfv_NormIndex];
+      const FLOAT fNX = vNormal0(1);
+      const FLOAT fNY = vNormal0(2);
+      const FLOAT fNZ = vNormal0(3);
+      // store vertex shade
+      _pswMipCol[iMipVx] = FloatToInt(fNX*_fLightObjX + fNY*_fLightObjY + fNZ*_fLightObjZ);
+      // store normal (if needed)
+      if( _bKeepNormals) {
+        pnorMipBase[iMipVx].nx = fNX;
+        pnorMipBase[iMipVx].ny = fNY;
+        pnorMipBase[iMipVx].nz = fNZ;
       }
-#endif
     }
-    // if lerping
-    else
-    {
-#if ASMOPT == 1
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      // re-adjust stretching factors because of fixint lerping (divide by 256)
-      fStretchX*=0.00390625f;  fOffsetX*=256.0f;  
-      fStretchY*=0.00390625f;  fOffsetY*=256.0f;
-      fStretchZ*=0.00390625f;  fOffsetZ*=256.0f;
-      // for each vertex in mip
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop8L:
-        push    ecx
-        push    ebx
-        mov     esi,D [puwMipToMdl]
-        movzx   ebx,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        mov     ecx,D [pFrame1]
-        // lerp vertex
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[0]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[0]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp1],eax
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[1]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[1]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp2],eax
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[2]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[2]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp3],eax
-        // store vertex
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // load normals
-        movzx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_NormIndex
-        movzx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_NormIndex
-        lea     esi,[eax*2+eax]
-        lea     ecx,[edx*2+edx]
-        // lerp normals
-        fld     D [avGouraudNormals+ ecx*4 +0]
-        fsub    D [avGouraudNormals+ esi*4 +0]
-        fld     D [avGouraudNormals+ ecx*4 +4]
-        fsub    D [avGouraudNormals+ esi*4 +4]
-        fld     D [avGouraudNormals+ ecx*4 +8]
-        fsub    D [avGouraudNormals+ esi*4 +8]
-        fxch    st(2)   // nx1-nx0, ny1-ny0, nz1-nz0
-        fmul    D [fLerpRatio]
-        fxch    st(1)   // ny1-ny0, lnx1, nz1-nz0
-        fmul    D [fLerpRatio]
-        fxch    st(2)   // nz1-nz0, lnx1, lny1
-        fmul    D [fLerpRatio]
-        fxch    st(1)   // lnx1, lnz1, lny1
-        fadd    D [avGouraudNormals+ esi*4 +0]
-        fxch    st(2)   // lny1, lnz1, fNX
-        fadd    D [avGouraudNormals+ esi*4 +4]
-        fxch    st(1)   // lnz1, fNY, fNX
-        fadd    D [avGouraudNormals+ esi*4 +8]
-        fxch    st(2)   // fNX, fNY, fNZ
-        // determine vertex shade
-        fld     D [fLightObjX]
-        fmul    st(0),st(1)     // flnx, fNX, fNY, fNZ 
-        pop     ebx            
-        fld     D [fLightObjY]
-        fmul    st(0),st(3)     // flny, flnx, fNX, fNY, fNZ 
-        fld     D [fLightObjZ]
-        fmul    st(0),st(5)     // flnz, flny, flnx, fNX, fNY, fNXZ
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)     // FL, fNX, fNY, fNXZ
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext8L
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        fstp    D [ecx]GFXNormal.nx
-        fstp    D [ecx]GFXNormal.ny
-        fst     D [ecx]GFXNormal.nz
-        fld     st(0)
-        fld     st(0)
-        // advance to next vertex
-vtxNext8L:
-        fstp    st(0)
-        fcompp
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop8L
-      }
-#else
-      // for each vertex in mip
-      for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
-        // get destination for unpacking
-        const INDEX iMdlVx = puwMipToMdl[iMipVx];
-        const ModelFrameVertex8 &mfv0 = pFrame0[iMdlVx];
-        const ModelFrameVertex8 &mfv1 = pFrame1[iMdlVx];
-        // store lerped vertex
-        GFXVertex3 &vtx = pvtxMipBase[iMipVx];
-        vtx.x = (Lerp( (FLOAT)mfv0.mfv_SBPoint(1), (FLOAT)mfv1.mfv_SBPoint(1), fLerpRatio) -fOffsetX) * fStretchX;
-        vtx.y = (Lerp( (FLOAT)mfv0.mfv_SBPoint(2), (FLOAT)mfv1.mfv_SBPoint(2), fLerpRatio) -fOffsetY) * fStretchY;
-        vtx.z = (Lerp( (FLOAT)mfv0.mfv_SBPoint(3), (FLOAT)mfv1.mfv_SBPoint(3), fLerpRatio) -fOffsetZ) * fStretchZ;
-        // determine lerped normal
-        const FLOAT3D &vNormal0 = avGouraudNormals[mfv0.mfv_NormIndex];
-        const FLOAT3D &vNormal1 = avGouraudNormals[mfv1.mfv_NormIndex];
-        const FLOAT fNX = Lerp( (FLOAT)vNormal0(1), (FLOAT)vNormal1(1), fLerpRatio);
-        const FLOAT fNY = Lerp( (FLOAT)vNormal0(2), (FLOAT)vNormal1(2), fLerpRatio);
-        const FLOAT fNZ = Lerp( (FLOAT)vNormal0(3), (FLOAT)vNormal1(3), fLerpRatio);
-        // store vertex shade
-        pswMipCol[iMipVx] = FloatToInt(fNX*fLightObjX + fNY*fLightObjY + fNZ*fLightObjZ);
-        // store lerped normal (if needed)
-        if( bKeepNormals) {
-          pnorMipBase[iMipVx].nx = fNX;
-          pnorMipBase[iMipVx].ny = fNY;
-          pnorMipBase[iMipVx].nz = fNZ;
-        }
+  }
+  // if lerping
+  else
+  {
+    // for each vertex in mip
+    for( INDEX iMipVx=iFirstVx; iMipVx<iLastVx; iMipVx++) {
+      // get destination for unpacking
+      const INDEX iMdlVx = _puwMipToMdl[iMipVx];
+      const ModelFrameVertex8 &mfv0 = pFrame0[iMdlVx];
+      const ModelFrameVertex8 &mfv1 = pFrame1[iMdlVx];
+      // store lerped vertex
+      GFXVertex3 &vtx = pvtxMipBase[iMipVx];
+      vtx.x = (Lerp( (FLOAT)mfv0.mfv_SBPoint(1), (FLOAT)mfv1.mfv_SBPoint(1), _fLerpRatio) -_fOffsetX) * _fStretchX;
+      vtx.y = (Lerp( (FLOAT)mfv0.mfv_SBPoint(2), (FLOAT)mfv1.mfv_SBPoint(2), _fLerpRatio) -_fOffsetY) * _fStretchY;
+      vtx.z = (Lerp( (FLOAT)mfv0.mfv_SBPoint(3), (FLOAT)mfv1.mfv_SBPoint(3), _fLerpRatio) -_fOffsetZ) * _fStretchZ;
+      // determine lerped normal
+      const FLOAT3D &vNormal0 = avGouraudNormals[mfv0.mfv_NormIndex];
+      const FLOAT3D &vNormal1 = avGouraudNormals[mfv1.mfv_NormIndex];
+      const FLOAT fNX = Lerp( (FLOAT)vNormal0(1), (FLOAT)vNormal1(1), _fLerpRatio);
+      const FLOAT fNY = Lerp( (FLOAT)vNormal0(2), (FLOAT)vNormal1(2), _fLerpRatio);
+      const FLOAT fNZ = Lerp( (FLOAT)vNormal0(3), (FLOAT)vNormal1(3), _fLerpRatio);
+      // store vertex shade
+      _pswMipCol[iMipVx] = FloatToInt(fNX*_fLightObjX + fNY*_fLightObjY + fNZ*_fLightObjZ);
+      // store lerped normal (if needed)
+      if( _bKeepNormals) {
+        pnorMipBase[iMipVx].nx = fNX;
+        pnorMipBase[iMipVx].ny = fNY;
+        pnorMipBase[iMipVx].nz = fNZ;
       }
-#endif
     }
   }
+}
+
+
+// transpose words of four vertices (x,y,z,normal each; two vertices per register) to float rows
+static inline void TransposePoints_SSE2( const __m128i &m01, const __m128i &m23,
+                                         __m128 &mX, __m128 &mY, __m128 &mZ)
+{
+  const __m128i m02 = _mm_unpacklo_epi16( m01, m23);  // x0 x2 y0 y2 z0 z2 n0 n2
+  const __m128i m13 = _mm_unpackhi_epi16( m01, m23);  // x1 x3 y1 y3 z1 z3 n1 n3
+  const __m128i mXY = _mm_unpacklo_epi16( m02, m13);  // x0 x1 x2 x3 y0 y1 y2 y3
+  const __m128i mZN = _mm_unpacklo_epi16( _mm_unpackhi_epi16( m02, m13), _mm_setzero_si128());
+  // sign-extend words to dwords and convert
+  mX = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( mXY, mXY), 16));
+  mY = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( mXY, mXY), 16));
+  mZ = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_slli_epi32( mZN, 16), 16));
+}
+
+
+// gather and decompress positions of four 16-bit vertices
+static inline void LoadPoints16_SSE2( const ModelFrameVertex16 *pFrame, const INDEX *piMdlVx,
+                                      __m128 &mX, __m128 &mY, __m128 &mZ)
+{
+  const __m128i m01 = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*)&pFrame[piMdlVx[0]]),
+                                          _mm_loadl_epi64( (const __m128i*)&pFrame[piMdlVx[1]]));
+  const __m128i m23 = _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i*)&pFrame[piMdlVx[2]]),
+                                          _mm_loadl_epi64( (const __m128i*)&pFrame[piMdlVx[3]]));
+  TransposePoints_SSE2( m01, m23, mX, mY, mZ);
+}
+
+
+// gather and decompress positions of four 8-bit vertices
+static inline void LoadPoints8_SSE2( const ModelFrameVertex8 *pFrame, const INDEX *piMdlVx,
+                                     __m128 &mX, __m128 &mY, __m128 &mZ)
+{
+  const __m128i m0123 = _mm_setr_epi32( *(const SLONG*)&pFrame[piMdlVx[0]], *(const SLONG*)&pFrame[piMdlVx[1]],
+                                        *(const SLONG*)&pFrame[piMdlVx[2]], *(const SLONG*)&pFrame[piMdlVx[3]]);
+  // sign-extend bytes to words, so they can be transposed as 16-bit ones
+  const __m128i m01 = _mm_srai_epi16( _mm_unpacklo_epi8( m0123, m0123), 8);
+  const __m128i m23 = _mm_srai_epi16( _mm_unpackhi_epi8( m0123, m0123), 8);
+  TransposePoints_SSE2( m01, m23, mX, mY, mZ);
+}
+
+
+// gather normals of four 16-bit vertices from heading and pitch tables
+static inline void LoadNormals16_SSE2( const ModelFrameVertex16 *pFrame, const INDEX *piMdlVx,
+                                       __m128 &mNX, __m128 &mNY, __m128 &mNZ)
+{
+  const ModelFrameVertex16 &mfv0 = pFrame[piMdlVx[0]];
+  const ModelFrameVertex16 &mfv1 = pFrame[piMdlVx[1]];
+  const ModelFrameVertex16 &mfv2 = pFrame[piMdlVx[2]];
+  const ModelFrameVertex16 &mfv3 = pFrame[piMdlVx[3]];
+  const __m128 mSign = _mm_set1_ps(-0.0f);
+  const __m128 mSinH = _mm_setr_ps( pfSinTable[mfv0.mfv_ubNormH], pfSinTable[mfv1.mfv_ubNormH],
+                                    pfSinTable[mfv2.mfv_ubNormH], pfSinTable[mfv3.mfv_ubNormH]);
+  const __m128 mCosH = _mm_setr_ps( pfCosTable[mfv0.mfv_ubNormH], pfCosTable[mfv1.mfv_ubNormH],
+                                    pfCosTable[mfv2.mfv_ubNormH], pfCosTable[mfv3.mfv_ubNormH]);
+  const __m128 mCosP = _mm_setr_ps( pfCosTable[mfv0.mfv_ubNormP], pfCosTable[mfv1.mfv_ubNormP],
+                                    pfCosTable[mfv2.mfv_ubNormP], pfCosTable[mfv3.mfv_ubNormP]);
+  mNX = _mm_mul_ps( _mm_xor_ps( mSinH, mSign), mCosP);
+  mNY = _mm_setr_ps( pfSinTable[mfv0.mfv_ubNormP], pfSinTable[mfv1.mfv_ubNormP],
+                     pfSinTable[mfv2.mfv_ubNormP], pfSinTable[mfv3.mfv_ubNormP]);
+  mNZ = _mm_mul_ps( _mm_xor_ps( mCosH, mSign), mCosP);
+}
+
+
+// gather normals of four 8-bit vertices from gouraud normals table
+static inline void LoadNormals8_SSE2( const ModelFrameVertex8 *pFrame, const INDEX *piMdlVx,
+                                      __m128 &mNX, __m128 &mNY, __m128 &mNZ)
+{
+  const FLOAT3D &vNormal0 = avGouraudNormals[pFrame[piMdlVx[0]].mfv_NormIndex];
+  const FLOAT3D &vNormal1 = avGouraudNormals[pFrame[piMdlVx[1]].mfv_NormIndex];
+  const FLOAT3D &vNormal2 = avGouraudNormals[pFrame[piMdlVx[2]].mfv_NormIndex];
+  const FLOAT3D &vNormal3 = avGouraudNormals[pFrame[piMdlVx[3]].mfv_NormIndex];
+  mNX = _mm_setr_ps( vNormal0(1), vNormal1(1), vNormal2(1), vNormal3(1));
+  mNY = _mm_setr_ps( vNormal0(2), vNormal1(2), vNormal2(2), vNormal3(2));
+  mNZ = _mm_setr_ps( vNormal0(3), vNormal1(3), vNormal2(3), vNormal3(3));
+}
+
+
+// lerp four values at once
+static inline __m128 Lerp_SSE2( const __m128 &m0, const __m128 &m1, const __m128 &mRatio)
+{
+  return _mm_add_ps( m0, _mm_mul_ps( _mm_sub_ps( m1, m0), mRatio));
+}
+
+
+// store x, y and z rows of four vertices (or normals) as consecutive three-float structures
+static inline void StoreRows_SSE2( FLOAT *pf, const __m128 &mX, const __m128 &mY, const __m128 &mZ)
+{
+  const __m128 mXY01 = _mm_unpacklo_ps( mX, mY);  // x0 y0 x1 y1
+  const __m128 mXY23 = _mm_unpackhi_ps( mX, mY);  // x2 y2 x3 y3
+  const __m128 mZ0X1 = _mm_shuffle_ps( mZ, mXY01, _MM_SHUFFLE(2,2,0,0));  // z0 z0 x1 x1
+  const __m128 mY1Z1 = _mm_shuffle_ps( mXY01, mZ, _MM_SHUFFLE(1,1,3,3));  // y1 y1 z1 z1
+  const __m128 mZ2Y3 = _mm_shuffle_ps( mZ, mXY23, _MM_SHUFFLE(3,2,3,2));  // z2 z3 x3 y3
+  _mm_storeu_ps( pf+0, _mm_shuffle_ps( mXY01, mZ0X1, _MM_SHUFFLE(2,0,1,0)));  // x0 y0 z0 x1
+  _mm_storeu_ps( pf+4, _mm_shuffle_ps( mY1Z1, mXY23, _MM_SHUFFLE(1,0,2,0)));  // y1 z1 x2 y2
+  _mm_storeu_ps( pf+8, _mm_shuffle_ps( mZ2Y3, mZ2Y3, _MM_SHUFFLE(1,3,2,0)));  // z2 x3 y3 z3
+}
+
+
+// stretch and store four unpacked vertices, and their shades and normals
+static inline void StoreVertices_SSE2( INDEX iMipVx, __m128 &mX, __m128 &mY, __m128 &mZ,
+                                       const __m128 &mNX, const __m128 &mNY, const __m128 &mNZ)
+{
+  mX = _mm_mul_ps( _mm_sub_ps( mX, _mm_set1_ps(_fOffsetX)), _mm_set1_ps(_fStretchX));
+  mY = _mm_mul_ps( _mm_sub_ps( mY, _mm_set1_ps(_fOffsetY)), _mm_set1_ps(_fStretchY));
+  mZ = _mm_mul_ps( _mm_sub_ps( mZ, _mm_set1_ps(_fOffsetZ)), _mm_set1_ps(_fStretchZ));
+  StoreRows_SSE2( &pvtxMipBase[iMipVx].x, mX, mY, mZ);
+  // shades are rounded same as with FloatToInt() and always fit in a word
+  const __m128 mShade = _mm_add_ps( _mm_add_ps( _mm_mul_ps( mNX, _mm_set1_ps(_fLightObjX)),
+                                                _mm_mul_ps( mNY, _mm_set1_ps(_fLightObjY))),
+                                                _mm_mul_ps( mNZ, _mm_set1_ps(_fLightObjZ)));
+  const __m128i mShadeI = _mm_cvtps_epi32( mShade);
+  _mm_storel_epi64( (__m128i*)&_pswMipCol[iMipVx], _mm_packs_epi32( mShadeI, mShadeI));
+  if( _bKeepNormals) StoreRows_SSE2( &pnorMipBase[iMipVx].nx, mNX, mNY, mNZ);
+}
+
+
+// unpack all mip vertices from 16-bit compressed frame(s), four at a time
+static void UnpackFrame16_SSE2(void)
+{
+  ASSERT( sizeof(ModelFrameVertex16)==8);
+  const ModelFrameVertex16 *pFrame0 = (const ModelFrameVertex16*)_pvFrame0;
+  const ModelFrameVertex16 *pFrame1 = (const ModelFrameVertex16*)_pvFrame1;
+  const BOOL bLerp = pFrame0!=pFrame1;
+  const __m128 mRatio = _mm_set1_ps(_fLerpRatio);
+  const INDEX ct4Vx = _ctAllMipVx & ~3;
+  for( INDEX iMipVx=0; iMipVx<ct4Vx; iMipVx+=4) {
+    const INDEX aiMdlVx[4] = { _puwMipToMdl[iMipVx+0], _puwMipToMdl[iMipVx+1],
+                               _puwMipToMdl[iMipVx+2], _puwMipToMdl[iMipVx+3] };
+    __m128 mX, mY, mZ, mNX, mNY, mNZ;
+    LoadPoints16_SSE2(  pFrame0, aiMdlVx, mX,  mY,  mZ);
+    LoadNormals16_SSE2( pFrame0, aiMdlVx, mNX, mNY, mNZ);
+    if( bLerp) {
+      __m128 mX1, mY1, mZ1, mNX1, mNY1, mNZ1;
+      LoadPoints16_SSE2(  pFrame1, aiMdlVx, mX1,  mY1,  mZ1);
+      LoadNormals16_SSE2( pFrame1, aiMdlVx, mNX1, mNY1, mNZ1);
+      mX  = Lerp_SSE2( mX,  mX1,  mRatio);
+      mY  = Lerp_SSE2( mY,  mY1,  mRatio);
+      mZ  = Lerp_SSE2( mZ,  mZ1,  mRatio);
+      mNX = Lerp_SSE2( mNX, mNX1, mRatio);
+      mNY = Lerp_SSE2( mNY, mNY1, mRatio);
+      mNZ = Lerp_SSE2( mNZ, mNZ1, mRatio);
+    }
+    StoreVertices_SSE2( iMipVx, mX, mY, mZ, mNX, mNY, mNZ);
+  }
+  // do the rest
+  UnpackFrame16_C( ct4Vx, _ctAllMipVx);
+}
+
+
+// unpack all mip vertices from 8-bit compressed frame(s), four at a time
+static void UnpackFrame8_SSE2(void)
+{
+  ASSERT( sizeof(ModelFrameVertex8)==4);
+  const ModelFrameVertex8 *pFrame0 = (const ModelFrameVertex8*)_pvFrame0;
+  const ModelFrameVertex8 *pFrame1 = (const ModelFrameVertex8*)_pvFrame1;
+  const BOOL bLerp = pFrame0!=pFrame1;
+  const __m128 mRatio = _mm_set1_ps(_fLerpRatio);
+  const INDEX ct4Vx = _ctAllMipVx & ~3;
+  for( INDEX iMipVx=0; iMipVx<ct4Vx; iMipVx+=4) {
+    const INDEX aiMdlVx[4] = { _puwMipToMdl[iMipVx+0], _puwMipToMdl[iMipVx+1],
+                               _puwMipToMdl[iMipVx+2], _puwMipToMdl[iMipVx+3] };
+    __m128 mX, mY, mZ, mNX, mNY, mNZ;
+    LoadPoints8_SSE2(  pFrame0, aiMdlVx, mX,  mY,  mZ);
+    LoadNormals8_SSE2( pFrame0, aiMdlVx, mNX, mNY, mNZ);
+    if( bLerp) {
+      __m128 mX1, mY1, mZ1, mNX1, mNY1, mNZ1;
+      LoadPoints8_SSE2(  pFrame1, aiMdlVx, mX1,  mY1,  mZ1);
+      LoadNormals8_SSE2( pFrame1, aiMdlVx, mNX1, mNY1, mNZ1);
+      mX  = Lerp_SSE2( mX,  mX1,  mRatio);
+      mY  = Lerp_SSE2( mY,  mY1,  mRatio);
+      mZ  = Lerp_SSE2( mZ,  mZ1,  mRatio);
+      mNX = Lerp_SSE2( mNX, mNX1, mRatio);
+      mNY = Lerp_SSE2( mNY, mNY1, mRatio);
+      mNZ = Lerp_SSE2( mNZ, mNZ1, mRatio);
+    }
+    StoreVertices_SSE2( iMipVx, mX, mY, mZ, mNX, mNY, mNZ);
+  }
+  // do the rest
+  UnpackFrame8_C( ct4Vx, _ctAllMipVx);
+}
+
+
+// unpack vertices, shades (and eventually normals) of one frame to mip arrays
+static void UnpackVertices( CRenderModel &rm, BOOL bKeepNormals, BOOL bSSE2)
+{
+  // cache lerp ratio, compression, stretch and light factors
+  _fStretchX = rm.rm_vStretch(1);
+  _fStretchY = rm.rm_vStretch(2);
+  _fStretchZ = rm.rm_vStretch(3);
+  _fOffsetX  = rm.rm_vOffset(1);
+  _fOffsetY  = rm.rm_vOffset(2);
+  _fOffsetZ  = rm.rm_vOffset(3);
+  _fLerpRatio = rm.rm_fRatio;
+  _fLightObjX = rm.rm_vLightObj(1) * -255.0f;  // multiplier is made here, so it doesn't need to be done per-vertex
+  _fLightObjY = rm.rm_vLightObj(2) * -255.0f;
+  _fLightObjZ = rm.rm_vLightObj(3) * -255.0f;
+  _puwMipToMdl = (const UWORD*)&rm.rm_pmmiMip->mmpi_auwMipToMdl[0];
+  _pswMipCol   = (SWORD*)&pcolMipBase[_ctAllMipVx>>1];
+  _bKeepNormals = bKeepNormals;
+
+  // get frames (lerping with ratio at either end is same as taking just that frame)
+  const BOOL b16Bit = rm.rm_pmdModelData->md_Flags & MF_COMPRESSED_16BIT;
+  _pvFrame0 = b16Bit ? (const void*)rm.rm_pFrame16_0 : (const void*)rm.rm_pFrame8_0;
+  _pvFrame1 = b16Bit ? (const void*)rm.rm_pFrame16_1 : (const void*)rm.rm_pFrame8_1;
+       if( _fLerpRatio==0) _pvFrame1 = _pvFrame0;
+  else if( _fLerpRatio==1) _pvFrame0 = _pvFrame1;
+
+  // unpack with kernel for frame compression
+  if( b16Bit) {
+    if( bSSE2) UnpackFrame16_SSE2();
+    else UnpackFrame16_C( 0, _ctAllMipVx);
+  } else {
+    if( bSSE2) UnpackFrame8_SSE2();
+    else UnpackFrame8_C( 0, _ctAllMipVx);
+  }
+}
+
+
+// unpack vertices (and eventually normals) of one frame
+static void UnpackFrame( CRenderModel &rm, BOOL bKeepNormals)
+{
+  _pfModelProfile.StartTimer( CModelProfile::PTI_VIEW_INIT_UNPACK);
+  _pfModelProfile.IncrementTimerAveragingCounter( CModelProfile::PTI_VIEW_INIT_UNPACK, _ctAllMipVx);
+
+  // unpack vertices and their shades
+  UnpackVertices( rm, bKeepNormals, UseSSE2());
+  SWORD *pswMipCol = _pswMipCol;
 
   // generate colors from shades
 #if ASMOPT == 1
@@ -3462,6 +3294,157 @@ void RenderBatchedSimpleShadows_View(void)
 }
 
 
+// point render model to given frames of its model data
+static void SetBenchmarkFrames( CRenderModel &rm, INDEX iFrame0, INDEX iFrame1)
+{
+  CModelData &md = *rm.rm_pmdModelData;
+  if( md.md_Flags & MF_COMPRESSED_16BIT) {
+    rm.rm_pFrame16_0 = &md.md_FrameVertices16[iFrame0*md.md_VerticesCt];
+    rm.rm_pFrame16_1 = &md.md_FrameVertices16[iFrame1*md.md_VerticesCt];
+  } else {
+    rm.rm_pFrame8_0 = &md.md_FrameVertices8[iFrame0*md.md_VerticesCt];
+    rm.rm_pFrame8_1 = &md.md_FrameVertices8[iFrame1*md.md_VerticesCt];
+  }
+}
+
+// get lerped vertex position as former x87 unpacking did it, in 8:8 fixed point
+// (for measuring how far reference kernels are from positions that were shipped)
+static FLOAT3D GetFixedLerpedPoint( const CRenderModel &rm, INDEX iMdlVx)
+{
+  const SLONG fixLerpRatio = FloatToInt(rm.rm_fRatio*256.0f); // fix 8:8
+  FLOAT3D vPoint;
+  for( INDEX i=1; i<=3; i++) {
+    if( rm.rm_pmdModelData->md_Flags & MF_COMPRESSED_16BIT) {
+      // 16-bit positions were lerped in integers and truncated
+      const SLONG sl0 = rm.rm_pFrame16_0[iMdlVx].mfv_SWPoint(i);
+      const SLONG sl1 = rm.rm_pFrame16_1[iMdlVx].mfv_SWPoint(i);
+      const SLONG slLerped = sl0 + (((sl1-sl0)*fixLerpRatio)>>8);
+      vPoint(i) = (slLerped - rm.rm_vOffset(i)) * rm.rm_vStretch(i);
+    } else {
+      // 8-bit positions were kept in 8:8 fixed point
+      const SLONG sl0 = rm.rm_pFrame8_0[iMdlVx].mfv_SBPoint(i);
+      const SLONG sl1 = rm.rm_pFrame8_1[iMdlVx].mfv_SBPoint(i);
+      const SLONG slLerped = (sl0<<8) + (sl1-sl0)*fixLerpRatio;
+      vPoint(i) = (slLerped - rm.rm_vOffset(i)*256.0f) * (rm.rm_vStretch(i)*0.00390625f);
+    }
+  }
+  return vPoint;
+}
+
+// unpack all frames of a model without rendering it, with reference and SSE2 kernels,
+// and check SSE2 results against reference ones (and reference positions against fixed point lerp
+// that former x87 kernels used)
+static void ModelUnpackBenchmark( const CTFileName &fnmModel)
+{
+  if( !sys_bCPUHasSSE2) {
+    CPrintF( TRANS("SSE2 is not supported on this CPU.\n"));
+    return;
+  }
+  CModelData *pmd;
+  try {
+    pmd = _pModelStock->Obtain_t(fnmModel);
+  } catch( char *strError) {
+    CPrintF( TRANS("Cannot load model '%s': %s\n"), (const char*)fnmModel, strError);
+    return;
+  }
+  PrepareModelForRendering( *pmd);
+
+  // model is unpacked in main mip, lit from above and in front
+  CRenderModel rm;
+  rm.rm_ulFlags |= RMF_ATTACHMENT;  // don't touch list of render models when done
+  rm.rm_pmdModelData = pmd;
+  rm.rm_pmmiMip  = &pmd->md_MipInfos[0];
+  rm.rm_vStretch = pmd->md_Stretch;
+  rm.rm_vOffset  = pmd->md_vCompressedCenter;
+  rm.rm_vLightObj = FLOAT3D( 0.3f, -0.8f, -0.5f);
+  rm.rm_vLightObj.Normalize();
+  const INDEX ctFrames = pmd->md_FramesCt;
+  _ctAllMipVx = rm.rm_pmmiMip->mmpi_ctMipVx;
+  // enough passes over all frames to unpack a few million vertices
+  const INDEX ctPasses = ClampDn( 2000000L/ClampDn( ctFrames*_ctAllMipVx, 1L), 1L);
+
+  // each kernel set gets its own output arrays
+  CStaticStackArray<GFXVertex3> aavtx[2];
+  CStaticStackArray<GFXNormal3> aanor[2];
+  CStaticStackArray<GFXColor>   aacol[2];
+  for( INDEX iArrays=0; iArrays<2; iArrays++) {
+    aavtx[iArrays].Push(_ctAllMipVx);
+    aanor[iArrays].Push(_ctAllMipVx);
+    aacol[iArrays].Push(_ctAllMipVx);
+  }
+
+  CPrintF( TRANS("Model '%s': %d frames, %d vertices in main mip, %s compression\n"), (const char*)fnmModel,
+           ctFrames, _ctAllMipVx, (pmd->md_Flags&MF_COMPRESSED_16BIT) ? "16-bit" : "8-bit");
+  CPrintF( "%-10s %10s %10s %8s %10s %6s %10s\n", "frames", "C (ms)", "SSE2 (ms)", "speedup", "max error", "shade", "vs fixed");
+  for( INDEX iLerp=0; iLerp<2; iLerp++)
+  {
+    // lerped frames are taken a bit off the middle, so both frames matter
+    rm.rm_fRatio = iLerp ? 0.3f : 0.0f;
+
+    // unpack every frame with both kernel sets and compare results
+    FLOAT fMaxError = 0.0f;
+    SLONG slMaxShadeError = 0;
+    FLOAT fMaxFixedDiff = 0.0f;
+    for( INDEX iFrame=0; iFrame<ctFrames; iFrame++) {
+      SetBenchmarkFrames( rm, iFrame, iLerp ? (iFrame+1)%ctFrames : iFrame);
+      for( INDEX iKernel=0; iKernel<2; iKernel++) {
+        pvtxMipBase = &aavtx[iKernel][0];
+        pnorMipBase = &aanor[iKernel][0];
+        pcolMipBase = &aacol[iKernel][0];
+        UnpackVertices( rm, TRUE, iKernel==1);
+      }
+      const SWORD *pswShade0 = (const SWORD*)&aacol[0][_ctAllMipVx>>1];
+      const SWORD *pswShade1 = (const SWORD*)&aacol[1][_ctAllMipVx>>1];
+      for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
+        // reference kernels may keep more precision in registers, so allow for rounding differences
+        const GFXVertex3 &vtx0 = aavtx[0][iMipVx];  const GFXVertex3 &vtx1 = aavtx[1][iMipVx];
+        const GFXNormal3 &nor0 = aanor[0][iMipVx];  const GFXNormal3 &nor1 = aanor[1][iMipVx];
+        fMaxError = Max( fMaxError, Abs(vtx0.x-vtx1.x) / (1.0f+Abs(vtx0.x)));
+        fMaxError = Max( fMaxError, Abs(vtx0.y-vtx1.y) / (1.0f+Abs(vtx0.y)));
+        fMaxError = Max( fMaxError, Abs(vtx0.z-vtx1.z) / (1.0f+Abs(vtx0.z)));
+        fMaxError = Max( fMaxError, Abs(nor0.nx-nor1.nx));
+        fMaxError = Max( fMaxError, Abs(nor0.ny-nor1.ny));
+        fMaxError = Max( fMaxError, Abs(nor0.nz-nor1.nz));
+        slMaxShadeError = Max( slMaxShadeError, (SLONG)Abs( pswShade0[iMipVx]-pswShade1[iMipVx]));
+        // positions differ from former fixed point lerp by up to one compression step
+        const FLOAT3D vFixed = GetFixedLerpedPoint( rm, _puwMipToMdl[iMipVx]);
+        fMaxFixedDiff = Max( fMaxFixedDiff, Abs(vtx0.x-vFixed(1)));
+        fMaxFixedDiff = Max( fMaxFixedDiff, Abs(vtx0.y-vFixed(2)));
+        fMaxFixedDiff = Max( fMaxFixedDiff, Abs(vtx0.z-vFixed(3)));
+      }
+    }
 
+    // time both kernel sets
+    DOUBLE adMs[2];
+    for( INDEX iKernel=0; iKernel<2; iKernel++) {
+      pvtxMipBase = &aavtx[iKernel][0];
+      pnorMipBase = &aanor[iKernel][0];
+      pcolMipBase = &aacol[iKernel][0];
+      CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+      for( INDEX iPass=0; iPass<ctPasses; iPass++) {
+        for( INDEX iFrame=0; iFrame<ctFrames; iFrame++) {
+          SetBenchmarkFrames( rm, iFrame, iLerp ? (iFrame+1)%ctFrames : iFrame);
+          UnpackVertices( rm, TRUE, iKernel==1);
+        }
+      }
+      CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+      adMs[iKernel] = (tv1-tv0).GetSeconds()*1000 / ctPasses;
+    }
+    const BOOL bSame = fMaxError<0.0001f && slMaxShadeError<=1;
+    CPrintF( "%-10s %10.3f %10.3f %7.2fx %10g %6d %10g %s\n", iLerp ? "lerped" : "single", adMs[0], adMs[1],
+             adMs[1]>0 ? adMs[0]/adMs[1] : 0.0, fMaxError, slMaxShadeError, fMaxFixedDiff, bSame ? "" : "MISMATCH!");
+  }
 
+  // mip arrays will be set again when next model is rendered
+  pvtxMipBase = NULL;
+  pnorMipBase = NULL;
+  pcolMipBase = NULL;
+  _ctAllMipVx = 0;
+  _pModelStock->Release(pmd);
+}
+void ModelUnpackBenchmarkCfunc(void *pArgs)
+{
+  CTString strModel = *NEXTARGUMENT(CTString*);
+  ModelUnpackBenchmark(CTFileName(strModel));
+}
 
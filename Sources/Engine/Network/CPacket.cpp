@@ -20,9 +20,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Math/Functions.h>
 #include <Engine/Base/Lists.h>
 #include <Engine/Base/Memory.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Synchronization.h>
 #include <Engine/Network/CPacket.h>
 
 #include <Engine/Base/Listiterator.inl>
+#include <Engine/Templates/StaticStackArray.cpp>
 
 // should the packet transfers in/out of the buffer be reported to the console
 extern INDEX net_bReportPackets;
@@ -32,6 +35,10 @@ extern FLOAT net_fSendRetryWait;
 #define MAX_RETRIES 10
 #define RETRY_INTERVAL 3.0f
 
+// maximum number of free packets kept for reuse
+#define MAX_POOLED_PACKETS 1024
+extern INDEX net_bPacketPool;
+
 // make the address broadcast
 void CAddress::MakeBroadcast(void)
 {
@@ -43,6 +50,90 @@ void CAddress::MakeBroadcast(void)
 
 
 
+/*
+*
+*	CPacket pool
+*
+*/
+
+// free packets are linked through their first bytes
+class CPacketPool {
+public:
+  CTCriticalSection pp_csPool;  // packets are created and deleted from several threads
+  void *pp_pvFirstFree;         // first free packet
+  INDEX pp_ctFree;              // number of free packets
+  BOOL pp_bDestroyed;           // set at exit, when packets go directly back to heap
+
+  CPacketPool(void) {
+    pp_csPool.cs_iIndex = -1;
+    pp_pvFirstFree = NULL;
+    pp_ctFree = 0;
+    pp_bDestroyed = FALSE;
+  };
+  ~CPacketPool(void) {
+    Clear();
+    pp_bDestroyed = TRUE;
+  };
+  void Clear(void) {
+    CTSingleLock slPool(&pp_csPool, TRUE);
+    while (pp_pvFirstFree!=NULL) {
+      void *pv = pp_pvFirstFree;
+      pp_pvFirstFree = *(void**)pv;
+      FreeMemory(pv);
+    }
+    pp_ctFree = 0;
+  };
+};
+static CPacketPool _ppPool;
+
+// take a packet from the pool, or allocate it if pool is empty
+void *CPacket::operator new(size_t size)
+{
+  ASSERT(size==sizeof(CPacket));
+  if (!_ppPool.pp_bDestroyed) {
+    CTSingleLock slPool(&_ppPool.pp_csPool, TRUE);
+    void *pv = _ppPool.pp_pvFirstFree;
+    if (pv!=NULL) {
+      _ppPool.pp_pvFirstFree = *(void**)pv;
+      _ppPool.pp_ctFree--;
+      return pv;
+    }
+  }
+  return AllocMemory(size);
+};
+
+// put a packet back in the pool, or free it if pool is full
+void CPacket::operator delete(void *pv)
+{
+  if (pv==NULL) {
+    return;
+  }
+  if (!_ppPool.pp_bDestroyed && net_bPacketPool) {
+    CTSingleLock slPool(&_ppPool.pp_csPool, TRUE);
+    if (_ppPool.pp_ctFree<MAX_POOLED_PACKETS) {
+      *(void**)pv = _ppPool.pp_pvFirstFree;
+      _ppPool.pp_pvFirstFree = pv;
+      _ppPool.pp_ctFree++;
+      return;
+    }
+  }
+  FreeMemory(pv);
+};
+
+// free all packets in the pool
+void CPacket::ClearPool(void)
+{
+  _ppPool.Clear();
+};
+
+// get number of packets in the pool
+INDEX CPacket::GetPoolCount(void)
+{
+  return _ppPool.pp_ctFree;
+};
+
+
+
 /*
 *
 *	CPacket class implementation
@@ -81,6 +172,7 @@ void CPacket::Clear()
 
 	pa_tvSendWhen = CTimerValue(0.0f);
 	if(pa_lnListNode.IsLinked()) pa_lnListNode.Remove();
+	if(pa_lnSequenceNode.IsLinked()) pa_lnSequenceNode.Remove();
 
 };
 
@@ -146,14 +238,28 @@ BOOL CPacket::WriteToPacket(void* pv,SLONG slSize,UBYTE ubReliable,ULONG ulSeque
 
 // Takes data from a pointer, reads the packet header and copies the data to the packet
 BOOL CPacket::WriteToPacketRaw(void* pv,SLONG slSize) 
+{
+	ASSERT(slSize <= MAX_PACKET_SIZE && slSize > 0);
+	ASSERT(pv != NULL);
+
+	// transfer the data to the packet
+	memcpy(pa_pubPacketData,pv,slSize);
+
+	// get the packet properties from the data
+	return ReadRawHeader(slSize);
+
+};
+
+
+// Reads the packet header from raw data that was received directly into the packet
+BOOL CPacket::ReadRawHeader(SLONG slSize) 
 {
 	UBYTE* pubData;
 
 	ASSERT(slSize <= MAX_PACKET_SIZE && slSize > 0);
-	ASSERT(pv != NULL);
 
-	// get the packet properties from the pointer, and set the values
-	pubData = (UBYTE*)pv;
+	// get the packet properties from the data, and set the values
+	pubData = pa_pubPacketData;
 	pa_ubReliable = *pubData;
 	pubData++;
 	pa_ulSequence = *(ULONG*)pubData;
@@ -165,9 +271,6 @@ BOOL CPacket::WriteToPacketRaw(void* pv,SLONG slSize)
 
 	pa_slSize = slSize;
 
-	// transfer the data to the packet
-	memcpy(pa_pubPacketData,pv,pa_slSize);
-
 	return TRUE;
 
 };
@@ -248,6 +351,9 @@ void CPacket::Drop()
 	if (pa_lnListNode.IsLinked()) {
 		pa_lnListNode.Remove();
 	}
+	if (pa_lnSequenceNode.IsLinked()) {
+		pa_lnSequenceNode.Remove();
+	}
 };
 
 SLONG CPacket::GetTransferSize() 
@@ -332,6 +438,9 @@ void CPacketBuffer::Clear()
 {
 
 	pb_lhPacketStorage.Clear();
+	for (INDEX iBucket=0; iBucket<PACKET_SEQUENCE_BUCKETS; iBucket++) {
+		pb_alhSequences[iBucket].Clear();
+	}
 	
 	pb_ulNumOfPackets = 0;
 	pb_ulNumOfReliablePackets = 0;
@@ -376,6 +485,32 @@ CTimerValue CPacketBuffer::GetPacketSendTime(SLONG slSize) {
 	return tvSendTime;
 };
 
+// Find first packet with given sequence that was added to the buffer
+CPacket* CPacketBuffer::FindPacket(ULONG ulSequence)
+{
+	FOREACHINLIST(CPacket,pa_lnSequenceNode,SequenceBucket(ulSequence),litPacketIter) {
+		if (litPacketIter->pa_ulSequence == ulSequence) {
+			return litPacketIter;
+		}
+	}
+	return NULL;
+};
+
+// Unlink a packet from the buffer and update buffer counters
+void CPacketBuffer::Unlink(CPacket &paPacket)
+{
+	paPacket.pa_lnListNode.Remove();
+	paPacket.pa_lnSequenceNode.Remove();
+
+	pb_ulNumOfPackets--;
+	if (paPacket.pa_ubReliable & UDP_PACKET_RELIABLE) {
+		pb_ulNumOfReliablePackets--;
+	}
+
+	// update the total size of data stored in the buffer
+	pb_ulTotalSize -= (paPacket.pa_slSize - MAX_HEADER_SIZE);
+};
+
 // Adds the packet to the end of the list
 BOOL CPacketBuffer::AppendPacket(CPacket &paPacket,BOOL bDelay) 
 {
@@ -390,6 +525,7 @@ BOOL CPacketBuffer::AppendPacket(CPacket &paPacket,BOOL bDelay)
 
 	// Add the packet to the end of the list
 	pb_lhPacketStorage.AddTail(paPacket.pa_lnListNode);
+	SequenceBucket(paPacket.pa_ulSequence).AddTail(paPacket.pa_lnSequenceNode);
 	pb_ulNumOfPackets++;
 
 	// if the packet is reliable, bump up the number of reliable packets
@@ -407,49 +543,41 @@ BOOL CPacketBuffer::AppendPacket(CPacket &paPacket,BOOL bDelay)
 BOOL CPacketBuffer::InsertPacket(CPacket &paPacket,BOOL bDelay) 
 {
 	
-	// find the right place to insert this packet (this is if this packet is out of sequence)
-	FOREACHINLIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
-		// if there is a packet in the buffer with greater sequence number, insert this one before it
-		if (paPacket.pa_ulSequence < litPacketIter->pa_ulSequence) {
-
-			// bDelay regulates if the packet should be delayed because of the bandwidth limits or not
-			// internal buffers (reliable, waitack and master buffers) do not pay attention to bandwidth limits
-			if (bDelay) {
-				paPacket.pa_tvSendWhen = GetPacketSendTime(paPacket.pa_slSize);
-			} else {
-				paPacket.pa_tvSendWhen = _pTimer->GetHighPrecisionTimer();
-			}
-
-			litPacketIter.InsertBeforeCurrent(paPacket.pa_lnListNode);
-			pb_ulNumOfPackets++;
-
-			// if the packet is reliable, bump up the number of reliable packets
-			if (paPacket.pa_ubReliable & UDP_PACKET_RELIABLE) {
-				pb_ulNumOfReliablePackets++;
-			}
-
-			// update the total size of data stored in the buffer
-			pb_ulTotalSize += paPacket.pa_slSize - MAX_HEADER_SIZE;
-
-      
-			return TRUE;
+	// if there already is a packet in the buffer with the same sequence, do nothing
+	if (FindPacket(paPacket.pa_ulSequence) != NULL) {
+		return FALSE;
+	}
 
-		// if there already is a packet in the buffer with the same sequence, do nothing
-		} else if (paPacket.pa_ulSequence == litPacketIter->pa_ulSequence) {
-			return FALSE;
+	// find the last packet with lower sequence, searching from the tail 
+	// (packets mostly arrive in order, so this is usually the tail itself)
+	CListNode *plnAfter = &pb_lhPacketStorage.IterationTail();
+	while (!plnAfter->IsHeadMarker()) {
+		CPacket *ppaInList = (CPacket *) ((UBYTE *)plnAfter - offsetof(CPacket, pa_lnListNode));
+		if (ppaInList->pa_ulSequence < paPacket.pa_ulSequence) {
+			break;
 		}
+		plnAfter = &plnAfter->IterationPred();
 	}
 
-	// if this packet has the greatest sequence number so far, add it to the end of the list
-	pb_lhPacketStorage.AddTail(paPacket.pa_lnListNode);
+	// bDelay regulates if the packet should be delayed because of the bandwidth limits or not
+	// internal buffers (reliable, waitack and master buffers) do not pay attention to bandwidth limits
+	if (bDelay) {
+		paPacket.pa_tvSendWhen = GetPacketSendTime(paPacket.pa_slSize);
+	} else {
+		paPacket.pa_tvSendWhen = _pTimer->GetHighPrecisionTimer();
+	}
+
+	// insert this packet after it
+	plnAfter->IterationInsertAfter(paPacket.pa_lnListNode);
+	SequenceBucket(paPacket.pa_ulSequence).AddTail(paPacket.pa_lnSequenceNode);
 	pb_ulNumOfPackets++;
 
-  
 	// if the packet is reliable, bump up the number of reliable packets
 	if (paPacket.pa_ubReliable & UDP_PACKET_RELIABLE) {
 		pb_ulNumOfReliablePackets++;
 	}
 
+	// update the total size of data stored in the buffer
 	pb_ulTotalSize += paPacket.pa_slSize - MAX_HEADER_SIZE;
 
 	return TRUE;
@@ -484,14 +612,7 @@ CPacket* CPacketBuffer::GetFirstPacket()
 	CPacket* ppaHead = LIST_HEAD(pb_lhPacketStorage,CPacket,pa_lnListNode);
 
 	// remove the first packet from the start of the list
-	pb_lhPacketStorage.RemHead();
-	pb_ulNumOfPackets--;
-	if (ppaHead->pa_ubReliable & UDP_PACKET_RELIABLE) {
-		pb_ulNumOfReliablePackets--;
-	}
-
-	// update the total size of data stored in the buffer
-	pb_ulTotalSize -= (ppaHead->pa_slSize - MAX_HEADER_SIZE);
+	Unlink(*ppaHead);
 
 	// mark the last packet sequence that was output from the buffer - helps to prevent problems wit duplicated packets	
 	if (pb_ulLastSequenceOut < ppaHead->pa_ulSequence) {
@@ -505,49 +626,25 @@ CPacket* CPacketBuffer::GetFirstPacket()
 // Reads the data from the packet with the requested sequence, but does not remove it
 CPacket* CPacketBuffer::PeekPacket(ULONG ulSequence)
 {
-	FOREACHINLIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
-		if (litPacketIter->pa_ulSequence == ulSequence) {
-			return litPacketIter;
-		}
-	}
-	return NULL;
+	return FindPacket(ulSequence);
 };
 
 // Returns te packet with the matching sequence from the buffer
 CPacket* CPacketBuffer::GetPacket(ULONG ulSequence)
 {
 	
-	FOREACHINLIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
-		if (litPacketIter->pa_ulSequence == ulSequence) {
-			litPacketIter->pa_lnListNode.Remove();
-
-			pb_ulNumOfPackets--;
-			if (litPacketIter->pa_ubReliable & UDP_PACKET_RELIABLE) {
-				pb_ulNumOfReliablePackets--;
-			}
-
-			// update the total size of data stored in the buffer
-			pb_ulTotalSize -= (litPacketIter->pa_slSize - MAX_HEADER_SIZE);
-
-			return litPacketIter;
-		}
+	CPacket *ppaPacket = FindPacket(ulSequence);
+	if (ppaPacket != NULL) {
+		Unlink(*ppaPacket);
 	}
-	return NULL;
+	return ppaPacket;
 };
 
 // Reads the first connection request packet from the buffer
 CPacket* CPacketBuffer::GetConnectRequestPacket() {
 		FOREACHINLIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
 		if (litPacketIter->pa_ubReliable & UDP_PACKET_CONNECT_REQUEST) {
-			litPacketIter->pa_lnListNode.Remove();
-
-			pb_ulNumOfPackets--;
-			// connect request packets are allways reliable
-			pb_ulNumOfReliablePackets--;
-
-			// update the total size of data stored in the buffer
-			pb_ulTotalSize -= (litPacketIter->pa_slSize - MAX_HEADER_SIZE);
-
+			Unlink(*litPacketIter);
 			return litPacketIter;
 		}
 	}
@@ -559,19 +656,11 @@ BOOL CPacketBuffer::RemoveFirstPacket(BOOL bDelete) {
 	ASSERT(pb_ulNumOfPackets > 0);
 	CPacket *lnHead = LIST_HEAD(pb_lhPacketStorage,CPacket,pa_lnListNode);
 
-	pb_ulNumOfPackets--;
-	if (lnHead->pa_ubReliable & UDP_PACKET_RELIABLE) {
-		pb_ulNumOfReliablePackets--;
-	}
-
-	// update the total size of data stored in the buffer
-	pb_ulTotalSize -= (lnHead->pa_slSize - MAX_HEADER_SIZE);
-
 	if (pb_ulLastSequenceOut < lnHead->pa_ulSequence) {
 		pb_ulLastSequenceOut = lnHead->pa_ulSequence;		
 	}
 
-	pb_lhPacketStorage.RemHead();
+	Unlink(*lnHead);
 	if (bDelete) {
 		delete lnHead;
 	}
@@ -582,18 +671,10 @@ BOOL CPacketBuffer::RemoveFirstPacket(BOOL bDelete) {
 BOOL CPacketBuffer::RemovePacket(ULONG ulSequence,BOOL bDelete)
 {
 //	ASSERT(pb_ulNumOfPackets > 0);
-	FORDELETELIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
+	// remove all packets with that sequence
+	FORDELETELIST(CPacket,pa_lnSequenceNode,SequenceBucket(ulSequence),litPacketIter) {
 		if (litPacketIter->pa_ulSequence == ulSequence) {
-			litPacketIter->pa_lnListNode.Remove();
-			
-			pb_ulNumOfPackets--;
-			if (litPacketIter->pa_ubReliable & UDP_PACKET_RELIABLE) {
-				pb_ulNumOfReliablePackets--;
-			}
-
-			// update the total size of data stored in the buffer
-			pb_ulTotalSize -= (litPacketIter->pa_slSize - MAX_HEADER_SIZE);
-
+			Unlink(*litPacketIter);
 			if (bDelete) {
 				delete litPacketIter;
 			}
@@ -606,16 +687,7 @@ BOOL CPacketBuffer::RemovePacket(ULONG ulSequence,BOOL bDelete)
 BOOL CPacketBuffer::RemoveConnectResponsePackets() {
 		FORDELETELIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
 		if (litPacketIter->pa_ubReliable & UDP_PACKET_CONNECT_RESPONSE) {
-			litPacketIter->pa_lnListNode.Remove();
-
-			pb_ulNumOfPackets--;
-			
-			// connect request packets are allways reliable
-			pb_ulNumOfReliablePackets--;
-
-			// update the total size of data stored in the buffer
-			pb_ulTotalSize -= (litPacketIter->pa_slSize - MAX_HEADER_SIZE);
-
+			Unlink(*litPacketIter);
 			delete litPacketIter;
 		}
 	}
@@ -641,15 +713,10 @@ ULONG CPacketBuffer::GetLastSequence()
 
 };
 
-// Removes the packet with the requested sequence from the buffer
+// Is the packet with the given sequence in the buffer?
 BOOL CPacketBuffer::IsSequenceInBuffer(ULONG ulSequence)
 {
-	FOREACHINLIST(CPacket,pa_lnListNode,pb_lhPacketStorage,litPacketIter) {
-		if (litPacketIter->pa_ulSequence == ulSequence) {
-			return TRUE;
-		}
-	}
-	return FALSE;
+	return FindPacket(ulSequence) != NULL;
 };
 
 
@@ -697,3 +764,149 @@ BOOL CPacketBuffer::CheckSequence(SLONG &slSize)
 
 
 
+
+
+
+/*
+*
+*	CPacketBuffer stress test
+*
+*/
+
+// one packet arrival in a simulated packet trace
+struct PacketArrival {
+  INDEX pa_iTime;         // tick when the packet arrives
+  ULONG pa_ulSequence;    // sequence of the packet
+};
+
+static int qsort_CompareArrivals(const void *ppv0, const void *ppv1)
+{
+  const PacketArrival &pa0 = *(const PacketArrival *)ppv0;
+  const PacketArrival &pa1 = *(const PacketArrival *)ppv1;
+  if (pa0.pa_iTime<pa1.pa_iTime) return -1;
+  if (pa0.pa_iTime>pa1.pa_iTime) return +1;
+  if (pa0.pa_ulSequence<pa1.pa_ulSequence) return -1;
+  if (pa0.pa_ulSequence>pa1.pa_ulSequence) return +1;
+  return 0;
+}
+
+// check that packets in buffer are sorted and that counters match them
+static BOOL CheckPacketBuffer(CPacketBuffer &pb, BOOL bSorted)
+{
+  ULONG ctPackets = 0;
+  ULONG ulLastSequence = 0;
+  FOREACHINLIST(CPacket,pa_lnListNode,pb.pb_lhPacketStorage,litPacketIter) {
+    if (bSorted && ctPackets>0 && litPacketIter->pa_ulSequence<=ulLastSequence) {
+      return FALSE;
+    }
+    if (pb.PeekPacket(litPacketIter->pa_ulSequence)==NULL) {
+      return FALSE;
+    }
+    ulLastSequence = litPacketIter->pa_ulSequence;
+    ctPackets++;
+  }
+  return ctPackets==pb.pb_ulNumOfPackets;
+}
+
+// replay a lossy, reordered packet trace through wait-ack and input buffers
+void PacketBufferStressTest(INDEX ctPackets, INDEX iLossPercent)
+{
+  ctPackets = Clamp(ctPackets, 100L, 1000000L);
+  const FLOAT fLoss = Clamp(iLossPercent, 0L, 90L)/100.0f;
+  const INDEX iReorderWindow = 256;   // max extra delay of a packet, in ticks
+  const INDEX iRetryDelay = 300;      // delay before lost packet is resent, in ticks
+  const FLOAT fDuplicate = 0.02f;
+
+  // generate the trace - each packet is sent at tick of its sequence
+  ULONG ulSeed = 0x2F6B1D3;
+  #define NEXTRANDOM() (ulSeed = ulSeed*1103515245+12345, FLOAT((ulSeed>>8)&0xFFFF)/65536.0f)
+  CStaticStackArray<PacketArrival> apaTrace;
+  INDEX iPacket;
+  for (iPacket=0; iPacket<ctPackets; iPacket++) {
+    INDEX iSent = iPacket;
+    while (NEXTRANDOM()<fLoss) {
+      iSent += iRetryDelay;
+    }
+    PacketArrival &pa = apaTrace.Push();
+    pa.pa_iTime = iSent + INDEX(NEXTRANDOM()*iReorderWindow);
+    pa.pa_ulSequence = iPacket+1;
+    if (NEXTRANDOM()<fDuplicate) {
+      PacketArrival &paDup = apaTrace.Push();
+      paDup.pa_iTime = iSent + INDEX(NEXTRANDOM()*iReorderWindow);
+      paDup.pa_ulSequence = iPacket+1;
+    }
+  }
+  #undef NEXTRANDOM
+  qsort(&apaTrace[0], apaTrace.Count(), sizeof(PacketArrival), qsort_CompareArrivals);
+
+  UBYTE aubPayload[64];
+  memset(aubPayload, 0xA5, sizeof(aubPayload));
+  CPacketBuffer pbWaitAck;
+  CPacketBuffer pbInput;
+  ULONG ulNextExpected = 1;
+  INDEX ctDuplicates = 0;
+  ULONG ctMaxWaitAck = 0;
+  ULONG ctMaxInput = 0;
+  BOOL bOk = TRUE;
+
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  INDEX iArrival = 0;
+  for (INDEX iTick=0; iArrival<apaTrace.Count(); iTick++) {
+    // send the packet for this tick and wait for its acknowledge
+    if (iTick<ctPackets) {
+      CPacket *ppaSent = new CPacket;
+      ppaSent->WriteToPacket(aubPayload, sizeof(aubPayload), UDP_PACKET_RELIABLE, iTick+1, 1, sizeof(aubPayload));
+      pbWaitAck.AppendPacket(*ppaSent, FALSE);
+    }
+    // receive everything that arrives at this tick
+    for (; iArrival<apaTrace.Count() && apaTrace[iArrival].pa_iTime<=iTick; iArrival++) {
+      ULONG ulSequence = apaTrace[iArrival].pa_ulSequence;
+      // acknowledge it
+      pbWaitAck.RemovePacket(ulSequence, TRUE);
+      // drop duplicates
+      if (ulSequence<ulNextExpected || pbInput.IsSequenceInBuffer(ulSequence)) {
+        ctDuplicates++;
+        continue;
+      }
+      CPacket *ppaReceived = new CPacket;
+      ppaReceived->WriteToPacket(aubPayload, sizeof(aubPayload), UDP_PACKET_RELIABLE, ulSequence, 1, sizeof(aubPayload));
+      if (!pbInput.InsertPacket(*ppaReceived, FALSE)) {
+        delete ppaReceived;
+        bOk = FALSE;
+      }
+      // consume all packets that are in order
+      while (pbInput.pb_ulNumOfPackets>0 && pbInput.GetFirstSequence()==ulNextExpected) {
+        delete pbInput.GetFirstPacket();
+        ulNextExpected++;
+      }
+    }
+    ctMaxWaitAck = Max(ctMaxWaitAck, pbWaitAck.pb_ulNumOfPackets);
+    ctMaxInput = Max(ctMaxInput, pbInput.pb_ulNumOfPackets);
+    // check consistency of buffers now and then
+    if ((iTick&1023)==0) {
+      bOk = bOk && CheckPacketBuffer(pbWaitAck, TRUE) && CheckPacketBuffer(pbInput, TRUE);
+    }
+  }
+  DOUBLE dSeconds = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+
+  // everything must have been received in order and acknowledged
+  bOk = bOk && ulNextExpected==ULONG(ctPackets+1) && pbWaitAck.IsEmpty() && pbInput.IsEmpty();
+  CPrintF("Packet buffer stress test: %d packets, %d%% loss, %d duplicates\n", ctPackets, iLossPercent, ctDuplicates);
+  CPrintF("  max wait-ack buffer: %d, max input buffer: %d\n", ctMaxWaitAck, ctMaxInput);
+  CPrintF("  %.1f ms (%.2f us per packet) - %s\n", dSeconds*1000, dSeconds*1E6/apaTrace.Count(),
+    bOk ? "OK" : "FAILED!");
+
+  // free what is left in case of failure
+  while (pbWaitAck.pb_ulNumOfPackets>0) {
+    delete pbWaitAck.GetFirstPacket();
+  }
+  while (pbInput.pb_ulNumOfPackets>0) {
+    delete pbInput.GetFirstPacket();
+  }
+}
+void PacketBufferStressTestCfunc(void *pArgs)
+{
+  INDEX ctPackets = NEXTARGUMENT(INDEX);
+  INDEX iLossPercent = NEXTARGUMENT(INDEX);
+  PacketBufferStressTest(ctPackets, iLossPercent);
+}
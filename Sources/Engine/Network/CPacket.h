@@ -75,6 +75,7 @@ public:
 	UBYTE pa_pubPacketData[MAX_PACKET_SIZE];		// Packet header + actual data contained in the packet
 
 	CListNode pa_lnListNode;					// used to create a linked list of packets - buffer
+	CListNode pa_lnSequenceNode;			// used to find the packet by its sequence in a buffer
 
   CAddress pa_adrAddress;				// packet address, port and client ID
   																
@@ -83,6 +84,14 @@ public:
 	CPacket(CPacket &paOriginal);		// Copy constructor
 	~CPacket() { Clear(); }
 
+	// packets are recycled through a pool of free packets instead of the heap
+	void *operator new(size_t size);
+	void operator delete(void *pv);
+	// free all packets in the pool
+	static void ClearPool(void);
+	// get number of packets in the pool
+	static INDEX GetPoolCount(void);
+
 	// Reset all packet data and free allocated memory
 	void Clear();
 
@@ -90,6 +99,8 @@ public:
 	BOOL WriteToPacket(void* pv,SLONG slSize,UBYTE ubReliable,ULONG ulSequence,UWORD uwClientID,SLONG slTransferSize);
 	// Write raw data to the packet and extract header data from the data
 	BOOL WriteToPacketRaw(void* pv,SLONG slSize);
+	// Extract header data from raw data already received into the packet
+	BOOL ReadRawHeader(SLONG slSize);
 	// Read data from the packet (no header data)
 	BOOL ReadFromPacket(void* pv,SLONG &slExpectedSize);
 
@@ -133,12 +144,16 @@ public:
 };
 
 
+// number of hash buckets for finding packets by sequence (must be power of two)
+#define PACKET_SEQUENCE_BUCKETS 64
+
 class CPacketBuffer {
 public:
 	ULONG pb_ulTotalSize;						// Total size of data in packets stored in this buffer (no headers)
 	ULONG pb_ulLastSequenceOut;			// Sequence number of the last packet taken out of the buffer
 	
 	CListHead pb_lhPacketStorage;
+	CListHead pb_alhSequences[PACKET_SEQUENCE_BUCKETS];	// same packets, hashed by sequence number
 	
 	ULONG pb_ulNumOfPackets;					// Total number of packets currently in storage
 	ULONG pb_ulNumOfReliablePackets;	// Number of reliable packets in storage (0 if no reliable stream in progress)
@@ -157,6 +172,15 @@ public:
 	// Calculate when the packet can be output from the buffer
 	CTimerValue GetPacketSendTime(SLONG slSize);
 
+	// Get the hash bucket for packets with given sequence
+	inline CListHead &SequenceBucket(ULONG ulSequence) {
+		return pb_alhSequences[ulSequence&(PACKET_SEQUENCE_BUCKETS-1)];
+	};
+	// Find first packet with given sequence that was added to the buffer
+	CPacket* FindPacket(ULONG ulSequence);
+	// Unlink a packet from the buffer and update buffer counters
+	void Unlink(CPacket &paPacket);
+
 	// Adds a packet to the end of the packet buffer
 	BOOL AppendPacket(CPacket &paPacket,BOOL bDelay);
 	// Inserts the packet in the buffer, according to it's sequence number
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/ErrorReporting.h>
 #include <Engine/Base/ErrorTable.h>
 #include <Engine/Base/ProgressHook.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Base/Synchronization.h>
 #include <Engine/Base/Translation.h>
 
@@ -42,6 +43,7 @@ extern INDEX net_bReportICMPErrors;
 extern FLOAT net_fDropPackets;
 extern FLOAT net_tmConnectionTimeout;
 extern INDEX net_bReportPackets;
+extern INDEX net_bPacketPool;
 
 static struct ErrorCode ErrorCodes[] = {
   ERRORCODE(WSAEINTR          , "WSAEINTR"),
@@ -356,6 +358,8 @@ void CCommunicationInterface::Unprepare(void)
 
   cci_pbMasterInput.Clear();
 	cci_pbMasterOutput.Clear();
+  // release memory of packets kept for reuse
+  CPacket::ClearPool();
 
 
   cm_bNetworkInitialized = cci_bWinSockOpen;
@@ -1171,7 +1175,6 @@ BOOL CCommunicationInterface::Client_Update(void)
 void CCommunicationInterface::UpdateMasterBuffers() 
 {
 
-	UBYTE aub[MAX_PACKET_SIZE];
 	CAddress adrIncomingAddress;
 	SOCKADDR_IN sa;
 	int size = sizeof(sa);
@@ -1182,12 +1185,17 @@ void CCommunicationInterface::UpdateMasterBuffers()
 	CTimerValue tvNow;
 
 	if (cci_bBound) {
+		// receive directly into a pooled packet, that is reused until it is taken into the input buffer
+		ppaNewPacket = NULL;
 		// read from the socket while there is incoming data
 		do {
 
 			// initially, nothing is done
 			bSomethingDone = FALSE;
-			slSizeReceived = recvfrom(cci_hSocket,(char*)aub,MAX_PACKET_SIZE,0,(SOCKADDR *)&sa,&size);
+			if (ppaNewPacket==NULL) {
+				ppaNewPacket = new CPacket;
+			}
+			slSizeReceived = recvfrom(cci_hSocket,(char*)ppaNewPacket->pa_pubPacketData,MAX_PACKET_SIZE,0,(SOCKADDR *)&sa,&size);
 			tvNow = _pTimer->GetHighPrecisionTimer();
 
 			adrIncomingAddress.adr_ulAddress = ntohl(sa.sin_addr.s_addr);
@@ -1201,6 +1209,7 @@ void CCommunicationInterface::UpdateMasterBuffers()
 					if (iResult!=WSAECONNRESET || net_bReportICMPErrors) {
 						CPrintF(TRANS("Socket error during UDP receive. %s\n"), 
 							(const char*)GetSocketError(iResult));
+						delete ppaNewPacket;
 						return;
 					}
 				}
@@ -1219,8 +1228,7 @@ void CCommunicationInterface::UpdateMasterBuffers()
 				} else if (net_fDropPackets <= 0  || (FLOAT(rand())/RAND_MAX) > net_fDropPackets) {
 					// if no packet drop emulation (or the packet is not dropped), form the packet 
 					// and add it to the end of the UDP Master's input buffer
-					ppaNewPacket = new CPacket;
-					ppaNewPacket->WriteToPacketRaw(aub,slSizeReceived);
+					ppaNewPacket->ReadRawHeader(slSizeReceived);
 					ppaNewPacket->pa_adrAddress.adr_ulAddress = adrIncomingAddress.adr_ulAddress;
 					ppaNewPacket->pa_adrAddress.adr_uwPort = adrIncomingAddress.adr_uwPort;						
 
@@ -1229,6 +1237,7 @@ void CCommunicationInterface::UpdateMasterBuffers()
 					}
 
 					cci_pbMasterInput.AppendPacket(*ppaNewPacket,FALSE);
+					ppaNewPacket = NULL;
 					// there might be more to do
 					bSomethingDone = TRUE;
 				
@@ -1236,6 +1245,8 @@ void CCommunicationInterface::UpdateMasterBuffers()
 			}	
 
 		} while (bSomethingDone);
+		// return the unused packet to the pool
+		delete ppaNewPacket;
 	}
 
 	// write from the output buffer to the socket
@@ -1281,3 +1292,126 @@ void CCommunicationInterface::UpdateMasterBuffers()
 };
 
 
+// get time this thread spent on the cpu, in seconds
+static DOUBLE GetThreadCPUTime(void)
+{
+  FILETIME ftCreation, ftExit, ftKernel, ftUser;
+  if (!GetThreadTimes(GetCurrentThread(), &ftCreation, &ftExit, &ftKernel, &ftUser)) {
+    return 0.0;
+  }
+  __int64 llKernel = (__int64(ftKernel.dwHighDateTime)<<32)|ftKernel.dwLowDateTime;
+  __int64 llUser   = (__int64(ftUser  .dwHighDateTime)<<32)|ftUser  .dwLowDateTime;
+  return DOUBLE(llKernel+llUser)/10000000.0;
+}
+
+// send bursts of packets over loopback and receive them the way master socket does
+static INDEX LoopbackBenchmarkPass(SOCKET hSend, SOCKET hRecv, SOCKADDR_IN &saRecv,
+  INDEX ctPackets, SLONG slSize, DOUBLE &dSeconds, DOUBLE &dCPUSeconds)
+{
+  const INDEX ctBurst = 32;
+  UBYTE aubPayload[MAX_UDP_BLOCK_SIZE];
+  memset(aubPayload, 0x5A, sizeof(aubPayload));
+  CPacketBuffer pbInput;
+  CPacket *ppaNewPacket = NULL;
+  INDEX ctReceived = 0;
+
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  DOUBLE dCPU0 = GetThreadCPUTime();
+  for (INDEX iPacket=0; iPacket<ctPackets; iPacket+=ctBurst) {
+    // send a burst of packets
+    for (INDEX iBurst=0; iBurst<ctBurst; iBurst++) {
+      CPacket paSend;
+      paSend.WriteToPacket(aubPayload, slSize, UDP_PACKET_UNRELIABLE, iPacket+iBurst, 1, slSize);
+      sendto(hSend, (char*)paSend.pa_pubPacketData, paSend.pa_slSize, 0, (SOCKADDR *)&saRecv, sizeof(saRecv));
+    }
+    // receive everything that arrived into the input buffer
+    FOREVER {
+      if (ppaNewPacket==NULL) {
+        ppaNewPacket = new CPacket;
+      }
+      SOCKADDR_IN sa;
+      int size = sizeof(sa);
+      SLONG slSizeReceived = recvfrom(hRecv, (char*)ppaNewPacket->pa_pubPacketData, MAX_PACKET_SIZE, 0, (SOCKADDR *)&sa, &size);
+      if (slSizeReceived==SOCKET_ERROR) {
+        break;
+      }
+      if (slSizeReceived<=MAX_HEADER_SIZE) {
+        continue;
+      }
+      ppaNewPacket->ReadRawHeader(slSizeReceived);
+      ppaNewPacket->pa_adrAddress.adr_ulAddress = ntohl(sa.sin_addr.s_addr);
+      ppaNewPacket->pa_adrAddress.adr_uwPort = ntohs(sa.sin_port);
+      pbInput.AppendPacket(*ppaNewPacket, FALSE);
+      ppaNewPacket = NULL;
+      ctReceived++;
+    }
+    // consume the received packets
+    while (pbInput.pb_ulNumOfPackets>0) {
+      delete pbInput.GetFirstPacket();
+    }
+  }
+  delete ppaNewPacket;
+  dCPUSeconds = GetThreadCPUTime()-dCPU0;
+  dSeconds = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+  return ctReceived;
+}
+
+// measure packet throughput of the UDP receive path on a loopback socket pair
+void NetLoopbackBenchmark(INDEX ctPackets, INDEX iSize)
+{
+  ctPackets = Clamp(ctPackets, 1000L, 10000000L);
+  SLONG slSize = Clamp(iSize, 1L, (INDEX)MAX_UDP_BLOCK_SIZE);
+
+  WSADATA	winsockdata;
+  if (WSAStartup(MAKEWORD(1, 1), &winsockdata)!=0) {
+    CPrintF(TRANS("Cannot start winsock.\n"));
+    return;
+  }
+  // create receiving socket on any free loopback port, and a socket to send from
+  SOCKET hRecv = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  SOCKET hSend = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  SOCKADDR_IN saRecv;
+  memset(&saRecv, 0, sizeof(saRecv));
+  saRecv.sin_family = AF_INET;
+  saRecv.sin_port = 0;
+  saRecv.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int size = sizeof(saRecv);
+  ULONG ulArgNonBlocking = 1;
+  int iBufferSize = 1024*1024;
+  if (hRecv==INVALID_SOCKET || hSend==INVALID_SOCKET
+    || bind(hRecv, (SOCKADDR *)&saRecv, sizeof(saRecv))==SOCKET_ERROR
+    || getsockname(hRecv, (SOCKADDR *)&saRecv, &size)==SOCKET_ERROR
+    || ioctlsocket(hRecv, FIONBIO, &ulArgNonBlocking)==SOCKET_ERROR) {
+    CPrintF(TRANS("Cannot open loopback sockets (error %d).\n"), WSAGetLastError());
+  } else {
+    setsockopt(hRecv, SOL_SOCKET, SO_RCVBUF, (char*)&iBufferSize, sizeof(iBufferSize));
+    CPrintF(TRANS("Loopback benchmark: %d packets of %d bytes\n"), ctPackets, slSize);
+    // run with and without packet pool
+    INDEX bPacketPoolOld = net_bPacketPool;
+    for (INDEX iPass=0; iPass<2; iPass++) {
+      net_bPacketPool = (iPass==0);
+      if (!net_bPacketPool) {
+        CPacket::ClearPool();
+      }
+      DOUBLE dSeconds, dCPUSeconds;
+      INDEX ctReceived = LoopbackBenchmarkPass(hSend, hRecv, saRecv, ctPackets, slSize, dSeconds, dCPUSeconds);
+      CPrintF(TRANS("  %-14s %7d received, %9.0f packets/s, %6.2f us cpu per packet\n"),
+        net_bPacketPool ? TRANS("pooled:") : TRANS("heap:"), ctReceived,
+        dSeconds>0 ? ctReceived/dSeconds : 0.0, ctReceived>0 ? dCPUSeconds*1E6/ctReceived : 0.0);
+    }
+    net_bPacketPool = bPacketPoolOld;
+  }
+  if (hRecv!=INVALID_SOCKET) {
+    closesocket(hRecv);
+  }
+  if (hSend!=INVALID_SOCKET) {
+    closesocket(hSend);
+  }
+  WSACleanup();
+}
+void NetLoopbackBenchmarkCfunc(void *pArgs)
+{
+  INDEX ctPackets = NEXTARGUMENT(INDEX);
+  INDEX iSize = NEXTARGUMENT(INDEX);
+  NetLoopbackBenchmark(ctPackets, iSize);
+}
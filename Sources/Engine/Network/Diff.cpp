@@ -28,60 +28,134 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define DIFF_NEW  1   // copy from new file
 #define DIFF_XOR  2   // xor between an old block and a new block
 
-UBYTE *_pubOld = NULL;
-SLONG _slSizeOld = 0;
-UBYTE *_pubNew = NULL;
-SLONG _slSizeNew = 0;
-ULONG _ulCRC;
+struct EntityBlockInfo {
+  ULONG ebi_ulID;
+  SLONG ebi_slOffset;
+  SLONG ebi_slSize;
+};
+
+// index of old entity blocks, sorted by entity id
+struct EntityBlockIndex {
+  ULONG ebx_ulID;
+  INDEX ebx_iBlock;
+};
 
-CTStream *_pstrmOut;
+// state of one diff or undiff operation
+// (each call has its own, since diffs are made on snapshot thread while main thread undiffs)
+class CDiffContext {
+public:
+  UBYTE *dc_pubOld;
+  SLONG dc_slSizeOld;
+  UBYTE *dc_pubNew;
+  SLONG dc_slSizeNew;
+  ULONG dc_ulCRC;
+  CTStream *dc_pstrmOut;
+  CStaticStackArray<EntityBlockInfo> dc_aebiOld;
+  CStaticStackArray<EntityBlockInfo> dc_aebiNew;
+  CStaticStackArray<EntityBlockIndex> dc_aebxOld;
+
+  CDiffContext(void) {
+    dc_pubOld = NULL;
+    dc_slSizeOld = 0;
+    dc_pubNew = NULL;
+    dc_slSizeNew = 0;
+    dc_ulCRC = 0;
+    dc_pstrmOut = NULL;
+  };
+  ~CDiffContext(void) {
+    if (dc_pubOld!=NULL) {
+      FreeMemory(dc_pubOld);
+    }
+    if (dc_pubNew!=NULL) {
+      FreeMemory(dc_pubNew);
+    }
+  };
+};
 
 // emit one block copied from old file
-void EmitOld_t(SLONG slOffsetOld, SLONG slSizeOld)
+static void EmitOld_t(CDiffContext &dc, SLONG slOffsetOld, SLONG slSizeOld)
 {
-  (*_pstrmOut)<<UBYTE(DIFF_OLD);
-  (*_pstrmOut)<<slOffsetOld;
-  (*_pstrmOut)<<slSizeOld;
+  (*dc.dc_pstrmOut)<<UBYTE(DIFF_OLD);
+  (*dc.dc_pstrmOut)<<slOffsetOld;
+  (*dc.dc_pstrmOut)<<slSizeOld;
 }
 // emit one block copied from new file
-void EmitNew_t(SLONG slOffsetNew, SLONG slSizeNew)
+static void EmitNew_t(CDiffContext &dc, SLONG slOffsetNew, SLONG slSizeNew)
 {
-  (*_pstrmOut)<<UBYTE(DIFF_NEW);
-  (*_pstrmOut)<<slSizeNew;
-  (*_pstrmOut).Write_t(_pubNew+slOffsetNew, slSizeNew);
+  (*dc.dc_pstrmOut)<<UBYTE(DIFF_NEW);
+  (*dc.dc_pstrmOut)<<slSizeNew;
+  (*dc.dc_pstrmOut).Write_t(dc.dc_pubNew+slOffsetNew, slSizeNew);
 }
 
 // emit one block xor-ed between new and old file
-void EmitXor_t(SLONG slOffsetOld, SLONG slSizeOld, SLONG slOffsetNew, SLONG slSizeNew)
+static void EmitXor_t(CDiffContext &dc, SLONG slOffsetOld, SLONG slSizeOld, SLONG slOffsetNew, SLONG slSizeNew)
 {
   // xor it
   SLONG slSizeXor = Min(slSizeOld, slSizeNew);
-  UBYTE *pub0 = _pubOld+slOffsetOld;
-  UBYTE *pub1 = _pubNew+slOffsetNew;
+  UBYTE *pub0 = dc.dc_pubOld+slOffsetOld;
+  UBYTE *pub1 = dc.dc_pubNew+slOffsetNew;
   for (INDEX i=0; i<slSizeXor; i++) {
     *pub1++ ^= *pub0++;
   }
 
   // emit it
-  (*_pstrmOut)<<UBYTE(DIFF_XOR);
-  (*_pstrmOut)<<slOffsetOld;
-  (*_pstrmOut)<<slSizeOld;
-  (*_pstrmOut)<<slSizeNew;
-  (*_pstrmOut).Write_t(_pubNew+slOffsetNew, slSizeNew);
+  (*dc.dc_pstrmOut)<<UBYTE(DIFF_XOR);
+  (*dc.dc_pstrmOut)<<slOffsetOld;
+  (*dc.dc_pstrmOut)<<slSizeOld;
+  (*dc.dc_pstrmOut)<<slSizeNew;
+  (*dc.dc_pstrmOut).Write_t(dc.dc_pubNew+slOffsetNew, slSizeNew);
 }
 
-struct EntityBlockInfo {
-  ULONG ebi_ulID;
-  SLONG ebi_slOffset;
-  SLONG ebi_slSize;
-};
+static int qsort_CompareEntityBlockIndex(const void *pv0, const void *pv1)
+{
+  const EntityBlockIndex &ebx0 = *(const EntityBlockIndex*)pv0;
+  const EntityBlockIndex &ebx1 = *(const EntityBlockIndex*)pv1;
+  if      (ebx0.ebx_ulID<ebx1.ebx_ulID) return -1;
+  else if (ebx0.ebx_ulID>ebx1.ebx_ulID) return +1;
+  // keep blocks with same id in stream order, so first one is found as before
+  else return ebx0.ebx_iBlock-ebx1.ebx_iBlock;
+}
 
-CStaticStackArray<EntityBlockInfo> _aebiOld;
-CStaticStackArray<EntityBlockInfo> _aebiNew;
+// make sorted index of entity ids in old block
+static void MakeIndex(CDiffContext &dc)
+{
+  dc.dc_aebxOld.PopAll();
+  INDEX ctBlocks = dc.dc_aebiOld.Count();
+  if (ctBlocks==0) {
+    return;
+  }
+  EntityBlockIndex *pebx = dc.dc_aebxOld.Push(ctBlocks);
+  for(INDEX i=0; i<ctBlocks; i++) {
+    pebx[i].ebx_ulID   = dc.dc_aebiOld[i].ebi_ulID;
+    pebx[i].ebx_iBlock = i;
+  }
+  qsort(pebx, ctBlocks, sizeof(EntityBlockIndex), qsort_CompareEntityBlockIndex);
+}
+
+// find first entity block in old file with given id (-1 if none)
+static INDEX FindOldBlock(CDiffContext &dc, ULONG ulID)
+{
+  CStaticStackArray<EntityBlockIndex> &aebx = dc.dc_aebxOld;
+  // binary search for lowest entry with that id
+  INDEX iLo = 0;
+  INDEX iHi = aebx.Count();
+  while (iLo<iHi) {
+    INDEX iMid = (iLo+iHi)/2;
+    if (aebx[iMid].ebx_ulID<ulID) {
+      iLo = iMid+1;
+    } else {
+      iHi = iMid;
+    }
+  }
+  if (iLo<aebx.Count() && aebx[iLo].ebx_ulID==ulID) {
+    return aebx[iLo].ebx_iBlock;
+  }
+  return -1;
+}
 
 // make array of entity offsets in a block
-void MakeInfos(CStaticStackArray<EntityBlockInfo> &aebi, 
-               UBYTE *pubBlock, SLONG slSize, UBYTE *pubFirst, UBYTE *&pubEnd)
+static void MakeInfos(CStaticStackArray<EntityBlockInfo> &aebi, 
+                      UBYTE *pubBlock, SLONG slSize, UBYTE *pubFirst, UBYTE *&pubEnd)
 {
   // clear all offsets
   aebi.PopAll();
@@ -114,7 +188,7 @@ void MakeInfos(CStaticStackArray<EntityBlockInfo> &aebi,
 }
 
 // find first entity in given block
-UBYTE *FindFirstEntity(UBYTE *pubBlock, SLONG slSize)
+static UBYTE *FindFirstEntity(UBYTE *pubBlock, SLONG slSize)
 {
   UBYTE *pub = pubBlock;
   while (pub<pubBlock+slSize) {
@@ -134,52 +208,48 @@ UBYTE *FindFirstEntity(UBYTE *pubBlock, SLONG slSize)
   return NULL;
 }
 
-void MakeDiff_t(void)
+static void MakeDiff_t(CDiffContext &dc)
 {
   // write header with size of files
-  (*_pstrmOut).WriteID_t("DIFF");
-  (*_pstrmOut)<<_slSizeOld<<_slSizeNew<<_ulCRC;
+  (*dc.dc_pstrmOut).WriteID_t("DIFF");
+  (*dc.dc_pstrmOut)<<dc.dc_slSizeOld<<dc.dc_slSizeNew<<dc.dc_ulCRC;
 
   // find first entities in blocks
-  UBYTE *pubOldEnts = FindFirstEntity(_pubOld, _slSizeOld);
-  UBYTE *pubNewEnts = FindFirstEntity(_pubNew, _slSizeNew);
+  UBYTE *pubOldEnts = FindFirstEntity(dc.dc_pubOld, dc.dc_slSizeOld);
+  UBYTE *pubNewEnts = FindFirstEntity(dc.dc_pubNew, dc.dc_slSizeNew);
   if (pubOldEnts==NULL || pubNewEnts==NULL) {
     ThrowF_t(TRANS("Invalid stream for Diff!"));
   }
 
   // make arrays of entity offsets
   UBYTE *pubEntEndOld;
-  MakeInfos(_aebiOld, _pubOld, _slSizeOld, pubOldEnts, pubEntEndOld);
+  MakeInfos(dc.dc_aebiOld, dc.dc_pubOld, dc.dc_slSizeOld, pubOldEnts, pubEntEndOld);
   UBYTE *pubEntEndNew;
-  MakeInfos(_aebiNew, _pubNew, _slSizeNew, pubNewEnts, pubEntEndNew);
+  MakeInfos(dc.dc_aebiNew, dc.dc_pubNew, dc.dc_slSizeNew, pubNewEnts, pubEntEndNew);
+  // index old entities by id
+  MakeIndex(dc);
 
   // emit chunk before entities by xor
-  EmitXor_t(0, pubOldEnts-_pubOld, 0, pubNewEnts-_pubNew);
+  EmitXor_t(dc, 0, pubOldEnts-dc.dc_pubOld, 0, pubNewEnts-dc.dc_pubNew);
 
   // for each entity in new
-  for(INDEX ieibNew = 0; ieibNew<_aebiNew.Count(); ieibNew++) {
-    EntityBlockInfo &ebiNew = _aebiNew[ieibNew];
+  for(INDEX ieibNew = 0; ieibNew<dc.dc_aebiNew.Count(); ieibNew++) {
+    EntityBlockInfo &ebiNew = dc.dc_aebiNew[ieibNew];
     // find same in old file
-    INDEX ieibOld = -1;
-    for(INDEX i=0; i<_aebiOld.Count(); i++) {
-      if (_aebiOld[i].ebi_ulID==ebiNew.ebi_ulID) {
-        ieibOld = i;
-        break;
-      }
-    }
+    INDEX ieibOld = FindOldBlock(dc, ebiNew.ebi_ulID);
     BOOL bDone = FALSE;
 
     // if found
     if (ieibOld>=0) {
-      EntityBlockInfo &ebiOld = _aebiOld[ieibOld];
+      EntityBlockInfo &ebiOld = dc.dc_aebiOld[ieibOld];
 
       // if same
       if ( ebiOld.ebi_slSize==ebiNew.ebi_slSize) {
-        if (memcmp(_pubOld+ebiOld.ebi_slOffset, 
-        _pubNew+ebiNew.ebi_slOffset, ebiNew.ebi_slSize)==0) {
+        if (memcmp(dc.dc_pubOld+ebiOld.ebi_slOffset, 
+        dc.dc_pubNew+ebiNew.ebi_slOffset, ebiNew.ebi_slSize)==0) {
           //CPrintF("Same blocks\n");
           // emit copy from old
-          EmitOld_t(ebiOld.ebi_slOffset, ebiOld.ebi_slSize);
+          EmitOld_t(dc, ebiOld.ebi_slOffset, ebiOld.ebi_slSize);
           bDone = TRUE;
         } else {
           //CPrintF("Different blocks\n");
@@ -190,7 +260,7 @@ void MakeDiff_t(void)
 
       if (!bDone) {
         // emit xor
-        EmitXor_t(
+        EmitXor_t(dc,
           ebiOld.ebi_slOffset, ebiOld.ebi_slSize,
           ebiNew.ebi_slOffset, ebiNew.ebi_slSize);
         bDone = TRUE;
@@ -201,22 +271,22 @@ void MakeDiff_t(void)
     if (!bDone) 
     {
       // emit from new
-      EmitNew_t(ebiNew.ebi_slOffset, ebiNew.ebi_slSize);
+      EmitNew_t(dc, ebiNew.ebi_slOffset, ebiNew.ebi_slSize);
       bDone = TRUE;
     }
   }
 
   // emit chunk after entities by xor
-  EmitXor_t(
-    pubEntEndOld-_pubOld, _pubOld+_slSizeOld-pubEntEndOld,
-    pubEntEndNew-_pubNew, _pubNew+_slSizeNew-pubEntEndNew);
+  EmitXor_t(dc,
+    pubEntEndOld-dc.dc_pubOld, dc.dc_pubOld+dc.dc_slSizeOld-pubEntEndOld,
+    pubEntEndNew-dc.dc_pubNew, dc.dc_pubNew+dc.dc_slSizeNew-pubEntEndNew);
 }
 
-void UnDiff_t(void)
+static void UnDiff_t(CDiffContext &dc)
 {
   // start at beginning
-  UBYTE *pubOld = _pubOld;
-  UBYTE *pubNew = _pubNew;
+  UBYTE *pubOld = dc.dc_pubOld;
+  UBYTE *pubNew = dc.dc_pubNew;
   SLONG slSizeOldStream = 0;
   SLONG slSizeOutStream = 0;
   // get header with size of files
@@ -228,13 +298,13 @@ void UnDiff_t(void)
   slSizeOutStream = *(SLONG*)pubNew; pubNew+=sizeof(SLONG);
   ULONG ulCRC =  *(ULONG*)pubNew; pubNew+=sizeof(ULONG);
 
-  CRC_Start(_ulCRC);
+  CRC_Start(dc.dc_ulCRC);
 
-  if (slSizeOldStream!=_slSizeOld) {
+  if (slSizeOldStream!=dc.dc_slSizeOld) {
     ThrowF_t(TRANS("Invalid DIFF stream!"));
   }
   // while not end of diff file
-  while (pubNew<_pubNew+_slSizeNew) {
+  while (pubNew<dc.dc_pubNew+dc.dc_slSizeNew) {
     // read block type
     UBYTE ubType = *pubNew++;
     switch(ubType) {
@@ -244,16 +314,16 @@ void UnDiff_t(void)
       SLONG slOffsetOld = *(SLONG*)pubNew;  pubNew+=sizeof(SLONG);
       SLONG slSizeOld = *(SLONG*)pubNew;    pubNew+=sizeof(SLONG);
       // copy it from there
-      (*_pstrmOut).Write_t(_pubOld+slOffsetOld, slSizeOld);
-      CRC_AddBlock(_ulCRC, _pubOld+slOffsetOld, slSizeOld);
+      (*dc.dc_pstrmOut).Write_t(dc.dc_pubOld+slOffsetOld, slSizeOld);
+      CRC_AddBlock(dc.dc_ulCRC, dc.dc_pubOld+slOffsetOld, slSizeOld);
                    } break;
     // if block type is 'copy from new file'
     case DIFF_NEW: {
       // get data size
       SLONG slSizeNew = *(SLONG*)pubNew;    pubNew+=sizeof(SLONG);
       // copy it from there
-      (*_pstrmOut).Write_t(pubNew, slSizeNew);
-      CRC_AddBlock(_ulCRC, pubNew, slSizeNew);
+      (*dc.dc_pstrmOut).Write_t(pubNew, slSizeNew);
+      CRC_AddBlock(dc.dc_ulCRC, pubNew, slSizeNew);
       pubNew+=slSizeNew;
                    } break;
     // if block type is 'xor between an old block and a new block'
@@ -265,15 +335,15 @@ void UnDiff_t(void)
 
       // xor it
       SLONG slSizeXor = Min(slSizeOld, slSizeNew);
-      UBYTE *pub0 = _pubOld+slOffsetOld;
+      UBYTE *pub0 = dc.dc_pubOld+slOffsetOld;
       UBYTE *pub1 = pubNew;
       for (INDEX i=0; i<slSizeXor; i++) {
         *pub1++ ^= *pub0++;
       }
 
       // copy the xor-ed data
-      (*_pstrmOut).Write_t(pubNew, slSizeNew);
-      CRC_AddBlock(_ulCRC, pubNew, slSizeNew);
+      (*dc.dc_pstrmOut).Write_t(pubNew, slSizeNew);
+      CRC_AddBlock(dc.dc_ulCRC, pubNew, slSizeNew);
       pubNew+=slSizeNew;
                    } break;
     default:
@@ -281,83 +351,139 @@ void UnDiff_t(void)
     }
   }
 
-  CRC_Finish(_ulCRC);
-  if (_ulCRC!=ulCRC) {
+  CRC_Finish(dc.dc_ulCRC);
+  if (dc.dc_ulCRC!=ulCRC) {
     ThrowF_t(TRANS("CRC error in DIFF!"));
   }
 }
 
-static void Cleanup(void)
-{
-  if (_pubOld!=NULL) {
-    FreeMemory(_pubOld);
-  }
-
-  if (_pubNew!=NULL) {
-    FreeMemory(_pubNew);
-  }
-  _pubOld = NULL;
-  _pubNew = NULL;
-}
-
 // make a difference file from two saved games
 void DIFF_Diff_t(CTStream *pstrmOld, CTStream *pstrmNew, CTStream *pstrmDiff)
 {
-  try {
-    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
-
-    _slSizeOld = pstrmOld->GetStreamSize()-pstrmOld->GetPos_t();
-    _pubOld = (UBYTE*)AllocMemory(_slSizeOld);
-    pstrmOld->Read_t(_pubOld, _slSizeOld);
+  // buffers are freed with the context, also if an error is thrown
+  CDiffContext dc;
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
 
-    _slSizeNew = pstrmNew->GetStreamSize()-pstrmNew->GetPos_t();
-    _pubNew = (UBYTE*)AllocMemory(_slSizeNew);
-    pstrmNew->Read_t(_pubNew, _slSizeNew);
+  dc.dc_slSizeOld = pstrmOld->GetStreamSize()-pstrmOld->GetPos_t();
+  dc.dc_pubOld = (UBYTE*)AllocMemory(dc.dc_slSizeOld);
+  pstrmOld->Read_t(dc.dc_pubOld, dc.dc_slSizeOld);
 
-    CRC_Start(_ulCRC);
-    CRC_AddBlock(_ulCRC, _pubNew, _slSizeNew);
-    CRC_Finish(_ulCRC);
+  dc.dc_slSizeNew = pstrmNew->GetStreamSize()-pstrmNew->GetPos_t();
+  dc.dc_pubNew = (UBYTE*)AllocMemory(dc.dc_slSizeNew);
+  pstrmNew->Read_t(dc.dc_pubNew, dc.dc_slSizeNew);
 
-    _pstrmOut = pstrmDiff;
+  CRC_Start(dc.dc_ulCRC);
+  CRC_AddBlock(dc.dc_ulCRC, dc.dc_pubNew, dc.dc_slSizeNew);
+  CRC_Finish(dc.dc_ulCRC);
 
-    MakeDiff_t();
+  dc.dc_pstrmOut = pstrmDiff;
 
-    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
-    //CPrintF("diff encoded in %.2gs\n", (tv1-tv0).GetSeconds());
+  MakeDiff_t(dc);
 
-    Cleanup();
-
-  } catch (char *) {
-    Cleanup();
-    throw;
-  }
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+  //CPrintF("diff encoded in %.2gs\n", (tv1-tv0).GetSeconds());
 }
 
 // make a new saved game from difference file and old saved game
 void DIFF_Undiff_t(CTStream *pstrmOld, CTStream *pstrmDiff, CTStream *pstrmNew)
 {
-  try {
-    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  // buffers are freed with the context, also if an error is thrown
+  CDiffContext dc;
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+
+  dc.dc_slSizeOld = pstrmOld->GetStreamSize()-pstrmOld->GetPos_t();
+  dc.dc_pubOld = (UBYTE*)AllocMemory(dc.dc_slSizeOld);
+  pstrmOld->Read_t(dc.dc_pubOld, dc.dc_slSizeOld);
 
-    _slSizeOld = pstrmOld->GetStreamSize()-pstrmOld->GetPos_t();
-    _pubOld = (UBYTE*)AllocMemory(_slSizeOld);
-    pstrmOld->Read_t(_pubOld, _slSizeOld);
+  dc.dc_slSizeNew = pstrmDiff->GetStreamSize()-pstrmDiff->GetPos_t();
+  dc.dc_pubNew = (UBYTE*)AllocMemory(dc.dc_slSizeNew);
+  pstrmDiff->Read_t(dc.dc_pubNew, dc.dc_slSizeNew);
 
-    _slSizeNew = pstrmDiff->GetStreamSize()-pstrmDiff->GetPos_t();
-    _pubNew = (UBYTE*)AllocMemory(_slSizeNew);
-    pstrmDiff->Read_t(_pubNew, _slSizeNew);
+  dc.dc_pstrmOut = pstrmNew;
 
-    _pstrmOut = pstrmNew;
+  UnDiff_t(dc);
 
-    UnDiff_t();
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+  //CPrintF("diff decoded in %.2gs\n", (tv1-tv0).GetSeconds());
+}
 
-    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
-    //CPrintF("diff decoded in %.2gs\n", (tv1-tv0).GetSeconds());
 
-    Cleanup();
+// write a synthetic session state with given number of entities
+static void MakeTestState_t(CTStream &strm, INDEX ctEntities, INDEX iVariant)
+{
+  // some data before entities
+  strm.WriteID_t("SESS");
+  for(INDEX iHead=0; iHead<64; iHead++) {
+    strm<<ULONG(iHead*iVariant);
+  }
+  // entities
+  for(INDEX iEntity=0; iEntity<ctEntities; iEntity++) {
+    // in new variant, every 16th entity is destroyed and every 8th one is changed
+    if (iVariant>0 && (iEntity%16)==3) {
+      continue;
+    }
+    INDEX ctData = 16+iEntity%48;
+    strm.WriteID_t("ENT4");
+    strm<<ULONG(iEntity);
+    strm<<SLONG(ctData*sizeof(ULONG));
+    for(INDEX iData=0; iData<ctData; iData++) {
+      ULONG ulData = iEntity*97+iData;
+      if (iVariant>0 && (iEntity%8)==5) {
+        ulData ^= iData;
+      }
+      strm<<ulData;
+    }
+  }
+  // new variant also has some freshly spawned entities
+  if (iVariant>0) {
+    for(INDEX iEntity=0; iEntity<ctEntities/16; iEntity++) {
+      strm.WriteID_t("ENT4");
+      strm<<ULONG(ctEntities+iEntity);
+      strm<<SLONG(4*sizeof(ULONG));
+      for(INDEX iData=0; iData<4; iData++) {
+        strm<<ULONG(iEntity);
+      }
+    }
+  }
+  // some data after entities
+  strm.WriteID_t("SEND");
+  strm<<ULONG(iVariant);
+}
 
-  } catch (char *) {
-    Cleanup();
-    throw;
+// measure diff speed for connection states of different sizes
+void DIFF_Benchmark(void)
+{
+  static const INDEX actEntities[] = { 5000, 20000, 50000 };
+  for(INDEX iTest=0; iTest<ARRAYCOUNT(actEntities); iTest++) {
+    const INDEX ctEntities = actEntities[iTest];
+    try {
+      CTMemoryStream strmOld;
+      CTMemoryStream strmNew;
+      CTMemoryStream strmDiff;
+      CTMemoryStream strmUndiff;
+      MakeTestState_t(strmOld, ctEntities, 0);
+      MakeTestState_t(strmNew, ctEntities, 1);
+      strmOld.SetPos_t(0);
+      strmNew.SetPos_t(0);
+
+      CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+      DIFF_Diff_t(&strmOld, &strmNew, &strmDiff);
+      CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+
+      // verify that the diff reconstructs the new state
+      strmOld.SetPos_t(0);
+      strmDiff.SetPos_t(0);
+      DIFF_Undiff_t(&strmOld, &strmDiff, &strmUndiff);
+      CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+
+      BOOL bSame = strmUndiff.GetStreamSize()==strmNew.GetStreamSize()
+        && strmUndiff.GetStreamCRC32_t()==strmNew.GetStreamCRC32_t();
+      CPrintF("%6d entities: %7d bytes -> %7d bytes diff, diff %.2fms, undiff %.2fms %s\n",
+        ctEntities, strmNew.GetStreamSize(), strmDiff.GetStreamSize(),
+        (tv1-tv0).GetSeconds()*1000, (tv2-tv1).GetSeconds()*1000,
+        bSame ? "" : "MISMATCH!");
+    } catch (char *strError) {
+      CPrintF(TRANS("Diff benchmark failed: %s\n"), strError);
+    }
   }
 }
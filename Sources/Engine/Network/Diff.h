@@ -23,6 +23,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 void DIFF_Diff_t(CTStream *pstrmOld, CTStream *pstrmNew, CTStream *pstrmDiff); // throw char *
 // make a new saved game from difference file and old saved game
 void DIFF_Undiff_t(CTStream *pstrmOld, CTStream *pstrmDiff, CTStream *pstrmNew); // throw char *
+// measure diff speed on synthetic connection states
+void DIFF_Benchmark(void);
 
 
 #endif  /* include-once check. */
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Entities/InternalClasses.h>
 #include <Engine/Entities/Precaching.h>
 #include <Engine/Network/CommunicationInterface.h>
+#include <Engine/Network/Diff.h>
 #include <Engine/Templates/Stock_CModelData.h>
 #include <Engine/Templates/Stock_CAnimData.h>
 #include <Engine/Templates/Stock_CTextureData.h>
@@ -81,6 +82,7 @@ extern BOOL _bNeedPretouch;
 extern BOOL _bMultiPlayer = FALSE;
 extern INDEX _ctEntities = 0;
 extern INDEX _ctPredictorEntities = 0;
+extern INDEX ent_bReportEvents = FALSE;
 extern LevelChangePhase _lphCurrent = LCP_NOCHANGE;
 extern BOOL _bTempNetwork = FALSE;  // set while using temporary second network object
 extern BOOL con_bCapture;
@@ -164,6 +166,7 @@ extern FLOAT net_tmProblemsTimeout = 5.0f;
 extern FLOAT net_tmDisconnectTimeout = 300.0f;  // must be higher for level changing
 extern INDEX net_bReportCRC = FALSE;
 extern FLOAT net_fDropPackets = 0.0f;
+extern INDEX net_bPacketPool = TRUE;
 extern FLOAT net_tmLatency = 0.0f;
 
 extern INDEX ent_bReportSpawnInWall = FALSE;
@@ -245,6 +248,13 @@ extern INDEX inp_bAutoDisableJoysticks;
 extern INDEX wed_bUseGenericTextureReplacement = FALSE;
 
 extern void RendererInfo(void);
+extern void RendererAddListBenchmark(void);
+extern void ReportEventStats(void);
+extern void NetLoopbackBenchmarkCfunc(void *pArgs);
+extern void PacketBufferStressTestCfunc(void *pArgs);
+extern void NetBitPackingTestCfunc(void *pArgs);
+extern void ShadowBakeBenchmarkCfunc(void *pArgs);
+extern void WorldLoadBenchmarkCfunc(void *pArgs);
 extern void ClearRenderer(void);
 
 
@@ -327,6 +337,9 @@ static void NetworkInfo(void)
   if (_pNetwork->ga_srvServer.srv_bActive) {
     CPrintF("  last processed tick: %g\n", _pNetwork->ga_srvServer.srv_tmLastProcessedTick);
     CPrintF("  last processed sequence: %d\n", _pNetwork->ga_srvServer.srv_iLastProcessedSequence);
+    CPrintF("  stream buffer: %dblk=%dk\n",
+      _pNetwork->ga_srvServer.srv_nssBlocks.GetUsedBlocks(),
+      _pNetwork->ga_srvServer.srv_nssBlocks.GetUsedMemory()/1024);
     CPrintF("  players:\n");
     for(INDEX iplb=0; iplb<_pNetwork->ga_srvServer.srv_aplbPlayers.Count(); iplb++) {
       CPlayerBuffer &plb = _pNetwork->ga_srvServer.srv_aplbPlayers[iplb];
@@ -341,9 +354,7 @@ static void NetworkInfo(void)
       CSessionSocket &sso = _pNetwork->ga_srvServer.srv_assoSessions[iSession];
       if (sso.sso_bActive) {
         CPrintF("  %2d:'%s'\n", iSession, _cmiComm.Server_GetClientName(iSession)),
-        CPrintF("    buffer: %dblk=%dk\n",
-          sso.sso_nsBuffer.GetUsedBlocks(),
-          sso.sso_nsBuffer.GetUsedMemory()/1024);
+        CPrintF("    buffer: from sequence %d\n", sso.sso_iOldestSequence);
         CPrintF("    state:");
         if (sso.sso_iDisconnectedState>0) {
           CPrintF("    disconnecting");
@@ -736,8 +747,14 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("user void StockInfo(void);",    &StockInfo);
   _pShell->DeclareSymbol("user void StockDump(void);",    &StockDump);
   _pShell->DeclareSymbol("user void RendererInfo(void);", &RendererInfo);
+  _pShell->DeclareSymbol("user void RendererAddListBenchmark(void);", &RendererAddListBenchmark);
+  _pShell->DeclareSymbol("user INDEX ent_bReportEvents;", &ent_bReportEvents);
+  _pShell->DeclareSymbol("user void ReportEventStats(void);", &ReportEventStats);
   _pShell->DeclareSymbol("user void ClearRenderer(void);",   &ClearRenderer);
   _pShell->DeclareSymbol("user void CacheShadows(void);",    &CacheShadows);
+  _pShell->DeclareSymbol("user void ShadowBakeBenchmark(CTString);", &ShadowBakeBenchmarkCfunc);
+  _pShell->DeclareSymbol("user void WorldLoadBenchmark(CTString);", &WorldLoadBenchmarkCfunc);
+  _pShell->DeclareSymbol("user void DiffBenchmark(void);",   &DIFF_Benchmark);
   _pShell->DeclareSymbol("user void KickClient(INDEX, CTString);", &KickClientCfunc);
   _pShell->DeclareSymbol("user void KickByName(CTString, CTString);", &KickByNameCfunc);
   _pShell->DeclareSymbol("user void ListPlayers(void);", &ListPlayers);
@@ -843,6 +860,10 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("user FLOAT net_fLimitBandwidthSend;", &_pbsSend.pbs_fBandwidthLimit);
   _pShell->DeclareSymbol("user FLOAT net_fLimitBandwidthRecv;", &_pbsRecv.pbs_fBandwidthLimit);
   _pShell->DeclareSymbol("user FLOAT net_fDropPackets;", &net_fDropPackets);
+  _pShell->DeclareSymbol("user INDEX net_bPacketPool;", &net_bPacketPool);
+  _pShell->DeclareSymbol("user void NetLoopbackBenchmark(INDEX, INDEX);", &NetLoopbackBenchmarkCfunc);
+  _pShell->DeclareSymbol("user void PacketBufferStressTest(INDEX, INDEX);", &PacketBufferStressTestCfunc);
+  _pShell->DeclareSymbol("user void NetBitPackingTest(INDEX);", &NetBitPackingTestCfunc);
 
   _pShell->DeclareSymbol("persistent user INDEX net_iGraphBuffer;", &net_iGraphBuffer);
 
@@ -137,6 +137,8 @@ public:
   UBYTE ga_aubProperties[NET_MAXSESSIONPROPERTIES];
 
   BOOL IsServer(void) { return ga_IsServer; };
+  // check if a game or demo is running in ga_World (timer loop is synchronized)
+  BOOL IsGameActive(void) { return ga_ctTimersPending>=0; };
 
   // make actions packet for local players and send to server
   void SendActionsToServer(void);
@@ -17,6 +17,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Network/NetworkMessage.h>
 #include <Engine/Network/Compression.h>
+#include <Engine/Network/Network.h>
+#include <Engine/CurrentVersion.h>
 
 #include <Engine/Math/Functions.h>
 #include <Engine/Base/CRC.h>
@@ -25,6 +27,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/Stream.h>
 #include <Engine/Base/ErrorTable.h>
 #include <Engine/Base/ErrorReporting.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 
 #include <Engine/Base/ListIterator.inl>
 
@@ -426,84 +430,146 @@ void CNetworkMessage::Shrink(void)
   nm_pubPointer = nm_pubMessage + slOffset;
 }
 
-// copy one bit from a byte to another byte
-static inline void CopyBit(const UBYTE &ubSrc, INDEX iSrc, UBYTE &ubDst, INDEX iDst)
-{
-  if (ubSrc&(1<<iSrc)) {
-    ubDst |= (1<<iDst);
-  } else {
-    ubDst &= ~(1<<iDst);
-  }
-}
+// bits are packed starting from the lowest bit of each byte, so both the message and the
+// buffer are read as little-endian bit streams and moved through a 64-bit accumulator
 
 void CNetworkMessage::ReadBits(void *pvBuffer, INDEX ctBits)
 {
-  UBYTE *pubDstByte = (UBYTE *)pvBuffer;
-  // for each bit
-  INDEX iDstBit = 0;
-  for (INDEX iBit=0; iBit<ctBits; iBit++) {
-    // get next bit and byte in message
-    UBYTE *pubSrcByte = nm_pubPointer;
-    INDEX iSrcBit = nm_iBit;
-    // if bit is 0 - start of byte
-    if (nm_iBit==0) {
-      // we will start reading from this byte, advance message to next byte
-      nm_pubPointer++;
-    // if bit is not 0 - inside byte
-    } else {
-      // we will read from previous byte, keep message as-is
-      pubSrcByte--;
+  if (ctBits<=0) {
+    return;
+  }
+  UBYTE *pubDst = (UBYTE *)pvBuffer;
+  // if byte aligned, copy whole bytes directly
+  if (nm_iBit==0 && ctBits>=8) {
+    const INDEX ctBytes = ctBits>>3;
+    memcpy(pubDst, nm_pubPointer, ctBytes);
+    nm_pubPointer += ctBytes;
+    pubDst += ctBytes;
+    ctBits &= 7;
+    if (ctBits==0) {
+      return;
     }
+  }
 
-    // copy the bit
-    CopyBit(*pubSrcByte, iSrcBit, *pubDstByte, iDstBit);
-
-    // go to next bit
-    nm_iBit++;
-    if (nm_iBit>=8) {
-      nm_iBit = 0;
+  // find first byte that holds the bits (previous byte if inside a byte)
+  UBYTE *pubSrc = nm_pubPointer;
+  const INDEX iSrcBit = nm_iBit;
+  if (iSrcBit!=0) {
+    pubSrc--;
+  }
+  // advance message past all bytes that are touched
+  INDEX ctSrcBytes = (iSrcBit+ctBits+7)>>3;
+  nm_pubPointer = pubSrc+ctSrcBytes;
+  nm_iBit = (iSrcBit+ctBits)&7;
+
+  // start with the rest of the first byte
+  unsigned __int64 uqAcc = (*pubSrc++)>>iSrcBit;
+  INDEX ctAccBits = 8-iSrcBit;
+  ctSrcBytes--;
+  while (ctBits>0) {
+    // refill accumulator a whole word at a time if possible
+    if (ctAccBits<32) {
+      if (ctSrcBytes>=4) {
+        uqAcc |= ((unsigned __int64)*(ULONG*)pubSrc)<<ctAccBits;
+        pubSrc += 4;
+        ctSrcBytes -= 4;
+        ctAccBits += 32;
+      } else {
+        while (ctSrcBytes>0) {
+          uqAcc |= ((unsigned __int64)*pubSrc++)<<ctAccBits;
+          ctSrcBytes--;
+          ctAccBits += 8;
+        }
+      }
     }
-    iDstBit++;
-    if (iDstBit>=8) {
-      iDstBit = 0;
-      pubDstByte++;
+    // output whole words and bytes
+    if (ctBits>=32 && ctAccBits>=32) {
+      *(ULONG*)pubDst = (ULONG)uqAcc;
+      pubDst += 4;
+      uqAcc >>= 32;
+      ctAccBits -= 32;
+      ctBits -= 32;
+    } else if (ctBits>=8) {
+      *pubDst++ = (UBYTE)uqAcc;
+      uqAcc >>= 8;
+      ctAccBits -= 8;
+      ctBits -= 8;
+    } else {
+      // last partial byte keeps its other bits
+      const UBYTE ubMask = (UBYTE)((1<<ctBits)-1);
+      *pubDst = (*pubDst&~ubMask) | ((UBYTE)uqAcc&ubMask);
+      ctBits = 0;
     }
   }
 }
 
 void CNetworkMessage::WriteBits(const void *pvBuffer, INDEX ctBits)
 {
-  const UBYTE *pubSrcByte = (const UBYTE *)pvBuffer;
-  // for each bit
-  INDEX iSrcBit = 0;
-  for (INDEX iBit=0; iBit<ctBits; iBit++) {
-    // get next bit and byte in message
-    UBYTE *pubDstByte = nm_pubPointer;
-    INDEX iDstBit = nm_iBit;
-    // if bit is 0 - start of byte
-    if (nm_iBit==0) {
-      // we will start writing to this byte, advance message to next byte
-      nm_pubPointer++;
-      nm_slSize++;
-    // if bit is not 0 - inside byte
-    } else {
-      // we will write to previous byte, keep message as-is
-      pubDstByte--;
+  if (ctBits<=0) {
+    return;
+  }
+  const UBYTE *pubSrc = (const UBYTE *)pvBuffer;
+  // if byte aligned, copy whole bytes directly
+  if (nm_iBit==0 && ctBits>=8) {
+    const INDEX ctBytes = ctBits>>3;
+    memcpy(nm_pubPointer, pubSrc, ctBytes);
+    nm_pubPointer += ctBytes;
+    nm_slSize += ctBytes;
+    pubSrc += ctBytes;
+    ctBits &= 7;
+    if (ctBits==0) {
+      return;
     }
+  }
 
-    // copy the bit
-    CopyBit(*pubSrcByte, iSrcBit, *pubDstByte, iDstBit);
-
-    // go to next bit
-    nm_iBit++;
-    if (nm_iBit>=8) {
-      nm_iBit = 0;
+  // find first byte to write to (previous byte if inside a byte)
+  UBYTE *pubDst = nm_pubPointer;
+  const INDEX iDstBit = nm_iBit;
+  if (iDstBit!=0) {
+    pubDst--;
+  }
+  // advance message past all bytes that are touched
+  UBYTE *pubEnd = pubDst + ((iDstBit+ctBits+7)>>3);
+  nm_slSize += pubEnd-nm_pubPointer;
+  nm_pubPointer = pubEnd;
+  nm_iBit = (iDstBit+ctBits)&7;
+
+  // start with bits already written in the first byte
+  unsigned __int64 uqAcc = (*pubDst)&((1<<iDstBit)-1);
+  INDEX ctAccBits = iDstBit;
+  while (ctBits>0) {
+    // fetch next word or byte from the buffer
+    if (ctBits>=32) {
+      uqAcc |= ((unsigned __int64)*(const ULONG*)pubSrc)<<ctAccBits;
+      pubSrc += 4;
+      ctAccBits += 32;
+      ctBits -= 32;
+    } else if (ctBits>=8) {
+      uqAcc |= ((unsigned __int64)*pubSrc++)<<ctAccBits;
+      ctAccBits += 8;
+      ctBits -= 8;
+    } else {
+      uqAcc |= ((unsigned __int64)(*pubSrc&((1<<ctBits)-1)))<<ctAccBits;
+      ctAccBits += ctBits;
+      ctBits = 0;
     }
-    iSrcBit++;
-    if (iSrcBit>=8) {
-      iSrcBit = 0;
-      pubSrcByte++;
+    // flush whole words and bytes
+    if (ctAccBits>=32) {
+      *(ULONG*)pubDst = (ULONG)uqAcc;
+      pubDst += 4;
+      uqAcc >>= 32;
+      ctAccBits -= 32;
     }
+    while (ctAccBits>=8) {
+      *pubDst++ = (UBYTE)uqAcc;
+      uqAcc >>= 8;
+      ctAccBits -= 8;
+    }
+  }
+  // last partial byte keeps its other bits
+  if (ctAccBits>0) {
+    const UBYTE ubMask = (UBYTE)((1<<ctAccBits)-1);
+    *pubDst = (*pubDst&~ubMask) | ((UBYTE)uqAcc&ubMask);
   }
 }
 
@@ -827,6 +893,162 @@ void CNetworkStream::RemoveOlderBlocksBySequence(INDEX iLastSequenceToKeep)
   };
 }
 
+/////////////////////////////////////////////////////////////////////
+// CNetworkStreamStore
+
+/*
+ * Constructor.
+ */
+CNetworkStreamStore::CNetworkStreamStore(void)
+{
+  nss_apnsbRing = NULL;
+  nss_ctRing = 0;
+  nss_iOldestSequence = 0;
+  nss_iNewestSequence = -1;
+  nss_ctBlocks = 0;
+  nss_slBlocksMemory = 0;
+}
+
+/*
+ * Destructor.
+ */
+CNetworkStreamStore::~CNetworkStreamStore(void)
+{
+  Clear();
+}
+
+/*
+ * Clear the object (remove all blocks).
+ */
+void CNetworkStreamStore::Clear(void)
+{
+  // delete all blocks and the ring itself
+  RemoveOlderBlocksBySequence(nss_iNewestSequence+1);
+  if (nss_apnsbRing!=NULL) {
+    FreeMemory(nss_apnsbRing);
+  }
+  nss_apnsbRing = NULL;
+  nss_ctRing = 0;
+  nss_iOldestSequence = 0;
+  nss_iNewestSequence = -1;
+  ASSERT(nss_ctBlocks==0 && nss_slBlocksMemory==0);
+}
+
+// enlarge the ring to hold at least given number of sequences
+void CNetworkStreamStore::Grow(INDEX ctSequences)
+{
+  INDEX ctNewRing = ClampDn(nss_ctRing, 256L);
+  while (ctNewRing<ctSequences) {
+    ctNewRing*=2;
+  }
+  if (ctNewRing==nss_ctRing) {
+    return;
+  }
+  // move stored blocks to their slots in new ring
+  CNetworkStreamBlock **apnsbNew = (CNetworkStreamBlock **)AllocMemory(ctNewRing*sizeof(CNetworkStreamBlock *));
+  memset(apnsbNew, 0, ctNewRing*sizeof(CNetworkStreamBlock *));
+  for (INDEX iSequence=nss_iOldestSequence; iSequence<=nss_iNewestSequence; iSequence++) {
+    apnsbNew[iSequence&(ctNewRing-1)] = Slot(iSequence);
+  }
+  if (nss_apnsbRing!=NULL) {
+    FreeMemory(nss_apnsbRing);
+  }
+  nss_apnsbRing = apnsbNew;
+  nss_ctRing = ctNewRing;
+}
+
+// get number of blocks used by this object
+INDEX CNetworkStreamStore::GetUsedBlocks(void)
+{
+  return nss_ctBlocks;
+}
+
+// get amount of memory used by this object
+SLONG CNetworkStreamStore::GetUsedMemory(void)
+{
+  return nss_slBlocksMemory + nss_ctRing*sizeof(CNetworkStreamBlock *);
+}
+
+// get index of newest sequence stored (-1 if empty)
+INDEX CNetworkStreamStore::GetNewestSequence(void)
+{
+  if (nss_ctBlocks<=0) {
+    return -1;
+  }
+  return nss_iNewestSequence;
+}
+
+/*
+ * Add a block to the store.
+ */
+void CNetworkStreamStore::AddBlock(CNetworkStreamBlock &nsbBlock)
+{
+  INDEX iSequence = nsbBlock.nsb_iSequenceNumber;
+  ASSERT(iSequence>=0);
+  // if the store is empty, start it from this block
+  if (nss_ctBlocks<=0) {
+    nss_iOldestSequence = iSequence;
+    nss_iNewestSequence = iSequence-1;
+  }
+  // if the block is older than the store, or already in it
+  if (iSequence<nss_iOldestSequence || iSequence<=nss_iNewestSequence && Slot(iSequence)!=NULL) {
+    // just discard it
+    return;
+  }
+  // make sure there is room for it
+  INDEX iNewest = Max(nss_iNewestSequence, iSequence);
+  if (iNewest-nss_iOldestSequence+1>nss_ctRing) {
+    Grow(iNewest-nss_iOldestSequence+1);
+  }
+  // create a shrunk copy of the block and put it in its slot
+  CNetworkStreamBlock *pnsbCopy = new CNetworkStreamBlock(nsbBlock);
+  pnsbCopy->Shrink();
+  Slot(iSequence) = pnsbCopy;
+  nss_iNewestSequence = iNewest;
+  nss_ctBlocks++;
+  nss_slBlocksMemory+=sizeof(CNetworkStreamBlock)+pnsbCopy->nm_slMaxSize;
+}
+
+/*
+ * Get a block by its sequence number, as seen by a client that needs sequences from given one on.
+ */
+CNetworkStream::Result CNetworkStreamStore::GetBlockBySequence(
+  INDEX iOldestSequence, INDEX iSequenceNumber, CNetworkStreamBlock *&pnsbBlock)
+{
+  pnsbBlock = NULL;
+  // if there are no blocks for this client at or after wanted sequence
+  iOldestSequence = Max(iOldestSequence, nss_iOldestSequence);
+  if (nss_ctBlocks<=0 || iSequenceNumber>nss_iNewestSequence || iOldestSequence>nss_iNewestSequence) {
+    // we assume that the wanted block is not yet received
+    return CNetworkStream::R_BLOCKNOTRECEIVEDYET;
+  }
+  // if the block is not available to this client
+  if (iSequenceNumber<iOldestSequence || Slot(iSequenceNumber)==NULL) {
+    // return that the block is missing (probably should be resent)
+    return CNetworkStream::R_BLOCKMISSING;
+  }
+  // return it
+  pnsbBlock = Slot(iSequenceNumber);
+  return CNetworkStream::R_OK;
+}
+
+/* Remove all blocks with sequence older than given. */
+void CNetworkStreamStore::RemoveOlderBlocksBySequence(INDEX iLastSequenceToKeep)
+{
+  // while there are any blocks older than given
+  while (nss_iOldestSequence<iLastSequenceToKeep && nss_iOldestSequence<=nss_iNewestSequence) {
+    // delete the oldest one
+    CNetworkStreamBlock *&pnsb = Slot(nss_iOldestSequence);
+    if (pnsb!=NULL) {
+      nss_ctBlocks--;
+      nss_slBlocksMemory-=sizeof(CNetworkStreamBlock)+pnsb->nm_slMaxSize;
+      delete pnsb;
+      pnsb = NULL;
+    }
+    nss_iOldestSequence++;
+  }
+}
+
 /////////////////////////////////////////////////////////////////////
 // CPlayerAction
 
@@ -900,11 +1122,31 @@ void CPlayerAction::Lerp(const CPlayerAction &pa0, const CPlayerAction &pa1, FLO
 //   (256-65535)  000001  = 16 bit value follows
 //   (65536-)     000000  = 32 bit value follows
 // note: above bits are ordered in reverse as they come when scanning bit by bit
+//
+// timetag is mostly sent as delta from previous action, so it is compressed as:
+//   (0)          1       = no bits follow, value is 0
+//   (1-65535)    01      = 16 bit value follows
+//   (other)      00      = 64 bit value follows
+// (demos up to minor version 10 have the whole 64 bit value instead)
+
+#define DEMOVER_RAWTIMETAG 10   // last minor version that wrote raw timetags
 
 /* Write an object into message. */
 CNetworkMessage &operator<<(CNetworkMessage &nm, const CPlayerAction &pa)
 {
-  nm.Write(&pa.pa_llCreated, sizeof(pa.pa_llCreated));
+  if (pa.pa_llCreated==0) {
+    UBYTE ub=1;
+    nm.WriteBits(&ub, 1);
+  } else if (pa.pa_llCreated>0 && pa.pa_llCreated<=65535) {
+    UBYTE ub=2;
+    nm.WriteBits(&ub, 2);
+    ULONG ulDelta = ULONG(pa.pa_llCreated);
+    nm.WriteBits(&ulDelta, 16);
+  } else {
+    UBYTE ub=0;
+    nm.WriteBits(&ub, 2);
+    nm.WriteBits(&pa.pa_llCreated, 64);
+  }
 
   const ULONG *pul = (const ULONG*)&pa.pa_vTranslation;
   for (INDEX i=0; i<9; i++) {
@@ -959,7 +1201,26 @@ CNetworkMessage &operator<<(CNetworkMessage &nm, const CPlayerAction &pa)
 /* Read an object from message. */
 CNetworkMessage &operator>>(CNetworkMessage &nm, CPlayerAction &pa)
 {
-  nm.Read(&pa.pa_llCreated, sizeof(pa.pa_llCreated));
+  // old demos have raw timetags
+  if (_pNetwork->ga_ulDemoMinorVersion<=DEMOVER_RAWTIMETAG) {
+    nm.Read(&pa.pa_llCreated, sizeof(pa.pa_llCreated));
+  } else {
+    UBYTE ub = 0;
+    nm.ReadBits(&ub, 1);
+    if (ub!=0) {
+      pa.pa_llCreated = 0;
+    } else {
+      nm.ReadBits(&ub, 1);
+      if (ub!=0) {
+        ULONG ulDelta = 0;
+        nm.ReadBits(&ulDelta, 16);
+        pa.pa_llCreated = ulDelta;
+      } else {
+        pa.pa_llCreated = 0;
+        nm.ReadBits(&pa.pa_llCreated, 64);
+      }
+    }
+  }
 
   ULONG *pul = (ULONG*)&pa.pa_vTranslation;
   for (INDEX i=0; i<9; i++) {
@@ -1027,3 +1288,200 @@ CTStream &operator>>(CTStream &strm, CPlayerAction &pa)
   strm.Read_t(&pa,sizeof(pa));
   return strm;
 }
+
+
+/////////////////////////////////////////////////////////////////////
+// bit packing test
+
+// original bit-by-bit implementation, kept as reference for the test
+static inline void CopyBit(const UBYTE &ubSrc, INDEX iSrc, UBYTE &ubDst, INDEX iDst)
+{
+  if (ubSrc&(1<<iSrc)) {
+    ubDst |= (1<<iDst);
+  } else {
+    ubDst &= ~(1<<iDst);
+  }
+}
+static void ReadBits_Reference(CNetworkMessage &nm, void *pvBuffer, INDEX ctBits)
+{
+  UBYTE *pubDstByte = (UBYTE *)pvBuffer;
+  INDEX iDstBit = 0;
+  for (INDEX iBit=0; iBit<ctBits; iBit++) {
+    UBYTE *pubSrcByte = nm.nm_pubPointer;
+    INDEX iSrcBit = nm.nm_iBit;
+    if (nm.nm_iBit==0) {
+      nm.nm_pubPointer++;
+    } else {
+      pubSrcByte--;
+    }
+    CopyBit(*pubSrcByte, iSrcBit, *pubDstByte, iDstBit);
+    nm.nm_iBit++;
+    if (nm.nm_iBit>=8) {
+      nm.nm_iBit = 0;
+    }
+    iDstBit++;
+    if (iDstBit>=8) {
+      iDstBit = 0;
+      pubDstByte++;
+    }
+  }
+}
+static void WriteBits_Reference(CNetworkMessage &nm, const void *pvBuffer, INDEX ctBits)
+{
+  const UBYTE *pubSrcByte = (const UBYTE *)pvBuffer;
+  INDEX iSrcBit = 0;
+  for (INDEX iBit=0; iBit<ctBits; iBit++) {
+    UBYTE *pubDstByte = nm.nm_pubPointer;
+    INDEX iDstBit = nm.nm_iBit;
+    if (nm.nm_iBit==0) {
+      nm.nm_pubPointer++;
+      nm.nm_slSize++;
+    } else {
+      pubDstByte--;
+    }
+    CopyBit(*pubSrcByte, iSrcBit, *pubDstByte, iDstBit);
+    nm.nm_iBit++;
+    if (nm.nm_iBit>=8) {
+      nm.nm_iBit = 0;
+    }
+    iSrcBit++;
+    if (iSrcBit>=8) {
+      iSrcBit = 0;
+      pubSrcByte++;
+    }
+  }
+}
+
+// one operation in a randomly generated message
+struct BitOperation {
+  INDEX bo_ctBits;      // number of bits, or negative number of bytes for plain read/write
+  UBYTE bo_aubData[8];
+};
+
+static BOOL SameMessageState(const CNetworkMessage &nm0, const CNetworkMessage &nm1)
+{
+  return nm0.nm_pubPointer-nm0.nm_pubMessage==nm1.nm_pubPointer-nm1.nm_pubMessage
+      && nm0.nm_iBit==nm1.nm_iBit && nm0.nm_slSize==nm1.nm_slSize
+      && memcmp(nm0.nm_pubMessage, nm1.nm_pubMessage, nm0.nm_slMaxSize)==0;
+}
+
+// fuzz new bit packing against the reference one and compare their speed
+void NetBitPackingTest(INDEX ctMessages)
+{
+  ctMessages = Clamp(ctMessages, 1L, 100000L);
+  ULONG ulSeed = 0x51F15EED;
+  #define NEXTRANDOM() (ulSeed = ulSeed*1103515245+12345, (ulSeed>>8)&0xFFFF)
+  // typical field sizes: flags, pings, player indices, floats
+  static const INDEX actTypicalBits[] = { 1, 1, 1, 2, 3, 4, 5, 6, 8, 10, 16, 32, 32, 32 };
+
+  const INDEX ctMaxOperations = 1024;
+  BitOperation *aboOperations = new BitOperation[ctMaxOperations];
+  CNetworkMessage nmNew(MSG_ACTION);
+  CNetworkMessage nmOld(MSG_ACTION);
+  CTimerValue tvNew(0.0), tvOld(0.0);
+  INDEX ctBitsTotal = 0;
+  BOOL bOk = TRUE;
+
+  for (INDEX iMessage=0; iMessage<ctMessages && bOk; iMessage++) {
+    // fill both messages with same garbage
+    INDEX iByte;
+    for (iByte=1; iByte<nmNew.nm_slMaxSize; iByte++) {
+      nmNew.nm_pubMessage[iByte] = nmOld.nm_pubMessage[iByte] = (UBYTE)NEXTRANDOM();
+    }
+    // generate operations that fit in the message
+    INDEX ctOperations = 0;
+    INDEX ctBitsUsed = 0;
+    while (ctOperations<ctMaxOperations) {
+      BitOperation &bo = aboOperations[ctOperations];
+      INDEX iType = NEXTRANDOM()%16;
+      if (iType==0) {
+        bo.bo_ctBits = -INDEX(1+NEXTRANDOM()%8);
+      } else if (iType==1) {
+        bo.bo_ctBits = 1+NEXTRANDOM()%64;
+      } else {
+        bo.bo_ctBits = actTypicalBits[NEXTRANDOM()%ARRAYCOUNT(actTypicalBits)];
+      }
+      INDEX ctBits = bo.bo_ctBits>0 ? bo.bo_ctBits : -bo.bo_ctBits*8+7;
+      if ((ctBitsUsed+ctBits)/8 > nmNew.nm_slMaxSize-16) {
+        break;
+      }
+      ctBitsUsed += ctBits;
+      for (iByte=0; iByte<8; iByte++) {
+        bo.bo_aubData[iByte] = (UBYTE)NEXTRANDOM();
+      }
+      ctOperations++;
+    }
+
+    // write with both implementations
+    nmNew.Reinit();
+    nmOld.Reinit();
+    INDEX iOperation;
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    for (iOperation=0; iOperation<ctOperations; iOperation++) {
+      const BitOperation &bo = aboOperations[iOperation];
+      if (bo.bo_ctBits>0) {
+        nmNew.WriteBits(bo.bo_aubData, bo.bo_ctBits);
+      } else {
+        nmNew.Write(bo.bo_aubData, -bo.bo_ctBits);
+      }
+    }
+    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+    for (iOperation=0; iOperation<ctOperations; iOperation++) {
+      const BitOperation &bo = aboOperations[iOperation];
+      if (bo.bo_ctBits>0) {
+        WriteBits_Reference(nmOld, bo.bo_aubData, bo.bo_ctBits);
+      } else {
+        nmOld.Write(bo.bo_aubData, -bo.bo_ctBits);
+      }
+    }
+    CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+    tvNew += tv1-tv0;
+    tvOld += tv2-tv1;
+    if (!SameMessageState(nmNew, nmOld)) {
+      CPrintF("Bit packing mismatch when writing message %d!\n", iMessage);
+      bOk = FALSE;
+      break;
+    }
+
+    // read back with both implementations into same garbage
+    nmNew.Rewind();
+    nmOld.Rewind();
+    for (iOperation=0; iOperation<ctOperations && bOk; iOperation++) {
+      const BitOperation &bo = aboOperations[iOperation];
+      UBYTE aubNew[8], aubOld[8];
+      for (iByte=0; iByte<8; iByte++) {
+        aubNew[iByte] = aubOld[iByte] = (UBYTE)NEXTRANDOM();
+      }
+      tv0 = _pTimer->GetHighPrecisionTimer();
+      if (bo.bo_ctBits>0) {
+        nmNew.ReadBits(aubNew, bo.bo_ctBits);
+      } else {
+        nmNew.Read(aubNew, -bo.bo_ctBits);
+      }
+      tv1 = _pTimer->GetHighPrecisionTimer();
+      if (bo.bo_ctBits>0) {
+        ReadBits_Reference(nmOld, aubOld, bo.bo_ctBits);
+      } else {
+        nmOld.Read(aubOld, -bo.bo_ctBits);
+      }
+      tv2 = _pTimer->GetHighPrecisionTimer();
+      tvNew += tv1-tv0;
+      tvOld += tv2-tv1;
+      if (memcmp(aubNew, aubOld, sizeof(aubNew))!=0 || !SameMessageState(nmNew, nmOld)) {
+        CPrintF("Bit packing mismatch when reading message %d!\n", iMessage);
+        bOk = FALSE;
+      }
+    }
+    ctBitsTotal += ctBitsUsed;
+  }
+  #undef NEXTRANDOM
+  delete[] aboOperations;
+
+  CPrintF("Bit packing test: %d messages, %d kbits - %s\n", ctMessages, ctBitsTotal/1024, bOk ? "OK" : "FAILED!");
+  CPrintF("  reference: %.2f ms, word packing: %.2f ms\n", tvOld.GetSeconds()*1000, tvNew.GetSeconds()*1000);
+}
+void NetBitPackingTestCfunc(void *pArgs)
+{
+  INDEX ctMessages = NEXTARGUMENT(INDEX);
+  NetBitPackingTest(ctMessages);
+}
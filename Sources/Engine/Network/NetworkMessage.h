@@ -271,6 +271,51 @@ public:
   void RemoveOlderBlocksBySequence(INDEX iLastSequenceToKeep);
 };
 
+/*
+ * Store of game stream blocks shared by all clients of a server.
+ *
+ * Blocks are kept in a ring indexed by their sequence numbers, and are never
+ * changed once added. Each client only remembers oldest sequence it still
+ * needs, and the store is trimmed up to the oldest of those.
+ */
+class CNetworkStreamStore {
+public:
+  CNetworkStreamBlock **nss_apnsbRing;  // blocks indexed by sequence modulo ring size
+  INDEX nss_ctRing;               // size of ring (power of two)
+  INDEX nss_iOldestSequence;      // oldest sequence stored
+  INDEX nss_iNewestSequence;      // newest sequence stored
+  INDEX nss_ctBlocks;             // number of blocks stored
+  SLONG nss_slBlocksMemory;       // memory used by stored blocks
+
+  // get slot for given sequence
+  inline CNetworkStreamBlock *&Slot(INDEX iSequence) {
+    return nss_apnsbRing[iSequence&(nss_ctRing-1)];
+  };
+  // enlarge the ring to hold at least given number of sequences
+  void Grow(INDEX ctSequences);
+public:
+  /* Constructor. */
+  CNetworkStreamStore(void);
+  /* Destructor. */
+  ~CNetworkStreamStore(void);
+  /* Clear the object (remove all blocks). */
+  void Clear(void);
+  // get number of blocks used by this object
+  INDEX GetUsedBlocks(void);
+  // get amount of memory used by this object
+  SLONG GetUsedMemory(void);
+  // get index of newest sequence stored (-1 if empty)
+  INDEX GetNewestSequence(void);
+
+  /* Add a block to the store (makes a copy of block). */
+  void AddBlock(CNetworkStreamBlock &nsbBlock);
+  /* Get a block by its sequence number, as seen by a client that needs sequences from given one on. */
+  CNetworkStream::Result GetBlockBySequence(
+    INDEX iOldestSequence, INDEX iSequenceNumber, CNetworkStreamBlock *&pnsbBlock);
+  /* Remove all blocks with sequence older than given. */
+  void RemoveOlderBlocksBySequence(INDEX iLastSequenceToKeep);
+};
+
 class ENGINE_API CPlayerAction {
 public:
   // order is important for compression and normalization - do not reorder!
@@ -29,12 +29,14 @@ CNetworkProfile::CNetworkProfile(void)
   SETTIMERNAME(CNetworkProfile::PTI_MAINLOOP,                 "MainLoop()", "");
   SETTIMERNAME(CNetworkProfile::PTI_TIMERLOOP,                "TimerLoop()", "");
   SETTIMERNAME(CNetworkProfile::PTI_SERVER_LOOP,              "ServerLoop()", "");
+  SETTIMERNAME(CNetworkProfile::PTI_SERVER_PACKGAMESTREAM,    "  packing gamestream", "batch");
   SETTIMERNAME(CNetworkProfile::PTI_SESSIONSTATE_LOOP,        "SessionStateLoop()", "");
   SETTIMERNAME(CNetworkProfile::PTI_SESSIONSTATE_PROCESSGAMESTREAM, "CSessionState::ProcessGameStream()", "");
   SETTIMERNAME(CNetworkProfile::PTI_SENDMESSAGE,              "Send()", "");
   SETTIMERNAME(CNetworkProfile::PTI_RECEIVEMESSAGE,           "Receive()", "");
 
   SETCOUNTERNAME(CNetworkProfile::PCI_GAMESTREAMRESENDS, "game stream resends");
+  SETCOUNTERNAME(CNetworkProfile::PCI_GAMESTREAM_PACKS,  "game stream batch packs");
 
   SETCOUNTERNAME(CNetworkProfile::PCI_GAMESTREAM_BYTES_SENT,     "gamestream bytes sent");
   SETCOUNTERNAME(CNetworkProfile::PCI_GAMESTREAM_BYTES_RECEIVED, "gamestream bytes received");
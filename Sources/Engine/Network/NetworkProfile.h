@@ -26,6 +26,7 @@ public:
     PTI_TIMERLOOP,                // time spent in timer game loop
 
     PTI_SERVER_LOOP,              // time server spent processing messages
+    PTI_SERVER_PACKGAMESTREAM,    // time server spent compressing game stream batches
     PTI_SESSIONSTATE_LOOP,        // time session state spent processing messages
     PTI_SESSIONSTATE_PROCESSGAMESTREAM, // time session state spent processing gamestream (includes physics)
 
@@ -35,6 +36,7 @@ public:
   };
   enum ProfileCounterIndex {
     PCI_GAMESTREAMRESENDS,  // how many times gamestream block was resent from server
+    PCI_GAMESTREAM_PACKS,   // how many times a gamestream batch was compressed
 
     PCI_GAMESTREAM_BYTES_SENT,      // bytes sent in gamestream messages
     PCI_GAMESTREAM_BYTES_RECEIVED,  // bytes received in gamestream messages
@@ -98,8 +98,7 @@ void CPlayerBuffer::ReceiveActionPacket(CNetworkMessage *pnm, INDEX iMaxBuffer)
 }
 
 /* Create action packet for player target from oldest buffered action. */
-// (prepares lag info for given client number)
-void CPlayerBuffer::CreateActionPacket(CNetworkMessage *pnm, INDEX iClient)
+void CPlayerBuffer::CreateActionPacket(CNetworkMessage *pnm)
 {
   ASSERT(plb_Active);
   CPlayerAction paCurrent;
@@ -122,15 +121,9 @@ void CPlayerBuffer::CreateActionPacket(CNetworkMessage *pnm, INDEX iClient)
   for (INDEX i=0; i<sizeof(CPlayerAction); i++) {
     ((UBYTE*)&paDelta)[i] = ((UBYTE*)&paCurrent)[i] ^ ((UBYTE*)&plb_paLastAction)[i];
   }
-  // if the client that message is sent to owns the player
-  if (iClient==plb_iClient) {
-    // send delta of the timetag
-    paDelta.pa_llCreated = paCurrent.pa_llCreated-plb_paLastAction.pa_llCreated;
-  // if the client doesn't own the player
-  } else {
-    // no timetag information
-    paDelta.pa_llCreated = 0;
-  }
+  // send delta of the timetag
+  // (packet is shared by all clients, only the one that owns the player uses it for lag info)
+  paDelta.pa_llCreated = paCurrent.pa_llCreated-plb_paLastAction.pa_llCreated;
   // send the delta packet
   (*pnm)<<paDelta;
 }
@@ -52,8 +52,7 @@ public:
   /* Receive action packet from player source. */
   void ReceiveActionPacket(CNetworkMessage *pnm, INDEX iMaxBuffer);
   /* Create action packet for player target from oldest buffered action. */
-  // (prepares lag info for given client number)
-  void CreateActionPacket(CNetworkMessage *pnm, INDEX iClient);
+  void CreateActionPacket(CNetworkMessage *pnm);
   /* Advance action buffer by one tick by removing oldest action. */
   void AdvanceActionBuffer(void);
 };
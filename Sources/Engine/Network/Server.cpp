@@ -54,8 +54,10 @@ CSessionSocket::CSessionSocket(void)
   sso_bActive = FALSE;
   sso_bVIP = FALSE;
   sso_bSendStream = FALSE;
+  sso_iStateSequence = -1;
   sso_iDisconnectedState = 0;
   sso_iLastSentSequence  = -1;
+  sso_iOldestSequence = -1;
   sso_ctBadSyncs = 0;
   sso_tvLastMessageSent.Clear();
   sso_tvLastPingSent.Clear();
@@ -75,12 +77,13 @@ void CSessionSocket::Clear(void)
   sso_bActive = FALSE;
   sso_bVIP = FALSE;
   sso_bSendStream = FALSE;
+  sso_iStateSequence = -1;
   sso_tvMessageReceived.Clear();
   sso_tmLastSyncReceived = -1.0f;
   sso_iLastSentSequence  = -1;
   sso_tvLastMessageSent.Clear();
   sso_tvLastPingSent.Clear();
-  sso_nsBuffer.Clear();
+  sso_iOldestSequence = -1;
   sso_iDisconnectedState = 0;
   sso_ctBadSyncs = 0;
   sso_sspParams.Clear();
@@ -96,6 +99,7 @@ void CSessionSocket::Activate(void)
   sso_bActive = TRUE;
   sso_bVIP = FALSE;
   sso_bSendStream = FALSE;
+  sso_iStateSequence = -1;
   sso_tvMessageReceived.Clear();
   sso_tmLastSyncReceived = -1.0f;
   sso_iLastSentSequence  = -1;
@@ -104,18 +108,19 @@ void CSessionSocket::Activate(void)
   sso_iDisconnectedState = 0;
   sso_ctBadSyncs = 0;
   sso_sspParams.Clear();
-//  sso_nsBuffer.Clear();
+//  sso_iOldestSequence = -1;
 }
 
 void CSessionSocket::Deactivate(void)
 {
+  sso_iStateSequence = -1;
   sso_iDisconnectedState = 0;
   sso_iLastSentSequence  = -1;
   sso_tvLastMessageSent.Clear();
   sso_tvLastPingSent.Clear();
   sso_ctBadSyncs = 0;
   sso_bActive = FALSE;
-  sso_nsBuffer.Clear();
+  sso_iOldestSequence = -1;
   sso_sspParams.Clear();
 }
 BOOL CSessionSocket::IsActive(void)
@@ -177,6 +182,118 @@ CNetworkMessage &operator>>(CNetworkMessage &nm, CSessionSocketParams &ssp)
   return nm;
 }
 
+CStateSnapshot::CStateSnapshot(void)
+{
+  ss_iSequence = -1;
+  ss_hThread = NULL;
+  ss_pstrmDefault = NULL;
+  ss_pstrmState = NULL;
+  ss_pstrmDelta = NULL;
+  ss_pstrmPacked = NULL;
+  ss_slFullSize = 0;
+  ss_slDeltaSize = 0;
+}
+
+CStateSnapshot::~CStateSnapshot(void)
+{
+  Clear();
+}
+
+void CStateSnapshot::Clear(void)
+{
+  // wait for the worker to finish, it is using the streams
+  if (ss_hThread!=NULL) {
+    WaitForSingleObject(ss_hThread, INFINITE);
+    CloseHandle(ss_hThread);
+    ss_hThread = NULL;
+  }
+  FreeWork();
+  if (ss_pstrmPacked !=NULL) { delete ss_pstrmPacked;  ss_pstrmPacked  = NULL; }
+  ss_iSequence = -1;
+  ss_slFullSize = 0;
+  ss_slDeltaSize = 0;
+  ss_strError = "";
+}
+
+BOOL CStateSnapshot::IsBusy(void)
+{
+  if (ss_hThread==NULL) {
+    return FALSE;
+  }
+  // if the worker has not finished yet
+  if (WaitForSingleObject(ss_hThread, 0)!=WAIT_OBJECT_0) {
+    return TRUE;
+  }
+  CloseHandle(ss_hThread);
+  ss_hThread = NULL;
+  FreeWork();
+  return FALSE;
+}
+
+void CStateSnapshot::FreeWork(void)
+{
+  // only the packed stream is needed after packing
+  if (ss_pstrmDefault!=NULL) { delete ss_pstrmDefault; ss_pstrmDefault = NULL; }
+  if (ss_pstrmState  !=NULL) { delete ss_pstrmState;   ss_pstrmState   = NULL; }
+  if (ss_pstrmDelta  !=NULL) { delete ss_pstrmDelta;   ss_pstrmDelta   = NULL; }
+}
+
+static DWORD WINAPI StateSnapshotThread(LPVOID lpParam)
+{
+  ((CStateSnapshot*)lpParam)->Pack();
+  return 0;
+}
+
+void CStateSnapshot::Pack(void)
+{
+  // NOTE: memory streams are all created by the server thread,
+  // worker only reads and writes their buffers
+  try {
+    DIFF_Diff_t(ss_pstrmDefault, ss_pstrmState, ss_pstrmDelta);
+    ss_pstrmDelta->SetPos_t(0);
+    ss_slDeltaSize = ss_pstrmDelta->GetStreamSize();
+    CzlibCompressor comp;
+    comp.PackStream_t(*ss_pstrmDelta, *ss_pstrmPacked);
+  } catch (char *strError) {
+    ss_strError = strError;
+  }
+}
+
+void CStateSnapshot::Start_t(INDEX iSequence)
+{
+  Clear();
+  ss_iSequence = iSequence;
+  ss_pstrmDefault = new CTMemoryStream;
+  ss_pstrmState   = new CTMemoryStream;
+  ss_pstrmDelta   = new CTMemoryStream;
+  ss_pstrmPacked  = new CTMemoryStream;
+
+  try {
+    // write main session state, this must be done while the world is not changing
+    _pNetwork->ga_sesSessionState.Write_t(ss_pstrmState);
+    ss_pstrmState->SetPos_t(0);
+    ss_slFullSize = ss_pstrmState->GetStreamSize();
+
+    // copy the default state, it can be freed on level change while worker is running
+    ss_pstrmDefault->Write_t(_pNetwork->ga_pubDefaultState, _pNetwork->ga_slDefaultStateSize);
+    ss_pstrmDefault->SetPos_t(0);
+
+    (*ss_pstrmPacked)<<INDEX(MSG_REP_STATEDELTA);
+  } catch (char *) {
+    Clear();
+    throw;
+  }
+
+  // diff and compress it on worker thread
+  DWORD dwThreadId;
+  ss_hThread = CreateThread(NULL, 0, StateSnapshotThread, this, 0, &dwThreadId);
+  // if the thread cannot be started, pack it here
+  if (ss_hThread==NULL) {
+    Pack();
+    FreeWork();
+  }
+}
+
 /*
  * Constructor.
  */
@@ -240,6 +357,11 @@ void CServer::Stop(void)
   // stop network driver server
   _cmiComm.Server_Close();
 
+  // drop connection state snapshot
+  srv_ssSnapshot.Clear();
+  // drop all buffered game stream blocks
+  srv_nssBlocks.Clear();
+
   // clear all session
   srv_assoSessions.Clear();
   srv_assoSessions.New(NET_MAXGAMECOMPUTERS);
@@ -266,6 +388,10 @@ void CServer::Start_t(void)
 {
   // init buffer for sync checks
   srv_ascChecks.Clear();
+  // make sure snapshot from previous game is not reused
+  srv_ssSnapshot.Clear();
+  // and that no game stream blocks are left from it
+  srv_nssBlocks.Clear();
 
   // set up structures
   srv_tmLastProcessedTick = 0.0f;
@@ -370,6 +496,21 @@ INDEX CServer::FindSyncCheck(TIME tmTick, CSyncCheck &sc)
   }
 }
 
+/* Pack first part of an uncompressed batch of game stream blocks. */
+static void PackGameStreamBlocks(CNetworkMessage &nmBlocks, SLONG slSize, CNetworkMessage &nmPacked)
+{
+  _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SERVER_PACKGAMESTREAM);
+  _pfNetworkProfile.IncrementCounter(CNetworkProfile::PCI_GAMESTREAM_PACKS);
+  // blocks are byte aligned, so the batch can be cut just by shortening the message
+  SLONG slFullSize = nmBlocks.nm_slSize;
+  nmBlocks.nm_slSize = slSize;
+  nmPacked.Reinit();
+  nmBlocks.PackDefault(nmPacked);
+  nmBlocks.nm_slSize = slFullSize;
+  _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SERVER_PACKGAMESTREAM);
+  _pfNetworkProfile.IncrementTimerAveragingCounter(CNetworkProfile::PTI_SERVER_PACKGAMESTREAM);
+}
+
 /* Send one regular batch of sequences to a client. */
 void CServer::SendGameStreamBlocks(INDEX iClient)
 {
@@ -408,17 +549,30 @@ void CServer::SendGameStreamBlocks(INDEX iClient)
   CNetworkMessage nmPackedBlocks(MSG_GAMESTREAMBLOCKS);
   CNetworkMessage nmPackedBlocksNew(MSG_GAMESTREAMBLOCKS);
 
+  // redundant older blocks must not be allowed more room than new ones
+  ctMinBytes = ClampUp(ctMinBytes, ctMaxBytes);
+
+  // for each gathered block, remember its sequence, the uncompressed batch size
+  // with it included and the packed size it must stay below
+  const INDEX ctMaxBlocks = 100;
+  INDEX aiSequences[ctMaxBlocks];
+  SLONG aslRawSizes[ctMaxBlocks];
+  INDEX actLimits[ctMaxBlocks];
+  INDEX ctBlocks = 0;       // number of blocks gathered in uncompressed message
+  INDEX ctBlocksOk = 1;     // largest batch known to fit (first block is always sent)
+  INDEX ctBlocksBad = -1;   // smallest batch known not to fit
+  INDEX ctBlocksPacked = 0; // batch currently held in packed message
+  INDEX ctNextPack = 2;     // batch size at which to pack next while gathering
+
   // repeat for max 100 sequences
-  INDEX iBlocksOk = 0;
-  INDEX iMaxSent = -1;
-  for(INDEX i=0; i<100; i++) {
-    if (iStep<0 && iBlocksOk>=3) {
+  for(INDEX i=0; i<ctMaxBlocks; i++) {
+    if (iStep<0 && ctBlocks>=3) {
 //      break;
     }
     // get the stream block with current sequence
 //    CPrintF("%d: ", iSequence);
     CNetworkStreamBlock *pnsbBlock;
-    CNetworkStream::Result res = sso.sso_nsBuffer.GetBlockBySequence(iSequence, pnsbBlock);
+    CNetworkStream::Result res = srv_nssBlocks.GetBlockBySequence(sso.sso_iOldestSequence, iSequence, pnsbBlock);
     // if it is not found
     if (res!=CNetworkStream::R_OK) {
       // if going upward
@@ -426,7 +580,7 @@ void CServer::SendGameStreamBlocks(INDEX iClient)
 //        // if this block is missing
 //        && res==CNetworkStream::R_BLOCKMISSING
         // if none sent so far
-        if (iBlocksOk<=0) {
+        if (ctBlocks<=0) {
           // give up
 //          CPrintF("giving up\n");
           break; 
@@ -453,25 +607,63 @@ void CServer::SendGameStreamBlocks(INDEX iClient)
       break;
     }
 
-    // add this block to the message and pack it
+    // add this block to the uncompressed message
     pnsbBlock->WriteToMessage(nmGameStreamBlocks);
-    nmPackedBlocksNew.Reinit();
-    nmGameStreamBlocks.PackDefault(nmPackedBlocksNew);
-    // if some blocks written already and the batch is too large
-    if (iBlocksOk>0) {
-      if (iStep>0 && nmPackedBlocksNew.nm_slSize>=ctMaxBytes ||
-          iStep<0 && nmPackedBlocksNew.nm_slSize>=ctMinBytes ) {
-        // stop
+    aiSequences[ctBlocks] = iSequence;
+    aslRawSizes[ctBlocks] = nmGameStreamBlocks.nm_slSize;
+    actLimits[ctBlocks] = iStep>0 ? ctMaxBytes : ctMinBytes;
+    ctBlocks++;
+    iSequence+= iStep;
+
+    // pack only at doubling batch sizes while gathering
+    if (ctBlocks==ctNextPack) {
+      ctNextPack*=2;
+      PackGameStreamBlocks(nmGameStreamBlocks, aslRawSizes[ctBlocks-1], nmPackedBlocksNew);
+      // if the batch is too large
+      if (nmPackedBlocksNew.nm_slSize>=actLimits[ctBlocks-1]) {
+        // stop gathering
 //        CPrintF("toomuch ");
+        ctBlocksBad = ctBlocks;
         break;
       }
+      // use new pack
+      nmPackedBlocks = nmPackedBlocksNew;
+      ctBlocksOk = ctBlocksPacked = ctBlocks;
     }
-    // use new pack
-//    CPrintF("added ");
-    nmPackedBlocks = nmPackedBlocksNew;
-    iMaxSent = Max(iMaxSent, iSequence);
-    iSequence+= iStep;
-    iBlocksOk++;
+  }
+
+  // if all gathered blocks might fit, but were not packed together yet
+  if (ctBlocksBad<0 && ctBlocks>ctBlocksOk) {
+    // check the whole batch
+    PackGameStreamBlocks(nmGameStreamBlocks, aslRawSizes[ctBlocks-1], nmPackedBlocksNew);
+    if (nmPackedBlocksNew.nm_slSize>=actLimits[ctBlocks-1]) {
+      ctBlocksBad = ctBlocks;
+    } else {
+      nmPackedBlocks = nmPackedBlocksNew;
+      ctBlocksOk = ctBlocksPacked = ctBlocks;
+    }
+  }
+  // bisect between largest batch that fits and smallest one that doesn't
+  if (ctBlocksBad>0) {
+    while (ctBlocksBad-ctBlocksOk>1) {
+      INDEX ctTry = (ctBlocksOk+ctBlocksBad)/2;
+      PackGameStreamBlocks(nmGameStreamBlocks, aslRawSizes[ctTry-1], nmPackedBlocksNew);
+      if (nmPackedBlocksNew.nm_slSize>=actLimits[ctTry-1]) {
+        ctBlocksBad = ctTry;
+      } else {
+        nmPackedBlocks = nmPackedBlocksNew;
+        ctBlocksOk = ctBlocksPacked = ctTry;
+      }
+    }
+  }
+  INDEX iBlocksOk = Min(ctBlocks, ctBlocksOk);
+  // pack the final batch if it isn't packed already
+  if (iBlocksOk>0 && ctBlocksPacked!=iBlocksOk) {
+    PackGameStreamBlocks(nmGameStreamBlocks, aslRawSizes[iBlocksOk-1], nmPackedBlocks);
+  }
+  INDEX iMaxSent = -1;
+  for (INDEX iBlock=0; iBlock<iBlocksOk; iBlock++) {
+    iMaxSent = Max(iMaxSent, aiSequences[iBlock]);
   }
 
   // if no blocks to write
@@ -497,7 +689,7 @@ void CServer::SendGameStreamBlocks(INDEX iClient)
 
   // remove the block(s) that fall out of the buffer
   extern INDEX ser_iRememberBehind;
-  sso.sso_nsBuffer.RemoveOlderBlocksBySequence(srv_iLastProcessedSequence-ser_iRememberBehind);
+  sso.sso_iOldestSequence = Max(sso.sso_iOldestSequence, srv_iLastProcessedSequence-ser_iRememberBehind);
 
 
   // if haven't sent pings for some time
@@ -543,7 +735,7 @@ void CServer::ResendGameStreamBlocks(INDEX iClient, INDEX iSequence0, INDEX ctSe
   for(; iSequence<iSequence0+ctSequences; iSequence++) {
     // get the stream block with that sequence
     CNetworkStreamBlock *pnsbBlock;
-    CNetworkStream::Result res = sso.sso_nsBuffer.GetBlockBySequence(iSequence, pnsbBlock);
+    CNetworkStream::Result res = srv_nssBlocks.GetBlockBySequence(sso.sso_iOldestSequence, iSequence, pnsbBlock);
     // if it is not found
     if (res!=CNetworkStream::R_OK) {
       // tell the requesting session state to disconnect
@@ -727,6 +919,8 @@ void CServer::ServerLoop(void)
 //  }
   // handle all incoming messages
   HandleAll();
+  // send connection state to joining clients when it gets packed
+  HandleStateSnapshot();
 
   INDEX iSpeed = 1;
   extern INDEX ser_bWaitFirstPlayer;
@@ -763,6 +957,8 @@ void CServer::ServerLoop(void)
     // send one regular batch of sequences to the client
     SendGameStreamBlocks(iSession);
   }
+  // free blocks that are not buffered for any client anymore
+  FreeUnusedBlocks();
 
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SERVER_LOOP);
 }
@@ -774,36 +970,28 @@ void CServer::MakeAllActions(void)
   srv_tmLastProcessedTick += _pTimer->TickQuantum;
   srv_iLastProcessedSequence++;
 
-  // for each active session
-  for(INDEX iSession=0; iSession<srv_assoSessions.Count(); iSession++) {
-    CSessionSocket &sso = srv_assoSessions[iSession];
-    if (iSession>0 && !sso.IsActive()) {
-      continue;
-    }
-
-    // create all-actions message
-    CNetworkStreamBlock nsbAllActions(MSG_SEQ_ALLACTIONS, srv_iLastProcessedSequence);
-    // write time there
-    nsbAllActions<<srv_tmLastProcessedTick;
+  // create all-actions message (same one is sent to all sessions)
+  CNetworkStreamBlock nsbAllActions(MSG_SEQ_ALLACTIONS, srv_iLastProcessedSequence);
+  // write time there
+  nsbAllActions<<srv_tmLastProcessedTick;
 
-    // for all players in game
-    INDEX iPlayer = 0;
-    FOREACHINSTATICARRAY(srv_aplbPlayers, CPlayerBuffer, itplb) {
-      // if player is active
-      if (itplb->IsActive()) {
+  // for all players in game
+  INDEX iPlayer = 0;
+  FOREACHINSTATICARRAY(srv_aplbPlayers, CPlayerBuffer, itplb) {
+    // if player is active
+    if (itplb->IsActive()) {
   // player indices transmission is unneccessary unless if debugging
-  //            // write its index
-  //            nsbAllActions<<iPlayer;
-        // write its action
-        itplb->CreateActionPacket(&nsbAllActions, iSession);
-      }
-      iPlayer++;
+  //          // write its index
+  //          nsbAllActions<<iPlayer;
+      // write its action
+      itplb->CreateActionPacket(&nsbAllActions);
     }
-
-    // add the all-actions block to the buffer
-    sso.sso_nsBuffer.AddBlock(nsbAllActions);
+    iPlayer++;
   }
 
+  // add the all-actions block to the buffer
+  srv_nssBlocks.AddBlock(nsbAllActions);
+
   // for all players in game
   {FOREACHINSTATICARRAY(srv_aplbPlayers, CPlayerBuffer, itplb) {
     // if player is active
@@ -817,16 +1005,24 @@ void CServer::MakeAllActions(void)
 // add a block to streams for all sessions
 void CServer::AddBlockToAllSessions(CNetworkStreamBlock &nsb)
 {
-  // for each active session
+  // add the block to the shared buffer
+  srv_nssBlocks.AddBlock(nsb);
+}
+
+// free buffered blocks that no session needs anymore
+void CServer::FreeUnusedBlocks(void)
+{
+  // find oldest sequence still buffered for any active session
+  INDEX iOldest = srv_nssBlocks.GetNewestSequence()+1;
   for(INDEX iSession=0; iSession<srv_assoSessions.Count(); iSession++) {
     CSessionSocket &sso = srv_assoSessions[iSession];
     if (iSession>0 && !sso.IsActive()) {
       continue;
     }
-
-    // add the block to the buffer
-    sso.sso_nsBuffer.AddBlock(nsb);
+    iOldest = Min(iOldest, sso.sso_iOldestSequence);
   }
+  // remove all blocks before it
+  srv_nssBlocks.RemoveOlderBlocksBySequence(iOldest);
 }
 
 /* Send initialization info to local client. */
@@ -1022,70 +1218,104 @@ void CServer::SendSessionStateData(INDEX iClient)
   ASSERT(iClient>0);
   // find session of this client
   CSessionSocket &sso = srv_assoSessions[iClient];
-  // copy its buffer from local session state
-  sso.sso_nsBuffer.Copy(srv_assoSessions[0].sso_nsBuffer);
-
-  // try to
-  try {
-    // prepare files or memory streams for connection info
-    CTFileStream strmStateFile; CTMemoryStream strmStateMem;
-    CTFileStream strmDeltaFile; CTMemoryStream strmDeltaMem;
-    CTStream *pstrmState; CTMemoryStream *pstrmDelta;
-    extern INDEX net_bDumpConnectionInfo;
-
-    UBYTE* pubSrc = NULL;
-    /*if (net_bDumpConnectionInfo) {
-      strmStateFile.Create_t(CTString("Temp\\State.bin"));
-      strmDeltaFile.Create_t(CTString("Temp\\Delta.bin"));
-      pstrmState = &strmStateFile;
-      pstrmDelta = &strmDeltaFile;
-    } else {*/
-      pstrmState = &strmStateMem;
-      pstrmDelta = &strmDeltaMem;
-
-      pubSrc = strmDeltaMem.mstrm_pubBuffer + strmDeltaMem.mstrm_slLocation;
-    //}
-
-    ASSERT(pubSrc != NULL);
-
-    // write main session state
-    _pNetwork->ga_sesSessionState.Write_t(pstrmState);
-    pstrmState->SetPos_t(0);
-    SLONG slFullSize = pstrmState->GetStreamSize();
+  // it can use all blocks still buffered for local session state
+  sso.sso_iOldestSequence = srv_assoSessions[0].sso_iOldestSequence;
+  // any state taken from now on fits that buffer
+  INDEX iSequence = _pNetwork->ga_sesSessionState.ses_iLastProcessedSequence;
+  sso.sso_iStateSequence = iSequence;
+
+  // if there is no snapshot for this tick and none is being packed
+  if (srv_ssSnapshot.ss_iSequence!=iSequence && !srv_ssSnapshot.IsBusy()) {
+    // try to
+    try {
+      // take a new one, all clients joining in this tick will share it
+      srv_ssSnapshot.Start_t(iSequence);
+
+    // if failed
+    } catch (char *strError) {
+      // deactivate it
+      sso.Deactivate();
 
-    CTMemoryStream strmInfo;
-    strmInfo<<INDEX(MSG_REP_STATEDELTA);
-
-    // compress it to another one, using delta from original
-    CTMemoryStream strmDefaultState;
-    strmDefaultState.Write_t
-      (_pNetwork->ga_pubDefaultState, _pNetwork->ga_slDefaultStateSize);
-    strmDefaultState.SetPos_t(0);
-    DIFF_Diff_t(&strmDefaultState, pstrmState, pstrmDelta);
-    pstrmDelta->SetPos_t(0);
-    SLONG slDeltaSize = pstrmDelta->GetStreamSize();
-    CzlibCompressor comp;
-    comp.PackStream_t(*pstrmDelta, strmInfo);
+      // report error
+      CPrintF(TRANS("Server: Cannot prepare connection data: %s\n"), strError);
+      return;
+    }
+  }
 
-    SLONG slSize = strmInfo.GetStreamSize();
+  // send it right away if it is already packed
+  HandleStateSnapshot();
+}
 
-    // send the stream to the remote session state
-    _pNetwork->SendToClientReliable(iClient, strmInfo);
-  
-    CPrintF(TRANS("Server: Sent connection data to '%s' (%dk->%dk->%dk)\n"),
-      (const char*)_cmiComm.Server_GetClientName(iClient), 
-      slFullSize/1024, slDeltaSize/1024, slSize/1024);
-    if (net_bDumpConnectionInfo) {
-      CPrintF(TRANS("Server: Connection data dumped.\n"));
-    }
+/* Send packed session state snapshot to remote client. */
+void CServer::SendStateSnapshot(INDEX iClient)
+{
+  CSessionSocket &sso = srv_assoSessions[iClient];
+  sso.sso_iStateSequence = -1;
 
-  // if failed
-  } catch (char *strError) {
+  // if packing failed
+  if (srv_ssSnapshot.ss_strError!="") {
     // deactivate it
     sso.Deactivate();
 
     // report error
-    CPrintF(TRANS("Server: Cannot prepare connection data: %s\n"), strError);
+    CPrintF(TRANS("Server: Cannot prepare connection data: %s\n"), (const char*)srv_ssSnapshot.ss_strError);
+    return;
+  }
+
+  // send the stream to the remote session state
+  CTMemoryStream &strmInfo = *srv_ssSnapshot.ss_pstrmPacked;
+  _pNetwork->SendToClientReliable(iClient, strmInfo);
+
+  SLONG slSize = strmInfo.GetStreamSize();
+  CPrintF(TRANS("Server: Sent connection data to '%s' (%dk->%dk->%dk)\n"),
+    (const char*)_cmiComm.Server_GetClientName(iClient), 
+    srv_ssSnapshot.ss_slFullSize/1024, srv_ssSnapshot.ss_slDeltaSize/1024, slSize/1024);
+}
+
+/* Send finished session state snapshot to all clients waiting for it. */
+void CServer::HandleStateSnapshot(void)
+{
+  // if there is no snapshot or it is still being packed
+  if (srv_ssSnapshot.ss_iSequence<0 || srv_ssSnapshot.IsBusy()) {
+    // nothing to do yet
+    return;
+  }
+
+  BOOL bNeedNew = FALSE;
+  // for each client waiting for connection state
+  for(INDEX iClient=1; iClient<srv_assoSessions.Count(); iClient++) {
+    CSessionSocket &sso = srv_assoSessions[iClient];
+    if (!sso.IsActive() || sso.sso_iStateSequence<0) {
+      continue;
+    }
+    // if the snapshot is older than its game stream buffer
+    if (srv_ssSnapshot.ss_iSequence<sso.sso_iStateSequence) {
+      // it needs a newer one
+      bNeedNew = TRUE;
+      continue;
+    }
+    SendStateSnapshot(iClient);
+  }
+
+  // if packing failed, don't reuse it
+  if (srv_ssSnapshot.ss_strError!="") {
+    srv_ssSnapshot.Clear();
+  }
+
+  // if some clients need a newer snapshot
+  if (bNeedNew) {
+    try {
+      srv_ssSnapshot.Start_t(_pNetwork->ga_sesSessionState.ses_iLastProcessedSequence);
+    } catch (char *strError) {
+      // deactivate all clients that were waiting for it
+      for(INDEX iClient=1; iClient<srv_assoSessions.Count(); iClient++) {
+        CSessionSocket &sso = srv_assoSessions[iClient];
+        if (sso.IsActive() && sso.sso_iStateSequence>=0) {
+          sso.Deactivate();
+        }
+      }
+      CPrintF(TRANS("Server: Cannot prepare connection data: %s\n"), strError);
+    }
   }
 }
 
@@ -1399,7 +1629,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
         // flush the clients stream buffer up to that sequence 
         // (the sync is used as piggy-backed acknowledge of packet receival)
         CSessionSocket &sso = srv_assoSessions[iClient];
-        sso.sso_nsBuffer.RemoveOlderBlocksBySequence(scRemote.sc_iSequence);
+        sso.sso_iOldestSequence = Max(sso.sso_iOldestSequence, scRemote.sc_iSequence);
 
         // if level was changed
         if (scLocal.sc_iLevel!=scRemote.sc_iLevel) {
@@ -1564,7 +1794,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
       // use the piggybacked sequence number to initiate sending stream to it
       CSessionSocket &sso = srv_assoSessions[iClient];
       sso.sso_bSendStream = TRUE;
-      sso.sso_nsBuffer.RemoveOlderBlocksBySequence(iLastSequence);
+      sso.sso_iOldestSequence = Max(sso.sso_iOldestSequence, iLastSequence);
       sso.sso_iLastSentSequence = iLastSequence;
     }
    
@@ -24,6 +24,35 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Network/SessionState.h>
 #include <Engine/Templates/StaticArray.h>
 
+/*
+ * Connection state snapshot, shared by all clients that ask for it in the same tick
+ */
+class CStateSnapshot {
+public:
+  INDEX ss_iSequence;       // session state sequence the snapshot was taken at (-1 if none)
+  void *ss_hThread;         // worker thread that is packing the snapshot (NULL when done)
+  CTMemoryStream *ss_pstrmDefault;  // default state that delta is made from
+  CTMemoryStream *ss_pstrmState;    // full session state
+  CTMemoryStream *ss_pstrmDelta;    // delta between default and full state
+  CTMemoryStream *ss_pstrmPacked;   // packed delta, ready for sending
+  SLONG ss_slFullSize;      // size of full state
+  SLONG ss_slDeltaSize;     // size of delta
+  CTString ss_strError;     // set if packing failed
+public:
+  CStateSnapshot(void);
+  ~CStateSnapshot(void);
+  /* Wait for the worker and free the snapshot. */
+  void Clear(void);
+  /* Take a snapshot of the session state and start packing it on the worker thread. */
+  void Start_t(INDEX iSequence); // throw char *
+  /* Check if the worker thread is still packing the snapshot. */
+  BOOL IsBusy(void);
+  /* Free streams that are needed only while packing. */
+  void FreeWork(void);
+  /* Pack the snapshot (runs on the worker thread). */
+  void Pack(void);
+};
+
 /*
  * Server, manages game joining and similar, routes messages from PlayerSource to PlayerTarget
  */
@@ -41,6 +70,8 @@ public:
   BOOL srv_bPause;      // set while game is paused
   BOOL srv_bGameFinished; // set while game is finished
   FLOAT srv_fServerStep;  // counter for smooth time slowdown/speedup
+  CStateSnapshot srv_ssSnapshot;  // connection state for clients that are joining
+  CNetworkStreamStore srv_nssBlocks;  // game stream blocks buffered for sending to all sessions
 public:
   /* Send disconnect message to some client. */
   void SendDisconnectMessage(INDEX iClient, const char *strExplanation, BOOL bStream = FALSE);
@@ -67,6 +98,10 @@ public:
   void ConnectRemoteSessionState(INDEX iClient, CNetworkMessage &nm);
   /* Send session state data to remote client. */
   void SendSessionStateData(INDEX iClient);
+  /* Send packed session state snapshot to remote client. */
+  void SendStateSnapshot(INDEX iClient);
+  /* Send finished session state snapshot to all clients waiting for it. */
+  void HandleStateSnapshot(void);
 
   /* Send one regular batch of sequences to a client. */
   void SendGameStreamBlocks(INDEX iClient);
@@ -82,6 +117,8 @@ public:
   void MakeAllActions(void);
   // add a block to streams for all sessions
   void AddBlockToAllSessions(CNetworkStreamBlock &nsb);
+  // free buffered blocks that no session needs anymore
+  void FreeUnusedBlocks(void);
   // find a mask of all players on a certain client
   ULONG MaskOfPlayersOnClient(INDEX iClient);
 public:
@@ -46,6 +46,7 @@ class CSessionSocket {
 public:
   BOOL sso_bActive;
   BOOL sso_bSendStream;
+  INDEX sso_iStateSequence;   // oldest state sequence usable for this client (-1 if not waiting for state)
   CTimerValue sso_tvMessageReceived;
   TIME sso_tmLastSyncReceived;
   INDEX sso_iDisconnectedState;
@@ -53,7 +54,7 @@ public:
   INDEX sso_ctBadSyncs;   // counter of bad sync in row
   CTimerValue sso_tvLastMessageSent;    // for sending keep-alive messages
   CTimerValue sso_tvLastPingSent;       // for sending ping
-  CNetworkStream sso_nsBuffer;  // stream of blocks buffered for sending
+  INDEX sso_iOldestSequence;    // oldest sequence still buffered for sending (-1 for all)
   CSessionSocketParams sso_sspParams; // parameters that the client wants
   INDEX sso_ctLocalPlayers;     // number of players that this client will connect
   BOOL sso_bVIP;          // set if the client was successfully authorized as a VIP
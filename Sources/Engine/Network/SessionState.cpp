@@ -41,6 +41,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Templates/DynamicContainer.cpp>
 #include <Engine/Templates/StaticArray.cpp>
+#include <Engine/Templates/StaticStackArray.cpp>
 #include <Engine/Base/ListIterator.inl>
 #include <Engine/Base/CRC.h>
 
@@ -697,33 +698,25 @@ void CSessionState::HandleTimers(TIME tmCurrentTick)
   IFDEBUG(TIME tmLast = 0.0f);
 
   _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_HANDLETIMERS);
+  CWorld &wo = _pNetwork->ga_World;
+  // due timers of non-predictors that are skipped while predicting
+  CStaticStackArray<CEntityPointer> apenSkipped;
   // repeat
-  CListHead &lhTimers = _pNetwork->ga_World.wo_lhTimers;
   FOREVER {
-    // no entity found initially
-    CRationalEntity *penTimer = NULL;
-    // for each entity in list of timers
-    FOREACHINLIST(CRationalEntity, en_lnInTimers, lhTimers, iten) {
-      // if due after current time
-      if(iten->en_timeTimer>tmCurrentTick+TIME_EPSILON) {
-        // stop searching
-        break;
-      }
-      // if now predicting and it is not a predictor
-      if (ses_bPredicting && !iten->IsPredictor()) {
-        // skip it
-        continue;
-      }
-      // remember found entity, and stop searching
-      penTimer = iten;
-      break;
-    }
-
-    // if no entity is found
-    if (penTimer==NULL) {
+    // get the first entity in list of timers
+    CRationalEntity *penTimer = wo.FirstTimer();
+    // if none, or it is due after current time
+    if (penTimer==NULL || penTimer->en_timeTimer>tmCurrentTick+TIME_EPSILON) {
       // stop
       break;
     }
+    // if now predicting and it is not a predictor
+    if (ses_bPredicting && !penTimer->IsPredictor()) {
+      // take it out until all predictors are handled
+      apenSkipped.Push() = penTimer;
+      wo.RemoveTimer(penTimer);
+      continue;
+    }
 
     // check that timers are propertly handled
     ASSERT(penTimer->en_timeTimer>tmCurrentTick-_pTimer->TickQuantum-TIME_EPSILON);
@@ -732,11 +725,25 @@ void CSessionState::HandleTimers(TIME tmCurrentTick)
 
     // remove the timer from the list
     penTimer->en_timeTimer = THINKTIME_NEVER;
-    penTimer->en_lnInTimers.Remove();
+    wo.RemoveTimer(penTimer);
+    _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_TIMERSFIRED);
     // send timer event to the entity
     penTimer->SendEvent(ETimer());
   }
 
+  // if some timers were skipped
+  if (apenSkipped.Count()>0) {
+    // put back those that were not rescheduled meanwhile, in their original order
+    CStaticStackArray<CRationalEntity *> apenRestore;
+    for (INDEX i=0; i<apenSkipped.Count(); i++) {
+      CRationalEntity *pen = (CRationalEntity *)(CEntity *)apenSkipped[i];
+      if (!pen->IsTimerSet() && pen->en_timeTimer!=THINKTIME_NEVER) {
+        apenRestore.Push() = pen;
+      }
+    }
+    wo.SetTimersOrder(apenRestore);
+  }
+
   // handle all the sent events
   CEntity::HandleSentEvents();
   _pfPhysicsProfile.StopTimer(CPhysicsProfile::PTI_HANDLETIMERS);
@@ -901,9 +908,12 @@ void ClearDumpStream(void)
  */
 
 extern INDEX cli_bEmulateDesync;
+extern void BeginEventStatsTick(void);
+extern void EndEventStatsTick(void);
 void CSessionState::ProcessGameTick(CNetworkMessage &nmMessage, TIME tmCurrentTick)
 {
   ses_tmLastPredictionProcessed = -1;
+  BeginEventStatsTick();
 
   _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_PROCESSGAMETICK);
   ASSERT(this!=NULL);
@@ -1009,6 +1019,7 @@ void CSessionState::ProcessGameTick(CNetworkMessage &nmMessage, TIME tmCurrentTi
 
   ses_tmPredictionHeadTick = Max(ses_tmPredictionHeadTick, tmCurrentTick);
 
+  EndEventStatsTick();
   _pfPhysicsProfile.StopTimer(CPhysicsProfile::PTI_PROCESSGAMETICK);
 
   // assure that FPU precision was low all the rendering time
@@ -1657,13 +1668,13 @@ void CSessionState::ReadWorldAndState_t(CTStream *pstr)   // throw char *
   // read world situation
   _pNetwork->ga_World.ReadState_t(pstr);
 
-  // create an empty list for relinking timers
-  CListHead lhNewTimers;
+  // create an empty list for reordering timers
+  CStaticStackArray<CRationalEntity *> apenNewTimers;
   // read number of entities in timer list
   pstr->ExpectID_t("TMRS");   // timers
   INDEX ctTimers;
   *pstr>>ctTimers;
-//  ASSERT(ctTimers == _pNetwork->ga_World.wo_lhTimers.Count());
+//  ASSERT(ctTimers == _pNetwork->ga_World.wo_apenTimers.Count());
   // for each entity in the timer list
   {for(INDEX ienTimer=0; ienTimer<ctTimers; ienTimer++) {
     // read its index in container of all entities
@@ -1671,15 +1682,14 @@ void CSessionState::ReadWorldAndState_t(CTStream *pstr)   // throw char *
     *pstr>>ien;
     // get the entity
     CRationalEntity *pen = (CRationalEntity*)_pNetwork->ga_World.EntityFromID(ien);
-    // remove it from the timer list and add it at the end of the new timer list
-    if (pen->en_lnInTimers.IsLinked()) {
-      pen->en_lnInTimers.Remove();
-      lhNewTimers.AddTail(pen->en_lnInTimers);
+    // add it at the end of the new timer list
+    if (pen->IsTimerSet()) {
+      apenNewTimers.Push() = pen;
     }
   }}
-  // use the new timer list instead the old one
-  ASSERT(_pNetwork->ga_World.wo_lhTimers.IsEmpty());
-  _pNetwork->ga_World.wo_lhTimers.MoveList(lhNewTimers);
+  // reschedule the timers in the order they were saved
+  ASSERT(apenNewTimers.Count()==_pNetwork->ga_World.wo_apenTimers.Count());
+  _pNetwork->ga_World.SetTimersOrder(apenNewTimers);
 
   // create an empty list for relinking movers
   CListHead lhNewMovers;
@@ -1787,12 +1797,13 @@ void CSessionState::WriteWorldAndState_t(CTStream *pstr)   // throw char *
 
   // write number of entities in timer list
   pstr->WriteID_t("TMRS");   // timers
-  CListHead &lhTimers = _pNetwork->ga_World.wo_lhTimers;
-  *pstr<<lhTimers.Count();
+  CStaticStackArray<CRationalEntity *> apenTimers;
+  _pNetwork->ga_World.GetTimersInOrder(apenTimers);
+  *pstr<<apenTimers.Count();
   // for each entity in the timer list
-  {FOREACHINLIST(CRationalEntity, en_lnInTimers, lhTimers, iten) {
+  {for(INDEX ienTimer=0; ienTimer<apenTimers.Count(); ienTimer++) {
     // save its index in container
-    *pstr<<iten->en_ulID;
+    *pstr<<apenTimers[ienTimer]->en_ulID;
   }}
 
   // write number of entities in mover list
@@ -311,39 +311,19 @@ void CRenderer::AddEdgeToAddAndRemoveLists(CScreenEdge &sed)
   sed.sed_psedNextRemove = re_apsedRemoveFirst[iBottomLine];
   re_apsedRemoveFirst[iBottomLine] = &sed;
 
-  // search all edges in the add list of top scan line of this edge
-  INDEX iTopLine = sed.sed_pixTopJ-re_pixTopScanLineJ;
-  CListNode *plnInList = re_alhAddLists[iTopLine].lh_Head;
-  re_actAddCounts[iTopLine]++;
-  SLONG slIThis = sed.sed_xI.slHolder;
-
   ASSERT(sed.sed_xI > FIX16_16(re_fbbClipBox.Min()(1)-SENTINELEDGE_EPSILON));
   ASSERT(sed.sed_xI < FIX16_16(re_fbbClipBox.Max()(1)+SENTINELEDGE_EPSILON));
 
-  SLONG slIInList;
-  while(plnInList->ln_Succ!=NULL) {
-    slIInList = 
-      ((CAddEdge*)((UBYTE*)plnInList-offsetof(CAddEdge, ade_lnInAdd))) -> ade_xI.slHolder;
-    // if the edge in list is right of the one to add
-    if (slIInList>slIThis) {
-      // stop searching
-      break;
-    }
-    plnInList = plnInList->ln_Succ;
-  }
-  // add it to add list
+  // add it to the front of add list at its top scan line
+  // (list is sorted only when it gets merged into active list)
+  INDEX iTopLine = sed.sed_pixTopJ-re_pixTopScanLineJ;
   CAddEdge &ade = re_aadeAddEdges.Push();
   ade = CAddEdge(&sed);
-  CListNode *plnThis  = &ade.ade_lnInAdd;
-  CListNode *plnAfter  = plnInList;
-  CListNode *plnBefore = plnInList->ln_Pred;
-  plnThis->ln_Succ = plnAfter;
-  plnThis->ln_Pred = plnBefore;
-  plnBefore->ln_Succ = plnThis;
-  plnAfter->ln_Pred = plnThis;
+  ade.ade_padeNext = re_apadeAddFirst[iTopLine];
+  re_apadeAddFirst[iTopLine] = &ade;
+  re_actAddCounts[iTopLine]++;
   // mark that it is added
   sed.sed_bAdded = TRUE;
-  ASSERT(re_actAddCounts[iTopLine]==re_alhAddLists[iTopLine].Count());
 
   _pfRenderProfile.StopTimer(CRenderProfile::PTI_ADDEDGETOADDLIST);
 }
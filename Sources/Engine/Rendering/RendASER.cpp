@@ -13,6 +13,64 @@ You should have received a copy of the GNU General Public License along
 with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
 
+/*
+ * Sort edges by their I coordinate, keeping order of edges with same coordinate.
+ */
+static void SortAddedEdges(CStaticStackArray<CActiveEdge> &aace, CStaticStackArray<CActiveEdge> &aaceTmp)
+{
+  const INDEX ctEdges = aace.Count();
+  const INDEX ctRun = 16;
+  CActiveEdge *paceSrc = &aace[0];
+
+  // sort short runs by insertion
+  for (INDEX iRun=0; iRun<ctEdges; iRun+=ctRun) {
+    CActiveEdge *paceRun = paceSrc+iRun;
+    INDEX ctInRun = Min(ctRun, ctEdges-iRun);
+    for (INDEX iEdge=1; iEdge<ctInRun; iEdge++) {
+      CActiveEdge aceCurrent = paceRun[iEdge];
+      INDEX iPlace = iEdge;
+      while (iPlace>0 && paceRun[iPlace-1].ace_xI.slHolder > aceCurrent.ace_xI.slHolder) {
+        paceRun[iPlace] = paceRun[iPlace-1];
+        iPlace--;
+      }
+      paceRun[iPlace] = aceCurrent;
+    }
+  }
+  // if there is only one run
+  if (ctEdges<=ctRun) {
+    // it is sorted already
+    return;
+  }
+
+  // merge runs of doubling length back and forth between the two buffers
+  aaceTmp.PopAll();
+  CActiveEdge *paceDst = aaceTmp.Push(ctEdges);
+  for (INDEX ctWidth=ctRun; ctWidth<ctEdges; ctWidth*=2) {
+    for (INDEX iLeft=0; iLeft<ctEdges; iLeft+=2*ctWidth) {
+      INDEX iMiddle = Min(iLeft+ctWidth, ctEdges);
+      INDEX iEnd = Min(iLeft+2*ctWidth, ctEdges);
+      INDEX i0 = iLeft;
+      INDEX i1 = iMiddle;
+      INDEX iDst = iLeft;
+      while (i0<iMiddle && i1<iEnd) {
+        // on same coordinate take the left one, to keep the order
+        if (paceSrc[i1].ace_xI.slHolder < paceSrc[i0].ace_xI.slHolder) {
+          paceDst[iDst++] = paceSrc[i1++];
+        } else {
+          paceDst[iDst++] = paceSrc[i0++];
+        }
+      }
+      while (i0<iMiddle) paceDst[iDst++] = paceSrc[i0++];
+      while (i1<iEnd)    paceDst[iDst++] = paceSrc[i1++];
+    }
+    Swap(paceSrc, paceDst);
+  }
+  // if result ended up in temporary buffer, copy it back
+  if (paceSrc!=&aace[0]) {
+    memcpy(&aace[0], paceSrc, ctEdges*sizeof(CActiveEdge));
+  }
+}
+
 /*
  * Add all edges in add list to active list.
  */
@@ -26,11 +84,26 @@ void CRenderer::AddAddListToActiveList(INDEX iScanLine)
   }
 
   _pfRenderProfile.StartTimer(CRenderProfile::PTI_ADDADDLIST);
-  CListHead &lhAdd = re_alhAddLists[iScanLine];
-  ASSERT(ctAddEdges==lhAdd.Count());
   // mark that scan-line coherence is lost
   re_bCoherentScanLine = 0;
 
+  // copy the add list to an array in order in which edges were added
+  // (list starts with the last added one)
+  _pfRenderProfile.StartTimer(CRenderProfile::PTI_SORTADDLIST);
+  re_aaceAddSorted.PopAll();
+  CActiveEdge *paceAdd = re_aaceAddSorted.Push(ctAddEdges)+ctAddEdges;
+  for (CAddEdge *pade=re_apadeAddFirst[iScanLine]; pade!=NULL; pade=pade->ade_padeNext) {
+    ASSERT(pade->ade_xI.slHolder == pade->ade_psedEdge->sed_xI.slHolder);
+    *--paceAdd = CActiveEdge(pade->ade_psedEdge);
+  }
+  ASSERT(paceAdd==&re_aaceAddSorted[0]);
+  // clear the add list
+  re_apadeAddFirst[iScanLine] = NULL;
+  re_actAddCounts[iScanLine] = 0;
+  // sort the edges, same as if they were inserted one by one
+  SortAddedEdges(re_aaceAddSorted, re_aaceAddSortedTmp);
+  _pfRenderProfile.StopTimer(CRenderProfile::PTI_SORTADDLIST);
+
   // allocate space in destination for sum of source and add
   INDEX ctActiveEdges = re_aaceActiveEdges.Count();
   re_aaceActiveEdgesTmp.Push(ctAddEdges+ctActiveEdges);
@@ -38,16 +111,12 @@ void CRenderer::AddAddListToActiveList(INDEX iScanLine)
   // check that the add list is sorted right
   #if ASER_EXTREME_CHECKING
   {
-    LISTITER(CAddEdge, ade_lnInAdd) itadeAdd(lhAdd);
-    FIX16_16 xLastI;
-    xLastI.slHolder = MIN_SLONG;
-    while(!itadeAdd.IsPastEnd()) {
-      CAddEdge &adeAdd = *itadeAdd;
-      ASSERT(adeAdd.ade_xI==adeAdd.ade_psedEdge->sed_xI);
-      ASSERT(xLastI.slHolder <= adeAdd.ade_xI.slHolder);
-      xLastI = adeAdd.ade_xI;
-      itadeAdd.MoveToNext();
-    }
+    CActiveEdge *paceEnd = &re_aaceAddSorted[ctAddEdges-1];
+    CActiveEdge *paceSrc = &re_aaceAddSorted[0];
+    while (paceSrc<paceEnd) {
+      ASSERT(paceSrc[0].ace_xI.slHolder <= paceSrc[1].ace_xI.slHolder);
+      paceSrc++;
+    };
   }
   #endif
 
@@ -64,7 +133,7 @@ void CRenderer::AddAddListToActiveList(INDEX iScanLine)
   #endif
 
   // start at begining of add list, source active list and destination active list
-  LISTITER(CAddEdge, ade_lnInAdd) itadeAdd(lhAdd);
+  CActiveEdge *paceAddEnd = paceAdd+ctAddEdges;
   CActiveEdge *paceSrc = &re_aaceActiveEdges[0];
   CActiveEdge *paceDst = &re_aaceActiveEdgesTmp[0];
 
@@ -73,11 +142,9 @@ void CRenderer::AddAddListToActiveList(INDEX iScanLine)
   IFDEBUG(INDEX ctOldActive2=0);
 
   // for each edge in add list
-  while(!itadeAdd.IsPastEnd()) {
-    CAddEdge &ade = *itadeAdd;
-
+  while (paceAdd<paceAddEnd) {
     // while the edge in active list is left of the edge in add list
-    while (paceSrc->ace_xI.slHolder < itadeAdd->ade_xI.slHolder) {
+    while (paceSrc->ace_xI.slHolder < paceAdd->ace_xI.slHolder) {
       // copy the active edge
       ASSERT(paceSrc<=&re_aaceActiveEdges[ctActiveEdges-1]);
       *paceDst++=*paceSrc++;
@@ -86,17 +153,11 @@ void CRenderer::AddAddListToActiveList(INDEX iScanLine)
 
     // copy the add edge
     ASSERT(paceDst > &re_aaceActiveEdgesTmp[0]);
-    ASSERT(ade.ade_xI.slHolder == ade.ade_psedEdge->sed_xI.slHolder);
-    ASSERT(paceDst[-1].ace_xI.slHolder <= ade.ade_xI.slHolder);
+    ASSERT(paceDst[-1].ace_xI.slHolder <= paceAdd->ace_xI.slHolder);
 
-    *paceDst++=CActiveEdge(itadeAdd->ade_psedEdge);
+    *paceDst++=*paceAdd++;
     IFDEBUG(ctNewActive++);
-    // advance iterator in add list
-    itadeAdd.MoveToNext();
   }
-  // clear the add list
-  lhAdd.Clear();
-  re_actAddCounts[iScanLine] = 0;
   // copy all edges left in the active list
   while (paceSrc<=&re_aaceActiveEdges[ctActiveEdges-1]) {
     *paceDst++=*paceSrc++;
@@ -862,3 +923,125 @@ void CRenderer::ScanEdges(void)
   EndScanEdges();
   _pfRenderProfile.StopTimer(CRenderProfile::PTI_SCANEDGES);
 }
+
+// edge in add list as it was kept before, sorted on insertion (for benchmark only)
+struct ListAddEdge {
+  FIX16_16 lae_xI;
+  CListNode lae_lnInAdd;
+  CScreenEdge *lae_psedEdge;
+};
+
+/*
+ * Compare sorted insertion to add lists with sorting when merging,
+ * on synthetic edges for 1080 and 2160 scan lines.
+ */
+void RendererAddListBenchmark(void)
+{
+  CStaticStackArray<CScreenEdge> asedEdges;
+  CStaticArray<CListHead> alhLists;
+  CStaticStackArray<CActiveEdge> aaceOld;
+  CStaticStackArray<CActiveEdge> aaceNew;
+
+  for (INDEX iPass=0; iPass<2; iPass++) {
+    const INDEX ctScanLines = (iPass==0) ? 1080 : 2160;
+    const INDEX ctScanWidth = ctScanLines*16/9;
+    const INDEX ctEdges = ctScanLines*100;
+    // half of edges start on few lines, as for tops of walls and stairs
+    ULONG ulSeed = 0x1234567;
+    asedEdges.PopAll();
+    CScreenEdge *psedEdges = asedEdges.Push(ctEdges);
+    for (INDEX iEdge=0; iEdge<ctEdges; iEdge++) {
+      CScreenEdge &sed = psedEdges[iEdge];
+      ulSeed = ulSeed*1103515245+12345;
+      INDEX iLine = (ulSeed>>8)%ctScanLines;
+      if (iEdge&1) iLine &= ~31;
+      ulSeed = ulSeed*1103515245+12345;
+      sed.sed_xI.slHolder = ((ulSeed>>8)%ctScanWidth)<<16;
+      sed.sed_xIStep.slHolder = 0;
+      sed.sed_pixTopJ = iLine;
+    }
+
+    // sorted insertion into linked lists
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    alhLists.Clear();
+    alhLists.New(ctScanLines);
+    ListAddEdge *plaeEdges = new ListAddEdge[ctEdges];
+    for (INDEX iEdge=0; iEdge<ctEdges; iEdge++) {
+      CScreenEdge &sed = psedEdges[iEdge];
+      CListNode *plnInList = alhLists[sed.sed_pixTopJ].lh_Head;
+      while (plnInList->ln_Succ!=NULL) {
+        ListAddEdge *plae = (ListAddEdge*)((UBYTE*)plnInList-offsetof(ListAddEdge, lae_lnInAdd));
+        if (plae->lae_xI.slHolder>sed.sed_xI.slHolder) {
+          break;
+        }
+        plnInList = plnInList->ln_Succ;
+      }
+      ListAddEdge &lae = plaeEdges[iEdge];
+      lae.lae_xI = sed.sed_xI;
+      lae.lae_psedEdge = &sed;
+      CListNode *plnThis = &lae.lae_lnInAdd;
+      CListNode *plnBefore = plnInList->ln_Pred;
+      plnThis->ln_Succ = plnInList;
+      plnThis->ln_Pred = plnBefore;
+      plnBefore->ln_Succ = plnThis;
+      plnInList->ln_Pred = plnThis;
+    }
+    aaceOld.PopAll();
+    for (INDEX iLine=0; iLine<ctScanLines; iLine++) {
+      FOREACHINLIST(ListAddEdge, lae_lnInAdd, alhLists[iLine], itlae) {
+        aaceOld.Push() = CActiveEdge(itlae->lae_psedEdge);
+      }
+    }
+    CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+
+    // unsorted add lists, sorted when merged
+    CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+    CRenderer::re_apadeAddFirst.Clear();
+    CRenderer::re_apadeAddFirst.New(ctScanLines);
+    CRenderer::re_actAddCounts.Clear();
+    CRenderer::re_actAddCounts.New(ctScanLines);
+    for (INDEX iLine=0; iLine<ctScanLines; iLine++) {
+      CRenderer::re_apadeAddFirst[iLine] = NULL;
+      CRenderer::re_actAddCounts[iLine] = 0;
+    }
+    CRenderer::re_aadeAddEdges.PopAll();
+    for (INDEX iEdge=0; iEdge<ctEdges; iEdge++) {
+      CScreenEdge &sed = psedEdges[iEdge];
+      CAddEdge &ade = CRenderer::re_aadeAddEdges.Push();
+      ade = CAddEdge(&sed);
+      ade.ade_padeNext = CRenderer::re_apadeAddFirst[sed.sed_pixTopJ];
+      CRenderer::re_apadeAddFirst[sed.sed_pixTopJ] = &ade;
+      CRenderer::re_actAddCounts[sed.sed_pixTopJ]++;
+    }
+    aaceNew.PopAll();
+    for (INDEX iLine=0; iLine<ctScanLines; iLine++) {
+      INDEX ctAdd = CRenderer::re_actAddCounts[iLine];
+      if (ctAdd==0) continue;
+      CRenderer::re_aaceAddSorted.PopAll();
+      CActiveEdge *paceAdd = CRenderer::re_aaceAddSorted.Push(ctAdd)+ctAdd;
+      for (CAddEdge *pade=CRenderer::re_apadeAddFirst[iLine]; pade!=NULL; pade=pade->ade_padeNext) {
+        *--paceAdd = CActiveEdge(pade->ade_psedEdge);
+      }
+      SortAddedEdges(CRenderer::re_aaceAddSorted, CRenderer::re_aaceAddSortedTmp);
+      memcpy(aaceNew.Push(ctAdd), &CRenderer::re_aaceAddSorted[0], ctAdd*sizeof(CActiveEdge));
+    }
+    CTimerValue tv3 = _pTimer->GetHighPrecisionTimer();
+
+    // both must give edges in same order
+    BOOL bSame = aaceOld.Count()==aaceNew.Count();
+    for (INDEX iEdge=0; bSame && iEdge<aaceNew.Count(); iEdge++) {
+      bSame = aaceOld[iEdge].ace_psedEdge==aaceNew[iEdge].ace_psedEdge;
+    }
+    CPrintF("%4d lines, %d edges: sorted insertion %.2f ms, sorting on merge %.2f ms %s\n",
+      ctScanLines, ctEdges, (tv1-tv0).GetSeconds()*1000, (tv3-tv2).GetSeconds()*1000,
+      bSame ? "" : "MISMATCH!");
+    // nodes unlink themselves when deleted
+    delete[] plaeEdges;
+  }
+
+  // renderer will reallocate lists for its own scan lines
+  CRenderer::re_apadeAddFirst.Clear();
+  CRenderer::re_actAddCounts.Clear();
+  CRenderer::re_apsedRemoveFirst.Clear();
+  CRenderer::re_aadeAddEdges.PopAll();
+}
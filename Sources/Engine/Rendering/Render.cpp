@@ -142,11 +142,13 @@ CStaticStackArray<INDEX> CRenderer::re_aiEdgeVxClipSrc;
 CStaticStackArray<INDEX> CRenderer::re_aiEdgeVxClipDst;
 
 // add and remove lists for each scan line
-CStaticArray<CListHead> CRenderer::re_alhAddLists;
+CStaticArray<CAddEdge *> CRenderer::re_apadeAddFirst;
 CStaticArray<INDEX> CRenderer::re_actAddCounts;   // count of edges in given add list
 CStaticArray<CScreenEdge *> CRenderer::re_apsedRemoveFirst;
 CStaticStackArray<CActiveEdge>  CRenderer::re_aaceActiveEdgesTmp;
 CStaticStackArray<CActiveEdge>  CRenderer::re_aaceActiveEdges;
+CStaticStackArray<CActiveEdge>  CRenderer::re_aaceAddSorted;
+CStaticStackArray<CActiveEdge>  CRenderer::re_aaceAddSortedTmp;
 
 // container for sorting translucent polygons
 CDynamicStackArray<CTranslucentPolygon> CRenderer::re_atcTranslucentPolygons;
@@ -179,13 +181,15 @@ void RendererInfo(void)
   slMem += CRenderer::re_aiEdgeVxClipSrc.sa_Count*sizeof(INDEX);
   slMem += CRenderer::re_aiEdgeVxClipDst.sa_Count*sizeof(INDEX);
 
-  slMem += CRenderer::re_alhAddLists.sa_Count*sizeof(CListHead);
+  slMem += CRenderer::re_apadeAddFirst.sa_Count*sizeof(CAddEdge *);
   slMem += CRenderer::re_actAddCounts.sa_Count*sizeof(INDEX);
   slMem += CRenderer::re_apsedRemoveFirst.sa_Count*sizeof(CScreenEdge *);
 
   slMem += CRenderer::re_atcTranslucentPolygons.da_Count*sizeof(CTranslucentPolygon);
   slMem += CRenderer::re_aaceActiveEdges.sa_Count*sizeof(CActiveEdge);
   slMem += CRenderer::re_aaceActiveEdgesTmp.sa_Count*sizeof(CActiveEdge);
+  slMem += CRenderer::re_aaceAddSorted.sa_Count*sizeof(CActiveEdge);
+  slMem += CRenderer::re_aaceAddSortedTmp.sa_Count*sizeof(CActiveEdge);
 
   for (INDEX ire = 0; ire<MAX_RENDERERS; ire++) {
     CRenderer &re = _areRenderers[ire];
@@ -211,12 +215,14 @@ void ClearRenderer(void)
   CRenderer::re_aiEdgeVxClipSrc.Clear();
   CRenderer::re_aiEdgeVxClipDst.Clear();
 
-  CRenderer::re_alhAddLists.Clear();
+  CRenderer::re_apadeAddFirst.Clear();
   CRenderer::re_actAddCounts.Clear();
   CRenderer::re_apsedRemoveFirst.Clear();
   CRenderer::re_atcTranslucentPolygons.Clear();
   CRenderer::re_aaceActiveEdges.Clear();
   CRenderer::re_aaceActiveEdgesTmp.Clear();
+  CRenderer::re_aaceAddSorted.Clear();
+  CRenderer::re_aaceAddSortedTmp.Clear();
 
   for (INDEX ire = 0; ire<MAX_RENDERERS; ire++) {
     CRenderer &re = _areRenderers[ire];
@@ -284,9 +290,9 @@ void CRenderer::Initialize(void)
   re_aiEdgeVxMain.PopAll();
 
   // if more scan lines are needed than last time
-  if (re_alhAddLists.Count()<re_ctScanLines) {
-    re_alhAddLists.Clear();
-    re_alhAddLists.New(re_ctScanLines);
+  if (re_apadeAddFirst.Count()<re_ctScanLines) {
+    re_apadeAddFirst.Clear();
+    re_apadeAddFirst.New(re_ctScanLines);
     re_actAddCounts.Clear();
     re_actAddCounts.New(re_ctScanLines);
 
@@ -296,6 +302,7 @@ void CRenderer::Initialize(void)
   // clear all add/remove lists
   for(INDEX iScan=0; iScan<re_ctScanLines; iScan++) {
     re_actAddCounts[iScan] = 0;
+    re_apadeAddFirst[iScan] = NULL;
     re_apsedRemoveFirst[iScan] = NULL;
   }
 
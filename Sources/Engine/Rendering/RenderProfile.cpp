@@ -48,6 +48,7 @@ CRenderProfile::CRenderProfile(void) :
   SETTIMERNAME(CRenderProfile::PTI_STEPANDRESORT,          "  StepAndResortActiveList()", "");
   SETTIMERNAME(CRenderProfile::PTI_REMREMLIST,             "  RemRemoveListFromActiveList()", "");
   SETTIMERNAME(CRenderProfile::PTI_ADDADDLIST,             "  AddAddListToActiveList()", "");
+  SETTIMERNAME(CRenderProfile::PTI_SORTADDLIST,            "   sorting add lists", "");
 
   SETTIMERNAME(CRenderProfile::PTI_ADDNONZONINGBRUSH,      " AddNonZoningBrush()", "");
   SETTIMERNAME(CRenderProfile::PTI_ADDMODELENTITY,         " AddModelEntity()", "");
@@ -43,6 +43,7 @@ public:
         PTI_STEPANDRESORT,      // time spent in StepAndResortActiveList()
         PTI_REMREMLIST,         // time spent in RemRemoveListFromActiveList()
         PTI_ADDADDLIST,         // time spent in AddAddListToActiveList()
+          PTI_SORTADDLIST,      // time spent sorting add lists before merging
       PTI_ADDNONZONINGBRUSH,  // time spent in AddNonZoningBrush()
       PTI_ADDMODELENTITY,       // time spent in AddModelEntity()
       PTI_ADDZONINGSECTORS,   // time spent in AddZoningSectors()
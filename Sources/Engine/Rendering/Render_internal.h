@@ -155,13 +155,14 @@ public:
 };
 
 /*
- * Structure used for sorting edges in add list
+ * Edge waiting in add list of its top scan line (lists are unsorted until merged)
  */
 class CAddEdge { // size is 16 bytes
 public:
   FIX16_16 ade_xI;            // top I coordinate
-  CListNode ade_lnInAdd;        // node in add list
+  CAddEdge *ade_padeNext;     // next edge in add list (added before this one)
   CScreenEdge *ade_psedEdge;  // the edge
+  ULONG ade_ulDummy;  // alignment to 16 bytes
 
   ALIGNED_NEW_AND_DELETE(32);
 
@@ -171,8 +172,7 @@ public:
     , ade_psedEdge(psed)
   {};
   inline void Clear(void) {
-    ade_lnInAdd.ln_Succ = NULL;
-    ade_lnInAdd.ln_Pred = NULL;
+    ade_padeNext = NULL;
   };
 };
 
@@ -345,7 +345,7 @@ public:
   static CStaticStackArray<INDEX> re_aiEdgeVxClipDst;
 
   // add and remove lists for each scan line
-  static CStaticArray<CListHead> re_alhAddLists;
+  static CStaticArray<CAddEdge *> re_apadeAddFirst; // last added edge in add list of given scan line
   static CStaticArray<INDEX> re_actAddCounts;   // count of edges in given add list
   static CStaticArray<CScreenEdge *> re_apsedRemoveFirst;
 
@@ -363,6 +363,8 @@ public:
 
   static CStaticStackArray<CActiveEdge> re_aaceActiveEdges; // active edges for current scan line
   static CStaticStackArray<CActiveEdge> re_aaceActiveEdgesTmp;
+  static CStaticStackArray<CActiveEdge> re_aaceAddSorted;    // add list being sorted for merging
+  static CStaticStackArray<CActiveEdge> re_aaceAddSortedTmp;
 
   INDEX re_iCurrentScan;            // index of current scan line in tables
   PIX re_pixCurrentScanJ;           // J coordinate of current scan line
@@ -42,7 +42,7 @@ void RememberUnCompresedRotatations(BOOL bRemember)
 }
 CAnimSet::CAnimSet()
 {
-
+  as_ulGeneration = 0;
 }
 CAnimSet::~CAnimSet()
 {
@@ -143,6 +143,7 @@ INDEX FindNextFrame(INDEX ifnToFind)
 // optimize all animations
 void CAnimSet::Optimize()
 {
+  as_ulGeneration++;
   INDEX ctan=as_Anims.Count();
   for(INDEX ian=0;ian<ctan;ian++)
   {
@@ -325,6 +326,7 @@ void CAnimSet::OptimizeAnimation(Animation &an, FLOAT fTreshold)
 // add animation to animset
 void CAnimSet::AddAnimation(Animation *pan)
 {
+  as_ulGeneration++;
   INDEX ctan = as_Anims.Count();
   as_Anims.Expand(ctan+1);
   Animation &an = as_Anims[ctan];
@@ -333,6 +335,7 @@ void CAnimSet::AddAnimation(Animation *pan)
 // remove animation from animset
 void CAnimSet::RemoveAnimation(Animation *pan)
 {
+  as_ulGeneration++;
   INDEX ctan = as_Anims.Count();
   ASSERT(ctan>0);
   ASSERT(pan!=NULL);
@@ -446,6 +449,7 @@ void CAnimSet::Write_t(CTStream *ostrFile)
 // read from stream
 void CAnimSet::Read_t(CTStream *istrFile)
 {
+  as_ulGeneration++;
   INDEX iFileVersion;
   // read chunk id
   istrFile->ExpectID_t(CChunkID(ANIMSET_ID));
@@ -587,6 +591,7 @@ void CAnimSet::Read_t(CTStream *istrFile)
 // clear animset
 void CAnimSet::Clear(void)
 {
+  as_ulGeneration++;
   INDEX ctAnims = as_Anims.Count();
   for(INDEX iAnims=0;iAnims<ctAnims;iAnims++)
   {
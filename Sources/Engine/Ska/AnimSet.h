@@ -99,6 +99,7 @@ public:
   SLONG GetUsedMemory(void);
 
   CStaticArray<struct Animation> as_Anims;
+  ULONG as_ulGeneration;  // changed whenever animations may have changed (reload, optimize, added or removed)
 };
 
 // if rotations are compresed does loader also fills array of uncompresed rotations
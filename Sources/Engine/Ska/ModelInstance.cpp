@@ -339,6 +339,8 @@ void CModelInstance::AddMesh_t(CTFileName fnMesh)
 void CModelInstance::AddSkeleton_t(CTFileName fnSkeleton)
 {
   mi_psklSkeleton = _pSkeletonStock->Obtain_t(fnSkeleton);
+  // bones of animations must be matched again
+  mi_aacAnimChannels.Clear();
 }
 
 // Add AnimSet to ModelInstance
@@ -346,6 +348,8 @@ void CModelInstance::AddAnimSet_t(CTFileName fnAnimSet)
 {
   CAnimSet *Anim = _pAnimSetStock->Obtain_t(fnAnimSet);
   mi_aAnimSet.Add(Anim);
+  // animation channels will be matched with skeleton when first played
+  mi_aacAnimChannels.Clear();
 }
 
 // Add texture to ModelInstance (if no mesh instance given, add texture to last mesh instance)
@@ -781,6 +785,72 @@ BOOL CModelInstance::FindAnimationByID(int iAnimID,INDEX *piAnimSetIndex,INDEX *
   return FALSE;
 }
 
+// Get bone channels of animation matched to given skeleton lod
+// (matched when animation is first played in that lod, and kept until animsets or skeleton change,
+// including reloads in place)
+AnimChannels &CModelInstance::GetAnimChannels(INDEX iAnimSetIndex, INDEX iAnimIndex, INDEX iSkeletonLOD)
+{
+  // find index of channels for this animation, and count all animations
+  INDEX ctan = 0;
+  INDEX iChannels = -1;
+  INDEX ctas = mi_aAnimSet.Count();
+  for(INDEX ias=0;ias<ctas;ias++) {
+    if(ias==iAnimSetIndex) iChannels = ctan+iAnimIndex;
+    ctan += mi_aAnimSet[ias].as_Anims.Count();
+  }
+  ASSERT(iChannels>=0 && iChannels<ctan);
+
+  // if count of animations has changed
+  if(mi_aacAnimChannels.Count()!=ctan) {
+    // forget all channels
+    mi_aacAnimChannels.Clear();
+    mi_aacAnimChannels.New(ctan);
+    for(INDEX iac=0;iac<ctan;iac++) {
+      mi_aacAnimChannels[iac].ac_panAnim = NULL;
+    }
+  }
+
+  CAnimSet &as = mi_aAnimSet[iAnimSetIndex];
+  Animation &an = as.as_Anims[iAnimIndex];
+  AnimChannels &ac = mi_aacAnimChannels[iChannels];
+  INDEX ctbe = an.an_abeBones.Count();
+  // if channels are not made for this animation
+  if(ac.ac_panAnim!=&an || ac.ac_ulAnimSetGeneration!=as.as_ulGeneration || ac.ac_aiBones.Count()!=ctbe) {
+    // make them
+    ac.ac_panAnim = &an;
+    ac.ac_ulAnimSetGeneration = as.as_ulGeneration;
+    ac.ac_psklSkeleton = NULL;
+    ac.ac_iSkeletonLOD = -1;
+    ac.ac_aiBones.Clear();
+    ac.ac_aiRotFrame.Clear();
+    ac.ac_aiPosFrame.Clear();
+    ac.ac_aiBones.New(ctbe);
+    ac.ac_aiRotFrame.New(ctbe);
+    ac.ac_aiPosFrame.New(ctbe);
+    for(INDEX ibe=0;ibe<ctbe;ibe++) {
+      ac.ac_aiRotFrame[ibe] = 0;
+      ac.ac_aiPosFrame[ibe] = 0;
+    }
+  }
+
+  // if bones are not matched in this skeleton lod
+  const ULONG ulSkeletonGeneration = (mi_psklSkeleton!=NULL) ? mi_psklSkeleton->skl_ulGeneration : 0;
+  if(ac.ac_psklSkeleton!=mi_psklSkeleton || ac.ac_ulSkeletonGeneration!=ulSkeletonGeneration
+   || ac.ac_iSkeletonLOD!=iSkeletonLOD) {
+    // find bone of each bone envelope
+    ac.ac_psklSkeleton = mi_psklSkeleton;
+    ac.ac_ulSkeletonGeneration = ulSkeletonGeneration;
+    ac.ac_iSkeletonLOD = iSkeletonLOD;
+    for(INDEX ibe=0;ibe<ctbe;ibe++) {
+      ac.ac_aiBones[ibe] = -1;
+      if(mi_psklSkeleton!=NULL && iSkeletonLOD>=0) {
+        ac.ac_aiBones[ibe] = mi_psklSkeleton->FindBoneInLOD(an.an_abeBones[ibe].be_iBoneID, iSkeletonLOD);
+      }
+    }
+  }
+  return ac;
+}
+
 // Find animation by ID
 INDEX CModelInstance::FindFirstAnimationID()
 {
@@ -1069,6 +1139,7 @@ void CModelInstance::Clear(void)
     _pAnimSetStock->Release(&mi_aAnimSet[ias]);  
   }
   mi_aAnimSet.Clear();
+  mi_aacAnimChannels.Clear();
 
   // clear all colision boxes 
   mi_cbAABox.Clear();
@@ -1089,6 +1160,12 @@ SLONG CModelInstance::GetUsedMemory(void)
   slMemoryUsed += mi_aMeshInst.Count() * sizeof(MeshInstance);
   // Count bounding boxes
   slMemoryUsed += mi_cbAABox.Count() * sizeof(ColisionBox);
+  // Count animation channels
+  INDEX ctac = mi_aacAnimChannels.Count();
+  for(INDEX iac=0;iac<ctac;iac++) {
+    slMemoryUsed += mi_aacAnimChannels[iac].ac_aiBones.Count() * 3*sizeof(INDEX);
+  }
+  slMemoryUsed += ctac * sizeof(AnimChannels);
   // Cound child model instances
   INDEX ctcmi = mi_cmiChildren.Count();
   for(INDEX icmi=0;icmi<ctcmi;icmi++) {
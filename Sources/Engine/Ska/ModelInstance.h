@@ -110,6 +110,19 @@ struct AnimList
   CStaticStackArray<struct PlayedAnim> al_PlayedAnims;  // Array of currently playing anims in this list
 };
 
+// bone channels of one animation matched to skeleton of model instance
+struct AnimChannels
+{
+  Animation *ac_panAnim;              // animation these channels are for (NULL if not matched yet)
+  ULONG ac_ulAnimSetGeneration;       // generation of animset when channels were made
+  CSkeleton *ac_psklSkeleton;         // skeleton bones were matched with
+  ULONG ac_ulSkeletonGeneration;      // generation of skeleton when bones were matched
+  INDEX ac_iSkeletonLOD;              // skeleton lod bones were matched in
+  CStaticArray<INDEX> ac_aiBones;     // bone index in skeleton lod for each bone envelope (-1 if not there)
+  CStaticArray<INDEX> ac_aiRotFrame;  // last found rotation keyframe for each bone envelope
+  CStaticArray<INDEX> ac_aiPosFrame;  // last found position keyframe for each bone envelope
+};
+
 struct PlayedAnim
 {
   FLOAT pa_fStartTime; // Time when this animation was started
@@ -201,6 +214,8 @@ public:
   void OffSetAnimationQueue(TIME fOffsetTime);
   // Find animation by ID
   BOOL FindAnimationByID(int iAnimID, INDEX *piAnimSetIndex, INDEX *piAnimIndex);
+  // Get bone channels of animation matched to given skeleton lod
+  AnimChannels &GetAnimChannels(INDEX iAnimSetIndex, INDEX iAnimIndex, INDEX iSkeletonLOD);
   // Find first animation of all animations in ModelInstance (safety function)
   INDEX FindFirstAnimationID();
   // Get animation length
@@ -250,6 +265,7 @@ public:
   CStaticArray<struct MeshInstance> mi_aMeshInst; // array of mesh instances
   CStaticArray<struct ColisionBox> mi_cbAABox;    // array of colision boxes
   CDynamicContainer<class CAnimSet> mi_aAnimSet;  // array of animsets
+  CStaticArray<struct AnimChannels> mi_aacAnimChannels; // channels of all animations in all animsets, one after another
   CDynamicContainer<class CModelInstance> mi_cmiChildren; // array of child model instances
 
   AnimQueue mi_aqAnims;   // current animation queue for this model instance
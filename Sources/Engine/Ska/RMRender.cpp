@@ -14,7 +14,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
 
 #include "StdH.h"
+#include <xmmintrin.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 #include <Engine/Math/Projection.h>
 #include <Engine/Math/Float.h>
 #include <Engine/Math/Vector.h>
@@ -53,6 +57,8 @@ static FLOAT _fCustomMlodDistance=-1; // custom distance for mesh lods
 static FLOAT _fCustomSlodDistance=-1; // custom distance for skeleton lods
 extern FLOAT ska_fLODMul;
 extern FLOAT ska_fLODAdd;
+extern INDEX ska_bUseSSE;
+extern BOOL  sys_bCPUHasSSE;
 
 // mask shader (for rendering models' shadows to shadowmaps)
 static CShader _shMaskShader;
@@ -237,6 +243,104 @@ inline void MatrixTranspose(Matrix12 &r, const Matrix12 &m)
   r[11] = -r[8]*m[3] - r[9]*m[7] - r[10]*m[11];
 }
 
+// add vertices and normals of one weight map to final arrays, transformed with bone
+// matrices and scaled by their weights (reference path, one vertex at a time)
+static void SkinWeightMap_C(const MeshVertex *pavSrc, const MeshNormal *panSrc, MeshVertex *pavDst, MeshNormal *panDst,
+                            const MeshVertexWeight *pavw, INDEX ctvw, const Matrix12 &mStrTransform, const Matrix12 &mTransform)
+{
+  for(int ivw=0; ivw<ctvw; ivw++) {
+    const MeshVertexWeight &vw = pavw[ivw];
+    INDEX ivx = vw.mww_iVertex;
+    MeshVertex mv = pavSrc[ivx];
+    MeshNormal mn = panSrc[ivx];
+
+    // transform vertex and normal with this weight transform matrix
+    TransformVector((FLOAT3&)mv,mStrTransform);
+    RotateVector((FLOAT3&)mn,mTransform); // Don't stretch normals
+
+    // Add new values to final vertices
+    pavDst[ivx].x += mv.x * vw.mww_fWeight;
+    pavDst[ivx].y += mv.y * vw.mww_fWeight;
+    pavDst[ivx].z += mv.z * vw.mww_fWeight;
+    panDst[ivx].nx += mn.nx * vw.mww_fWeight;
+    panDst[ivx].ny += mn.ny * vw.mww_fWeight;
+    panDst[ivx].nz += mn.nz * vw.mww_fWeight;
+  }
+}
+
+// add transposed x,y,z rows of four transformed vectors to their final vectors
+// (one by one, so same vertex can appear more than once in a group)
+static __forceinline void AddSkinnedVectors(FLOAT *pf0, FLOAT *pf1, FLOAT *pf2, FLOAT *pf3,
+                                            __m128 vX, __m128 vY, __m128 vZ)
+{
+  __m128 vW = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(vX, vY, vZ, vW);
+  _mm_storeu_ps(pf0, _mm_add_ps(_mm_loadu_ps(pf0), vX));
+  _mm_storeu_ps(pf1, _mm_add_ps(_mm_loadu_ps(pf1), vY));
+  _mm_storeu_ps(pf2, _mm_add_ps(_mm_loadu_ps(pf2), vZ));
+  _mm_storeu_ps(pf3, _mm_add_ps(_mm_loadu_ps(pf3), vW));
+}
+
+// same as above, but four vertices at a time with vertices transposed to x,y,z rows
+static void SkinWeightMap_SSE(const MeshVertex *pavSrc, const MeshNormal *panSrc, MeshVertex *pavDst, MeshNormal *panDst,
+                              const MeshVertexWeight *pavw, INDEX ctvw, const Matrix12 &mStrTransform, const Matrix12 &mTransform)
+{
+  // matrix elements in all lanes
+  __m128 avStr[12], avRot[12];
+  for(INDEX i=0; i<12; i++) {
+    avStr[i] = _mm_set1_ps(mStrTransform[i]);
+    avRot[i] = _mm_set1_ps(mTransform[i]);
+  }
+
+  INDEX ivw=0;
+  for(; ivw+4<=ctvw; ivw+=4) {
+    const MeshVertexWeight *pvw = pavw+ivw;
+    const INDEX ivx0 = pvw[0].mww_iVertex;
+    const INDEX ivx1 = pvw[1].mww_iVertex;
+    const INDEX ivx2 = pvw[2].mww_iVertex;
+    const INDEX ivx3 = pvw[3].mww_iVertex;
+    const __m128 vWeight = _mm_setr_ps(pvw[0].mww_fWeight, pvw[1].mww_fWeight, pvw[2].mww_fWeight, pvw[3].mww_fWeight);
+
+    // transform vertices (same order of operations as TransformVector)
+    __m128 vX = _mm_loadu_ps(&pavSrc[ivx0].x);
+    __m128 vY = _mm_loadu_ps(&pavSrc[ivx1].x);
+    __m128 vZ = _mm_loadu_ps(&pavSrc[ivx2].x);
+    __m128 vW = _mm_loadu_ps(&pavSrc[ivx3].x);
+    _MM_TRANSPOSE4_PS(vX, vY, vZ, vW);
+    __m128 vTX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(avStr[0],vX), _mm_mul_ps(avStr[1],vY)), _mm_mul_ps(avStr[ 2],vZ)), avStr[ 3]);
+    __m128 vTY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(avStr[4],vX), _mm_mul_ps(avStr[5],vY)), _mm_mul_ps(avStr[ 6],vZ)), avStr[ 7]);
+    __m128 vTZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(avStr[8],vX), _mm_mul_ps(avStr[9],vY)), _mm_mul_ps(avStr[10],vZ)), avStr[11]);
+    AddSkinnedVectors(&pavDst[ivx0].x, &pavDst[ivx1].x, &pavDst[ivx2].x, &pavDst[ivx3].x,
+                      _mm_mul_ps(vTX,vWeight), _mm_mul_ps(vTY,vWeight), _mm_mul_ps(vTZ,vWeight));
+
+    // rotate normals (don't stretch them)
+    vX = _mm_loadu_ps(&panSrc[ivx0].nx);
+    vY = _mm_loadu_ps(&panSrc[ivx1].nx);
+    vZ = _mm_loadu_ps(&panSrc[ivx2].nx);
+    vW = _mm_loadu_ps(&panSrc[ivx3].nx);
+    _MM_TRANSPOSE4_PS(vX, vY, vZ, vW);
+    vTX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(avRot[0],vX), _mm_mul_ps(avRot[1],vY)), _mm_mul_ps(avRot[ 2],vZ));
+    vTY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(avRot[4],vX), _mm_mul_ps(avRot[5],vY)), _mm_mul_ps(avRot[ 6],vZ));
+    vTZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(avRot[8],vX), _mm_mul_ps(avRot[9],vY)), _mm_mul_ps(avRot[10],vZ));
+    AddSkinnedVectors(&panDst[ivx0].nx, &panDst[ivx1].nx, &panDst[ivx2].nx, &panDst[ivx3].nx,
+                      _mm_mul_ps(vTX,vWeight), _mm_mul_ps(vTY,vWeight), _mm_mul_ps(vTZ,vWeight));
+  }
+
+  // do the rest one by one
+  SkinWeightMap_C(pavSrc, panSrc, pavDst, panDst, pavw+ivw, ctvw-ivw, mStrTransform, mTransform);
+}
+
+// skin one weight map with the best available path
+static void SkinWeightMap(const MeshVertex *pavSrc, const MeshNormal *panSrc, MeshVertex *pavDst, MeshNormal *panDst,
+                          const MeshVertexWeight *pavw, INDEX ctvw, const Matrix12 &mStrTransform, const Matrix12 &mTransform)
+{
+  if(ska_bUseSSE && sys_bCPUHasSSE) {
+    SkinWeightMap_SSE(pavSrc, panSrc, pavDst, panDst, pavw, ctvw, mStrTransform, mTransform);
+  } else {
+    SkinWeightMap_C(pavSrc, panSrc, pavDst, panDst, pavw, ctvw, mStrTransform, mTransform);
+  }
+}
+
 // viewer absolute and object space projection
 static FLOAT3D _vViewer;
 static FLOAT3D _vViewerObj;
@@ -1237,6 +1341,28 @@ static INDEX FindFrame(UBYTE *pFirstMember, INDEX iFind, INDEX ctfn, UINT uiSize
   }
 }
 
+// find frame index as above, but first try few keyframes from the last found one
+static INDEX FindFrame(UBYTE *pFirstMember, INDEX iFind, INDEX ctfn, UINT uiSize, INDEX &iLastFound)
+{
+  #define FRAMENUM(i) (*(UWORD*)(pFirstMember+(uiSize*(i))))
+  INDEX iFrame = iLastFound;
+  // if last found keyframe is not after the one to find
+  if(iFrame>=0 && iFrame<ctfn && FRAMENUM(iFrame)<=iFind) {
+    // step forward while next keyframe is not after it
+    for(INDEX iStep=0;iStep<4;iStep++) {
+      if(iFrame==ctfn-1 || FRAMENUM(iFrame+1)>iFind) {
+        iLastFound = iFrame;
+        return iFrame;
+      }
+      iFrame++;
+    }
+  }
+  #undef FRAMENUM
+  // animation has jumped, do binary search
+  iLastFound = FindFrame(pFirstMember, iFind, ctfn, uiSize);
+  return iLastFound;
+}
+
 // Find renbone in given renmodel
 static BOOL FindRenBone(RenModel &rm,int iBoneID,INDEX *piBoneIndex)
 {
@@ -1911,13 +2037,19 @@ static void MatchAnims(RenModel &rm)
           iNextAnimFrame = ClampUp(iCurentFrame+1L,an.an_iFrames-1L);
         }
         
-        // for each bone envelope
+        // get bone envelopes matched to bones in current skeleton lod
         INDEX ctbe = an.an_abeBones.Count();
+        if(rm.rm_ctBones==0) ctbe = 0;
+        AnimChannels *pac = NULL;
+        if(ctbe>0) pac = &rm.rm_pmiModel->GetAnimChannels(iAnimSetIndex,iAnimIndex,rm.rm_iSkeletonLODIndex);
+
+        // for each bone envelope
         for(int ibe=0;ibe<ctbe;ibe++) {
-          INDEX iBoneIndex;
-          // find its renbone in array of renbones
-          if(FindRenBone(rm,an.an_abeBones[ibe].be_iBoneID, &iBoneIndex)) {
-            RenBone &rb = _aRenBones[iBoneIndex];
+          // if its bone is in current skeleton lod
+          const INDEX iBone = pac->ac_aiBones[ibe];
+          ASSERT(iBone<rm.rm_ctBones);
+          if(iBone>=0 && iBone<rm.rm_ctBones) {
+            RenBone &rb = _aRenBones[rm.rm_iFirstBone+iBone];
             BoneEnvelope &be = an.an_abeBones[ibe];
 
             INDEX iRotFrameIndex;
@@ -1936,7 +2068,7 @@ static void MatchAnims(RenModel &rm)
               AnimRot *arFirst = &be.be_arRot[0];
               INDEX ctfn = be.be_arRot.Count();
               // find index of closest frame
-              iRotFrameIndex = FindFrame((UBYTE*)arFirst,iAnimFrame,ctfn,sizeof(AnimRot));
+              iRotFrameIndex = FindFrame((UBYTE*)arFirst,iAnimFrame,ctfn,sizeof(AnimRot),pac->ac_aiRotFrame[ibe]);
               
               // get index of next frame
               if(bAnimLooping) {
@@ -1953,7 +2085,7 @@ static void MatchAnims(RenModel &rm)
             } else {
               AnimRotOpt *aroFirst = &be.be_arRotOpt[0];
               INDEX ctfn = be.be_arRotOpt.Count();
-              iRotFrameIndex = FindFrame((UBYTE*)aroFirst,iAnimFrame,ctfn,sizeof(AnimRotOpt));
+              iRotFrameIndex = FindFrame((UBYTE*)aroFirst,iAnimFrame,ctfn,sizeof(AnimRotOpt),pac->ac_aiRotFrame[ibe]);
 
               // get index of next frame
               if(bAnimLooping) { 
@@ -1996,7 +2128,7 @@ static void MatchAnims(RenModel &rm)
 
             AnimPos *apFirst = &be.be_apPos[0];
             INDEX ctfn = be.be_apPos.Count();
-            INDEX iPosFrameIndex = FindFrame((UBYTE*)apFirst,iAnimFrame,ctfn,sizeof(AnimPos));
+            INDEX iPosFrameIndex = FindFrame((UBYTE*)apFirst,iAnimFrame,ctfn,sizeof(AnimPos),pac->ac_aiPosFrame[ibe]);
 
             INDEX iNextPosFrameIndex;
             // is animation looping
@@ -2297,25 +2429,11 @@ static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod)
         RemoveRotationFromMatrix(mStrTransform);
       }
 
-      // for each vertex in this weight
+      // add all vertices in this weight to final vertices
       INDEX ctvw = rw.rw_pwmWeightMap->mwm_aVertexWeight.Count();
-      for(int ivw=0; ivw<ctvw; ivw++) {
-        MeshVertexWeight &vw = rw.rw_pwmWeightMap->mwm_aVertexWeight[ivw];
-        INDEX ivx = vw.mww_iVertex;
-        MeshVertex mv = _aMorphedVtxs[ivx];
-        MeshNormal mn = _aMorphedNormals[ivx];
-        
-        // transform vertex and normal with this weight transform matrix
-        TransformVector((FLOAT3&)mv,mStrTransform);
-        RotateVector((FLOAT3&)mn,mTransform); // Don't stretch normals
-
-        // Add new values to final vertices
-        _aFinalVtxs[ivx].x += mv.x * vw.mww_fWeight;
-        _aFinalVtxs[ivx].y += mv.y * vw.mww_fWeight;
-        _aFinalVtxs[ivx].z += mv.z * vw.mww_fWeight;
-        _aFinalNormals[ivx].nx += mn.nx * vw.mww_fWeight;
-        _aFinalNormals[ivx].ny += mn.ny * vw.mww_fWeight;
-        _aFinalNormals[ivx].nz += mn.nz * vw.mww_fWeight;
+      if(ctvw>0) {
+        SkinWeightMap(&_aMorphedVtxs[0], &_aMorphedNormals[0], &_aFinalVtxs[0], &_aFinalNormals[0],
+                      &rw.rw_pwmWeightMap->mwm_aVertexWeight[0], ctvw, mStrTransform, mTransform);
       }
     }
     _pavFinalVertices = &_aFinalVtxs[0];
@@ -2602,3 +2720,175 @@ static void ClearRenArrays()
   _fCustomSlodDistance = -1;
 }
 
+
+// synthetic mesh and instances for skinning benchmark
+static const INDEX _ctBenchBones = 32;
+static INDEX _ctBenchVertices = 0;
+static INDEX _ctBenchInstances = 0;
+static INDEX _ctBenchThreads = 0;
+static BOOL  _bBenchSSE = FALSE;
+static CStaticStackArray<MeshVertex> _avBenchSrc;
+static CStaticStackArray<MeshNormal> _anBenchSrc;
+static CStaticStackArray<MeshVertexWeight> _avwBenchWeights; // weights of all bones, one after another
+static INDEX _aiBenchFirstWeight[_ctBenchBones+1];
+static CStaticStackArray<Matrix12> _amBenchBones;            // stretch and rotation matrix per bone per instance
+static CStaticStackArray<MeshVertex> _avBenchDst[2];         // results of reference and tested path
+static CStaticStackArray<MeshNormal> _anBenchDst[2];
+
+// skin every n-th instance of benchmark mesh
+static DWORD WINAPI SkinningBenchmarkThread(LPVOID lpParam)
+{
+  INDEX iThread = (INDEX)lpParam;
+  INDEX iResult = _bBenchSSE ? 1 : 0;
+  for(INDEX iInstance=iThread; iInstance<_ctBenchInstances; iInstance+=_ctBenchThreads) {
+    MeshVertex *pavDst = &_avBenchDst[iResult][iInstance*_ctBenchVertices];
+    MeshNormal *panDst = &_anBenchDst[iResult][iInstance*_ctBenchVertices];
+    memset(pavDst, 0, sizeof(MeshVertex)*_ctBenchVertices);
+    memset(panDst, 0, sizeof(MeshNormal)*_ctBenchVertices);
+    for(INDEX iBone=0; iBone<_ctBenchBones; iBone++) {
+      const Matrix12 &mStr = _amBenchBones[(iInstance*_ctBenchBones+iBone)*2+0];
+      const Matrix12 &mRot = _amBenchBones[(iInstance*_ctBenchBones+iBone)*2+1];
+      const MeshVertexWeight *pavw = &_avwBenchWeights[_aiBenchFirstWeight[iBone]];
+      INDEX ctvw = _aiBenchFirstWeight[iBone+1]-_aiBenchFirstWeight[iBone];
+      if(_bBenchSSE) {
+        SkinWeightMap_SSE(&_avBenchSrc[0], &_anBenchSrc[0], pavDst, panDst, pavw, ctvw, mStr, mRot);
+      } else {
+        SkinWeightMap_C(&_avBenchSrc[0], &_anBenchSrc[0], pavDst, panDst, pavw, ctvw, mStr, mRot);
+      }
+    }
+  }
+  return 0;
+}
+
+// skin all benchmark instances with given path and number of threads, return time in seconds
+static DOUBLE RunSkinningBenchmark(BOOL bSSE, INDEX ctThreads)
+{
+  _bBenchSSE = bSSE;
+  _ctBenchThreads = ctThreads;
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  if(ctThreads==1) {
+    SkinningBenchmarkThread((LPVOID)0);
+  } else {
+    HANDLE ahThreads[64];
+    for(INDEX iThread=0; iThread<ctThreads; iThread++) {
+      DWORD dwThreadId;
+      ahThreads[iThread] = CreateThread(NULL, 0, SkinningBenchmarkThread, (LPVOID)iThread, 0, &dwThreadId);
+    }
+    WaitForMultipleObjects(ctThreads, ahThreads, TRUE, INFINITE);
+    for(INDEX iThread=0; iThread<ctThreads; iThread++) {
+      CloseHandle(ahThreads[iThread]);
+    }
+  }
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+  return (tv1-tv0).GetSeconds();
+}
+
+// find biggest difference between reference and tested results
+static FLOAT SkinningBenchmarkError(void)
+{
+  FLOAT fMaxError = 0.0f;
+  for(INDEX ivx=0; ivx<_ctBenchInstances*_ctBenchVertices; ivx++) {
+    const MeshVertex &mv0 = _avBenchDst[0][ivx];
+    const MeshVertex &mv1 = _avBenchDst[1][ivx];
+    const MeshNormal &mn0 = _anBenchDst[0][ivx];
+    const MeshNormal &mn1 = _anBenchDst[1][ivx];
+    fMaxError = Max(fMaxError, Abs(mv0.x-mv1.x));
+    fMaxError = Max(fMaxError, Abs(mv0.y-mv1.y));
+    fMaxError = Max(fMaxError, Abs(mv0.z-mv1.z));
+    fMaxError = Max(fMaxError, Abs(mn0.nx-mn1.nx));
+    fMaxError = Max(fMaxError, Abs(mn0.ny-mn1.ny));
+    fMaxError = Max(fMaxError, Abs(mn0.nz-mn1.nz));
+  }
+  return fMaxError;
+}
+
+// skin given number of instances of a synthetic mesh without rendering them,
+// with reference and SSE path, and check SSE results against reference ones
+void RM_SkinningBenchmark(INDEX ctInstances, INDEX ctThreads)
+{
+  if(!sys_bCPUHasSSE) {
+    CPrintF(TRANS("SSE is not supported on this CPU.\n"));
+    return;
+  }
+  _ctBenchInstances = Clamp(ctInstances, 1L, 1024L);
+  ctThreads = Clamp(ctThreads, 1L, 64L);
+  _ctBenchVertices = 2000;
+
+  // mesh is a ring of vertices where each vertex is weighted to three bones
+  ULONG ulSeed = 0x1234567;
+  #define BENCHRANDOM() (ulSeed = ulSeed*1103515245+12345, ((ulSeed>>8)&0xFFFF)/65535.0f)
+  _avBenchSrc.PopAll();
+  _anBenchSrc.PopAll();
+  _avwBenchWeights.PopAll();
+  _avBenchSrc.Push(_ctBenchVertices);
+  _anBenchSrc.Push(_ctBenchVertices);
+  for(INDEX ivx=0; ivx<_ctBenchVertices; ivx++) {
+    MeshVertex &mv = _avBenchSrc[ivx];
+    MeshNormal &mn = _anBenchSrc[ivx];
+    mv.x = BENCHRANDOM()*2-1;  mv.y = BENCHRANDOM()*2;  mv.z = BENCHRANDOM()*2-1;  mv.dummy = 0;
+    FLOAT3D vNormal(mv.x, 0.5f, mv.z);
+    vNormal.Normalize();
+    mn.nx = vNormal(1);  mn.ny = vNormal(2);  mn.nz = vNormal(3);  mn.dummy = 0;
+  }
+  static const FLOAT afWeights[3] = { 0.6f, 0.3f, 0.1f };
+  static const INDEX aiBoneOffsets[3] = { 0, 1, 7 };
+  for(INDEX iBone=0; iBone<_ctBenchBones; iBone++) {
+    _aiBenchFirstWeight[iBone] = _avwBenchWeights.Count();
+    for(INDEX ivx=0; ivx<_ctBenchVertices; ivx++) {
+      for(INDEX iw=0; iw<3; iw++) {
+        if((ivx+aiBoneOffsets[iw])%_ctBenchBones==iBone) {
+          MeshVertexWeight &vw = _avwBenchWeights.Push();
+          vw.mww_iVertex = ivx;
+          vw.mww_fWeight = afWeights[iw];
+        }
+      }
+    }
+  }
+  _aiBenchFirstWeight[_ctBenchBones] = _avwBenchWeights.Count();
+
+  // each instance has its own pose
+  _amBenchBones.PopAll();
+  _amBenchBones.Push(_ctBenchInstances*_ctBenchBones*2);
+  for(INDEX im=0; im<_ctBenchInstances*_ctBenchBones; im++) {
+    FLOATmatrix3D mRot;
+    MakeRotationMatrixFast(mRot, ANGLE3D(BENCHRANDOM()*360, BENCHRANDOM()*90-45, BENCHRANDOM()*90-45));
+    FLOAT3D vPos(BENCHRANDOM()*4-2, BENCHRANDOM()*4-2, BENCHRANDOM()*4-2);
+    MatrixVectorToMatrix12(_amBenchBones[im*2+1], mRot, vPos);
+    MatrixVectorToMatrix12(_amBenchBones[im*2+0], mRot*(1.0f+BENCHRANDOM()*0.2f), vPos);
+  }
+  #undef BENCHRANDOM
+  for(INDEX iResult=0; iResult<2; iResult++) {
+    _avBenchDst[iResult].PopAll();
+    _anBenchDst[iResult].PopAll();
+    _avBenchDst[iResult].Push(_ctBenchInstances*_ctBenchVertices);
+    _anBenchDst[iResult].Push(_ctBenchInstances*_ctBenchVertices);
+  }
+
+  // reference path on one thread, then SSE path on one and on all threads
+  DOUBLE dRef = RunSkinningBenchmark(FALSE, 1);
+  CPrintF(TRANS("%d instances, %d vertices, %d weights each\n"), _ctBenchInstances, _ctBenchVertices, _avwBenchWeights.Count());
+  CPrintF("reference, 1 thread(s):  %7.2f ms\n", dRef*1000);
+  for(INDEX iPass=0; iPass<2; iPass++) {
+    INDEX ctPassThreads = (iPass==0) ? 1 : ctThreads;
+    memset(&_avBenchDst[1][0], 0xFF, sizeof(MeshVertex)*_ctBenchInstances*_ctBenchVertices);
+    DOUBLE dSSE = RunSkinningBenchmark(TRUE, ctPassThreads);
+    FLOAT fError = SkinningBenchmarkError();
+    CPrintF("SSE, %2d thread(s):      %7.2f ms (%.2fx), max error %g %s\n", ctPassThreads, dSSE*1000,
+      dSSE>0 ? dRef/dSSE : 0.0, fError, fError<0.0001f ? "" : "MISMATCH!");
+  }
+
+  _avBenchSrc.Clear();
+  _anBenchSrc.Clear();
+  _avwBenchWeights.Clear();
+  _amBenchBones.Clear();
+  for(INDEX iClear=0; iClear<2; iClear++) {
+    _avBenchDst[iClear].Clear();
+    _anBenchDst[iClear].Clear();
+  }
+}
+void RM_SkinningBenchmarkCfunc(void *pArgs)
+{
+  INDEX ctInstances = NEXTARGUMENT(INDEX);
+  INDEX ctThreads = NEXTARGUMENT(INDEX);
+  RM_SkinningBenchmark(ctInstances, ctThreads);
+}
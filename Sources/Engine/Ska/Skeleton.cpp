@@ -31,6 +31,7 @@ INDEX ctSortBones;
 
 CSkeleton::CSkeleton()
 {
+  skl_ulGeneration = 0;
 }
 
 CSkeleton::~CSkeleton()
@@ -59,6 +60,7 @@ INDEX CSkeleton::FindBoneInLOD(INDEX iBoneID,INDEX iSkeletonLod)
 // Sorts bones in skeleton so parent bones are allways before child bones in array
 void CSkeleton::SortSkeleton()
 {
+  skl_ulGeneration++;
   // sort each lod in skeleton
   INDEX ctslods = skl_aSkeletonLODs.Count();
   // for each lod in skeleton
@@ -130,6 +132,7 @@ void CSkeleton::CalculateAbsoluteTransformations(INDEX iSkeletonLod)
 // Add skeleton lod to skeleton
 void CSkeleton::AddSkletonLod(SkeletonLOD &slod)
 {
+  skl_ulGeneration++;
   INDEX ctlods = skl_aSkeletonLODs.Count();
   skl_aSkeletonLODs.Expand(ctlods+1);
   skl_aSkeletonLODs[ctlods] = slod;
@@ -138,6 +141,7 @@ void CSkeleton::AddSkletonLod(SkeletonLOD &slod)
 // Remove skleton lod form skeleton
 void CSkeleton::RemoveSkeletonLod(SkeletonLOD *pslodRemove)
 {
+  skl_ulGeneration++;
   INDEX ctslod = skl_aSkeletonLODs.Count();
   // create temp space for skeleton lods
   CStaticArray<struct SkeletonLOD> aTempSLODs;
@@ -206,6 +210,7 @@ void CSkeleton::Write_t(CTStream *ostrFile)
 // read from stream
 void CSkeleton::Read_t(CTStream *istrFile)
 {
+  skl_ulGeneration++;
   INDEX iFileVersion;
   INDEX ctslods;
   // read chunk id
@@ -261,6 +266,7 @@ void CSkeleton::Read_t(CTStream *istrFile)
 // Clear skeleton
 void CSkeleton::Clear(void)
 {
+  skl_ulGeneration++;
   // for each LOD
   for (INDEX islod=0; islod<skl_aSkeletonLODs.Count(); islod++) {
     // clear bones array
@@ -77,6 +77,7 @@ public:
 
 
   CStaticArray<struct SkeletonLOD>  skl_aSkeletonLODs;
+  ULONG skl_ulGeneration; // changed whenever bones may have changed (reload, sort, lods added or removed)
 }; 
 
 
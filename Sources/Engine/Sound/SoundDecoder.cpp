@@ -22,7 +22,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/FileName.h>
 #include <Engine/Base/Unzip.h>
 #include <Engine/Base/Translation.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Synchronization.h>
+#include <Engine/Base/ListIterator.inl>
 #include <Engine/Math/Functions.h>
+#include <Engine/Sound/SoundLibrary.h>
+#include <Engine/Sound/SoundProfile.h>
 
 // generic function called if a dll function is not found
 static void FailFunction_t(const char *strName) {
@@ -187,6 +193,103 @@ static ov_callbacks ovcCallbacks = {
 };
 
 
+// ------------------------------------ decoder threads
+
+extern INDEX snd_bStreamDecoding;
+extern INDEX snd_iDecoderThreads;
+extern FLOAT snd_tmStreamAhead;
+
+#define DECODE_CHUNK (16*1024)   // most bytes that decoder thread decodes at once
+#define MAX_DECODERTHREADS 4
+
+static CTCriticalSection _csDecoders;   // guards list of streaming decoders and their ring positions
+static CListHead _lhStreamingDecoders;  // decoders that decoder threads keep filled
+static HANDLE _ahDecoderThreads[MAX_DECODERTHREADS];
+static INDEX _ctDecoderThreads = 0;
+static HANDLE _hDecoderEvent = NULL;    // signaled when mixer takes data from some ring
+static volatile BOOL _bStopDecoders = FALSE;
+
+
+// find streaming decoder with least data decoded ahead and mark it as busy
+static CSoundDecoder *PickDecoder(void)
+{
+  CTSingleLock slDecoders(&_csDecoders, TRUE);
+  CSoundDecoder *psdcBest = NULL;
+  FLOAT fBestFill = 1.0f;
+  FOREACHINLIST( CSoundDecoder, sdc_lnStreaming, _lhStreamingDecoders, itsdc) {
+    CSoundDecoder &sdc = *itsdc;
+    if( sdc.sdc_bBusy || sdc.sdc_bEnded) continue;
+    const SLONG slBuffered = sdc.sdc_ulRingWritten-sdc.sdc_ulRingRead;
+    // skip if there is no room for a reasonable chunk
+    if( sdc.sdc_slRingSize-slBuffered < DECODE_CHUNK/4) continue;
+    const FLOAT fFill = (FLOAT)slBuffered/sdc.sdc_slRingSize;
+    if( fFill<fBestFill) {
+      fBestFill = fFill;
+      psdcBest = &sdc;
+    }
+  }
+  if( psdcBest!=NULL) psdcBest->sdc_bBusy = TRUE;
+  return psdcBest;
+}
+
+
+static DWORD WINAPI DecoderThread(LPVOID lpParam)
+{
+  while( !_bStopDecoders) {
+    CSoundDecoder *psdc = PickDecoder();
+    // if nothing to decode, wait until mixer takes some data
+    if( psdc==NULL) {
+      WaitForSingleObject( _hDecoderEvent, 10);
+      continue;
+    }
+    psdc->FillRing();
+    CTSingleLock slDecoders(&_csDecoders, TRUE);
+    psdc->sdc_bBusy = FALSE;
+  }
+  return 0;
+}
+
+
+static BOOL StartDecoderThreads(void)
+{
+  if( _ctDecoderThreads>0) return TRUE;
+  _csDecoders.cs_iIndex = -1;
+  _bStopDecoders = FALSE;
+  _hDecoderEvent = CreateEvent( NULL, FALSE, FALSE, NULL);
+  if( _hDecoderEvent==NULL) return FALSE;
+
+  snd_iDecoderThreads = Clamp( snd_iDecoderThreads, 1L, (INDEX)MAX_DECODERTHREADS);
+  for( INDEX iThread=0; iThread<snd_iDecoderThreads; iThread++) {
+    DWORD dwThreadId;
+    HANDLE hThread = CreateThread( NULL, 0, DecoderThread, NULL, 0, &dwThreadId);
+    if( hThread==NULL) break;
+    _ahDecoderThreads[_ctDecoderThreads++] = hThread;
+  }
+  // if no thread could be started, sounds will be decoded when mixing
+  if( _ctDecoderThreads==0) {
+    CloseHandle( _hDecoderEvent);
+    _hDecoderEvent = NULL;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+static void StopDecoderThreads(void)
+{
+  if( _ctDecoderThreads==0) return;
+  ASSERT( _lhStreamingDecoders.IsEmpty());
+  _bStopDecoders = TRUE;
+  WaitForMultipleObjects( _ctDecoderThreads, _ahDecoderThreads, TRUE, INFINITE);
+  for( INDEX iThread=0; iThread<_ctDecoderThreads; iThread++) {
+    CloseHandle( _ahDecoderThreads[iThread]);
+  }
+  _ctDecoderThreads = 0;
+  CloseHandle( _hDecoderEvent);
+  _hDecoderEvent = NULL;
+}
+
+
 // initialize/end the decoding support engine(s)
 void CSoundDecoder::InitPlugins(void)
 {
@@ -239,6 +342,9 @@ void CSoundDecoder::InitPlugins(void)
 
 void CSoundDecoder::EndPlugins(void)
 {
+  // no more streaming
+  StopDecoderThreads();
+
   // cleanup amp11lib when not needed anymore
   if (_bAMP11Enabled) {
     palEndLibrary();
@@ -262,6 +368,13 @@ CSoundDecoder::CSoundDecoder(const CTFileName &fnm)
 {
   sdc_pogg = NULL;
   sdc_pmpeg = NULL;
+  sdc_pubRing = NULL;
+  sdc_slRingSize = 0;
+  sdc_ulRingRead = 0;
+  sdc_ulRingWritten = 0;
+  sdc_bLoop  = FALSE;
+  sdc_bEnded = FALSE;
+  sdc_bBusy  = FALSE;
 
   CTFileName fnmExpanded;
   INDEX iFileType = ExpandFilePath(EFP_READ, fnm, fnmExpanded);
@@ -484,6 +597,8 @@ CSoundDecoder::~CSoundDecoder(void)
 
 void CSoundDecoder::Clear(void)
 {
+  StopStreaming();
+
   if (sdc_pmpeg!=NULL) {
     if (sdc_pmpeg->mpeg_hDecoder!=0)  palClose(sdc_pmpeg->mpeg_hDecoder);
     if (sdc_pmpeg->mpeg_hFile!=0)     palClose(sdc_pmpeg->mpeg_hFile);
@@ -511,8 +626,126 @@ void CSoundDecoder::Clear(void)
   }
 }
 
+// start decoding ahead on decoder threads (decoding then only copies already decoded data)
+void CSoundDecoder::StartStreaming(BOOL bLoop)
+{
+  if (!snd_bStreamDecoding || !IsOpen() || sdc_pubRing!=NULL) {
+    return;
+  }
+  if (!StartDecoderThreads()) {
+    return;
+  }
+
+  // ring must hold at least two mixings (and its size is a power of 2, so positions can wrap around)
+  WAVEFORMATEX wfe;
+  GetFormat(wfe);
+  snd_tmStreamAhead = Clamp(snd_tmStreamAhead, 0.25f, 4.0f);
+  SLONG slWanted = FloatToInt(snd_tmStreamAhead*wfe.nAvgBytesPerSec);
+  slWanted = Max(slWanted, _pSound->sl_slDecodeBufferSize*2);
+  SLONG slSize = DECODE_CHUNK*4;
+  while (slSize<slWanted) slSize *= 2;
+  sdc_pubRing = (UBYTE*)AllocMemory(slSize);
+  sdc_slRingSize = slSize;
+  sdc_ulRingRead = 0;
+  sdc_ulRingWritten = 0;
+  sdc_bLoop  = bLoop;
+  sdc_bEnded = FALSE;
+  sdc_bBusy  = FALSE;
+
+  // let decoder threads fill it (nothing is decoded here, since caller may hold sound lock;
+  // they take emptiest stream first, and mixing plays silence until first data is ready)
+  CTSingleLock slDecoders(&_csDecoders, TRUE);
+  _lhStreamingDecoders.AddTail(sdc_lnStreaming);
+  SetEvent(_hDecoderEvent);
+}
+
+// stop decoding ahead and free ring buffer
+void CSoundDecoder::StopStreaming(void)
+{
+  if (sdc_pubRing==NULL) {
+    return;
+  }
+  // unlink from decoder threads when none of them is decoding this one
+  FOREVER {
+    {
+      CTSingleLock slDecoders(&_csDecoders, TRUE);
+      if (!sdc_bBusy) {
+        sdc_lnStreaming.Remove();
+        break;
+      }
+    }
+    Sleep(1);
+  }
+  FreeMemory(sdc_pubRing);
+  sdc_pubRing = NULL;
+  sdc_slRingSize = 0;
+}
+
+// decode ahead into ring buffer (called by decoder threads)
+void CSoundDecoder::FillRing(void)
+{
+  // find free part of ring after last written byte (mixer doesn't touch that part)
+  SLONG slFree, slWritePos;
+  {
+    CTSingleLock slDecoders(&_csDecoders, TRUE);
+    slFree = sdc_slRingSize - (SLONG)(sdc_ulRingWritten-sdc_ulRingRead);
+    slWritePos = sdc_ulRingWritten % sdc_slRingSize;
+  }
+  const SLONG slToDecode = Min(Min(slFree, sdc_slRingSize-slWritePos), (SLONG)DECODE_CHUNK);
+  if (slToDecode<=0) {
+    return;
+  }
+
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  INDEX ctDecoded = DecodeStream(sdc_pubRing+slWritePos, slToDecode);
+  BOOL bEnded = FALSE;
+  // if stream came to end
+  if (ctDecoded<slToDecode) {
+    // if looping, restart it (unless nothing can be decoded even from the start)
+    if (sdc_bLoop) {
+      ResetStream();
+      if (ctDecoded==0) {
+        ctDecoded = DecodeStream(sdc_pubRing+slWritePos, slToDecode);
+        bEnded = ctDecoded<=0;
+      }
+    } else {
+      bEnded = TRUE;
+    }
+  }
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+
+  // publish decoded data
+  CTSingleLock slDecoders(&_csDecoders, TRUE);
+  sdc_ulRingWritten += ctDecoded;
+  sdc_bEnded = bEnded;
+  _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_STREAMDECODETIME, (INDEX)((tv1-tv0).GetSeconds()*1E6));
+}
+
 // reset decoder to start of sample
 void CSoundDecoder::Reset(void)
+{
+  // if decoding ahead
+  if (sdc_pubRing!=NULL) {
+    // wait until no decoder thread is decoding this one
+    CTSingleLock slDecoders(&_csDecoders, TRUE);
+    while (sdc_bBusy) {
+      slDecoders.Unlock();
+      Sleep(1);
+      slDecoders.Lock();
+    }
+    // discard decoded data and restart
+    ResetStream();
+    sdc_ulRingRead = 0;
+    sdc_ulRingWritten = 0;
+    sdc_bEnded = FALSE;
+    SetEvent(_hDecoderEvent);
+    return;
+  }
+  ResetStream();
+}
+
+// reset stream to start of sample
+void CSoundDecoder::ResetStream(void)
 {
   if (sdc_pmpeg!=NULL) {
     palDecSeekAbs(sdc_pmpeg->mpeg_hDecoder, 0.0f);
@@ -550,11 +783,54 @@ void CSoundDecoder::GetFormat(WAVEFORMATEX &wfe)
 
 // decode a block of bytes
 INDEX CSoundDecoder::Decode(void *pvDestBuffer, INDEX ctBytesToDecode)
+{
+  // if not decoding ahead, decode now
+  if (sdc_pubRing==NULL) {
+    return DecodeStream(pvDestBuffer, ctBytesToDecode);
+  }
+
+  // see how much is decoded ahead
+  SLONG slAvailable, slReadPos;
+  BOOL bEnded;
+  {
+    CTSingleLock slDecoders(&_csDecoders, TRUE);
+    slAvailable = sdc_ulRingWritten-sdc_ulRingRead;
+    slReadPos = sdc_ulRingRead % sdc_slRingSize;
+    bEnded = sdc_bEnded;
+  }
+  WAVEFORMATEX wfe;
+  GetFormat(wfe);
+  _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_STREAMAHEADMS, (INDEX)(slAvailable*1000.0/wfe.nAvgBytesPerSec));
+
+  // copy it (decoder threads don't write to the part that is not taken yet)
+  UBYTE *pub = (UBYTE*)pvDestBuffer;
+  const SLONG slCopy  = Min(slAvailable, (SLONG)ctBytesToDecode);
+  const SLONG slFirst = Min(slCopy, sdc_slRingSize-slReadPos);
+  memcpy(pub, sdc_pubRing+slReadPos, slFirst);
+  memcpy(pub+slFirst, sdc_pubRing, slCopy-slFirst);
+  {
+    CTSingleLock slDecoders(&_csDecoders, TRUE);
+    sdc_ulRingRead += slCopy;
+  }
+  SetEvent(_hDecoderEvent);
+
+  // if decoder threads were too slow (or have not filled a new stream yet),
+  // play silence instead of missing data
+  if (slCopy<ctBytesToDecode && !bEnded) {
+    _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_STREAMUNDERRUNS);
+    memset(pub+slCopy, 0, ctBytesToDecode-slCopy);
+    return ctBytesToDecode;
+  }
+  return slCopy;
+}
+
+// decode a block of bytes directly from stream
+INDEX CSoundDecoder::DecodeStream(void *pvDestBuffer, INDEX ctBytesToDecode)
 {
   // if ogg
   if (sdc_pogg!=NULL && sdc_pogg->ogg_vfVorbisFile!=0) {
     // decode ogg
-    static int iCurrrentSection = -1; // we don't care about this
+    int iCurrrentSection = -1; // we don't care about this
     char *pch = (char *)pvDestBuffer;
     INDEX ctDecoded = 0;
     while (ctDecoded<ctBytesToDecode) {
@@ -15,11 +15,23 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <Engine/Base/Lists.h>
+
 class CSoundDecoder {
 public:
   class CDecodeData_MPEG *sdc_pmpeg;
   class CDecodeData_OGG  *sdc_pogg ;
 
+  // ring buffer that decoder threads keep filled ahead of the mixer (only when streaming)
+  UBYTE *sdc_pubRing;       // decoded data (NULL if decoding when mixing)
+  SLONG  sdc_slRingSize;    // size of ring buffer in bytes
+  ULONG  sdc_ulRingRead;    // total bytes taken by mixer (wraps around)
+  ULONG  sdc_ulRingWritten; // total bytes written by decoder thread (wraps around)
+  BOOL   sdc_bLoop;         // decoder thread restarts the stream when it ends
+  BOOL   sdc_bEnded;        // decoder thread came to end of stream
+  BOOL   sdc_bBusy;         // a decoder thread is decoding this stream
+  CListNode sdc_lnStreaming; // for linking in list of streaming decoders
+
   // initialize/end the decoding support engine(s)
   static void InitPlugins(void);
   static void EndPlugins(void);
@@ -34,8 +46,20 @@ public:
   // get wave format of the decoder (invaid if it is not open)
   void GetFormat(WAVEFORMATEX &wfe);
 
+  // start decoding ahead on decoder threads (decoding then only copies already decoded data)
+  void StartStreaming(BOOL bLoop);
+  // stop decoding ahead and free ring buffer
+  void StopStreaming(void);
+
   // decode a block of bytes
   INDEX Decode(void *pvDestBuffer, INDEX ctBytesToDecode);
   // reset decoder to start of sample
   void Reset(void);
+
+  // decode a block of bytes directly from stream
+  INDEX DecodeStream(void *pvDestBuffer, INDEX ctBytesToDecode);
+  // reset stream to start of sample
+  void ResetStream(void);
+  // decode ahead into ring buffer (called by decoder threads)
+  void FillRing(void);
 };
@@ -68,6 +68,11 @@ extern FLOAT snd_fDFilter  = 3.0f;   // filter for down
 
 ENGINE_API extern INDEX snd_iFormat = 3;
 extern INDEX snd_bMono = FALSE;
+extern INDEX snd_bUseSSE2 = TRUE;  // mix sounds with SSE2 kernel when CPU supports it
+extern INDEX snd_bStreamDecoding = TRUE;  // decode streamed sounds ahead on decoder threads
+extern INDEX snd_iDecoderThreads = 1;     // number of decoder threads
+extern FLOAT snd_tmStreamAhead   = 1.0f;  // how much to decode ahead (in seconds)
+static INDEX snd_iMaxVoices = 0;   // max sounds mixed at once, others are only advanced (0 for no limit)
 static INDEX snd_iDevice = -1;
 static INDEX snd_iInterface = 2;   // 0=WaveOut, 1=DirectSound, 2=EAX
 static INDEX snd_iMaxOpenRetries = 3;
@@ -78,6 +83,9 @@ static FLOAT snd_fEAXPanning = 0.0f;
 static FLOAT snd_fNormalizer = 0.9f;
 static FLOAT _fLastNormalizeValue = 1;
 
+extern void SoundMixerBenchmark(void);
+extern void SoundVirtualVoiceCheck(void);
+
 extern HWND  _hwndMain; // global handle for application window
 static HWND  _hwndCurrent = NULL;
 static HINSTANCE _hInstDS = NULL;
@@ -757,6 +765,13 @@ void CSoundLibrary::Init(void)
   _pShell->DeclareSymbol( "void SndPostFunc(INDEX);", &SndPostFunc);
 
   _pShell->DeclareSymbol( "           user INDEX snd_bMono;", &snd_bMono);
+  _pShell->DeclareSymbol( "persistent user INDEX snd_bUseSSE2;", &snd_bUseSSE2);
+  _pShell->DeclareSymbol( "persistent user INDEX snd_bStreamDecoding;", &snd_bStreamDecoding);
+  _pShell->DeclareSymbol( "persistent user INDEX snd_iDecoderThreads;", &snd_iDecoderThreads);
+  _pShell->DeclareSymbol( "persistent user FLOAT snd_tmStreamAhead;",   &snd_tmStreamAhead);
+  _pShell->DeclareSymbol( "persistent user INDEX snd_iMaxVoices;", &snd_iMaxVoices);
+  _pShell->DeclareSymbol( "user void SoundMixerBenchmark(void);", &SoundMixerBenchmark);
+  _pShell->DeclareSymbol( "user void SoundVirtualVoiceCheck(void);", &SoundVirtualVoiceCheck);
   _pShell->DeclareSymbol( "persistent user FLOAT snd_fEarsDistance;",      &snd_fEarsDistance);
   _pShell->DeclareSymbol( "persistent user FLOAT snd_fDelaySoundSpeed;",   &snd_fDelaySoundSpeed);
   _pShell->DeclareSymbol( "persistent user FLOAT snd_fDopplerSoundSpeed;", &snd_fDopplerSoundSpeed);
@@ -1247,6 +1262,38 @@ static SLONG PrepareSoundBuffer_waveout( CSoundLibrary &sl)
   return slDataToMix;
 }
 
+
+// sound that should be mixed and how much it can be heard
+class CMixerVoiceSlot {
+public:
+  CSoundObject *mvs_pso;
+  FLOAT mvs_fAudibility;
+};
+static CStaticStackArray<CMixerVoiceSlot> _amvsVoices;
+
+// estimate how well can a sound be heard (volumes already include distance falloff to listeners)
+static FLOAT SoundAudibility( CSoundObject &so)
+{
+  // music and encoded sounds must always be mixed
+  if( (so.so_slFlags&SOF_MUSIC) || (so.so_pCsdLink->sd_ulFlags&SDF_ENCODED)) return UpperLimit(0.0f);
+  // sounds that are still delayed cannot be heard yet
+  if( so.so_fDelayed < so.so_sp.sp_fDelay) return 0.0f;
+  FLOAT fAudibility = Max( Max( so.so_sp.sp_fLeftVolume, so.so_sp.sp_fRightVolume),
+                           Max( so.so_fLastLeftVolume,   so.so_fLastRightVolume));
+  // prefer sounds that were mixed last time, so they don't keep switching on and off
+  if( !(so.so_slFlags&SOF_VIRTUAL)) fAudibility *= 1.5f;
+  return fAudibility;
+}
+
+static int qsort_CompareVoiceSlots( const void *ppv0, const void *ppv1)
+{
+  const CMixerVoiceSlot &mvs0 = *(const CMixerVoiceSlot *)ppv0;
+  const CMixerVoiceSlot &mvs1 = *(const CMixerVoiceSlot *)ppv1;
+  if( mvs0.mvs_fAudibility > mvs1.mvs_fAudibility) return -1;
+  if( mvs0.mvs_fAudibility < mvs1.mvs_fAudibility) return +1;
+  return 0;
+}
+
   
 /* Update Mixer */
 void CSoundLibrary::MixSounds(void)
@@ -1284,6 +1331,7 @@ void CSoundLibrary::MixSounds(void)
   BOOL bGamePaused = _pNetwork->IsPaused() || _pNetwork->IsServer() && _pNetwork->GetLocalPause();
 
   // for each sound
+  _amvsVoices.PopAll();
   FOREACHINLIST( CSoundData, sd_Node, sl_ClhAwareList, itCsdSoundData) {
     FORDELETELIST( CSoundObject, so_Node, itCsdSoundData->sd_ClhLinkList, itCsoSoundObject) {
       CSoundObject &so = *itCsoSoundObject;
@@ -1296,12 +1344,38 @@ void CSoundLibrary::MixSounds(void)
       if( so.so_slFlags&SOF_PLAY && 
           so.so_slFlags&SOF_PREPARE &&
         !(so.so_slFlags&SOF_PAUSED)) {
-        // mix it
-        MixSound(&so);
+        // it should be mixed
+        CMixerVoiceSlot &mvs = _amvsVoices.Push();
+        mvs.mvs_pso = &so;
+        mvs.mvs_fAudibility = 0.0f;
       }
     }
   }
 
+  // if there are more sounds than allowed
+  const INDEX ctVoices = _amvsVoices.Count();
+  snd_iMaxVoices = ClampDn( snd_iMaxVoices, 0L);
+  INDEX ctRealVoices = ctVoices;
+  if( snd_iMaxVoices>0 && ctVoices>snd_iMaxVoices) {
+    // mix only those that can be heard best
+    for( INDEX iVoice=0; iVoice<ctVoices; iVoice++) {
+      _amvsVoices[iVoice].mvs_fAudibility = SoundAudibility( *_amvsVoices[iVoice].mvs_pso);
+    }
+    qsort( &_amvsVoices[0], ctVoices, sizeof(CMixerVoiceSlot), qsort_CompareVoiceSlots);
+    ctRealVoices = snd_iMaxVoices;
+  }
+  _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_VOICESPLAYING, ctVoices);
+
+  // mix real sounds and advance virtual ones
+  for( INDEX iVoice=0; iVoice<ctVoices; iVoice++) {
+    CSoundObject &so = *_amvsVoices[iVoice].mvs_pso;
+    const BOOL bVirtual = iVoice>=ctRealVoices;
+    if( bVirtual) so.so_slFlags |=  SOF_VIRTUAL;
+    else          so.so_slFlags &= ~SOF_VIRTUAL;
+    MixSound( &so, bVirtual);
+  }
+  FlushMixer();
+
   // eventually normalize mixed sounds
   snd_fNormalizer = Clamp( snd_fNormalizer, 0.0f, 1.0f);
   NormalizeMixerBuffer( snd_fNormalizer, slDataToMix, _fLastNormalizeValue);
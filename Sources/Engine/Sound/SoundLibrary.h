@@ -43,8 +43,11 @@ void CopyMixerBuffer_stereo( const SLONG slSrcOffset, const void *pDstBuffer, co
 void CopyMixerBuffer_mono(   const SLONG slSrcOffset, const void *pDstBuffer, const SLONG slBytes);
 // normalize mixed sounds
 void NormalizeMixerBuffer( const FLOAT snd_fNormalizer, const SLONG slBytes, FLOAT &_fLastNormalizeValue);
-// mix in one sound object to mixer buffer
-void MixSound( class CSoundObject *pso);
+// mix in one sound object to mixer buffer (might wait for more sounds to mix them together)
+// virtual sounds are only advanced, but not mixed
+void MixSound( class CSoundObject *pso, BOOL bVirtual=FALSE);
+// mix in sound objects that are still waiting
+void FlushMixer(void);
 
 
 /*
@@ -22,21 +22,18 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Sound/SoundObject.h>
 #include <Engine/Base/Statistics_Internal.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Timer.h>
 
-// asm shortcuts
-#define O offset
-#define Q qword ptr
-#define D dword ptr
-#define W  word ptr
-#define B  byte ptr
+#include <emmintrin.h>
 
-#define ASMOPT 1
 
-
-// console variables for volume
+// console variables for volume and mixer kernels
 extern FLOAT snd_fSoundVolume;
 extern FLOAT snd_fMusicVolume;
 extern INDEX snd_bMono;
+extern INDEX snd_bUseSSE2;
+extern BOOL  sys_bCPUHasSSE2;
 
 
 // a bunch of local vars coming up
@@ -48,18 +45,49 @@ static void *pvMixerBuffer;            // pointer to the start of the destinatio
 static CSoundData *psd;
 static SWORD *pswSrcBuffer;
 static SLONG slLeftVolume,  slRightVolume, slLeftFilter, slRightFilter;
-static SLONG slLastLeftSample, slLastRightSample, slSoundBufferSize;
+static SLONG slSoundBufferSize;
 static FLOAT fSoundSampleRate, fPhase;
 static FLOAT fOfsDelta, fStep, fLeftStep, fRightStep, fLeftOfs, fRightOfs;
-static __int64 fixLeftOfs, fixRightOfs; // fixed integers 32:32
-static __int64 mmSurroundFactor, mmLeftStep, mmRightStep, mmVolumeGain;
-static BOOL bNotLoop, bEndOfSound;
-
-static const FLOAT f65536 = 65536.0f;
-static const FLOAT f4G    = 4294967296.0f;
-static __int64 mmInvFactor   = 0x00007FFF00007FFF;
-static __int64 mmMaskLD      = 0x00000000FFFFFFFF;
-static __int64 mmUnsign2Sign = 0x8000800080008000;
+static BOOL bNotLoop;
+
+
+// one sound prepared for mixing (index 0 of each pair is for left channel, 1 for right)
+class CMixerVoice {
+public:
+  CSoundObject *mv_pso;     // sound object that is mixed (NULL in benchmark)
+  const SWORD *mv_pswSrc;   // source samples
+  SLONG mv_slSrcSize;       // source size in samples per channel
+  BOOL  mv_bStereo;         // source has two interleaved channels
+  BOOL  mv_bNotLoop;        // sound ends when offset comes to the end of source
+  BOOL  mv_bEndOfSound;     // set by mixer when a non-looping sound ends
+  SLONG mv_slSamples;       // number of samples to mix into mixer buffer
+  SLONG mv_aslOfs[2];       // integer part of source offsets
+  SLONG mv_aslFrac[2];      // 16-bit fraction of source offsets
+  SLONG mv_aslStep[2];      // integer part of source steps
+  SLONG mv_aslStepFrac[2];  // 16-bit fraction of source steps
+  SLONG mv_aslVolume[2];    // volumes (16:16)
+  SLONG mv_aslGain[2];      // volume change per sample
+  SLONG mv_aslFilter[2];    // filters (1:15)
+  SLONG mv_aslLast[2];      // last filtered samples
+  SLONG mv_slSurround;      // 0xFFFF if left channel is inverted for surround
+  // for finishing the mixing of sound object
+  BOOL  mv_bEncoded;
+  BOOL  mv_bDecodingFinished;
+  FLOAT mv_fStepDelta;
+  FLOAT mv_fNewLeftVolume, mv_fNewRightVolume;
+};
+
+// voices mixed in one pass of SSE2 mixer (two channels of each fill 8 words)
+#define MIXER_VOICES 4
+static CMixerVoice _amvPending[MIXER_VOICES];  // voices waiting to be mixed
+static INDEX _ctPending = 0;
+
+
+// check which kernels should be used for mixing
+static BOOL UseSSE2(void)
+{
+  return snd_bUseSSE2 && sys_bCPUHasSSE2;
+}
 
 
 
@@ -76,15 +104,9 @@ void ResetMixer( const SLONG *pslBuffer, const SLONG slBufferSize)
   slMixerBufferSize = slBufferSize /2/2; // because it's stereo and 16-bit dst format
   slMixerBufferSampleRate = _pSound->sl_SwfeFormat.nSamplesPerSec;
 
-  // wipe destination mixer buffer
-  __asm {
-    cld
-    xor     eax,eax
-    mov     edi,D [pvMixerBuffer]
-    mov     ecx,D [slMixerBufferSize]
-    shl     ecx,1 // *2 because of 32-bit src format
-    rep     stosd
-  }
+  // wipe destination mixer buffer (*2 because of 32-bit src format)
+  memset( pvMixerBuffer, 0, slMixerBufferSize*2*sizeof(SLONG));
+  _ctPending = 0;
 }
 
 
@@ -94,15 +116,7 @@ void CopyMixerBuffer_stereo( const SLONG slSrcOffset, const void *pDstBuffer, co
   ASSERT( pDstBuffer!=NULL);
   ASSERT( slBytes%4==0);
   if( slBytes<4) return;
-  __asm {
-    cld
-    mov     esi,D [slSrcOffset]
-    add     esi,D [pvMixerBuffer]
-    mov     edi,D [pDstBuffer]
-    mov     ecx,D [slBytes]
-    shr     ecx,2   // bytes to samples per channel
-    rep     movsd
-  }
+  memcpy( (void*)pDstBuffer, (UBYTE*)pvMixerBuffer+slSrcOffset, slBytes);
 }
 
 
@@ -112,19 +126,11 @@ void CopyMixerBuffer_mono( const SLONG slSrcOffset, const void *pDstBuffer, cons
   ASSERT( pDstBuffer!=NULL);
   ASSERT( slBytes%2==0);
   if( slBytes<4) return;
-  __asm {
-    mov     esi,D [slSrcOffset]
-    add     esi,D [pvMixerBuffer]
-    mov     edi,D [pDstBuffer]
-    mov     ecx,D [slBytes]
-    shr     ecx,2   // bytes to samples
-copyLoop:
-    movzx   eax,W [esi]
-    mov     W [edi],ax
-    add     esi,4
-    add     edi,2
-    dec     ecx
-    jnz     copyLoop
+  const SWORD *pswSrc = (const SWORD*)((UBYTE*)pvMixerBuffer+slSrcOffset);
+  SWORD *pswDst = (SWORD*)pDstBuffer;
+  const INDEX ctSamples = slBytes/4; // bytes to samples
+  for( INDEX iSample=0; iSample<ctSamples; iSample++) {
+    pswDst[iSample] = pswSrc[iSample*2];
   }
 }
 
@@ -134,21 +140,21 @@ static void ConvertMixerBuffer( const SLONG slBytes)
 {
   ASSERT( slBytes%4==0);
   if( slBytes<4) return;
-  __asm {
-    cld
-    mov     esi,D [pvMixerBuffer]
-    mov     edi,D [pvMixerBuffer]
-    mov     ecx,D [slBytes]
-    shr     ecx,2 // bytes to samples (2 channels)
-copyLoop:
-    movq    mm0,Q [esi]
-    packssdw mm0,mm0
-    movd    D [edi],mm0
-    add     esi,8
-    add     edi,4
-    dec     ecx
-    jnz     copyLoop
-    emms
+  const SLONG *pslSrc = (const SLONG*)pvMixerBuffer;
+  SWORD *pswDst = (SWORD*)pvMixerBuffer;
+  INDEX ctSamples = slBytes/2; // bytes to samples (both channels)
+  // destination is never ahead of source, so conversion can be done in place
+  if( UseSSE2()) {
+    for( ; ctSamples>=8; ctSamples-=8) {
+      const __m128i m0 = _mm_loadu_si128( (const __m128i*)(pslSrc+0));
+      const __m128i m1 = _mm_loadu_si128( (const __m128i*)(pslSrc+4));
+      _mm_storeu_si128( (__m128i*)pswDst, _mm_packs_epi32( m0, m1));
+      pslSrc += 8;
+      pswDst += 8;
+    }
+  }
+  for( ; ctSamples>0; ctSamples--) {
+    *pswDst++ = (SWORD)Clamp( *pslSrc++, (SLONG)MIN_SWORD, (SLONG)MAX_SWORD);
   }
 }
 
@@ -201,380 +207,344 @@ void NormalizeMixerBuffer( const FLOAT fNormStrength, const SLONG slBytes, FLOAT
  
 
 
-// mixes one mono 16-bit signed sound to destination buffer
-inline void MixMono( CSoundObject *pso)
+
+
+// saturate to 16 bits (like MMX/SSE2 packing and saturated adds do)
+static inline SLONG Saturate16( SLONG sl)
 {
-  _pfSoundProfile.StartTimer(CSoundProfile::PTI_RAWMIXER);
+  return Clamp( sl, (SLONG)MIN_SWORD, (SLONG)MAX_SWORD);
+}
 
-#if ASMOPT == 1
-
-  __asm {
-    // convert from floats to fixints 32:16
-    fld     D [fLeftOfs]
-    fmul    D [f65536]
-    fld     D [fRightOfs]
-    fmul    D [f65536]
-    fld     D [fLeftStep]
-    fmul    D [f65536]
-    fld     D [fRightStep]
-    fmul    D [f4G]
-    fistp   Q [mmRightStep] // fixint 32:32
-    fistp   Q [mmLeftStep]  // fixint 32:16
-    fistp   Q [fixRightOfs] // fixint 32:16
-    fistp   Q [fixLeftOfs]  // fixint 32:16
-
-    // get last played sample (for filtering purposes)
-    movzx   eax,W [slLastRightSample]
-    movzx   edx,W [slLastLeftSample]
-    shl     eax,16
-    or      eax,edx
-    movd    mm6,eax                       // MM6 = 0 | 0 || lastRightSample | lastLeftSample
-
-    // get volume
-    movd    mm5,D [slRightVolume]
-    movd    mm0,D [slLeftVolume]
-    psllq   mm5,32
-    por     mm5,mm0                       // MM5 = rightVolume || leftVolume
-
-    // get filter
-    mov     eax,D [slRightFilter]
-    mov     edx,D [slLeftFilter]
-    shl     eax,16
-    or      eax,edx
-    movd    mm7,eax                       // MM7 = 0 | 0 || rightFilter | leftFilter
-
-    // get offset of each channel inside sound and loop thru destination buffer
-    mov     W [mmRightStep],0
-    movzx   eax,W [fixLeftOfs]
-    movzx   edx,W [fixRightOfs]
-    shl     edx,16
-    or      eax,edx                       // EAX = right ofs frac | left ofs frac
-    mov     ebx,D [fixLeftOfs+2]          // EBX = left ofs int
-    mov     edx,D [fixRightOfs+2]         // EDX = right ofs int
-    mov     esi,D [pswSrcBuffer]          // ESI = source sound buffer start ptr
-    mov     edi,D [pvMixerBuffer]         // EDI = mixer buffer ptr
-    mov     ecx,D [slMixerBufferSize]     // ECX = samples counter
-
-sampleLoop:
-    // check if source offsets came to the end of source sound buffer
-    cmp     ebx,D [slSoundBufferSize]
-    jl      lNotEnd
-    sub     ebx,D [slSoundBufferSize]
-    push    D [bNotLoop]
-    pop     D [bEndOfSound]
-lNotEnd:
-    // same for right channel
-    cmp     edx,D [slSoundBufferSize]
-    jl      rNotEnd
-    sub     edx,D [slSoundBufferSize]
-    push    D [bNotLoop]
-    pop     D [bEndOfSound]
-rNotEnd:
-
-    // check end of sample
-    cmp     ecx,0
-    jle     loopEnd
-    cmp     D [bEndOfSound],TRUE
-    je      loopEnd
-
-    // get sound samples
-    movd    mm1,D [esi+ ebx*2]    // MM1 = 0 | 0 || nextLeftSample  | leftSample
-    movd    mm2,D [esi+ edx*2]    // MM2 = 0 | 0 || nextRightSample | RightSample
-    psllq   mm2,32
-    por     mm1,mm2   // MM1 = nextRightSample | rightSample || nextLeftSample | leftSample
-
-    // calc linear interpolation factor (strength)
-    movd    mm3,eax   // MM3 = 0 | 0 || right frac | left frac
-    punpcklwd mm3,mm3
-    psrlw   mm3,1     // MM3 = rightFrac | rightFrac || leftFrac | leftFrac
-    pxor    mm3,Q [mmInvFactor] // MM3 = rightFrac | 1-rightFrac || leftFrac | 1-leftFrac
-    // apply linear interpolation
-    pmaddwd mm1,mm3
-    psrad   mm1,15
-    packssdw mm1,mm1  // MM1 = ? | ? || linearRightSample | linearLeftSample
-
-    // apply filter
-    psubsw  mm1,mm6
-    pmulhw  mm1,mm7
-    psllw   mm1,1
-    paddsw  mm1,mm6
-    movq    mm6,mm1
-
-    // apply volume adjustment
-    movq    mm0,mm5
-    psrad   mm0,16
-    packssdw mm0,mm0
-    pmulhw  mm1,mm0
-    psllw   mm1,1
-    pxor    mm1,Q [mmSurroundFactor]
-    paddd   mm5,Q [mmVolumeGain]   // modify volume
-
-    // unpack to 32bit and mix it into destination buffer
-    punpcklwd mm1,mm1
-    psrad   mm1,16              // MM1 = finalRightSample || finalLeftSample
-    paddd   mm1,Q [edi]
-    movq    Q [edi],mm1
-
-    // advance to next samples in source sound
-    add     eax,D [mmRightStep+0]
-    adc     edx,D [mmRightStep+4]
-    add      ax,W [mmLeftStep +0]
-    adc     ebx,D [mmLeftStep +2]
-    add     edi,8
-    dec     ecx
-    jmp     sampleLoop
-
-loopEnd:
-    // store modified asm local vars
-    mov     D [fixLeftOfs +0],eax
-    shr     eax,16
-    mov     D [fixRightOfs+0],eax
-    mov     D [fixLeftOfs +2],ebx
-    mov     D [fixRightOfs+2],edx
-    movd    eax,mm6
-    mov     edx,eax
-    and     eax,0x0000FFFF
-    shr     edx,16
-    mov     D [slLastLeftSample],eax
-    mov     D [slLastRightSample],edx
-    emms
+// high word of signed 16-bit multiplication (like pmulhw does)
+static inline SLONG MulHigh16( SLONG sl0, SLONG sl1)
+{
+  return (sl0*sl1)>>16;
+}
+
+// check if source offsets came to the end of source sound buffer
+static inline void WrapVoiceOffsets( CMixerVoice &mv)
+{
+  for( INDEX iCh=0; iCh<2; iCh++) {
+    if( mv.mv_aslOfs[iCh] >= mv.mv_slSrcSize) {
+      // step can be longer than whole source (short loop at high pitch)
+      if( mv.mv_slSrcSize>0) mv.mv_aslOfs[iCh] %= mv.mv_slSrcSize;
+      // if has no loop, end it
+      mv.mv_bEndOfSound = mv.mv_bNotLoop;
+    }
   }
+}
 
-#else
-
-  // initialize some local vars
-  SLONG slLeftSample, slRightSample, slNextSample;
-  SLONG *pslDstBuffer = (SLONG*)pvMixerBuffer;
-  fixLeftOfs   = (__int64)(fLeftOfs   * 65536.0);
-  fixRightOfs  = (__int64)(fRightOfs  * 65536.0);
-  __int64 fixLeftStep  = (__int64)(fLeftStep  * 65536.0);
-  __int64 fixRightStep = (__int64)(fRightStep * 65536.0);
-  __int64 fixSoundBufferSize = ((__int64)slSoundBufferSize)<<16;
-  mmSurroundFactor = (__int64)(SWORD)mmSurroundFactor;
-
-  // loop thru source buffer
-  INDEX iCt = slMixerBufferSize;
-  FOREVER
+// get two neighbour source samples of one channel (for linear interpolation)
+static inline void FetchVoiceSamples( const CMixerVoice &mv, INDEX iCh, SLONG &sl0, SLONG &sl1)
+{
+  if( mv.mv_bStereo) {
+    const SWORD *psw = mv.mv_pswSrc + mv.mv_aslOfs[iCh]*2 + iCh;
+    sl0 = psw[0];
+    sl1 = psw[2];
+  } else {
+    const SWORD *psw = mv.mv_pswSrc + mv.mv_aslOfs[iCh];
+    sl0 = psw[0];
+    sl1 = psw[1];
+  }
+}
+
+// advance to next samples in source sound
+static inline void AdvanceVoice( CMixerVoice &mv)
+{
+  for( INDEX iCh=0; iCh<2; iCh++) {
+    mv.mv_aslFrac[iCh] += mv.mv_aslStepFrac[iCh];
+    mv.mv_aslOfs[iCh]  += mv.mv_aslStep[iCh] + (mv.mv_aslFrac[iCh]>>16);
+    mv.mv_aslFrac[iCh] &= 0xFFFF;
+  }
+}
+
+
+// mix one voice into destination buffer (reference kernel with the arithmetic of old MMX mixer)
+static void MixVoice_C( CMixerVoice &mv, SLONG *pslDst)
+{
+  for( INDEX iSample=0; ; iSample++)
   {
-    // if left channel source sample came to end of sample buffer
-    if( fixLeftOfs >= fixSoundBufferSize) {
-      fixLeftOfs -= fixSoundBufferSize;
-      // if has no loop, end it
-      bEndOfSound = bNotLoop;
+    WrapVoiceOffsets(mv);
+    // end of buffer or sample?
+    if( iSample>=mv.mv_slSamples || mv.mv_bEndOfSound) break;
+
+    for( INDEX iCh=0; iCh<2; iCh++) {
+      // fetch one lineary interpolated sample (factors are 1:15)
+      SLONG sl0, sl1;
+      FetchVoiceSamples( mv, iCh, sl0, sl1);
+      const SLONG slFactor = mv.mv_aslFrac[iCh]>>1;
+      SLONG slSample = Saturate16( (sl0*(slFactor^0x7FFF) + sl1*slFactor) >>15);
+      // filter sample
+      const SLONG slLast = mv.mv_aslLast[iCh];
+      slSample = MulHigh16( Saturate16(slSample-slLast), (SWORD)mv.mv_aslFilter[iCh]);
+      slSample = Saturate16( (SWORD)(slSample<<1) + slLast);
+      mv.mv_aslLast[iCh] = slSample;
+      // apply volume (and surround on left channel)
+      slSample = MulHigh16( slSample, Saturate16(mv.mv_aslVolume[iCh]>>16));
+      slSample = (SWORD)(slSample<<1);
+      if( iCh==0) slSample = (SWORD)(slSample^mv.mv_slSurround);
+      mv.mv_aslVolume[iCh] += mv.mv_aslGain[iCh];
+      // mix in current sample
+      pslDst[iCh] += slSample;
     }
-    // if right channel source sample came to end of sample buffer
-    if( fixRightOfs >= fixSoundBufferSize) {
-      fixRightOfs -= fixSoundBufferSize;
-      // if has no loop, end it
-      bEndOfSound = bNotLoop;
+    AdvanceVoice(mv);
+    pslDst += 2;
+  }
+}
+
+
+// mix up to MIXER_VOICES voices into destination buffer at once (same results as reference kernel)
+static void MixVoices_SSE2( CMixerVoice *amv, INDEX ctVoices, SLONG *pslDst)
+{
+  ASSERT( ctVoices>0 && ctVoices<=MIXER_VOICES);
+  // per channel state, in order: voice 0 left, voice 0 right, voice 1 left, ...
+  SWORD aswFilter[8], aswLast[8], aswSurround[8], aswMask[8];
+  SLONG aslVolume[8], aslGain[8];
+  BOOL  abActive[MIXER_VOICES];
+  INDEX iVoice;
+  for( iVoice=0; iVoice<MIXER_VOICES; iVoice++) {
+    const BOOL bUsed = iVoice<ctVoices;
+    abActive[iVoice] = bUsed;
+    for( INDEX iCh=0; iCh<2; iCh++) {
+      const INDEX iLane = iVoice*2+iCh;
+      aswFilter[iLane] = bUsed ? (SWORD)amv[iVoice].mv_aslFilter[iCh] : 0;
+      aswLast[iLane]   = bUsed ? (SWORD)amv[iVoice].mv_aslLast[iCh]   : 0;
+      aslVolume[iLane] = bUsed ? amv[iVoice].mv_aslVolume[iCh] : 0;
+      aslGain[iLane]   = bUsed ? amv[iVoice].mv_aslGain[iCh]   : 0;
+      aswSurround[iLane] = (bUsed && iCh==0) ? (SWORD)amv[iVoice].mv_slSurround : 0;
+    }
+  }
+  const __m128i mFilter   = _mm_loadu_si128( (__m128i*)aswFilter);
+  const __m128i mSurround = _mm_loadu_si128( (__m128i*)aswSurround);
+  const __m128i mGain0    = _mm_loadu_si128( (__m128i*)(aslGain+0));
+  const __m128i mGain1    = _mm_loadu_si128( (__m128i*)(aslGain+4));
+  __m128i mLast    = _mm_loadu_si128( (__m128i*)aswLast);
+  __m128i mVolume0 = _mm_loadu_si128( (__m128i*)(aslVolume+0));
+  __m128i mVolume1 = _mm_loadu_si128( (__m128i*)(aslVolume+4));
+
+  const __m128i mInvFactor = _mm_set1_epi16( 0x7FFF);
+  ULONG aulPairs[8];  // two neighbour source samples of each channel
+  UWORD auwFracs[8];  // source offset fractions of each channel
+
+  for( INDEX iSample=0; ; )
+  {
+    // end voices that came to end of buffer or sample
+    INDEX ctActive = 0;
+    SLONG slSpan = MAX_SLONG;
+    for( iVoice=0; iVoice<ctVoices; iVoice++) {
+      if( !abActive[iVoice]) continue;
+      CMixerVoice &mv = amv[iVoice];
+      WrapVoiceOffsets(mv);
+      if( iSample>=mv.mv_slSamples || mv.mv_bEndOfSound) {
+        abActive[iVoice] = FALSE;
+        continue;
+      }
+      ctActive++;
+      // determine how many samples can be mixed before offsets must be checked again
+      slSpan = Min( slSpan, mv.mv_slSamples-iSample);
+      for( INDEX iCh=0; iCh<2; iCh++) {
+        const __int64 fixStep = ((__int64)mv.mv_aslStep[iCh]<<16) + mv.mv_aslStepFrac[iCh];
+        if( fixStep<=0) continue;
+        const __int64 fixLeft = ((__int64)mv.mv_slSrcSize<<16) - ((__int64)mv.mv_aslOfs[iCh]<<16) - mv.mv_aslFrac[iCh];
+        slSpan = (SLONG)Min( (__int64)slSpan, (fixLeft+fixStep-1) / fixStep);
+      }
+    }
+    if( ctActive==0) break;
+    ASSERT( slSpan>0);
+    slSpan = ClampDn( slSpan, 1L);
+
+    // channels of ended voices must not change
+    for( iVoice=0; iVoice<MIXER_VOICES; iVoice++) {
+      aswMask[iVoice*2+0] = abActive[iVoice] ? -1 : 0;
+      aswMask[iVoice*2+1] = abActive[iVoice] ? -1 : 0;
+      aulPairs[iVoice*2+0] = aulPairs[iVoice*2+1] = 0;
+      auwFracs[iVoice*2+0] = auwFracs[iVoice*2+1] = 0;
     }
-    // end of buffer?
-    if( iCt<=0 || bEndOfSound) break;
-
-    // fetch one lineary interpolated sample on left channel
-    slLeftSample = pswSrcBuffer[(fixLeftOfs>>16)+0];
-    slNextSample = pswSrcBuffer[(fixLeftOfs>>16)+1];
-    slLeftSample = (slLeftSample*(65535-(fixLeftOfs&65535)) + slNextSample*(fixLeftOfs&65535)) >>16;
-    // fetch one lineary interpolated sample on right channel
-    slRightSample = pswSrcBuffer[(fixRightOfs>>16)+0];
-    slNextSample  = pswSrcBuffer[(fixRightOfs>>16)+1];
-    slRightSample = (slRightSample*(65535-(fixRightOfs&65535)) + slNextSample*(fixRightOfs&65535)) >>16;
-
-    // filter samples
-    slLastLeftSample  += ((slLeftSample -slLastLeftSample) *slLeftFilter) >>15;
-    slLastRightSample += ((slRightSample-slLastRightSample)*slRightFilter)>>15;
-
-    // apply stereo volume to current sample
-    slLeftSample  = (slLastLeftSample  * slLeftVolume) >>15;
-    slRightSample = (slLastRightSample * slRightVolume)>>15;
-
-    slRightSample = slRightSample ^ mmSurroundFactor;
-
-    // mix in current sample
-    slLeftSample  += pslDstBuffer[0];
-    slRightSample += pslDstBuffer[1];
-    // upper clamp
-    if( slLeftSample  > MAX_SWORD) slLeftSample  = MAX_SWORD;
-    if( slRightSample > MAX_SWORD) slRightSample = MAX_SWORD;
-    // lower clamp
-    if( slLeftSample  < MIN_SWORD) slLeftSample  = MIN_SWORD;
-    if( slRightSample < MIN_SWORD) slRightSample = MIN_SWORD;
-
-    // store samples (both channels)
-    pslDstBuffer[0] = slLeftSample;
-    pslDstBuffer[1] = slRightSample;
-
-    // modify volume  `
-    slLeftVolume  += (SWORD)((mmVolumeGain>> 0)&0xFFFF);
-    slRightVolume += (SWORD)((mmVolumeGain>>16)&0xFFFF);
-
-    // advance to next sample
-    fixLeftOfs   += fixLeftStep;
-    fixRightOfs  += fixRightStep;
-    pslDstBuffer += 4;
-    iCt--;
+    const __m128i mMask   = _mm_loadu_si128( (__m128i*)aswMask);
+    const __m128i mGainM0 = _mm_and_si128( mGain0, _mm_unpacklo_epi16( mMask, mMask));
+    const __m128i mGainM1 = _mm_and_si128( mGain1, _mm_unpackhi_epi16( mMask, mMask));
+
+    // mix whole span without checking for ends
+    for( INDEX iSpan=0; iSpan<slSpan; iSpan++)
+    {
+      // gather source samples and offset fractions of all channels
+      for( iVoice=0; iVoice<ctVoices; iVoice++) {
+        if( !abActive[iVoice]) continue;
+        CMixerVoice &mv = amv[iVoice];
+        if( mv.mv_bStereo) {
+          const UWORD *puwL = (const UWORD*)mv.mv_pswSrc + mv.mv_aslOfs[0]*2 +0;
+          const UWORD *puwR = (const UWORD*)mv.mv_pswSrc + mv.mv_aslOfs[1]*2 +1;
+          aulPairs[iVoice*2+0] = puwL[0] | ((ULONG)puwL[2]<<16);
+          aulPairs[iVoice*2+1] = puwR[0] | ((ULONG)puwR[2]<<16);
+        } else {
+          aulPairs[iVoice*2+0] = *(const ULONG*)(mv.mv_pswSrc + mv.mv_aslOfs[0]);
+          aulPairs[iVoice*2+1] = *(const ULONG*)(mv.mv_pswSrc + mv.mv_aslOfs[1]);
+        }
+        auwFracs[iVoice*2+0] = (UWORD)mv.mv_aslFrac[0];
+        auwFracs[iVoice*2+1] = (UWORD)mv.mv_aslFrac[1];
+        AdvanceVoice(mv);
+      }
+
+      // apply linear interpolation (factors are 1:15)
+      const __m128i mFactor = _mm_srli_epi16( _mm_loadu_si128( (__m128i*)auwFracs), 1);
+      const __m128i mFactorInv = _mm_xor_si128( mFactor, mInvFactor);
+      const __m128i mSample0 = _mm_madd_epi16( _mm_loadu_si128( (__m128i*)(aulPairs+0)), _mm_unpacklo_epi16( mFactorInv, mFactor));
+      const __m128i mSample1 = _mm_madd_epi16( _mm_loadu_si128( (__m128i*)(aulPairs+4)), _mm_unpackhi_epi16( mFactorInv, mFactor));
+      __m128i mSample = _mm_packs_epi32( _mm_srai_epi32( mSample0, 15), _mm_srai_epi32( mSample1, 15));
+
+      // apply filter (and keep filter state of ended voices)
+      mSample = _mm_mulhi_epi16( _mm_subs_epi16( mSample, mLast), mFilter);
+      mSample = _mm_adds_epi16( _mm_slli_epi16( mSample, 1), mLast);
+      mLast   = _mm_or_si128( _mm_and_si128( mMask, mSample), _mm_andnot_si128( mMask, mLast));
+
+      // apply volume adjustment
+      const __m128i mVolume = _mm_packs_epi32( _mm_srai_epi32( mVolume0, 16), _mm_srai_epi32( mVolume1, 16));
+      mSample  = _mm_slli_epi16( _mm_mulhi_epi16( mSample, mVolume), 1);
+      mSample  = _mm_and_si128( _mm_xor_si128( mSample, mSurround), mMask);
+      mVolume0 = _mm_add_epi32( mVolume0, mGainM0);
+      mVolume1 = _mm_add_epi32( mVolume1, mGainM1);
+
+      // unpack to 32bit, sum all voices and mix into destination buffer
+      __m128i mSum = _mm_add_epi32( _mm_srai_epi32( _mm_unpacklo_epi16( mSample, mSample), 16),
+                                    _mm_srai_epi32( _mm_unpackhi_epi16( mSample, mSample), 16));
+      mSum = _mm_add_epi32( mSum, _mm_srli_si128( mSum, 8));
+      _mm_storel_epi64( (__m128i*)pslDst, _mm_add_epi32( _mm_loadl_epi64( (__m128i*)pslDst), mSum));
+      pslDst += 2;
+    }
+    iSample += slSpan;
   }
-                    
-#endif
 
-  _pfSoundProfile.StopTimer(CSoundProfile::PTI_RAWMIXER);
+  // store filter and volume state
+  _mm_storeu_si128( (__m128i*)aswLast, mLast);
+  _mm_storeu_si128( (__m128i*)(aslVolume+0), mVolume0);
+  _mm_storeu_si128( (__m128i*)(aslVolume+4), mVolume1);
+  for( iVoice=0; iVoice<ctVoices; iVoice++) {
+    for( INDEX iCh=0; iCh<2; iCh++) {
+      amv[iVoice].mv_aslLast[iCh]   = aswLast[iVoice*2+iCh];
+      amv[iVoice].mv_aslVolume[iCh] = aslVolume[iVoice*2+iCh];
+    }
+  }
 }
 
 
-// mixes one stereo 16-bit signed sound to destination buffer
-inline void MixStereo( CSoundObject *pso)
+// mix voices with kernels appropriate for this CPU
+static void MixVoices( CMixerVoice *amv, INDEX ctVoices)
 {
   _pfSoundProfile.StartTimer(CSoundProfile::PTI_RAWMIXER);
+  if( UseSSE2()) {
+    MixVoices_SSE2( amv, ctVoices, (SLONG*)pvMixerBuffer);
+  } else {
+    for( INDEX iVoice=0; iVoice<ctVoices; iVoice++) MixVoice_C( amv[iVoice], (SLONG*)pvMixerBuffer);
+  }
+  _pfSoundProfile.StopTimer(CSoundProfile::PTI_RAWMIXER);
+}
+
+
+// convert float to fixint with rounding to nearest even (like fistp does in default rounding mode)
+static inline __int64 FloatToFix64( DOUBLE d)
+{
+  const DOUBLE dFloor = floor(d);
+  const DOUBLE dFrac  = d-dFloor;
+  __int64 fix = (__int64)dFloor;
+  if( dFrac>0.5 || (dFrac==0.5 && (fix&1))) fix++;
+  return fix;
+}
+
+
+// set source offsets of voice from sound object offsets
+static void SetVoiceOffsets( CMixerVoice &mv, FLOAT fLeftOfs, FLOAT fRightOfs)
+{
+  const __int64 fixLeftOfs  = FloatToFix64( fLeftOfs  *65536.0);
+  const __int64 fixRightOfs = FloatToFix64( fRightOfs *65536.0);
+  mv.mv_aslOfs[0]  = (SLONG)(fixLeftOfs >>16);
+  mv.mv_aslOfs[1]  = (SLONG)(fixRightOfs>>16);
+  mv.mv_aslFrac[0] = (SLONG)(fixLeftOfs  &0xFFFF);
+  mv.mv_aslFrac[1] = (SLONG)(fixRightOfs &0xFFFF);
+}
 
-#if ASMOPT == 1
-
-  __asm {
-    // convert from floats to fixints 32:16
-    fld     D [fLeftOfs]
-    fmul    D [f65536]
-    fld     D [fRightOfs]
-    fmul    D [f65536]
-    fld     D [fLeftStep]
-    fmul    D [f65536]
-    fld     D [fRightStep]
-    fmul    D [f4G]
-    fistp   Q [mmRightStep] // fixint 32:32
-    fistp   Q [mmLeftStep]  // fixint 32:16
-    fistp   Q [fixRightOfs] // fixint 32:16
-    fistp   Q [fixLeftOfs]  // fixint 32:16
-
-    // get last played sample (for filtering purposes)
-    movzx   eax,W [slLastRightSample]
-    movzx   edx,W [slLastLeftSample]
-    shl     eax,16
-    or      eax,edx
-    movd    mm6,eax                       // MM6 = 0 | 0 || lastRightSample | lastLeftSample
-
-    // get volume
-    movd    mm5,D [slRightVolume]
-    movd    mm0,D [slLeftVolume]
-    psllq   mm5,32
-    por     mm5,mm0                       // MM5 = rightVolume || leftVolume
-
-    // get filter
-    mov     eax,D [slRightFilter]
-    mov     edx,D [slLeftFilter]
-    shl     eax,16
-    or      eax,edx
-    movd    mm7,eax                       // MM7 = 0 | 0 || rightFilter | leftFilter
-
-    // get offset of each channel inside sound and loop thru destination buffer
-    mov     W [mmRightStep],0
-    movzx   eax,W [fixLeftOfs]
-    movzx   edx,W [fixRightOfs]
-    shl     edx,16
-    or      eax,edx                       // EAX = right ofs frac | left ofs frac
-    mov     ebx,D [fixLeftOfs+2]          // EBX = left ofs int
-    mov     edx,D [fixRightOfs+2]         // EDX = right ofs int
-    mov     esi,D [pswSrcBuffer]          // ESI = source sound buffer start ptr
-    mov     edi,D [pvMixerBuffer]         // EDI = mixer buffer ptr
-    mov     ecx,D [slMixerBufferSize]     // ECX = samples counter
-
-sampleLoop:
-    // check if source offsets came to the end of source sound buffer
-    cmp     ebx,D [slSoundBufferSize]
-    jl      lNotEnd
-    sub     ebx,D [slSoundBufferSize]
-    push    D [bNotLoop]
-    pop     D [bEndOfSound]
-lNotEnd:
-    // same for right channel
-    cmp     edx,D [slSoundBufferSize]
-    jl      rNotEnd
-    sub     edx,D [slSoundBufferSize]
-    push    D [bNotLoop]
-    pop     D [bEndOfSound]
-rNotEnd:
-
-    // check end of sample
-    cmp     ecx,0
-    jle     loopEnd
-    cmp     D [bEndOfSound],TRUE
-    je      loopEnd
-
-    // get sound samples
-    movq    mm1,Q [esi+ ebx*4]
-    movq    mm2,Q [esi+ edx*4]
-    pslld   mm1,16
-    psrad   mm1,16              // MM1 = 0 | nextLeftSample  || 0 | leftSample
-    psrad   mm2,16              // MM2 = 0 | nextRightSample || 0 | rightSample
-    packssdw mm1,mm2  // MM1 = nextRightSample | rightSample || nextLeftSample | leftSample
-
-    // calc linear interpolation factor (strength)
-    movd    mm3,eax   // MM3 = 0 | 0 || right frac | left frac
-    punpcklwd mm3,mm3
-    psrlw   mm3,1     // MM3 = rightFrac | rightFrac || leftFrac | leftFrac
-    pxor    mm3,Q [mmInvFactor] // MM3 = rightFrac | 1-rightFrac || leftFrac | 1-leftFrac
-    // apply linear interpolation
-    pmaddwd mm1,mm3
-    psrad   mm1,15
-    packssdw mm1,mm1  // MM1 = ? | ? || linearRightSample | linearLeftSample
-
-    // apply filter
-    psubsw  mm1,mm6
-    pmulhw  mm1,mm7
-    psllw   mm1,1
-    paddsw  mm1,mm6
-    movq    mm6,mm1
-
-    // apply volume adjustment
-    movq    mm0,mm5
-    psrad   mm0,16
-    packssdw mm0,mm0
-    pmulhw  mm1,mm0
-    psllw   mm1,1
-    pxor    mm1,Q [mmSurroundFactor]
-    paddd   mm5,Q [mmVolumeGain]   // modify volume
-
-    // unpack to 32bit and mix it into destination buffer
-    punpcklwd mm1,mm1
-    psrad   mm1,16              // MM1 = finalRightSample || finalLeftSample
-    paddd   mm1,Q [edi]
-    movq    Q [edi],mm1
-
-    // advance to next samples in source sound
-    add     eax,D [mmRightStep+0]
-    adc     edx,D [mmRightStep+4]
-    add      ax,W [mmLeftStep +0]
-    adc     ebx,D [mmLeftStep +2]
-    add     edi,8
-    dec     ecx
-    jmp     sampleLoop
-
-loopEnd:
-    // store modified asm local vars
-    mov     D [fixLeftOfs +0],eax
-    shr     eax,16
-    mov     D [fixRightOfs+0],eax
-    mov     D [fixLeftOfs +2],ebx
-    mov     D [fixRightOfs+2],edx
-    movd    eax,mm6
-    mov     edx,eax
-    and     eax,0x0000FFFF
-    shr     edx,16
-    mov     D [slLastLeftSample],eax
-    mov     D [slLastRightSample],edx
-    emms
+
+// update sound object after its voice has been mixed
+static void FinishVoice( CMixerVoice &mv)
+{
+  CSoundObject *pso = mv.mv_pso;
+
+  BOOL bEndOfSound = mv.mv_bEndOfSound;
+  // if encoded sound
+  if( mv.mv_bEncoded) {
+    // ignore mixing finished flag, but use decoding finished flag
+    bEndOfSound = mv.mv_bDecodingFinished;
+  }
+
+  // if sound ended, not buffer
+  if( bEndOfSound) {
+    // reset some sound vars
+    mv.mv_aslLast[0] = 0;
+    mv.mv_aslLast[1] = 0;
+    pso->so_slFlags  &= ~SOF_PLAY;
+    pso->so_fDelayed     = 0.0f;
+    pso->so_sp.sp_fDelay = 0.0f;
   }
 
-#endif
+  // rememer last samples for the next mix in
+  pso->so_swLastLeftSample  = (SWORD)mv.mv_aslLast[0];
+  pso->so_swLastRightSample = (SWORD)mv.mv_aslLast[1];
+  // determine new phase shift offset
+  pso->so_fOffsetDelta += mv.mv_fStepDelta*slMixerBufferSize;
+  // update play offset for the next mix iteration
+  const __int64 fixLeftOfs  = ((__int64)mv.mv_aslOfs[0]<<16) + mv.mv_aslFrac[0];
+  const __int64 fixRightOfs = ((__int64)mv.mv_aslOfs[1]<<16) + mv.mv_aslFrac[1];
+  pso->so_fLeftOffset  = fixLeftOfs  * (1.0f/65536.0f);
+  pso->so_fRightOffset = fixRightOfs * (1.0f/65536.0f);
+  // update volume
+  pso->so_fLastLeftVolume  = mv.mv_fNewLeftVolume;
+  pso->so_fLastRightVolume = mv.mv_fNewRightVolume;
+}
+
 
-  _pfSoundProfile.StopTimer(CSoundProfile::PTI_RAWMIXER);
+// mix all voices that are waiting for a full pass
+void FlushMixer(void)
+{
+  if( _ctPending==0) return;
+  MixVoices( _amvPending, _ctPending);
+  for( INDEX iVoice=0; iVoice<_ctPending; iVoice++) FinishVoice( _amvPending[iVoice]);
+  _ctPending = 0;
+}
+
+
+// advance sound object over one mixer buffer without mixing it
+static void SkipSoundSegment( CSoundObject *pso, FLOAT fOfsDelta, SLONG slSoundBufferSize, BOOL bVirtual)
+{
+  pso->so_fLeftOffset  += fOfsDelta;
+  pso->so_fRightOffset += fOfsDelta;
+  const FLOAT fMinOfs = Min( pso->so_fLeftOffset, pso->so_fRightOffset);
+  ASSERT( fMinOfs>=0);
+  if( fMinOfs<0) CPrintF( "BUG: negative offset (%.2g) encountered in sound: '%s' !\n", fMinOfs, (CTString&)psd->GetName());
+  // if looping
+  if (pso->so_slFlags & SOF_LOOP) {
+    // adjust offset ptrs inside sound
+    while( pso->so_fLeftOffset  < 0) pso->so_fLeftOffset  += slSoundBufferSize;
+    while( pso->so_fRightOffset < 0) pso->so_fRightOffset += slSoundBufferSize;
+    while( pso->so_fLeftOffset  >= slSoundBufferSize) pso->so_fLeftOffset  -= slSoundBufferSize;
+    while( pso->so_fRightOffset >= slSoundBufferSize) pso->so_fRightOffset -= slSoundBufferSize;
+  // if not looping
+  } else {
+    // virtual sound keeps playing silently until it comes to its end, so it can be heard again
+    if( bVirtual && (pso->so_fLeftOffset<slSoundBufferSize || pso->so_fRightOffset<slSoundBufferSize)) return;
+    // no more playing
+    pso->so_slFlags  &= ~SOF_PLAY;
+    pso->so_fDelayed     = 0.0f;
+    pso->so_sp.sp_fDelay = 0.0f;
+  }
 }
 
 
 // mixes one sound to destination buffer
-void MixSound( CSoundObject *pso)
+void MixSound( CSoundObject *pso, BOOL bVirtual/*=FALSE*/)
 {
   psd = pso->so_pCsdLink;
 
   // if don't mix encoded sounds if they are not opened properly
-  if((psd->sd_ulFlags&SDF_ENCODED) && 
+  if((psd->sd_ulFlags&SDF_ENCODED) &&
     (pso->so_psdcDecoder==NULL || !pso->so_psdcDecoder->IsOpen()) ) {
     return;
   }
@@ -621,32 +591,16 @@ void MixSound( CSoundObject *pso)
     fNewRightVolume *= snd_fSoundVolume;
   }
 
-  // if both channel volumes are too low
-  if( fLeftVolume<0.001f && fRightVolume<0.001f && fNewLeftVolume<0.001f && fNewRightVolume<0.001f)
+  // encoded sounds cannot be advanced without decoding, so they are never virtual
+  if( psd->sd_ulFlags&SDF_ENCODED) bVirtual = FALSE;
+
+  // if both channel volumes are too low, or sound is virtual
+  if( bVirtual || fLeftVolume<0.001f && fRightVolume<0.001f && fNewLeftVolume<0.001f && fNewRightVolume<0.001f)
   {
     // if this is not an encoded sound
     if( !(psd->sd_ulFlags&SDF_ENCODED) ) {
       // skip mixing of this sample segment
-      fOfsDelta = fStep*slMixerBufferSampleRate*fSecondsToMix;
-      pso->so_fLeftOffset  += fOfsDelta;
-      pso->so_fRightOffset += fOfsDelta;
-      const FLOAT fMinOfs = Min( pso->so_fLeftOffset, pso->so_fRightOffset);
-      ASSERT( fMinOfs>=0);
-      if( fMinOfs<0) CPrintF( "BUG: negative offset (%.2g) encountered in sound: '%s' !\n", fMinOfs, (CTString&)psd->GetName());
-      // if looping
-      if (pso->so_slFlags & SOF_LOOP) {
-        // adjust offset ptrs inside sound
-        while( pso->so_fLeftOffset  < 0) pso->so_fLeftOffset  += slSoundBufferSize;
-        while( pso->so_fRightOffset < 0) pso->so_fRightOffset += slSoundBufferSize;
-        while( pso->so_fLeftOffset  >= slSoundBufferSize) pso->so_fLeftOffset  -= slSoundBufferSize;
-        while( pso->so_fRightOffset >= slSoundBufferSize) pso->so_fRightOffset -= slSoundBufferSize;
-      // if not looping
-      } else {
-        // no more playing
-        pso->so_slFlags  &= ~SOF_PLAY;
-        pso->so_fDelayed     = 0.0f;
-        pso->so_sp.sp_fDelay = 0.0f;
-      }
+      SkipSoundSegment( pso, fStep*slMixerBufferSampleRate*fSecondsToMix, slSoundBufferSize, bVirtual);
     }
     // reset last samples
     pso->so_swLastLeftSample  = 0;
@@ -655,7 +609,11 @@ void MixSound( CSoundObject *pso)
     pso->so_fLastLeftVolume  = fNewLeftVolume;
     pso->so_fLastRightVolume = fNewRightVolume;
 
-    _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_SOUNDSSKIPPED, 1);
+    if( bVirtual) {
+      _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_VOICESVIRTUAL, 1);
+    } else {
+      _pfSoundProfile.IncrementCounter(CSoundProfile::PCI_SOUNDSSKIPPED, 1);
+    }
     return;
   }
   _sfStats.IncrementCounter(CStatForm::SCI_SOUNDSMIXING);
@@ -670,20 +628,17 @@ void MixSound( CSoundObject *pso)
   const FLOAT fMixBufSize = 65536*32767.0f / slMixerBufferSize;
   const SLONG slLeftGain  = FloatToInt( (fNewLeftVolume -fLeftVolume)  *fMixBufSize);
   const SLONG slRightGain = FloatToInt( (fNewRightVolume-fRightVolume) *fMixBufSize);
-  mmVolumeGain  = ((__int64)(slRightGain)<<32) | ((__int64)(slLeftGain)&0xFFFFFFFF);
   // extrapolate back new volumes because of not enough precision in interpolation!
   // (otherwise we might hear occasional pucks)
   if( fNewLeftVolume >0.001f) fNewLeftVolume  = (slLeftVolume  + slLeftGain *slMixerBufferSize) /(65536*32767.0f);
   if( fNewRightVolume>0.001f) fNewRightVolume = (slRightVolume + slRightGain*slMixerBufferSize) /(65536*32767.0f);
   //ASSERT( fNewLeftVolume>=0 && fNewRightVolume>=0);
-  //CPrintF( "NV: %.4f / %.4f, GV: %.4f / %.4f\n", fNewLeftVolume,fNewRightVolume, fLeftGainedVolume,fRightGainedVolume); 
+  //CPrintF( "NV: %.4f / %.4f, GV: %.4f / %.4f\n", fNewLeftVolume,fNewRightVolume, fLeftGainedVolume,fRightGainedVolume);
 
-  // determine filtering and surround 
+  // determine filtering and surround
   slLeftFilter  = pso->so_sp.sp_slLeftFilter;
   slRightFilter = pso->so_sp.sp_slRightFilter;
   bNotLoop = !(pso->so_slFlags & SOF_LOOP);
-  mmSurroundFactor = 0;
-  if( pso->so_slFlags & SOF_SURROUND) mmSurroundFactor = 0x0000FFFF;
 
   // if this is an encoded sound
   BOOL bDecodingFinished = FALSE;
@@ -729,9 +684,6 @@ void MixSound( CSoundObject *pso)
 
   _pfSoundProfile.StartTimer(CSoundProfile::PTI_MIXSOUND);
 
-  slLastLeftSample  = pso->so_swLastLeftSample;
-  slLastRightSample = pso->so_swLastRightSample;
-
   // calculate eventual new offsets from phase shift
   FLOAT fLastPhase  = fOfsDelta / fSoundSampleRate;
   FLOAT fPhaseDelta = fPhase - fLastPhase;
@@ -777,50 +729,187 @@ void MixSound( CSoundObject *pso)
       slLeftFilter  = (slLeftFilter+slRightFilter)/2;
       slRightFilter = slLeftFilter;
     }
-
-    // call corresponding mixer routine for current sound format
-    bEndOfSound = FALSE;
-    if( slChannels==2) {
-      // mix as 16-bit stereo
-      MixStereo( pso);
-    } else {
-      // mix as 16-bit mono
-      MixMono( pso);
-    }
   }
 
-  // if encoded sound
-  if( psd->sd_ulFlags&SDF_ENCODED) {
-    // ignore mixing finished flag, but use decoding finished flag
-    bEndOfSound = bDecodingFinished;
+  // prepare voice for mixing (offsets are 32:16, right step is rounded as 32:32 and truncated)
+  CMixerVoice mv;
+  mv.mv_pso         = pso;
+  mv.mv_pswSrc      = pswSrcBuffer;
+  mv.mv_slSrcSize   = slSoundBufferSize;
+  mv.mv_bStereo     = slChannels==2;
+  mv.mv_bNotLoop    = bNotLoop;
+  mv.mv_bEndOfSound = FALSE;
+  mv.mv_slSamples   = slSoundBufferSize>0 ? slMixerBufferSize : 0;
+  SetVoiceOffsets( mv, fLeftOfs, fRightOfs);
+  const __int64 fixLeftStep  = FloatToFix64( fLeftStep *65536.0);
+  const __int64 fixRightStep = FloatToFix64( fRightStep*4294967296.0) >>16;
+  mv.mv_aslStep[0]     = (SLONG)(fixLeftStep >>16);
+  mv.mv_aslStep[1]     = (SLONG)(fixRightStep>>16);
+  mv.mv_aslStepFrac[0] = (SLONG)(fixLeftStep &0xFFFF);
+  mv.mv_aslStepFrac[1] = (SLONG)(fixRightStep&0xFFFF);
+  mv.mv_aslVolume[0]   = slLeftVolume;
+  mv.mv_aslVolume[1]   = slRightVolume;
+  mv.mv_aslGain[0]     = slLeftGain;
+  mv.mv_aslGain[1]     = slRightGain;
+  mv.mv_aslFilter[0]   = slLeftFilter;
+  mv.mv_aslFilter[1]   = slRightFilter;
+  mv.mv_aslLast[0]     = pso->so_swLastLeftSample;
+  mv.mv_aslLast[1]     = pso->so_swLastRightSample;
+  mv.mv_slSurround     = (pso->so_slFlags&SOF_SURROUND) ? 0xFFFF : 0;
+  mv.mv_bEncoded           = psd->sd_ulFlags&SDF_ENCODED;
+  mv.mv_bDecodingFinished  = bDecodingFinished;
+  mv.mv_fStepDelta         = fStepDelta;
+  mv.mv_fNewLeftVolume     = fNewLeftVolume;
+  mv.mv_fNewRightVolume    = fNewRightVolume;
+
+  // encoded sounds share one decode buffer, so they must be mixed right away
+  if( mv.mv_bEncoded) {
+    MixVoices( &mv, 1);
+    FinishVoice(mv);
+  // other sounds wait until there is enough of them for a full pass
+  } else {
+    _amvPending[_ctPending++] = mv;
+    if( _ctPending==MIXER_VOICES) FlushMixer();
   }
 
-  // if sound ended, not buffer
-  if( bEndOfSound) {
-    // reset some sound vars
-    slLastLeftSample  = 0;
-    slLastRightSample = 0;
-    pso->so_slFlags  &= ~SOF_PLAY;
-    pso->so_fDelayed     = 0.0f;
-    pso->so_sp.sp_fDelay = 0.0f;
+  _pfSoundProfile.StopTimer(CSoundProfile::PTI_MIXSOUND);
+}
+
+
+
+// compare reference and SSE2 mixing kernels on synthetic voices and measure their speed
+void SoundMixerBenchmark(void)
+{
+  if( !sys_bCPUHasSSE2) {
+    CPrintF( TRANS("SSE2 is not supported on this CPU.\n"));
+    return;
+  }
+  // synthetic source sounds (with one extra sample for linear interpolation)
+  const SLONG slSrcSize = 8192;
+  const SLONG slMixSize = 2048;
+  const INDEX ctPasses  = 10;
+  SWORD *pswMono   = (SWORD*)AllocMemory( (slSrcSize+1)  *sizeof(SWORD));
+  SWORD *pswStereo = (SWORD*)AllocMemory( (slSrcSize+1)*2*sizeof(SWORD));
+  SLONG *pslC      = (SLONG*)AllocMemory( slMixSize*2*sizeof(SLONG));
+  SLONG *pslSSE2   = (SLONG*)AllocMemory( slMixSize*2*sizeof(SLONG));
+  ULONG ulSeed = 0x1234567;
+  INDEX iSample;
+  for( iSample=0; iSample<(slSrcSize+1)*2; iSample++) {
+    ulSeed = ulSeed*1103515245 + 12345;
+    if( iSample<slSrcSize+1) pswMono[iSample] = (SWORD)(ulSeed>>16);
+    pswStereo[iSample] = (SWORD)(ulSeed>>8);
   }
 
-  // rememer last samples for the next mix in
-  pso->so_swLastLeftSample  = (SWORD)slLastLeftSample;
-  pso->so_swLastRightSample = (SWORD)slLastRightSample;
-  // determine new phase shift offset
-  pso->so_fOffsetDelta += fStepDelta*slMixerBufferSize;
-  // update play offset for the next mix iteration
-  pso->so_fLeftOffset  = fixLeftOfs  * (1.0f/65536.0f);
-  pso->so_fRightOffset = fixRightOfs * (1.0f/65536.0f);
-  // update volume
-  pso->so_fLastLeftVolume  = fNewLeftVolume;
-  pso->so_fLastRightVolume = fNewRightVolume;
+  CPrintF( "%-8s %10s %10s %8s\n", "voices", "C (ms)", "SSE2 (ms)", "speedup");
+  for( INDEX ctVoices=64; ctVoices<=256; ctVoices*=2)
+  {
+    // random voices, some of them not looping so they end in the middle of mixer buffer
+    CMixerVoice *amvC    = (CMixerVoice*)AllocMemory( ctVoices*sizeof(CMixerVoice));
+    CMixerVoice *amvSSE2 = (CMixerVoice*)AllocMemory( ctVoices*sizeof(CMixerVoice));
+    INDEX iVoice;
+    for( iVoice=0; iVoice<ctVoices; iVoice++) {
+      CMixerVoice &mv = amvC[iVoice];
+      memset( &mv, 0, sizeof(mv));
+      ulSeed = ulSeed*1103515245 + 12345;
+      mv.mv_bStereo   = (ulSeed>>20)&1;
+      mv.mv_bNotLoop  = ((ulSeed>>21)&3)==0;
+      mv.mv_slSurround= ((ulSeed>>23)&7)==0 ? 0xFFFF : 0;
+      mv.mv_pswSrc    = mv.mv_bStereo ? pswStereo : pswMono;
+      mv.mv_slSrcSize = slSrcSize;
+      mv.mv_slSamples = slMixSize;
+      for( INDEX iCh=0; iCh<2; iCh++) {
+        ulSeed = ulSeed*1103515245 + 12345;
+        mv.mv_aslOfs[iCh]      = (ulSeed>>8)%slSrcSize;
+        mv.mv_aslFrac[iCh]     = ulSeed&0xFFFF;
+        ulSeed = ulSeed*1103515245 + 12345;
+        mv.mv_aslStep[iCh]     = (ulSeed>>16)&1;  // steps from 0 to 2 samples
+        mv.mv_aslStepFrac[iCh] = ulSeed&0xFFFF;
+        ulSeed = ulSeed*1103515245 + 12345;
+        mv.mv_aslVolume[iCh]   = (ulSeed>>1)&0x3FFF0000;
+        mv.mv_aslGain[iCh]     = (SLONG)(ulSeed&0xFFFF)-0x8000;
+        ulSeed = ulSeed*1103515245 + 12345;
+        mv.mv_aslFilter[iCh]   = (ulSeed>>8)&0x7FFF;
+        mv.mv_aslLast[iCh]     = (SWORD)(ulSeed>>16);
+      }
+      // some voices are short loops played at high pitch, so one step can skip whole loop
+      ulSeed = ulSeed*1103515245 + 12345;
+      if( ((ulSeed>>16)&15)==0) {
+        mv.mv_bNotLoop  = FALSE;
+        mv.mv_slSrcSize = 1 + (ulSeed>>20)%4;
+        for( INDEX iCh=0; iCh<2; iCh++) {
+          mv.mv_aslOfs[iCh] %= mv.mv_slSrcSize;
+          mv.mv_aslStep[iCh] = 2 + (ulSeed>>(24+iCh*3))%8;
+        }
+      }
+    }
+    memcpy( amvSSE2, amvC, ctVoices*sizeof(CMixerVoice));
+    memset( pslC,    0, slMixSize*2*sizeof(SLONG));
+    memset( pslSSE2, 0, slMixSize*2*sizeof(SLONG));
+
+    // run both kernels on same voices and time them (both mix all passes into same buffer)
+    CTimerValue tvC(0.0), tvSSE2(0.0);
+    for( INDEX iPass=0; iPass<ctPasses; iPass++) {
+      CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+      for( iVoice=0; iVoice<ctVoices; iVoice++) MixVoice_C( amvC[iVoice], pslC);
+      CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+      for( iVoice=0; iVoice<ctVoices; iVoice+=MIXER_VOICES) {
+        MixVoices_SSE2( amvSSE2+iVoice, Min( ctVoices-iVoice, (INDEX)MIXER_VOICES), pslSSE2);
+      }
+      CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+      tvC    += tv1-tv0;
+      tvSSE2 += tv2-tv1;
+    }
 
-  //if( pso->so_fLastLeftVolume>0 || pso->so_fLastRightVolume>0 || fNewLeftVolume>0 || fNewRightVolume>0) {
-  //  CPrintF( "SO: 0x%8X; OV: %.4f / %.4f, NV: %.4f / %.4f\n", pso,
-  //            pso->so_fLastLeftVolume,pso->so_fLastRightVolume, fNewLeftVolume,fNewRightVolume);
-  //}
-  _pfSoundProfile.StopTimer(CSoundProfile::PTI_MIXSOUND);
+    // mixed samples and voice state must be exact
+    BOOL bSame = memcmp( pslC, pslSSE2, slMixSize*2*sizeof(SLONG))==0;
+    for( iVoice=0; iVoice<ctVoices; iVoice++) {
+      const CMixerVoice &mvC = amvC[iVoice];
+      const CMixerVoice &mvSSE2 = amvSSE2[iVoice];
+      bSame = bSame && mvC.mv_bEndOfSound==mvSSE2.mv_bEndOfSound
+        && memcmp( mvC.mv_aslOfs,  mvSSE2.mv_aslOfs,  sizeof(mvC.mv_aslOfs))==0
+        && memcmp( mvC.mv_aslFrac, mvSSE2.mv_aslFrac, sizeof(mvC.mv_aslFrac))==0
+        && memcmp( mvC.mv_aslLast, mvSSE2.mv_aslLast, sizeof(mvC.mv_aslLast))==0
+        && memcmp( mvC.mv_aslVolume, mvSSE2.mv_aslVolume, sizeof(mvC.mv_aslVolume))==0;
+    }
+    const DOUBLE dMsC    = tvC.GetSeconds()   *1000 / ctPasses;
+    const DOUBLE dMsSSE2 = tvSSE2.GetSeconds()*1000 / ctPasses;
+    CPrintF( "%-8d %10.3f %10.3f %7.2fx %s\n", ctVoices, dMsC, dMsSSE2,
+             dMsSSE2>0 ? dMsC/dMsSSE2 : 0.0, bSame ? "" : "MISMATCH!");
+    FreeMemory( amvC);
+    FreeMemory( amvSSE2);
+  }
+
+  FreeMemory( pswMono);
+  FreeMemory( pswStereo);
+  FreeMemory( pslC);
+  FreeMemory( pslSSE2);
 }
 
+
+// check that virtual sounds keep advancing and resume where they got to
+void SoundVirtualVoiceCheck(void)
+{
+  const SLONG slSrcSize = 8192;
+  const SLONG slMixSize = 2048;
+  // one-shot sound that is virtual for a few passes must keep advancing, and when it becomes
+  // real again its voice must start where the sound got to
+  CSoundObject so;
+  so.so_slFlags = SOF_PLAY|SOF_PREPARE|SOF_VIRTUAL;
+  const FLOAT fOfsDelta = slMixSize*0.75f;
+  const INDEX ctVirtualPasses = 3;
+  for( INDEX iPass=0; iPass<ctVirtualPasses; iPass++) SkipSoundSegment( &so, fOfsDelta, slSrcSize, TRUE);
+  CMixerVoice mv;
+  SetVoiceOffsets( mv, so.so_fLeftOffset, so.so_fRightOffset);
+  const SLONG slExpectedOfs = (SLONG)(fOfsDelta*ctVirtualPasses);
+  BOOL bResumed = (so.so_slFlags&SOF_PLAY) && mv.mv_aslOfs[0]==slExpectedOfs && mv.mv_aslOfs[1]==slExpectedOfs;
+  // and it must stop only when it comes to its end
+  INDEX ctPasses = ctVirtualPasses;
+  while( (so.so_slFlags&SOF_PLAY) && ctPasses<1000) {
+    SkipSoundSegment( &so, fOfsDelta, slSrcSize, TRUE);
+    ctPasses++;
+  }
+  const INDEX ctExpectedPasses = (INDEX)ceil( slSrcSize/fOfsDelta);
+  const BOOL bEnded = !(so.so_slFlags&SOF_PLAY) && ctPasses==ctExpectedPasses;
+  CPrintF( "virtual one-shot: resumed at %d, ended after %d passes %s\n", mv.mv_aslOfs[0], ctPasses,
+           (bResumed && bEnded) ? "" : "MISMATCH!");
+}
@@ -264,6 +264,7 @@ void CSoundObject::Play_internal( CSoundData *pCsdLink, SLONG slFlags)
     // create decoder
     if (so_pCsdLink->sd_ulFlags&SDF_STREAMING) {
       so_psdcDecoder = new CSoundDecoder(so_pCsdLink->GetName());
+      so_psdcDecoder->StartStreaming(slFlags&SOF_LOOP);
     } else {
       ASSERT(FALSE);  // nonstreaming not supported anymore
     }
@@ -36,6 +36,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SOF_NONGAME      (1L<<7)   // game sounds are not mixed while the game is paused
 #define SOF_NOFILTER     (1L<<8)   // used to disable listener-specific filters - i.e. underwater
 
+#define SOF_VIRTUAL      (1L<<27)  // playing, but not mixed because of voice limit (internal)
 #define SOF_PAUSED       (1L<<28)  // playing, but paused (internal)
 #define SOF_LOADED       (1L<<29)  // sound just loaded (internal)
 #define SOF_PREPARE      (1L<<30)  // prepared for playing (internal)
@@ -38,5 +38,10 @@ CSoundProfile::CSoundProfile(void)
   SETCOUNTERNAME( PCI_SOUNDSMIXED,   "sounds mixed");
   SETCOUNTERNAME( PCI_SOUNDSSKIPPED, "sounds skipped for low volume");
   SETCOUNTERNAME( PCI_SOUNDSDELAYED, "sounds delayed for sound speed latency");
+  SETCOUNTERNAME( PCI_VOICESPLAYING, "sounds playing");
+  SETCOUNTERNAME( PCI_VOICESVIRTUAL, "sounds virtual (over voice limit)");
   SETCOUNTERNAME( PCI_SAMPLES,       "samples mixed");
+  SETCOUNTERNAME( PCI_STREAMUNDERRUNS,  "stream decoding underruns");
+  SETCOUNTERNAME( PCI_STREAMAHEADMS,    "ms decoded ahead of mixer");
+  SETCOUNTERNAME( PCI_STREAMDECODETIME, "us spent in decoder threads");
 }
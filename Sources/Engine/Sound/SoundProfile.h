@@ -40,7 +40,12 @@ public:
     PCI_SOUNDSMIXED,       // sounds mixed
     PCI_SOUNDSSKIPPED,     // sounds skipped for low volume
     PCI_SOUNDSDELAYED,     // sounds delayed for sound speed latency
+    PCI_VOICESPLAYING,     // sounds playing (mixed or virtual)
+    PCI_VOICESVIRTUAL,     // sounds only advanced, but not mixed because of voice limit
     PCI_SAMPLES,      // samples mixed
+    PCI_STREAMUNDERRUNS,   // streamed sounds that were not decoded ahead enough
+    PCI_STREAMAHEADMS,     // milliseconds decoded ahead of mixer (summed over streams)
+    PCI_STREAMDECODETIME,  // microseconds spent decoding on decoder threads
 
     PCI_COUNT
   };
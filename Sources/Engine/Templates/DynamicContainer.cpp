@@ -32,6 +32,10 @@ CDynamicContainer<Type>::CDynamicContainer(void) {
   // not locked
   dc_LockCt = 0;
 #endif
+  // not hashed
+  dc_bHashed = FALSE;
+  dc_aiHashSlots = NULL;
+  dc_ctHashSlots = 0;
 }
 
 /*
@@ -44,6 +48,10 @@ CDynamicContainer<Type>::CDynamicContainer(CDynamicContainer<Type> &dcOriginal)
   // not locked
   dc_LockCt = 0;
 #endif
+  // not hashed
+  dc_bHashed = FALSE;
+  dc_aiHashSlots = NULL;
+  dc_ctHashSlots = 0;
 
   // call assignment operator
   (*this) = dcOriginal;
@@ -54,6 +62,10 @@ CDynamicContainer<Type>::CDynamicContainer(CDynamicContainer<Type> &dcOriginal)
 template<class Type>
 CDynamicContainer<Type>::~CDynamicContainer(void) {
   Clear();
+  if (dc_aiHashSlots!=NULL) {
+    FreeMemory(dc_aiHashSlots);
+    dc_aiHashSlots = NULL;
+  }
 }
 
 /*
@@ -63,6 +75,115 @@ template<class Type>
 void CDynamicContainer<Type>::Clear(void) {
   ASSERT(this!=NULL);
   CStaticStackArray<Type *>::Clear();
+  // mark all hash slots as empty
+  for (INDEX iSlot=0; iSlot<dc_ctHashSlots; iSlot++) {
+    dc_aiHashSlots[iSlot] = -1;
+  }
+}
+
+// get first hash slot for a pointer
+static inline INDEX DynamicContainerHashSlot(const void *pv, INDEX ctSlots)
+{
+  ULONG ulHash = ULONG(size_t(pv))*0x9E3779B1UL;
+  ulHash ^= ulHash>>16;
+  return INDEX(ulHash&(ctSlots-1));
+}
+
+/*
+ * Keep members hashed for fast lookup.
+ */
+template<class Type>
+void CDynamicContainer<Type>::EnableHashing(void)
+{
+  ASSERT(this!=NULL);
+  if (dc_bHashed) {
+    return;
+  }
+  dc_bHashed = TRUE;
+  Rehash();
+}
+
+/*
+ * Rebuild hash of all members.
+ */
+template<class Type>
+void CDynamicContainer<Type>::Rehash(void)
+{
+  if (!dc_bHashed) {
+    return;
+  }
+  // keep at most half of the slots used
+  INDEX ctSlots = 64;
+  while (ctSlots<Count()*2+2) {
+    ctSlots *= 2;
+  }
+  if (ctSlots!=dc_ctHashSlots) {
+    if (dc_aiHashSlots!=NULL) {
+      FreeMemory(dc_aiHashSlots);
+    }
+    dc_aiHashSlots = (INDEX*)AllocMemory(ctSlots*sizeof(INDEX));
+    dc_ctHashSlots = ctSlots;
+  }
+  for (INDEX iSlot=0; iSlot<dc_ctHashSlots; iSlot++) {
+    dc_aiHashSlots[iSlot] = -1;
+  }
+  for (INDEX iMember=0; iMember<Count(); iMember++) {
+    HashMember(iMember);
+  }
+}
+
+/*
+ * Find hash slot of an object (-1 if not member).
+ */
+template<class Type>
+INDEX CDynamicContainer<Type>::FindHashSlot(Type *ptMember)
+{
+  ASSERT(dc_bHashed && dc_ctHashSlots>0);
+  INDEX iSlot = DynamicContainerHashSlot(ptMember, dc_ctHashSlots);
+  // probe until an empty slot
+  while (dc_aiHashSlots[iSlot]>=0) {
+    if (sa_Array[dc_aiHashSlots[iSlot]]==ptMember) {
+      return iSlot;
+    }
+    iSlot = (iSlot+1)&(dc_ctHashSlots-1);
+  }
+  return -1;
+}
+
+/*
+ * Add member with given index to hash.
+ */
+template<class Type>
+void CDynamicContainer<Type>::HashMember(INDEX iMember)
+{
+  INDEX iSlot = DynamicContainerHashSlot(sa_Array[iMember], dc_ctHashSlots);
+  while (dc_aiHashSlots[iSlot]>=0) {
+    ASSERT(sa_Array[dc_aiHashSlots[iSlot]]!=sa_Array[iMember]);  // members must be unique
+    iSlot = (iSlot+1)&(dc_ctHashSlots-1);
+  }
+  dc_aiHashSlots[iSlot] = iMember;
+}
+
+/*
+ * Remove a slot from hash.
+ */
+template<class Type>
+void CDynamicContainer<Type>::UnhashSlot(INDEX iSlot)
+{
+  const INDEX iMask = dc_ctHashSlots-1;
+  // move following slots back so that their probe sequences stay unbroken
+  INDEX iNext = (iSlot+1)&iMask;
+  while (dc_aiHashSlots[iNext]>=0) {
+    INDEX iHome = DynamicContainerHashSlot(sa_Array[dc_aiHashSlots[iNext]], dc_ctHashSlots);
+    // if the emptied slot is between the slot's home and the slot itself
+    if (((iNext-iHome)&iMask) >= ((iNext-iSlot)&iMask)) {
+      // move it to the emptied slot
+      dc_aiHashSlots[iSlot] = dc_aiHashSlots[iNext];
+      iSlot = iNext;
+    }
+    iNext = (iNext+1)&iMask;
+  }
+  dc_aiHashSlots[iSlot] = -1;
 }
 
 /*
@@ -73,6 +194,15 @@ void CDynamicContainer<Type>::Add(Type *ptNewObject)
 {
   // set the new pointer
   Push() = ptNewObject;
+  // if hashed
+  if (dc_bHashed) {
+    // grow hash if too full, or just add the new member
+    if (Count()*2+2>dc_ctHashSlots) {
+      Rehash();
+    } else {
+      HashMember(Count()-1);
+    }
+  }
 }
 
 /*
@@ -90,6 +220,8 @@ void CDynamicContainer<Type>::Insert(Type *ptNewObject, const INDEX iPos/*=0*/)
   memmove( pptMoveTo, pptInsertAt, sizeof(Type*)*ctMovees);
   // store pointer to newly inserted member at specified position
   *pptInsertAt = ptNewObject;
+  // indices of all moved members have changed
+  Rehash();
 }
 
 /*
@@ -104,6 +236,27 @@ void CDynamicContainer<Type>::Remove(Type *ptOldObject)
   ASSERT(dc_LockCt == 0);
 #endif
 
+  // if hashed
+  if (dc_bHashed) {
+    // find its slot and index
+    INDEX iSlot = FindHashSlot(ptOldObject);
+    if (iSlot<0) {
+      ASSERTALWAYS("CDynamicContainer<Type><>::Remove(): Not a member of this container!");
+      return;
+    }
+    INDEX iMember = dc_aiHashSlots[iSlot];
+    UnhashSlot(iSlot);
+    // if it is not last, last member will move to its index
+    INDEX iLast = Count()-1;
+    if (iMember!=iLast) {
+      dc_aiHashSlots[FindHashSlot(sa_Array[iLast])] = iMember;
+    }
+    // move last pointer here
+    sa_Array[iMember]=sa_Array[iLast];
+    Pop();
+    return;
+  }
+
   // find its index
   INDEX iMember=GetIndex(ptOldObject);
   // move last pointer here
@@ -116,6 +269,10 @@ template<class Type>
 BOOL CDynamicContainer<Type>::IsMember(Type *ptOldObject)
 {
   ASSERT(this!=NULL);
+  // if hashed, just look it up
+  if (dc_bHashed) {
+    return FindHashSlot(ptOldObject)>=0;
+  }
   // slow !!!!
   // check all members
   for (INDEX iMember=0; iMember<Count(); iMember++) {
@@ -196,6 +353,15 @@ INDEX CDynamicContainer<Type>::Index(Type *ptMember) {
 template<class Type>
 INDEX CDynamicContainer<Type>::GetIndex(Type *ptMember) {
   ASSERT(this!=NULL);
+  // if hashed, just look it up
+  if (dc_bHashed) {
+    INDEX iSlot = FindHashSlot(ptMember);
+    if (iSlot>=0) {
+      return dc_aiHashSlots[iSlot];
+    }
+    ASSERTALWAYS("CDynamicContainer<Type><>::Index(): Not a member of this container!");
+    return 0;
+  }
   // slow !!!!
   // check all members
   for (INDEX iMember=0; iMember<Count(); iMember++) {
@@ -222,6 +388,7 @@ template<class Type>
 CDynamicContainer<Type> &CDynamicContainer<Type>::operator=(CDynamicContainer<Type> &coOriginal)
 {
   CStaticStackArray<Type *>::operator=(coOriginal);
+  Rehash();
   return *this;
 }
 
@@ -237,6 +404,8 @@ void CDynamicContainer<Type>::MoveContainer(CDynamicContainer<Type> &coOther)
   ASSERT(dc_LockCt==0 && coOther.dc_LockCt==0);
 #endif
   CStaticStackArray<Type*>::MoveArray(coOther);
+  Rehash();
+  coOther.Rehash();
 }
 
 /////////////////////////////////////////////////////////////////////
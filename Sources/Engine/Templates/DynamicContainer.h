@@ -31,9 +31,20 @@ public:
 #if CHECKARRAYLOCKING
   INDEX da_LockCt;          // lock counter for getting indices
 #endif
+  BOOL dc_bHashed;          // set if members are hashed for fast lookup
+  INDEX *dc_aiHashSlots;    // index of member in each hash slot (-1 if slot is empty)
+  INDEX dc_ctHashSlots;     // number of hash slots (power of 2)
 
   /* Get index of an object from it's pointer without locking. */
   INDEX GetIndex(Type *ptMember);
+  /* Find hash slot of an object (-1 if not member). */
+  INDEX FindHashSlot(Type *ptMember);
+  /* Add member with given index to hash. */
+  void HashMember(INDEX iMember);
+  /* Remove a slot from hash. */
+  void UnhashSlot(INDEX iSlot);
+  /* Rebuild hash of all members. */
+  void Rehash(void);
 public:
   /* Default constructor. */
   CDynamicContainer(void);
@@ -50,6 +61,9 @@ public:
   void Remove(Type *ptOldObject);
   /* Remove all objects, and reset the container to initial (empty) state. */
   void Clear(void);
+  /* Keep members hashed, so that IsMember(), Index() and Remove() don't scan the container
+     (members must be unique and must not be pushed/popped directly through the stack array). */
+  void EnableHashing(void);
   /* Test if a given object is in the container. */
   BOOL IsMember(Type *ptOldObject);
 
@@ -79,6 +79,20 @@ TYPE *CStock_TYPE::Obtain_t(const CTFileName &fnmFileName)
   return ptNew;
 }
 
+/*
+ * Start reading an object's file ahead if it is not on stock (Obtain_t() then loads it).
+ */
+
+void CStock_TYPE::Prefetch(const CTFileName &fnmFileName)
+{
+  // if already on stock, there is nothing to read
+  if (st_ntObjects.Find(fnmFileName)!=NULL) {
+    return;
+  }
+  // let loader threads read the file (they ignore files that are already requested)
+  PreloadFile(fnmFileName);
+}
+
 /*
  * Release an object when not needed any more.
  */
@@ -36,6 +36,8 @@ public:
 
   /* Obtain an object from stock - loads if not loaded. */
   ENGINE_API TYPE *Obtain_t(const CTFileName &fnmFileName); // throw char *
+  /* Start reading an object's file ahead if it is not on stock (Obtain_t() then loads it). */
+  ENGINE_API void Prefetch(const CTFileName &fnmFileName);
   /* Release an object when not needed any more. */
   ENGINE_API void Release(TYPE *ptObject);
   // free all unused elements of the stock
@@ -79,6 +79,7 @@ CPhysicsProfile::CPhysicsProfile(void)
   SETTIMERNAME(PTI_ADDENTITYTOGRID,               " AddEntityToCollisionGrid()", "");
   SETTIMERNAME(PTI_REMENTITYFROMGRID,             " RemoveEntityFromCollisionGrid()", "");
   SETTIMERNAME(PTI_MOVEENTITYINGRID,              " MoveEntityInCollisionGrid()", "");
+  SETTIMERNAME(PTI_FINDENTITIESINRANGE,           " FindEntitiesInRange()", "");
 
   SETCOUNTERNAME(PCI_GRAVITY_NONTRIVIAL,  "non-trivial gravity moves");
   SETCOUNTERNAME(PCI_GRAVITY_TRIVIAL,     "trivial gravity moves");
@@ -109,5 +110,10 @@ CPhysicsProfile::CPhysicsProfile(void)
   SETCOUNTERNAME(PCI_NEARCELLSFOUND,  "cells found in FindEntitiesNearBox()");
   SETCOUNTERNAME(PCI_NEAROCCUPIEDCELLSFOUND, "occupied cells found in FindEntitiesNearBox()");
   SETCOUNTERNAME(PCI_NEARENTITIESFOUND,  "entities found in FindEntitiesNearBox()");
+
+  SETCOUNTERNAME(PCI_TIMERSFIRED,     "timers fired");
+  SETCOUNTERNAME(PCI_TIMEROPERATIONS, "timer queue operations");
+  SETCOUNTERNAME(PCI_SENTEVENTS,      "events sent");
+  SETCOUNTERNAME(PCI_SENTEVENTS_HEAP, "sent events copied on heap");
 }
 
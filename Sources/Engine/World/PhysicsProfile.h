@@ -84,6 +84,7 @@ public:
     PTI_ADDENTITYTOGRID,
     PTI_REMENTITYFROMGRID,
     PTI_MOVEENTITYINGRID,
+    PTI_FINDENTITIESINRANGE,
     PTI_COUNT
   };
   enum ProfileCounterIndex {
@@ -116,6 +117,11 @@ public:
     PCI_NEARCELLSFOUND,           // cells found in FindEntitiesNearBox()
     PCI_NEAROCCUPIEDCELLSFOUND,   // occupied cells found in FindEntitiesNearBox()
     PCI_NEARENTITIESFOUND,        // near entities found in FindEntitiesNearBox()
+
+    PCI_TIMERSFIRED,              // timer events sent in HandleTimers()
+    PCI_TIMEROPERATIONS,          // additions and removals in timer queue
+    PCI_SENTEVENTS,               // events sent with SendEvent()
+    PCI_SENTEVENTS_HEAP,          // sent events that were copied on heap instead of in pool
     PCI_COUNT
   };
   // constructor
@@ -16,6 +16,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "stdh.h"
 
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Math/Float.h>
 #include <Engine/World/World.h>
 #include <Engine/World/WorldEditingProfile.h>
@@ -37,8 +38,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Light/LightSource.h>
 #include <Engine/Base/ProgressHook.h>
 #include <Engine/Templates/StaticArray.cpp>
+#include <Engine/Templates/StaticStackArray.cpp>
 #include <Engine/Templates/Selection.cpp>
 #include <Engine/Terrain/Terrain.h>
+#include <Engine/World/PhysicsProfile.h>
 
 #include <Engine/Templates/Stock_CEntityClass.h>
 
@@ -50,6 +53,8 @@ template CEntitySelection;
 extern BOOL _bPortalSectorLinksPreLoaded;
 extern BOOL _bEntitySectorLinksPreLoaded;
 extern INDEX _ctPredictorEntities;
+extern void BeginShadowBake(void);
+extern void EndShadowBake(void);
 
 // calculate ray placement from origin and target positions (obsolete?)
 static inline CPlacement3D CalculateRayPlacement(
@@ -115,6 +120,12 @@ CWorld::CWorld(void)
   wo_fRtL = wo_fRtH = 1.0f; wo_fRtCZ = wo_fRtCY = 0.0f;
 
   wo_ulNextEntityID = 1;
+  wo_ulNextTimerOrder = 0;
+  wo_apenTimers.SetAllocationStep(256);
+
+  // entities are removed from these on each destruction, keep them hashed
+  wo_cenEntities.EnableHashing();
+  wo_cenAllEntities.EnableHashing();
 
   // set default placement
   wo_plFocus = CPlacement3D( FLOAT3D(3.0f, 4.0f, 10.0f),
@@ -239,6 +250,84 @@ CEntity *CWorld::CreateEntity(const CPlacement3D &plPlacement, CEntityClass *pec
   return penEntity;
 }
 
+// spawn and destroy many entities to measure entity container overhead
+void EntitySpawnBenchmark(INDEX ctEntities)
+{
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+  ctEntities = Clamp(ctEntities, 1L, 1000000L);
+  // spawning advances entity IDs and timer order, which would desync a running game or demo
+  if (_pNetwork->IsGameActive()) {
+    CPrintF(TRANS("Cannot run benchmark while a game is running.\n"));
+    return;
+  }
+  CWorld &wo = _pNetwork->ga_World;
+  if (wo.wo_cenEntities.Count()==0) {
+    CPrintF(TRANS("Load a world first.\n"));
+    return;
+  }
+  // use class of any existing entity, entities are not initialized so its logic never runs
+  CEntityClass *pecClass = wo.wo_cenEntities.GetFirst().en_pecClass;
+  const INDEX ctEntitiesBefore = wo.wo_cenEntities.Count();
+
+  // spawn entities
+  CStaticArray<CEntity *> apenSpawned;
+  apenSpawned.New(ctEntities);
+  CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+  {for (INDEX ien=0; ien<ctEntities; ien++) {
+    apenSpawned[ien] = wo.CreateEntity(CPlacement3D(FLOAT3D(0,0,0), ANGLE3D(0,0,0)), pecClass);
+    // keep it alive until after it is destroyed
+    apenSpawned[ien]->AddReference();
+  }}
+  CTimerValue tv1 = _pTimer->GetHighPrecisionTimer();
+
+  // shuffle them, so they are not destroyed in order of spawning
+  ULONG ulSeed = 0x7E57ABC;
+  {for (INDEX ien=ctEntities-1; ien>0; ien--) {
+    ulSeed = ulSeed*1103515245+12345;
+    INDEX ienOther = (ulSeed>>8)%(ien+1);
+    Swap(apenSpawned[ien], apenSpawned[ienOther]);
+  }}
+
+  // compare plain and hashed containers on the same pointers
+  CDynamicContainer<CEntity> cenPlain, cenHashed;
+  cenHashed.EnableHashing();
+  CTimerValue tvPlain(0.0), tvHashed(0.0);
+  {for (INDEX iPass=0; iPass<2; iPass++) {
+    CDynamicContainer<CEntity> &cen = iPass==0 ? cenPlain : cenHashed;
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    for (INDEX ien=0; ien<ctEntities; ien++) {
+      cen.Add(apenSpawned[ctEntities-1-ien]);
+    }
+    for (INDEX ienRemove=0; ienRemove<ctEntities; ienRemove++) {
+      cen.Remove(apenSpawned[ienRemove]);
+    }
+    (iPass==0 ? tvPlain : tvHashed) = _pTimer->GetHighPrecisionTimer()-tvStart;
+  }}
+
+  // destroy entities (removes them from active entities) and release them (deletes them)
+  CTimerValue tv2 = _pTimer->GetHighPrecisionTimer();
+  {for (INDEX ien=0; ien<ctEntities; ien++) {
+    apenSpawned[ien]->Destroy();
+  }}
+  CTimerValue tv3 = _pTimer->GetHighPrecisionTimer();
+  {for (INDEX ien=0; ien<ctEntities; ien++) {
+    apenSpawned[ien]->RemReference();
+  }}
+  CTimerValue tv4 = _pTimer->GetHighPrecisionTimer();
+  ASSERT(wo.wo_cenEntities.Count()==ctEntitiesBefore);
+
+  CPrintF("Entity spawn benchmark: %d entities\n", ctEntities);
+  CPrintF("  spawn: %.2f ms, destroy: %.2f ms, delete: %.2f ms\n",
+    (tv1-tv0).GetSeconds()*1000, (tv3-tv2).GetSeconds()*1000, (tv4-tv3).GetSeconds()*1000);
+  CPrintF("  container add/remove - plain: %.2f ms, hashed: %.2f ms\n",
+    tvPlain.GetSeconds()*1000, tvHashed.GetSeconds()*1000);
+}
+void EntitySpawnBenchmarkCfunc(void *pArgs)
+{
+  INDEX ctEntities = NEXTARGUMENT(INDEX);
+  EntitySpawnBenchmark(ctEntities);
+}
+
 /*
  * Create a new entity of given class.
  */
@@ -359,6 +448,90 @@ CPlayerEntity *CWorld::FindEntityWithCharacter(CPlayerCharacter &pcCharacter)
   return NULL;
 }
 
+// check if one timer is due before another one
+// (among timers for same moment, the one that was set later is due first)
+static inline BOOL TimerIsBefore(const CRationalEntity *pen0, const CRationalEntity *pen1)
+{
+  if (pen0->en_timeTimer!=pen1->en_timeTimer) {
+    return pen0->en_timeTimer<pen1->en_timeTimer;
+  }
+  return pen0->en_ulTimerOrder>pen1->en_ulTimerOrder;
+}
+
+// put a timer to given place in the heap
+static inline void PlaceTimer(CStaticStackArray<CRationalEntity *> &apen, INDEX i, CRationalEntity *pen)
+{
+  apen[i] = pen;
+  pen->en_iInTimers = i;
+}
+
+// move a timer up the heap until its parent is due before it
+static void SiftTimerUp(CStaticStackArray<CRationalEntity *> &apen, INDEX i)
+{
+  CRationalEntity *pen = apen[i];
+  while (i>0) {
+    INDEX iParent = (i-1)/2;
+    if (!TimerIsBefore(pen, apen[iParent])) {
+      break;
+    }
+    PlaceTimer(apen, i, apen[iParent]);
+    i = iParent;
+  }
+  PlaceTimer(apen, i, pen);
+}
+
+// move a timer down the heap until it is due before both of its children
+static void SiftTimerDown(CStaticStackArray<CRationalEntity *> &apen, INDEX i)
+{
+  CRationalEntity *pen = apen[i];
+  const INDEX ct = apen.Count();
+  FOREVER {
+    INDEX iChild = i*2+1;
+    if (iChild>=ct) {
+      break;
+    }
+    // pick the child that is due first
+    if (iChild+1<ct && TimerIsBefore(apen[iChild+1], apen[iChild])) {
+      iChild++;
+    }
+    if (!TimerIsBefore(apen[iChild], pen)) {
+      break;
+    }
+    PlaceTimer(apen, i, apen[iChild]);
+    i = iChild;
+  }
+  PlaceTimer(apen, i, pen);
+}
+
+// renumber waiting timers from zero, keeping the order in which they are due
+// (heap stays valid since no two timers change their relative order)
+static void RenumberTimers(CWorld &wo)
+{
+  CStaticStackArray<CRationalEntity *> apenTimers;
+  wo.GetTimersInOrder(apenTimers);
+  const INDEX ct = apenTimers.Count();
+  for (INDEX i=0; i<ct; i++) {
+    // those due first get higher order
+    apenTimers[i]->en_ulTimerOrder = ct-1-i;
+  }
+  wo.wo_ulNextTimerOrder = ct;
+}
+
+// add a timer to the heap as the latest one set for its moment
+static void PushTimer(CWorld &wo, CRationalEntity *pen)
+{
+  ASSERT(pen->en_iInTimers<0);
+  // if order would wrap around, make room for it first
+  if (wo.wo_ulNextTimerOrder==MAX_ULONG) {
+    RenumberTimers(wo);
+  }
+  pen->en_ulTimerOrder = wo.wo_ulNextTimerOrder++;
+  wo.wo_apenTimers.Push() = NULL;
+  PlaceTimer(wo.wo_apenTimers, wo.wo_apenTimers.Count()-1, pen);
+  SiftTimerUp(wo.wo_apenTimers, pen->en_iInTimers);
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_TIMEROPERATIONS);
+}
+
 /*
  * Add an entity to list of thinkers.
  */
@@ -368,20 +541,82 @@ void CWorld::AddTimer(CRationalEntity *penThinker)
   ASSERT(GetFPUPrecision()==FPT_24BIT);
 
   // if the entity is already in the list
-  if (penThinker->en_lnInTimers.IsLinked()) {
+  if (penThinker->en_iInTimers>=0) {
     // remove it
-    penThinker->en_lnInTimers.Remove();
+    RemoveTimer(penThinker);
   }
-  // for each entity in the thinker list
-  FOREACHINLISTKEEP(CRationalEntity, en_lnInTimers, wo_lhTimers, iten) {
-    // if the entity in list has greater or same think time than the one to add
-    if (iten->en_timeTimer>=penThinker->en_timeTimer) {
-      // stop searching
-      break;
+  // add it after all others for same moment
+  PushTimer(*this, penThinker);
+}
+
+/*
+ * Remove an entity from list of thinkers.
+ */
+void CWorld::RemoveTimer(CRationalEntity *penThinker)
+{
+  INDEX i = penThinker->en_iInTimers;
+  ASSERT(i>=0 && i<wo_apenTimers.Count() && wo_apenTimers[i]==penThinker);
+  penThinker->en_iInTimers = -1;
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_TIMEROPERATIONS);
+
+  // fill the hole with the last timer
+  CRationalEntity *penLast = wo_apenTimers.Pop();
+  if (i<wo_apenTimers.Count()) {
+    PlaceTimer(wo_apenTimers, i, penLast);
+    // restore the heap order around it
+    if (i>0 && TimerIsBefore(penLast, wo_apenTimers[(i-1)/2])) {
+      SiftTimerUp(wo_apenTimers, i);
+    } else {
+      SiftTimerDown(wo_apenTimers, i);
     }
   }
-  // add the new entity before current one
-  iten.InsertBeforeCurrent(penThinker->en_lnInTimers);
+  // when no timers are left, reset the ordering
+  if (wo_apenTimers.Count()==0) {
+    wo_ulNextTimerOrder = 0;
+  }
+}
+
+static int qsort_CompareTimers(const void *ppv0, const void *ppv1)
+{
+  const CRationalEntity *pen0 = *(const CRationalEntity **)ppv0;
+  const CRationalEntity *pen1 = *(const CRationalEntity **)ppv1;
+  if (TimerIsBefore(pen0, pen1)) {
+    return -1;
+  } else if (TimerIsBefore(pen1, pen0)) {
+    return +1;
+  } else {
+    return 0;
+  }
+}
+
+/*
+ * Get all entities in list of thinkers, in order in which they are due.
+ */
+void CWorld::GetTimersInOrder(CStaticStackArray<CRationalEntity *> &apenTimers)
+{
+  apenTimers.PopAll();
+  const INDEX ct = wo_apenTimers.Count();
+  if (ct==0) {
+    return;
+  }
+  CRationalEntity **ppen = apenTimers.Push(ct);
+  memcpy(ppen, &wo_apenTimers[0], ct*sizeof(CRationalEntity *));
+  qsort(ppen, ct, sizeof(CRationalEntity *), qsort_CompareTimers);
+}
+
+/*
+ * Reschedule entities in list of thinkers so that they are due in given order.
+ */
+void CWorld::SetTimersOrder(CStaticStackArray<CRationalEntity *> &apenTimers)
+{
+  // re-add them from last to first, so that earlier ones end up before later ones
+  for (INDEX i=apenTimers.Count()-1; i>=0; i--) {
+    CRationalEntity *pen = apenTimers[i];
+    if (pen->en_iInTimers>=0) {
+      RemoveTimer(pen);
+    }
+    PushTimer(*this, pen);
+  }
 }
 
 // set overdue timers to be due in current time
@@ -390,15 +625,20 @@ void CWorld::AdjustLateTimers(TIME tmCurrentTime)
   // must be in 24bit mode when managing entities
   CSetFPUPrecision FPUPrecision(FPT_24BIT);
 
+  // get the timers in their current order
+  CStaticStackArray<CRationalEntity *> apenTimers;
+  GetTimersInOrder(apenTimers);
   // for each entity in the thinker list
-  FOREACHINLIST(CRationalEntity, en_lnInTimers, wo_lhTimers, iten) {
-    CRationalEntity &en = *iten;
+  for (INDEX i=0; i<apenTimers.Count(); i++) {
+    CRationalEntity &en = *apenTimers[i];
     // if the entity in list is overdue
     if (en.en_timeTimer<tmCurrentTime) {
       // set it to current time
       en.en_timeTimer = tmCurrentTime;
     }
   }
+  // keep them in same order, even those that now share the same moment
+  SetTimersOrder(apenTimers);
 }
 
 
@@ -506,11 +746,14 @@ void CWorld::CalculateDirectionalShadows(void)
   _ctShadowClusters=0;
 
   // for each shadow map that is queued for calculation
+  BeginShadowBake();
   FORDELETELIST(CBrushShadowMap, bsm_lnInUncalculatedShadowMaps,
     wo_baBrushes.ba_lhUncalculatedShadowMaps, itbsm) {
     // calculate shadows on it
     itbsm->GetBrushPolygon()->MakeShadowMap(this, TRUE);
   }
+  // wait for all layers to be finished
+  EndShadowBake();
 
   // report shadow rendering stats
   CTimerValue tvStop = _pTimer->GetHighPrecisionTimer();
@@ -522,12 +765,19 @@ void CWorld::CalculateDirectionalShadows(void)
 
 void CWorld::CalculateNonDirectionalShadows(void)
 {
+  // if nothing is queued, don't bother starting bake threads
+  if (wo_baBrushes.ba_lhUncalculatedShadowMaps.IsEmpty()) {
+    return;
+  }
   // for each shadow map that is queued for calculation
+  BeginShadowBake();
   FORDELETELIST(CBrushShadowMap, bsm_lnInUncalculatedShadowMaps,
     wo_baBrushes.ba_lhUncalculatedShadowMaps, itbsm) {
     // calculate shadows on it
     itbsm->GetBrushPolygon()->MakeShadowMap(this, FALSE);
   }
+  // wait for all layers to be finished
+  EndShadowBake();
 }
 
 
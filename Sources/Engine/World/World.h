@@ -94,7 +94,8 @@ public:
   CTString wo_strDescription; // description of the level (intro, mission, etc.)
 
   ULONG wo_ulNextEntityID;    // next free ID for entities
-  CListHead wo_lhTimers;      // timer scheduled entities
+  CStaticStackArray<CRationalEntity *> wo_apenTimers; // timer scheduled entities - heap sorted by wait time
+  ULONG wo_ulNextTimerOrder;  // next order for timers set at the same moment
   CListHead wo_lhMovers;        // entities that want to/have to move
   BOOL wo_bPortalLinksUpToDate; // set if portal-sector links are up to date
 
@@ -123,6 +124,16 @@ public:
 
   /* Add an entity to list of timers. */
   void AddTimer(CRationalEntity *penTimer);
+  /* Remove an entity from list of timers. */
+  void RemoveTimer(CRationalEntity *penTimer);
+  /* Get entity with the earliest timer (NULL if none). */
+  inline CRationalEntity *FirstTimer(void) {
+    return wo_apenTimers.Count()>0 ? wo_apenTimers[0] : NULL;
+  };
+  /* Get all entities in list of timers, in order in which they are due. */
+  void GetTimersInOrder(CStaticStackArray<CRationalEntity *> &apenTimers);
+  /* Reschedule entities so that they are due in given order. */
+  void SetTimersOrder(CStaticStackArray<CRationalEntity *> &apenTimers);
   // set overdue timers to be due in current time
   void AdjustLateTimers(TIME tmCurrentTime);
 
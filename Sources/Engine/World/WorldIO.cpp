@@ -16,6 +16,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "stdh.h"
 
 #include <Engine/Base/Stream.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 #include <Engine/Math/Float.h>
 #include <Engine/World/World.h>
 #include <Engine/World/WorldEditingProfile.h>
@@ -39,6 +42,8 @@ extern BOOL _bPortalSectorLinksPreLoaded;
 extern BOOL _bEntitySectorLinksPreLoaded;
 extern BOOL _bFileReplacingApplied;
 extern BOOL _bReadEntitiesByID = FALSE;
+extern INDEX fil_iLoaderThreads;
+extern void FreeUnusedStock(void);
 
 /*
  * Save entire world (both brushes  current state).
@@ -836,3 +841,43 @@ void CWorld::WriteInfo_t(CTStream *strm) // throw char *
   // write the world description
   (*strm)<<wo_strDescription;
 }
+
+
+// load a world without and with loader threads reading its files ahead and compare times
+static void WorldLoadBenchmark(const CTFileName &fnmWorld)
+{
+  // remember user's setting, passes below override it
+  const INDEX iLoaderThreadsOld = fil_iLoaderThreads;
+  const INDEX iLoaderThreads = (fil_iLoaderThreads>0) ? fil_iLoaderThreads : 2;
+  DOUBLE atmLoad[3];
+  for (INDEX iPass=0; iPass<3; iPass++) {
+    // first pass only fills system file cache, second is without loader threads, third with them
+    fil_iLoaderThreads = (iPass==2) ? iLoaderThreads : 0;
+    // make sure that resources are really loaded again (those used by current world stay on stock)
+    FreeUnusedStock();
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    try {
+      CWorld woWorld;
+      woWorld.Load_t(fnmWorld);
+      atmLoad[iPass] = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+    } catch (char *strError) {
+      CPrintF(TRANS("Cannot load world '%s': %s\n"), (const char*)fnmWorld, strError);
+      fil_iLoaderThreads = iLoaderThreadsOld;
+      return;
+    }
+  }
+  fil_iLoaderThreads = iLoaderThreadsOld;
+  FreeUnusedStock();
+
+  CPrintF(TRANS("Load of '%s':\n"), (const char*)fnmWorld);
+  CPrintF(TRANS("  first load:       %7.3fs\n"), atmLoad[0]);
+  CPrintF(TRANS("  no read ahead:    %7.3fs\n"), atmLoad[1]);
+  CPrintF(TRANS("  %2d loader threads: %7.3fs\n"), iLoaderThreads, atmLoad[2]);
+  CPrintF(TRANS("  speedup: %.2fx\n"), atmLoad[1]/ClampDn(atmLoad[2], 0.001));
+}
+
+void WorldLoadBenchmarkCfunc(void *pArgs)
+{
+  CTString strWorld = *NEXTARGUMENT(CTString*);
+  WorldLoadBenchmark(CTFileName(strWorld));
+}